@@ -41,6 +41,15 @@ ONNXTensorElementDataType TranslateTensorType(std::string_view value) {
   if (value == "float16") {
     return ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16;
   }
+  if (value == "bfloat16") {
+    return ONNX_TENSOR_ELEMENT_DATA_TYPE_BFLOAT16;
+  }
+  if (value == "int8") {
+    return ONNX_TENSOR_ELEMENT_DATA_TYPE_INT8;
+  }
+  if (value == "float8e4m3fn") {
+    return ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT8E4M3FN;
+  }
   throw std::runtime_error("Invalid tensor type: " + std::string(value));
 }
 
@@ -767,6 +776,10 @@ struct Vision_Element : JSON::Element {
       v_.patch_size = static_cast<int>(JSON::Get<double>(value));
     } else if (name == "window_size") {
       v_.window_size = static_cast<int>(JSON::Get<double>(value));
+    } else if (name == "max_packed_patches") {
+      v_.max_packed_patches = static_cast<int>(JSON::Get<double>(value));
+    } else if (name == "max_concurrent_runs") {
+      v_.max_concurrent_runs = static_cast<int>(JSON::Get<double>(value));
     } else {
       throw JSON::unknown_value_error{};
     }
@@ -1269,6 +1282,26 @@ struct DynamicBatching_Element : JSON::Element {
       v_->gpu_utilization_factor = static_cast<float>(JSON::Get<double>(value));
     } else if (name == "max_batch_size") {
       v_->max_batch_size = static_cast<size_t>(JSON::Get<double>(value));
+    } else if (name == "max_memory_bytes") {
+      v_->max_memory_bytes = static_cast<size_t>(JSON::Get<double>(value));
+    } else if (name == "enable_prefix_caching") {
+      v_->enable_prefix_caching = JSON::Get<bool>(value);
+    } else if (name == "preemption_mode") {
+      v_->preemption_mode = JSON::Get<std::string_view>(value);
+      if (v_->preemption_mode != "recompute" && v_->preemption_mode != "swap") {
+        throw std::runtime_error("Unsupported preemption_mode: " + v_->preemption_mode + ". Expected recompute or swap.");
+      }
+    } else if (name == "num_swap_blocks") {
+      v_->num_swap_blocks = static_cast<size_t>(JSON::Get<double>(value));
+    } else if (name == "num_disk_swap_blocks") {
+      v_->num_disk_swap_blocks = static_cast<size_t>(JSON::Get<double>(value));
+    } else if (name == "swap_file") {
+      v_->swap_file = JSON::Get<std::string_view>(value);
+    } else if (name == "max_num_batched_tokens") {
+      v_->max_num_batched_tokens = static_cast<size_t>(JSON::Get<double>(value));
+      if (*v_->max_num_batched_tokens == 0) {
+        throw std::runtime_error("max_num_batched_tokens must be greater than 0.");
+      }
     } else {
       throw JSON::unknown_value_error{};
     }
@@ -1293,9 +1326,34 @@ struct StaticBatching_Element : JSON::Element {
   std::optional<Config::Engine::StaticBatching>& v_;
 };
 
+struct Scheduling_Element : JSON::Element {
+  explicit Scheduling_Element(Config::Engine::Scheduling& v) : v_{v} {}
+
+  void OnValue(std::string_view name, JSON::Value value) override {
+    if (name == "policy") {
+      v_.policy = JSON::Get<std::string_view>(value);
+    } else if (name == "reject_missed_deadlines") {
+      v_.reject_missed_deadlines = JSON::Get<bool>(value);
+    } else {
+      throw JSON::unknown_value_error{};
+    }
+  }
+
+ private:
+  Config::Engine::Scheduling& v_;
+};
+
 struct Engine_Element : JSON::Element {
   explicit Engine_Element(Config::Engine& v) : v_{v} {}
 
+  void OnValue(std::string_view name, JSON::Value value) override {
+    if (name == "async_token_delivery") {
+      v_.async_token_delivery = JSON::Get<bool>(value);
+    } else {
+      throw JSON::unknown_value_error{};
+    }
+  }
+
   Element& OnObject(std::string_view name) override {
     if (name == "dynamic_batching") {
       if (v_.static_batching)
@@ -1305,6 +1363,8 @@ struct Engine_Element : JSON::Element {
       if (v_.dynamic_batching)
         v_.dynamic_batching.reset();
       return static_batching_;
+    } else if (name == "scheduling") {
+      return scheduling_;
     }
     throw JSON::unknown_value_error{};
   }
@@ -1313,6 +1373,39 @@ struct Engine_Element : JSON::Element {
   Config::Engine& v_;
   DynamicBatching_Element dynamic_batching_{v_.dynamic_batching};
   StaticBatching_Element static_batching_{v_.static_batching};
+  Scheduling_Element scheduling_{v_.scheduling};
+};
+
+struct PromptCache_Element : JSON::Element {
+  explicit PromptCache_Element(Config::PromptCache& v) : v_{v} {}
+
+  void OnValue(std::string_view name, JSON::Value value) override {
+    if (name == "max_bytes") {
+      v_.max_bytes = static_cast<size_t>(JSON::Get<double>(value));
+    } else if (name == "min_length") {
+      v_.min_length = static_cast<size_t>(JSON::Get<double>(value));
+    } else {
+      throw JSON::unknown_value_error{};
+    }
+  }
+
+ private:
+  Config::PromptCache& v_;
+};
+
+struct VisionCache_Element : JSON::Element {
+  explicit VisionCache_Element(Config::VisionCache& v) : v_{v} {}
+
+  void OnValue(std::string_view name, JSON::Value value) override {
+    if (name == "max_bytes") {
+      v_.max_bytes = static_cast<size_t>(JSON::Get<double>(value));
+    } else {
+      throw JSON::unknown_value_error{};
+    }
+  }
+
+ private:
+  Config::VisionCache& v_;
 };
 
 void SetSearchNumber(Config::Search& search, std::string_view name, double value) {
@@ -1500,6 +1593,8 @@ struct Root_Element : JSON::Element {
     if (name == "model") return model_element_;
     if (name == "search") return search_element_;
     if (name == "engine") return engine_element_;
+    if (name == "prompt_cache") return prompt_cache_element_;
+    if (name == "vision_cache") return vision_cache_element_;
     throw JSON::unknown_value_error{};
   }
 
@@ -1507,6 +1602,8 @@ struct Root_Element : JSON::Element {
   Model_Element model_element_{config_.model};
   Search_Element search_element_{config_.search};
   Engine_Element engine_element_{config_.engine};
+  PromptCache_Element prompt_cache_element_{config_.prompt_cache};
+  VisionCache_Element vision_cache_element_{config_.vision_cache};
 };
 
 struct RootObject_Element : JSON::Element {
@@ -42,6 +42,7 @@ struct Config {
     static constexpr std::string_view ImageAttentionMaskName = "image_attention_mask";
     static constexpr std::string_view ImageFeaturesName = "image_features";
     static constexpr std::string_view NumImageTokens = "num_image_tokens";
+    static constexpr std::string_view VisionCacheKeyName = "vision_cache_key";  // Key of the images in the vision cache, set by the processor
 
     // Embedding names
     static constexpr std::string_view AudioEmbedsName = "audio_embeds";
@@ -220,6 +221,12 @@ struct Config {
                            // 0 = auto-compute as patch_size * spatial_merge_size * 2
                            // Qwen2.5-VL default: 56 (14*4), Qwen3-VL default: 64 (16*4)
 
+      // Qwen VL multi-image runs, for vision models that take one image per run.
+      // Consecutive images of the same size are packed into one run as the frames of a single grid, since
+      // attention never crosses frames. This needs a graph that reads the frame count from image_grid_thw.
+      int max_packed_patches{0};   // Patch budget of a packed run. 0 runs every image separately
+      int max_concurrent_runs{1};  // Number of runs of the vision session in flight at once
+
       std::string config_filename{"processor_config.json"};
       std::optional<std::string> adapter_filename{};
 
@@ -399,10 +406,17 @@ struct Config {
 
   struct Engine {
     struct DynamicBatching {
-      size_t block_size{256};                       // Total number of slots per block.
-      std::optional<size_t> num_blocks;             // Total number of blocks per layer.
-      std::optional<float> gpu_utilization_factor;  // Fraction of free GPU memory to use for key-value cache.
-      size_t max_batch_size{16};                    // Maximum batch size for dynamically batching requests.
+      size_t block_size{256};                        // Total number of slots per block.
+      std::optional<size_t> num_blocks;              // Total number of blocks per layer.
+      std::optional<float> gpu_utilization_factor;   // Fraction of free GPU memory to use for key-value cache.
+      size_t max_batch_size{16};                     // Maximum batch size for dynamically batching requests.
+      std::optional<size_t> max_memory_bytes;        // Memory budget of the key-value cache and search state of the batched requests. Replaces max_batch_size when set. Unless num_blocks is set, the block pool is no larger than the budget.
+      bool enable_prefix_caching{};                  // Share the key-value cache blocks of identical prompt prefixes across requests.
+      std::string preemption_mode{"recompute"};      // How requests are preempted when the cache is full. "recompute" or "swap".
+      size_t num_swap_blocks{};                      // Number of host memory blocks per layer to swap preempted requests into. Only whole requests are swapped, so every request must still fit in num_blocks.
+      size_t num_disk_swap_blocks{};                 // Number of blocks per layer in swap_file, used once the host swap blocks are full. Holds preempted requests only, like num_swap_blocks.
+      std::string swap_file;                         // Path of the memory mapped file holding the disk swap blocks. Deleted when the engine is destroyed.
+      std::optional<size_t> max_num_batched_tokens;  // Maximum number of tokens processed in one step. Longer prompts are prefilled in chunks.
     };
     std::optional<DynamicBatching> dynamic_batching;  // Dynamic batching settings
 
@@ -410,8 +424,25 @@ struct Config {
       size_t max_batch_size{4};  // Maximum batch size for static batching
     };
     std::optional<StaticBatching> static_batching;  // Static batching settings
+
+    struct Scheduling {
+      std::string policy{"fcfs"};      // Order in which requests are served. "fcfs", "priority", "shortest_prompt_first" or "earliest_deadline_first".
+      bool reject_missed_deadlines{};  // Reject requests whose deadline cannot be met when they are added instead of queueing them.
+    };
+    Scheduling scheduling;  // Scheduling and admission control settings
+
+    bool async_token_delivery{};  // Hand a step's tokens to the application on a separate thread while the next step runs. Only applies to started engines.
   } engine;                                         // Engine settings
 
+  struct PromptCache {
+    size_t max_bytes{};      // Memory budget of the prompt cache shared by the generators of the model. 0 disables it.
+    size_t min_length{16};  // Prompts shorter than this are not cached
+  } prompt_cache;
+
+  struct VisionCache {
+    size_t max_bytes{};  // Memory budget of the cached image preprocessing results and vision encoder outputs. 0 disables it.
+  } vision_cache;
+
   void AddMapping(const std::string& nominal_name, const std::string& graph_name);
   // Returns graph name and true if the nominal name is found in the mapping
   // otherwise returns the nominal name and false
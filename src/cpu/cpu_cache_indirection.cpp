@@ -0,0 +1,31 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "cpu_cache_indirection.h"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace Generators {
+namespace cpu {
+
+void UpdateCacheIndirection(int32_t* tgt_indir_cache, const int32_t* src_indir_cache, const int32_t* beam_ids, int batch_size, int beam_width,
+                            int input_seq_length, int max_seq_length, int current_length) {
+  const int copy_begin = std::min(input_seq_length, current_length);
+  const int copy_end = std::max(copy_begin, current_length - 1);
+  for (int batch = 0; batch < batch_size; batch++) {
+    for (int beam = 0; beam < beam_width; beam++) {
+      const int src_beam = beam_ids[batch * beam_width + beam] % beam_width;
+      int32_t* tgt = tgt_indir_cache + (static_cast<size_t>(batch) * beam_width + beam) * max_seq_length;
+      const int32_t* src = src_indir_cache + (static_cast<size_t>(batch) * beam_width + src_beam) * max_seq_length;
+
+      std::fill(tgt, tgt + copy_begin, 0);
+      std::copy(src + copy_begin, src + copy_end, tgt + copy_begin);
+      if (copy_end < current_length)
+        tgt[current_length - 1] = beam;
+    }
+  }
+}
+
+}  // namespace cpu
+}  // namespace Generators
@@ -0,0 +1,19 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <cstdint>
+
+namespace Generators {
+namespace cpu {
+
+// Writes the cache indirection table of the next step to tgt_indir_cache, both tables have shape
+// (batch_size, beam_width, max_seq_length). beam_ids holds the source beam of every beam picked in the last step.
+// The prompt tokens [0, input_seq_length) come from beam 0, the last token from the beam itself, and the tokens in
+// between are taken from the table of the source beam. Only the first current_length tokens of each beam are written.
+void UpdateCacheIndirection(int32_t* tgt_indir_cache, const int32_t* src_indir_cache, const int32_t* beam_ids, int batch_size, int beam_width,
+                            int input_seq_length, int max_seq_length, int current_length);
+
+}  // namespace cpu
+}  // namespace Generators
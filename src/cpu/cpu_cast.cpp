@@ -0,0 +1,318 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "cpu_cast.h"
+
+#include <cassert>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define OGA_CPU_CAST_X64 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define OGA_TARGET_AVX2
+#define OGA_TARGET_AVX512
+#else
+#define OGA_TARGET_AVX2 __attribute__((target("avx2,f16c")))
+#define OGA_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+#elif (defined(__aarch64__) || defined(_M_ARM64)) && (defined(__ARM_NEON) || defined(_M_ARM64))
+#define OGA_CPU_CAST_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace Generators {
+namespace cpu {
+
+namespace {
+
+enum struct Isa {
+  Scalar,
+  Avx2,  // With F16C, which every AVX2 CPU has
+  Avx512,
+};
+
+Isa DetectIsa() {
+#if defined(OGA_CPU_CAST_X64)
+#if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  __cpuidex(info, 1, 0);
+  const bool has_f16c = (info[2] & (1 << 29)) != 0;
+  const bool has_osxsave = (info[2] & (1 << 27)) != 0;
+  if (!has_osxsave)
+    return Isa::Scalar;
+  const unsigned long long xcr0 = _xgetbv(0);
+  __cpuidex(info, 7, 0);
+  const bool has_avx2 = (info[1] & (1 << 5)) != 0;
+  const bool has_avx512f = (info[1] & (1 << 16)) != 0;
+  if (has_avx512f && (xcr0 & 0xe6) == 0xe6)
+    return Isa::Avx512;
+  if (has_avx2 && has_f16c && (xcr0 & 0x6) == 0x6)
+    return Isa::Avx2;
+#else
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return Isa::Avx512;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c"))
+    return Isa::Avx2;
+#endif
+#endif
+  return Isa::Scalar;
+}
+
+Isa GetIsa() {
+  static const Isa isa = DetectIsa();
+  return isa;
+}
+
+uint32_t FloatBits(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+float BitsFloat(uint32_t bits) {
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// The scalar conversions follow F. Giesen's half_to_float and float_to_half_fast3_rtne, with NaNs handled
+// like the F16C instructions do (quieted, payload kept) so that every path gives the same bits.
+float Float16ToFloat32(uint16_t value) {
+  constexpr uint32_t kShiftedExponent = 0x7c00u << 13;  // Exponent mask after the shift
+  uint32_t bits = (value & 0x7fffu) << 13;
+  const uint32_t exponent = bits & kShiftedExponent;
+  bits += (127 - 15) << 23;  // Adjust the exponent bias
+  if (exponent == kShiftedExponent) {
+    bits += (128 - 16) << 23;  // Infinity or NaN
+    if (bits & 0x007fffffu)
+      bits |= 0x00400000u;  // Quiet the NaN
+  } else if (exponent == 0) {
+    bits += 1 << 23;  // Denormal, renormalize through the FPU
+    bits = FloatBits(BitsFloat(bits) - BitsFloat(113u << 23));
+  }
+  return BitsFloat(bits | (static_cast<uint32_t>(value & 0x8000u) << 16));
+}
+
+uint16_t Float32ToFloat16(float value) {
+  uint32_t bits = FloatBits(value);
+  const uint32_t sign = (bits >> 16) & 0x8000u;
+  bits &= 0x7fffffffu;
+
+  uint32_t result;
+  if (bits >= 0x47800000u) {  // At least 65536, or infinity or NaN
+    result = bits > 0x7f800000u ? 0x7e00u | ((bits >> 13) & 0x3ffu) : 0x7c00u;
+  } else if (bits < 0x38800000u) {  // Below the smallest normal, rounded by the FPU when adding 0.5
+    result = FloatBits(BitsFloat(bits) + 0.5f) - FloatBits(0.5f);
+  } else {
+    const uint32_t mantissa_odd = (bits >> 13) & 1;
+    bits += (static_cast<uint32_t>(15 - 127) << 23) + 0xfffu;  // Adjust the exponent bias and round
+    bits += mantissa_odd;
+    result = bits >> 13;
+  }
+  return static_cast<uint16_t>(result | sign);
+}
+
+void CastFloat16ToFloat32Scalar(const uint16_t* input, float* output, size_t begin, size_t count) {
+  for (size_t i = begin; i < count; i++)
+    output[i] = Float16ToFloat32(input[i]);
+}
+
+void CastFloat32ToFloat16Scalar(const float* input, uint16_t* output, size_t begin, size_t count) {
+  for (size_t i = begin; i < count; i++)
+    output[i] = Float32ToFloat16(input[i]);
+}
+
+void CastBFloat16ToFloat32Scalar(const uint16_t* input, float* output, size_t begin, size_t count) {
+  for (size_t i = begin; i < count; i++)
+    output[i] = BitsFloat(static_cast<uint32_t>(input[i]) << 16);
+}
+
+void CastFloat32ToBFloat16Scalar(const float* input, uint16_t* output, size_t begin, size_t count) {
+  for (size_t i = begin; i < count; i++)
+    output[i] = static_cast<uint16_t>(FloatBits(input[i]) >> 16);
+}
+
+#if defined(OGA_CPU_CAST_X64)
+
+OGA_TARGET_AVX2 void CastFloat16ToFloat32Avx2(const uint16_t* input, float* output, size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8)
+    _mm256_storeu_ps(output + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i))));
+  CastFloat16ToFloat32Scalar(input, output, i, count);
+}
+
+OGA_TARGET_AVX2 void CastFloat32ToFloat16Avx2(const float* input, uint16_t* output, size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8)
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm256_cvtps_ph(_mm256_loadu_ps(input + i), _MM_FROUND_TO_NEAREST_INT));
+  CastFloat32ToFloat16Scalar(input, output, i, count);
+}
+
+OGA_TARGET_AVX2 void CastBFloat16ToFloat32Avx2(const uint16_t* input, float* output, size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m256i bits = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), _mm256_slli_epi32(bits, 16));
+  }
+  CastBFloat16ToFloat32Scalar(input, output, i, count);
+}
+
+OGA_TARGET_AVX2 void CastFloat32ToBFloat16Avx2(const float* input, uint16_t* output, size_t count) {
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    const __m256i low = _mm256_srli_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i)), 16);
+    const __m256i high = _mm256_srli_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i + 8)), 16);
+    // The pack interleaves the 128 bit lanes of its operands, the permute puts them back in order
+    const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(low, high), 0xd8);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), packed);
+  }
+  CastFloat32ToBFloat16Scalar(input, output, i, count);
+}
+
+OGA_TARGET_AVX512 void CastFloat16ToFloat32Avx512(const uint16_t* input, float* output, size_t count) {
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16)
+    _mm512_storeu_ps(output + i, _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i))));
+  CastFloat16ToFloat32Scalar(input, output, i, count);
+}
+
+OGA_TARGET_AVX512 void CastFloat32ToFloat16Avx512(const float* input, uint16_t* output, size_t count) {
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    const __m256i half = _mm512_cvtps_ph(_mm512_loadu_ps(input + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), half);
+  }
+  CastFloat32ToFloat16Scalar(input, output, i, count);
+}
+
+OGA_TARGET_AVX512 void CastBFloat16ToFloat32Avx512(const uint16_t* input, float* output, size_t count) {
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    const __m512i bits = _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i)));
+    _mm512_storeu_si512(output + i, _mm512_slli_epi32(bits, 16));
+  }
+  CastBFloat16ToFloat32Scalar(input, output, i, count);
+}
+
+OGA_TARGET_AVX512 void CastFloat32ToBFloat16Avx512(const float* input, uint16_t* output, size_t count) {
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    const __m512i bits = _mm512_srli_epi32(_mm512_loadu_si512(input + i), 16);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), _mm512_cvtepi32_epi16(bits));
+  }
+  CastFloat32ToBFloat16Scalar(input, output, i, count);
+}
+
+#endif
+
+#if defined(OGA_CPU_CAST_NEON)
+
+void CastFloat16ToFloat32Neon(const uint16_t* input, float* output, size_t count) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4)
+    vst1q_f32(output + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(input + i))));
+  CastFloat16ToFloat32Scalar(input, output, i, count);
+}
+
+void CastFloat32ToFloat16Neon(const float* input, uint16_t* output, size_t count) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4)
+    vst1_u16(output + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(input + i))));
+  CastFloat32ToFloat16Scalar(input, output, i, count);
+}
+
+void CastBFloat16ToFloat32Neon(const uint16_t* input, float* output, size_t count) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4)
+    vst1q_f32(output + i, vreinterpretq_f32_u32(vshll_n_u16(vld1_u16(input + i), 16)));
+  CastBFloat16ToFloat32Scalar(input, output, i, count);
+}
+
+void CastFloat32ToBFloat16Neon(const float* input, uint16_t* output, size_t count) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4)
+    vst1_u16(output + i, vshrn_n_u32(vreinterpretq_u32_f32(vld1q_f32(input + i)), 16));
+  CastFloat32ToBFloat16Scalar(input, output, i, count);
+}
+
+#endif
+
+}  // namespace
+
+void CastFloat16ToFloat32(std::span<const uint16_t> input, std::span<float> output) {
+  assert(output.size() >= input.size());
+  switch (GetIsa()) {
+#if defined(OGA_CPU_CAST_X64)
+    case Isa::Avx512:
+      return CastFloat16ToFloat32Avx512(input.data(), output.data(), input.size());
+    case Isa::Avx2:
+      return CastFloat16ToFloat32Avx2(input.data(), output.data(), input.size());
+#endif
+    default:
+#if defined(OGA_CPU_CAST_NEON)
+      return CastFloat16ToFloat32Neon(input.data(), output.data(), input.size());
+#else
+      return CastFloat16ToFloat32Scalar(input.data(), output.data(), 0, input.size());
+#endif
+  }
+}
+
+void CastFloat32ToFloat16(std::span<const float> input, std::span<uint16_t> output) {
+  assert(output.size() >= input.size());
+  switch (GetIsa()) {
+#if defined(OGA_CPU_CAST_X64)
+    case Isa::Avx512:
+      return CastFloat32ToFloat16Avx512(input.data(), output.data(), input.size());
+    case Isa::Avx2:
+      return CastFloat32ToFloat16Avx2(input.data(), output.data(), input.size());
+#endif
+    default:
+#if defined(OGA_CPU_CAST_NEON)
+      return CastFloat32ToFloat16Neon(input.data(), output.data(), input.size());
+#else
+      return CastFloat32ToFloat16Scalar(input.data(), output.data(), 0, input.size());
+#endif
+  }
+}
+
+void CastBFloat16ToFloat32(std::span<const uint16_t> input, std::span<float> output) {
+  assert(output.size() >= input.size());
+  switch (GetIsa()) {
+#if defined(OGA_CPU_CAST_X64)
+    case Isa::Avx512:
+      return CastBFloat16ToFloat32Avx512(input.data(), output.data(), input.size());
+    case Isa::Avx2:
+      return CastBFloat16ToFloat32Avx2(input.data(), output.data(), input.size());
+#endif
+    default:
+#if defined(OGA_CPU_CAST_NEON)
+      return CastBFloat16ToFloat32Neon(input.data(), output.data(), input.size());
+#else
+      return CastBFloat16ToFloat32Scalar(input.data(), output.data(), 0, input.size());
+#endif
+  }
+}
+
+void CastFloat32ToBFloat16(std::span<const float> input, std::span<uint16_t> output) {
+  assert(output.size() >= input.size());
+  switch (GetIsa()) {
+#if defined(OGA_CPU_CAST_X64)
+    case Isa::Avx512:
+      return CastFloat32ToBFloat16Avx512(input.data(), output.data(), input.size());
+    case Isa::Avx2:
+      return CastFloat32ToBFloat16Avx2(input.data(), output.data(), input.size());
+#endif
+    default:
+#if defined(OGA_CPU_CAST_NEON)
+      return CastFloat32ToBFloat16Neon(input.data(), output.data(), input.size());
+#else
+      return CastFloat32ToBFloat16Scalar(input.data(), output.data(), 0, input.size());
+#endif
+  }
+}
+
+}  // namespace cpu
+}  // namespace Generators
@@ -0,0 +1,29 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <cstdint>
+#include "../span.h"
+
+namespace Generators {
+namespace cpu {
+
+// Conversions between float and the 16 bit float types, vectorized with the best instruction set of the CPU
+// (AVX-512, AVX2 with F16C, or NEON) and falling back to scalar code. All paths produce the same results.
+// The output must be at least as large as the input.
+
+// IEEE binary16 to float, exact including denormals, infinities and NaNs.
+void CastFloat16ToFloat32(std::span<const uint16_t> input, std::span<float> output);
+
+// Float to IEEE binary16, rounded to nearest even. Values too large for binary16 become infinities.
+void CastFloat32ToFloat16(std::span<const float> input, std::span<uint16_t> output);
+
+// BFloat16 to float, exact.
+void CastBFloat16ToFloat32(std::span<const uint16_t> input, std::span<float> output);
+
+// Float to BFloat16 by truncating the low 16 bits of the mantissa.
+void CastFloat32ToBFloat16(std::span<const float> input, std::span<uint16_t> output);
+
+}  // namespace cpu
+}  // namespace Generators
@@ -0,0 +1,644 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "cpu_sampling.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define OGA_CPU_SAMPLING_X64 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define OGA_TARGET_AVX2
+#define OGA_TARGET_AVX512
+#else
+#define OGA_TARGET_AVX2 __attribute__((target("avx2,fma,popcnt")))
+#define OGA_TARGET_AVX512 __attribute__((target("avx512f,popcnt")))
+#endif
+#elif (defined(__aarch64__) || defined(_M_ARM64)) && (defined(__ARM_NEON) || defined(_M_ARM64))
+#define OGA_CPU_SAMPLING_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace Generators {
+namespace cpu {
+
+namespace {
+
+// Constants of the Cephes single precision exp approximation, accurate to about 1 ulp.
+// The kernels only see arguments <= 0. Arguments below kExpMin, including the -inf of masked logits, produce 0.
+constexpr float kExpMin = -87.3f;
+constexpr float kLog2e = 1.44269504088896341f;
+constexpr float kLn2Hi = 0.693359375f;
+constexpr float kLn2Lo = -2.12194440e-4f;
+constexpr float kExpP0 = 1.9875691500e-4f;
+constexpr float kExpP1 = 1.3981999507e-3f;
+constexpr float kExpP2 = 8.3334519073e-3f;
+constexpr float kExpP3 = 4.1665795894e-2f;
+constexpr float kExpP4 = 1.6666665459e-1f;
+constexpr float kExpP5 = 5.0000001201e-1f;
+
+enum struct Isa {
+  Scalar,
+  Avx2,
+  Avx512,
+};
+
+Isa DetectIsa() {
+#if defined(OGA_CPU_SAMPLING_X64)
+#if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  __cpuidex(info, 1, 0);
+  const bool has_fma = (info[2] & (1 << 12)) != 0;
+  const bool has_osxsave = (info[2] & (1 << 27)) != 0;
+  if (!has_osxsave)
+    return Isa::Scalar;
+  const unsigned long long xcr0 = _xgetbv(0);
+  __cpuidex(info, 7, 0);
+  const bool has_avx2 = (info[1] & (1 << 5)) != 0;
+  const bool has_avx512f = (info[1] & (1 << 16)) != 0;
+  if (has_avx512f && (xcr0 & 0xe6) == 0xe6)
+    return Isa::Avx512;
+  if (has_avx2 && has_fma && (xcr0 & 0x6) == 0x6)
+    return Isa::Avx2;
+#else
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return Isa::Avx512;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return Isa::Avx2;
+#endif
+#endif
+  return Isa::Scalar;
+}
+
+Isa GetIsa() {
+  static const Isa isa = DetectIsa();
+  return isa;
+}
+
+// Unnormalized probabilities are in [0, 1], so their bit patterns are ordered and at most 0x3f800000.
+// Bucketing by the top 12 bits keeps the exponent and 3 mantissa bits and fits in kNumBuckets.
+size_t ProbBucket(float prob) {
+  uint32_t bits;
+  std::memcpy(&bits, &prob, sizeof(bits));
+  return bits >> 20;
+}
+
+float BucketLowerBound(size_t bucket) {
+  const uint32_t bits = static_cast<uint32_t>(bucket) << 20;
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+float MaxScoreScalar(const float* scores, size_t begin, size_t end, float max_score) {
+  for (size_t i = begin; i < end; i++)
+    max_score = std::max(max_score, scores[i]);
+  return max_score;
+}
+
+size_t FindAboveScalar(const float* scores, size_t begin, size_t end, float threshold) {
+  for (size_t i = begin; i < end; i++) {
+    if (scores[i] > threshold)
+      return i;
+  }
+  return end;
+}
+
+size_t GatherAboveScalar(const float* values, size_t begin, size_t end, float threshold, int32_t* indices) {
+  size_t count = 0;
+  for (size_t i = begin; i < end; i++) {
+    indices[count] = static_cast<int32_t>(i);
+    count += values[i] > threshold;
+  }
+  return count;
+}
+
+float ExpScalar(const float* scores, float* probs, size_t begin, size_t end, float max_score, float inverse_temperature) {
+  float sum = 0.0f;
+  for (size_t i = begin; i < end; i++) {
+    const float x = (scores[i] - max_score) * inverse_temperature;
+    probs[i] = x >= kExpMin ? std::exp(x) : 0.0f;
+    sum += probs[i];
+  }
+  return sum;
+}
+
+#if defined(OGA_CPU_SAMPLING_X64)
+
+size_t CountTrailingZeros(uint32_t mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return index;
+#else
+  return static_cast<size_t>(__builtin_ctz(mask));
+#endif
+}
+
+size_t PopCount(uint32_t mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  return __popcnt(mask);
+#else
+  return static_cast<size_t>(__builtin_popcount(mask));
+#endif
+}
+
+OGA_TARGET_AVX2 float MaxScoreAvx2(const float* scores, size_t count) {
+  __m256 max_score = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8)
+    max_score = _mm256_max_ps(max_score, _mm256_loadu_ps(scores + i));
+  __m128 max4 = _mm_max_ps(_mm256_castps256_ps128(max_score), _mm256_extractf128_ps(max_score, 1));
+  max4 = _mm_max_ps(max4, _mm_movehl_ps(max4, max4));
+  max4 = _mm_max_ss(max4, _mm_shuffle_ps(max4, max4, 1));
+  return MaxScoreScalar(scores, i, count, _mm_cvtss_f32(max4));
+}
+
+OGA_TARGET_AVX2 size_t FindAboveAvx2(const float* scores, size_t begin, size_t count, float threshold) {
+  const __m256 limit = _mm256_set1_ps(threshold);
+  size_t i = begin;
+  for (; i + 8 <= count; i += 8) {
+    const int mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(scores + i), limit, _CMP_GT_OQ));
+    if (mask != 0)
+      return i + CountTrailingZeros(static_cast<uint32_t>(mask));
+  }
+  return FindAboveScalar(scores, i, count, threshold);
+}
+
+// For every 8 bit mask, the lanes of its set bits packed to the front, one byte per lane
+constexpr std::array<uint64_t, 256> MakeLeftPackTable() {
+  std::array<uint64_t, 256> table{};
+  for (uint32_t mask = 0; mask < 256; mask++) {
+    uint32_t num_lanes = 0;
+    for (uint32_t lane = 0; lane < 8; lane++) {
+      if (mask & (1u << lane))
+        table[mask] |= static_cast<uint64_t>(lane) << (8 * num_lanes++);
+    }
+  }
+  return table;
+}
+
+constexpr std::array<uint64_t, 256> kLeftPackTable = MakeLeftPackTable();
+
+// Stores all 8 lanes every time and advances by the number of selected ones, so it writes up to 8 entries
+// past the gathered ones. This stays within indices as long as it is as large as values.
+OGA_TARGET_AVX2 size_t GatherAboveAvx2(const float* values, size_t count, float threshold, int32_t* indices) {
+  const __m256 limit = _mm256_set1_ps(threshold);
+  size_t num_gathered = 0;
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(values + i), limit, _CMP_GT_OQ)));
+    const __m256i lanes = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(static_cast<long long>(kLeftPackTable[mask])));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(indices + num_gathered), _mm256_add_epi32(lanes, _mm256_set1_epi32(static_cast<int32_t>(i))));
+    num_gathered += PopCount(mask);
+  }
+  return num_gathered + GatherAboveScalar(values, i, count, threshold, indices + num_gathered);
+}
+
+OGA_TARGET_AVX2 __m256 ExpAvx2(__m256 x) {
+  const __m256 in_range = _mm256_cmp_ps(x, _mm256_set1_ps(kExpMin), _CMP_GE_OQ);
+  x = _mm256_max_ps(x, _mm256_set1_ps(kExpMin));
+  const __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(kLog2e)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  __m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(kLn2Hi), x);
+  r = _mm256_fnmadd_ps(n, _mm256_set1_ps(kLn2Lo), r);
+  __m256 y = _mm256_set1_ps(kExpP0);
+  y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(kExpP1));
+  y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(kExpP2));
+  y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(kExpP3));
+  y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(kExpP4));
+  y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(kExpP5));
+  y = _mm256_fmadd_ps(y, _mm256_mul_ps(r, r), _mm256_add_ps(r, _mm256_set1_ps(1.0f)));
+  const __m256i exponent = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+  return _mm256_and_ps(_mm256_mul_ps(y, _mm256_castsi256_ps(exponent)), in_range);
+}
+
+OGA_TARGET_AVX2 float ExpAvx2(const float* scores, float* probs, size_t count, float max_score, float inverse_temperature) {
+  const __m256 max = _mm256_set1_ps(max_score);
+  const __m256 scale = _mm256_set1_ps(inverse_temperature);
+  __m256 sum = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m256 prob = ExpAvx2(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(scores + i), max), scale));
+    _mm256_storeu_ps(probs + i, prob);
+    sum = _mm256_add_ps(sum, prob);
+  }
+  __m128 sum4 = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+  sum4 = _mm_add_ps(sum4, _mm_movehl_ps(sum4, sum4));
+  sum4 = _mm_add_ss(sum4, _mm_shuffle_ps(sum4, sum4, 1));
+  return _mm_cvtss_f32(sum4) + ExpScalar(scores, probs, i, count, max_score, inverse_temperature);
+}
+
+OGA_TARGET_AVX512 float MaxScoreAvx512(const float* scores, size_t count) {
+  __m512 max_score = _mm512_set1_ps(-std::numeric_limits<float>::infinity());
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16)
+    max_score = _mm512_max_ps(max_score, _mm512_loadu_ps(scores + i));
+  return MaxScoreScalar(scores, i, count, _mm512_reduce_max_ps(max_score));
+}
+
+OGA_TARGET_AVX512 size_t FindAboveAvx512(const float* scores, size_t begin, size_t count, float threshold) {
+  const __m512 limit = _mm512_set1_ps(threshold);
+  size_t i = begin;
+  for (; i + 16 <= count; i += 16) {
+    const __mmask16 mask = _mm512_cmp_ps_mask(_mm512_loadu_ps(scores + i), limit, _CMP_GT_OQ);
+    if (mask != 0)
+      return i + CountTrailingZeros(static_cast<uint32_t>(mask));
+  }
+  return FindAboveScalar(scores, i, count, threshold);
+}
+
+OGA_TARGET_AVX512 size_t GatherAboveAvx512(const float* values, size_t count, float threshold, int32_t* indices) {
+  const __m512 limit = _mm512_set1_ps(threshold);
+  __m512i lane_indices = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  size_t num_gathered = 0;
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    const __mmask16 mask = _mm512_cmp_ps_mask(_mm512_loadu_ps(values + i), limit, _CMP_GT_OQ);
+    _mm512_mask_compressstoreu_epi32(indices + num_gathered, mask, lane_indices);
+    num_gathered += PopCount(mask);
+    lane_indices = _mm512_add_epi32(lane_indices, _mm512_set1_epi32(16));
+  }
+  return num_gathered + GatherAboveScalar(values, i, count, threshold, indices + num_gathered);
+}
+
+OGA_TARGET_AVX512 __m512 ExpAvx512(__m512 x) {
+  const __mmask16 in_range = _mm512_cmp_ps_mask(x, _mm512_set1_ps(kExpMin), _CMP_GE_OQ);
+  x = _mm512_max_ps(x, _mm512_set1_ps(kExpMin));
+  const __m512 n = _mm512_roundscale_ps(_mm512_mul_ps(x, _mm512_set1_ps(kLog2e)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  __m512 r = _mm512_fnmadd_ps(n, _mm512_set1_ps(kLn2Hi), x);
+  r = _mm512_fnmadd_ps(n, _mm512_set1_ps(kLn2Lo), r);
+  __m512 y = _mm512_set1_ps(kExpP0);
+  y = _mm512_fmadd_ps(y, r, _mm512_set1_ps(kExpP1));
+  y = _mm512_fmadd_ps(y, r, _mm512_set1_ps(kExpP2));
+  y = _mm512_fmadd_ps(y, r, _mm512_set1_ps(kExpP3));
+  y = _mm512_fmadd_ps(y, r, _mm512_set1_ps(kExpP4));
+  y = _mm512_fmadd_ps(y, r, _mm512_set1_ps(kExpP5));
+  y = _mm512_fmadd_ps(y, _mm512_mul_ps(r, r), _mm512_add_ps(r, _mm512_set1_ps(1.0f)));
+  const __m512i exponent = _mm512_slli_epi32(_mm512_add_epi32(_mm512_cvtps_epi32(n), _mm512_set1_epi32(127)), 23);
+  return _mm512_maskz_mul_ps(in_range, y, _mm512_castsi512_ps(exponent));
+}
+
+OGA_TARGET_AVX512 float ExpAvx512(const float* scores, float* probs, size_t count, float max_score, float inverse_temperature) {
+  const __m512 max = _mm512_set1_ps(max_score);
+  const __m512 scale = _mm512_set1_ps(inverse_temperature);
+  __m512 sum = _mm512_setzero_ps();
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    const __m512 prob = ExpAvx512(_mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(scores + i), max), scale));
+    _mm512_storeu_ps(probs + i, prob);
+    sum = _mm512_add_ps(sum, prob);
+  }
+  return _mm512_reduce_add_ps(sum) + ExpScalar(scores, probs, i, count, max_score, inverse_temperature);
+}
+
+#elif defined(OGA_CPU_SAMPLING_NEON)
+
+float MaxScoreNeon(const float* scores, size_t count) {
+  float32x4_t max_score = vdupq_n_f32(-std::numeric_limits<float>::infinity());
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4)
+    max_score = vmaxq_f32(max_score, vld1q_f32(scores + i));
+  return MaxScoreScalar(scores, i, count, vmaxvq_f32(max_score));
+}
+
+size_t FindAboveNeon(const float* scores, size_t begin, size_t count, float threshold) {
+  const float32x4_t limit = vdupq_n_f32(threshold);
+  size_t i = begin;
+  for (; i + 4 <= count; i += 4) {
+    if (vmaxvq_u32(vcgtq_f32(vld1q_f32(scores + i), limit)) != 0)
+      return FindAboveScalar(scores, i, i + 4, threshold);
+  }
+  return FindAboveScalar(scores, i, count, threshold);
+}
+
+size_t GatherAboveNeon(const float* values, size_t count, float threshold, int32_t* indices) {
+  const float32x4_t limit = vdupq_n_f32(threshold);
+  size_t num_gathered = 0;
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    if (vmaxvq_u32(vcgtq_f32(vld1q_f32(values + i), limit)) != 0)
+      num_gathered += GatherAboveScalar(values, i, i + 4, threshold, indices + num_gathered);
+  }
+  return num_gathered + GatherAboveScalar(values, i, count, threshold, indices + num_gathered);
+}
+
+float32x4_t ExpNeon(float32x4_t x) {
+  const uint32x4_t in_range = vcgeq_f32(x, vdupq_n_f32(kExpMin));
+  x = vmaxq_f32(x, vdupq_n_f32(kExpMin));
+  const float32x4_t n = vrndnq_f32(vmulq_f32(x, vdupq_n_f32(kLog2e)));
+  float32x4_t r = vfmsq_f32(x, n, vdupq_n_f32(kLn2Hi));
+  r = vfmsq_f32(r, n, vdupq_n_f32(kLn2Lo));
+  float32x4_t y = vdupq_n_f32(kExpP0);
+  y = vfmaq_f32(vdupq_n_f32(kExpP1), y, r);
+  y = vfmaq_f32(vdupq_n_f32(kExpP2), y, r);
+  y = vfmaq_f32(vdupq_n_f32(kExpP3), y, r);
+  y = vfmaq_f32(vdupq_n_f32(kExpP4), y, r);
+  y = vfmaq_f32(vdupq_n_f32(kExpP5), y, r);
+  y = vfmaq_f32(vaddq_f32(r, vdupq_n_f32(1.0f)), y, vmulq_f32(r, r));
+  const int32x4_t exponent = vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(n), vdupq_n_s32(127)), 23);
+  const float32x4_t result = vmulq_f32(y, vreinterpretq_f32_s32(exponent));
+  return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(result), in_range));
+}
+
+float ExpNeon(const float* scores, float* probs, size_t count, float max_score, float inverse_temperature) {
+  const float32x4_t max = vdupq_n_f32(max_score);
+  const float32x4_t scale = vdupq_n_f32(inverse_temperature);
+  float32x4_t sum = vdupq_n_f32(0.0f);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const float32x4_t prob = ExpNeon(vmulq_f32(vsubq_f32(vld1q_f32(scores + i), max), scale));
+    vst1q_f32(probs + i, prob);
+    sum = vaddq_f32(sum, prob);
+  }
+  return vaddvq_f32(sum) + ExpScalar(scores, probs, i, count, max_score, inverse_temperature);
+}
+
+#endif
+
+// Returns the index of the first score after begin that is greater than threshold, or scores.size() if there is none.
+size_t FindAbove(std::span<const float> scores, size_t begin, float threshold) {
+  switch (GetIsa()) {
+#if defined(OGA_CPU_SAMPLING_X64)
+    case Isa::Avx512:
+      return FindAboveAvx512(scores.data(), begin, scores.size(), threshold);
+    case Isa::Avx2:
+      return FindAboveAvx2(scores.data(), begin, scores.size(), threshold);
+#endif
+    default:
+#if defined(OGA_CPU_SAMPLING_NEON)
+      return FindAboveNeon(scores.data(), begin, scores.size(), threshold);
+#else
+      return FindAboveScalar(scores.data(), begin, scores.size(), threshold);
+#endif
+  }
+}
+
+// Writes the indices of the values greater than threshold to indices in ascending order and returns their number.
+// indices must have room for values.size() entries.
+size_t GatherAbove(std::span<const float> values, float threshold, int32_t* indices) {
+  switch (GetIsa()) {
+#if defined(OGA_CPU_SAMPLING_X64)
+    case Isa::Avx512:
+      return GatherAboveAvx512(values.data(), values.size(), threshold, indices);
+    case Isa::Avx2:
+      return GatherAboveAvx2(values.data(), values.size(), threshold, indices);
+#endif
+    default:
+#if defined(OGA_CPU_SAMPLING_NEON)
+      return GatherAboveNeon(values.data(), values.size(), threshold, indices);
+#else
+      return GatherAboveScalar(values.data(), 0, values.size(), threshold, indices);
+#endif
+  }
+}
+
+// Draws a token from the first count candidates in data.indices, weighted by their unnormalized probabilities.
+int32_t SampleCandidates(const SamplingData& data, std::span<const float> probs, size_t count, double mass, std::mt19937& generator) {
+  std::uniform_real_distribution<double> distribution(0.0, mass);
+  const double threshold = distribution(generator);
+  double cumulative = 0.0;
+  int32_t token = data.indices[0];
+  for (size_t i = 0; i < count; i++) {
+    const float prob = probs[data.indices[i]];
+    if (prob <= 0.0f)
+      continue;
+    token = data.indices[i];
+    cumulative += prob;
+    if (cumulative > threshold)
+      break;
+  }
+  return token;
+}
+
+}  // namespace
+
+SamplingData::SamplingData(size_t vocab_size)
+    : indices(vocab_size), candidates(vocab_size), probs(vocab_size) {}
+
+float MaxScore(std::span<const float> scores) {
+  switch (GetIsa()) {
+#if defined(OGA_CPU_SAMPLING_X64)
+    case Isa::Avx512:
+      return MaxScoreAvx512(scores.data(), scores.size());
+    case Isa::Avx2:
+      return MaxScoreAvx2(scores.data(), scores.size());
+#endif
+    default:
+#if defined(OGA_CPU_SAMPLING_NEON)
+      return MaxScoreNeon(scores.data(), scores.size());
+#else
+      return MaxScoreScalar(scores.data(), 0, scores.size(), -std::numeric_limits<float>::infinity());
+#endif
+  }
+}
+
+int32_t ArgMax(std::span<const float> scores) {
+  const float max_score = MaxScore(scores);
+  const auto it = std::find(scores.begin(), scores.end(), max_score);
+  return it == scores.end() ? 0 : static_cast<int32_t>(std::distance(scores.begin(), it));
+}
+
+float ExpWithTemperature(std::span<const float> scores, std::span<float> probs, float max_score, float temperature) {
+  assert(probs.size() >= scores.size());
+  const float inverse_temperature = 1.0f / temperature;
+  switch (GetIsa()) {
+#if defined(OGA_CPU_SAMPLING_X64)
+    case Isa::Avx512:
+      return ExpAvx512(scores.data(), probs.data(), scores.size(), max_score, inverse_temperature);
+    case Isa::Avx2:
+      return ExpAvx2(scores.data(), probs.data(), scores.size(), max_score, inverse_temperature);
+#endif
+    default:
+#if defined(OGA_CPU_SAMPLING_NEON)
+      return ExpNeon(scores.data(), probs.data(), scores.size(), max_score, inverse_temperature);
+#else
+      return ExpScalar(scores.data(), probs.data(), 0, scores.size(), max_score, inverse_temperature);
+#endif
+  }
+}
+
+float LogSumExp(std::span<const float> scores, float max_score) {
+  // The exponentials are written to a small buffer that stays in the L1 cache and are only summed
+  std::array<float, 1024> probs;
+  double sum = 0.0;
+  for (size_t begin = 0; begin < scores.size(); begin += probs.size()) {
+    const size_t count = std::min(probs.size(), scores.size() - begin);
+    sum += ExpWithTemperature(scores.subspan(begin, count), probs, max_score, 1.0f);
+  }
+  return static_cast<float>(std::log(sum));
+}
+
+void SelectTopK(std::span<const float> scores, size_t k, SamplingData& data) {
+  assert(k > 0 && k <= scores.size());
+  if (data.indices.size() < scores.size())
+    data.indices.resize(scores.size());
+
+  auto begin = data.indices.begin();
+  auto greater = [scores = scores.data()](int32_t i, int32_t j) { return scores[i] > scores[j] || (scores[i] == scores[j] && i < j); };
+
+  // Start from the first k tokens and only keep later tokens that beat the k-th largest score seen so far.
+  // When the candidates fill up, they are cut back to the top k and the threshold is raised.
+  std::iota(begin, begin + k, 0);
+  float threshold = *std::min_element(scores.begin(), scores.begin() + k);
+  const size_t capacity = std::min(scores.size(), 2 * k + 1024);
+  size_t num_candidates = k;
+  for (size_t i = FindAbove(scores, k, threshold); i < scores.size(); i = FindAbove(scores, i + 1, threshold)) {
+    data.indices[num_candidates++] = static_cast<int32_t>(i);
+    if (num_candidates == capacity && capacity < scores.size()) {
+      std::nth_element(begin, begin + (k - 1), begin + num_candidates, greater);
+      threshold = scores[data.indices[k - 1]];
+      num_candidates = k;
+    }
+  }
+
+  if (num_candidates > k)
+    std::nth_element(begin, begin + (k - 1), begin + num_candidates, greater);
+  std::sort(begin, begin + k, greater);
+}
+
+void SelectBeamCandidates(std::span<const float> logits, float beam_score, SamplingData& data, std::span<float> scores, std::span<int32_t> tokens) {
+  const float max_score = MaxScore(logits);
+  const float offset = beam_score - max_score - LogSumExp(logits, max_score);
+
+  SelectTopK(logits, scores.size(), data);
+  for (size_t i = 0; i < scores.size(); i++) {
+    tokens[i] = data.indices[i];
+    scores[i] = logits[tokens[i]] + offset;
+  }
+}
+
+void MergeBeamCandidates(std::span<const float> candidate_scores, std::span<const int32_t> candidate_tokens, size_t num_beams, std::span<int32_t> order,
+                         std::span<float> top_scores, std::span<int32_t> top_tokens, std::span<int32_t> top_indices) {
+  assert(order.size() == candidate_scores.size() && top_scores.size() <= candidate_scores.size());
+  const size_t num_candidates = candidate_scores.size() / num_beams;
+
+  auto greater = [scores = candidate_scores.data()](int32_t a, int32_t b) { return scores[a] > scores[b] || (scores[a] == scores[b] && a < b); };
+  std::iota(order.begin(), order.end(), 0);
+  std::partial_sort(order.begin(), order.begin() + top_scores.size(), order.end(), greater);
+
+  for (size_t i = 0; i < top_scores.size(); i++) {
+    const int32_t candidate = order[i];
+    top_scores[i] = candidate_scores[candidate];
+    top_tokens[i] = candidate_tokens[candidate];
+    top_indices[i] = static_cast<int32_t>(candidate / num_candidates);
+  }
+}
+
+int32_t SampleTopK(SamplingData& data, std::mt19937& generator, std::span<const float> scores, int k, float temperature) {
+  return SampleTopKTopP(data, generator, scores, k, 1.0f, temperature);
+}
+
+int32_t SampleTopP(SamplingData& data, std::mt19937& generator, std::span<const float> scores, float p, float temperature) {
+  if (data.indices.size() < scores.size())
+    data.indices.resize(scores.size());
+  if (data.candidates.size() < scores.size())
+    data.candidates.resize(scores.size());
+  if (data.probs.size() < scores.size())
+    data.probs.resize(scores.size());
+
+  const float max_score = MaxScore(scores);
+  if (max_score == -std::numeric_limits<float>::infinity())
+    return ArgMax(scores);
+
+  auto probs = std::span<float>(data.probs.data(), scores.size());
+  const float sum = ExpWithTemperature(scores, probs, max_score, temperature);
+  const double target = static_cast<double>(p) * sum;
+
+  // Tokens at or below the cutoff hold at most half of 1 - p of the total probability, so the nucleus never
+  // reaches them. Only the tokens above it are gathered, and a histogram of their mass is built on the way.
+  // Interleaved histograms keep consecutive tokens from waiting on each other's updates of the same bucket.
+  constexpr size_t num_buckets = SamplingData::kNumBuckets;
+  const float cutoff = static_cast<float>(0.5 * (1.0 - p) * sum / static_cast<double>(probs.size()));
+  const size_t num_candidates = GatherAbove(probs, cutoff, data.candidates.data());
+  data.masses.fill(0.0);
+  size_t i = 0;
+  for (; i + SamplingData::kNumHistograms <= num_candidates; i += SamplingData::kNumHistograms) {
+    for (size_t histogram = 0; histogram < SamplingData::kNumHistograms; histogram++) {
+      const float prob = probs[data.candidates[i + histogram]];
+      data.masses[histogram * num_buckets + ProbBucket(prob)] += prob;
+    }
+  }
+  for (; i < num_candidates; i++)
+    data.masses[ProbBucket(probs[data.candidates[i]])] += probs[data.candidates[i]];
+  for (size_t histogram = 1; histogram < SamplingData::kNumHistograms; histogram++) {
+    for (size_t bucket = 0; bucket < num_buckets; bucket++)
+      data.masses[bucket] += data.masses[histogram * num_buckets + bucket];
+  }
+
+  // Every token in a bucket above the boundary bucket is in the nucleus. The boundary bucket is the one
+  // whose mass makes the cumulative probability reach p, and only its tokens need to be ordered.
+  size_t boundary = num_buckets - 1;
+  double mass_above = 0.0;
+  while (boundary > 0 && mass_above + data.masses[boundary] < target) {
+    mass_above += data.masses[boundary];
+    --boundary;
+  }
+
+  // Gather the tokens from the lower bound of the boundary bucket up with a vectorized scan, then move the ones
+  // above the bucket to the front and the ones in it after them. Writing every token and advancing only on a match
+  // avoids a mispredicted branch per token.
+  const float lower_bound = BucketLowerBound(boundary);
+  const float upper_bound = BucketLowerBound(boundary + 1);
+  const size_t num_at_least_lower = GatherAbove(probs, std::nextafter(lower_bound, -1.0f), data.candidates.data());
+  size_t num_above = 0;
+  for (i = 0; i < num_at_least_lower; i++) {
+    data.indices[num_above] = data.candidates[i];
+    num_above += probs[data.candidates[i]] >= upper_bound;
+  }
+  int32_t* boundary_indices = data.indices.data() + num_above;
+  size_t num_boundary = 0;
+  for (i = 0; i < num_at_least_lower; i++) {
+    boundary_indices[num_boundary] = data.candidates[i];
+    num_boundary += probs[data.candidates[i]] < upper_bound;
+  }
+  std::sort(boundary_indices, boundary_indices + num_boundary,
+            [probs = probs.data()](int32_t i, int32_t j) { return probs[i] > probs[j] || (probs[i] == probs[j] && i < j); });
+
+  double mass = mass_above;
+  size_t num_nucleus = num_above;
+  while (num_nucleus < num_above + num_boundary && (num_nucleus == 0 || mass < target))
+    mass += probs[data.indices[num_nucleus++]];
+
+  return SampleCandidates(data, probs, num_nucleus, mass, generator);
+}
+
+int32_t SampleTopKTopP(SamplingData& data, std::mt19937& generator, std::span<const float> scores, int k, float p, float temperature) {
+  if (data.probs.size() < scores.size())
+    data.probs.resize(scores.size());
+
+  const size_t top_k = std::min(static_cast<size_t>(k), scores.size());
+  SelectTopK(scores, top_k, data);
+
+  const float max_score = scores[data.indices[0]];
+  if (max_score == -std::numeric_limits<float>::infinity())
+    return data.indices[0];
+
+  // The probabilities of the top k tokens are stored at their token ids, as in the full vocabulary case
+  const float inverse_temperature = 1.0f / temperature;
+  double sum = 0.0;
+  for (size_t i = 0; i < top_k; i++) {
+    const int32_t token = data.indices[i];
+    data.probs[token] = std::exp((scores[token] - max_score) * inverse_temperature);
+    sum += data.probs[token];
+  }
+
+  // The top k tokens are in descending order, so the nucleus is a prefix of them
+  const double target = static_cast<double>(p) * sum;
+  double mass = 0.0;
+  size_t num_nucleus = 0;
+  while (num_nucleus < top_k && (num_nucleus == 0 || mass < target))
+    mass += data.probs[data.indices[num_nucleus++]];
+
+  return SampleCandidates(data, data.probs, num_nucleus, mass, generator);
+}
+
+}  // namespace cpu
+}  // namespace Generators
@@ -0,0 +1,68 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "../span.h"
+
+namespace Generators {
+namespace cpu {
+
+// This struct holds the scratch buffers of the CPU sampling kernels.
+// A search owns one and reuses it for every row and every step, so sampling does not allocate.
+struct SamplingData {
+  static constexpr size_t kNumBuckets = 1024;  // Buckets of the top-p histogram, indexed by the top bits of a probability
+  static constexpr size_t kNumHistograms = 4;  // Interleaved copies of the histogram
+
+  SamplingData(size_t vocab_size);
+
+  std::vector<int32_t> indices;                             // Selected token ids, shape (vocab_size)
+  std::vector<int32_t> candidates;                          // Token ids gathered by a threshold scan, shape (vocab_size)
+  std::vector<float> probs;                                 // Unnormalized probabilities, shape (vocab_size)
+  std::array<double, kNumHistograms * kNumBuckets> masses;  // Probability mass per bucket
+};
+
+// Returns the largest score.
+float MaxScore(std::span<const float> scores);
+
+// Returns the index of the first largest score.
+int32_t ArgMax(std::span<const float> scores);
+
+// Writes exp((scores[i] - max_score) / temperature) to probs and returns the sum of the written values.
+// The probabilities are left unnormalized; callers scale their thresholds by the returned sum instead.
+float ExpWithTemperature(std::span<const float> scores, std::span<float> probs, float max_score, float temperature);
+
+// Returns log(sum(exp(scores[i] - max_score))), so the log softmax of a score is score - max_score - LogSumExp(scores, max_score).
+float LogSumExp(std::span<const float> scores, float max_score);
+
+// Selects the k largest scores with a vectorized threshold filter instead of sorting the vocabulary.
+// On return data.indices[0, k) holds their token ids in descending score order.
+void SelectTopK(std::span<const float> scores, size_t k, SamplingData& data);
+
+// Selects the scores.size() best next tokens of a beam, where the score of a token is its log softmax plus beam_score.
+// Within a beam that is the logit plus a constant, so the tokens are selected from the logits and only they are scored.
+// On return scores and tokens hold the selected scores and token ids in descending score order.
+void SelectBeamCandidates(std::span<const float> logits, float beam_score, SamplingData& data, std::span<float> scores, std::span<int32_t> tokens);
+
+// Merges the candidates of the beams of a batch entry, candidate_scores and candidate_tokens have shape (num_beams, num_candidates).
+// The top_scores.size() best candidates are written to top_scores, top_tokens and top_indices (their beam) in descending score order,
+// ties go to the lower beam and then to the earlier candidate. order is scratch space of num_beams * num_candidates entries.
+void MergeBeamCandidates(std::span<const float> candidate_scores, std::span<const int32_t> candidate_tokens, size_t num_beams, std::span<int32_t> order,
+                         std::span<float> top_scores, std::span<int32_t> top_tokens, std::span<int32_t> top_indices);
+
+// Samples a token from the k highest scores after applying the temperature.
+int32_t SampleTopK(SamplingData& data, std::mt19937& generator, std::span<const float> scores, int k, float temperature);
+
+// Samples a token from the smallest set of tokens whose probabilities add up to at least p.
+// The set is found with a probability mass histogram; only the tokens of the boundary bucket are sorted.
+int32_t SampleTopP(SamplingData& data, std::mt19937& generator, std::span<const float> scores, float p, float temperature);
+
+// Samples a token from the top-p nucleus of the k highest scores.
+int32_t SampleTopKTopP(SamplingData& data, std::mt19937& generator, std::span<const float> scores, int k, float p, float temperature);
+
+}  // namespace cpu
+}  // namespace Generators
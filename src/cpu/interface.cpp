@@ -4,6 +4,8 @@
 #include "../generators.h"
 #include "../search.h"
 #include "../models/utils.h"
+#include "cpu_cache_indirection.h"
+#include "cpu_cast.h"
 #include "interface.h"
 
 namespace Generators {
@@ -11,6 +13,27 @@ namespace Generators {
 static Ort::Allocator* ort_allocator_{};
 const char* label_cpu = "cpu";
 
+// Casts of more elements than this, such as the logits of a large vocabulary across a batch, are split into
+// chunks of this many elements and run on the thread pool
+constexpr size_t kCastChunkSize = 1 << 18;
+
+template <typename TInput, typename TOutput>
+void ParallelCast(const void* input_data, void* output_data, size_t element_count,
+                  void (*cast)(std::span<const TInput>, std::span<TOutput>)) {
+  std::span<const TInput> input{static_cast<const TInput*>(input_data), element_count};
+  std::span<TOutput> output{static_cast<TOutput*>(output_data), element_count};
+  if (element_count <= kCastChunkSize) {
+    cast(input, output);
+    return;
+  }
+
+  GetThreadPool().ParallelFor((element_count + kCastChunkSize - 1) / kCastChunkSize, [&](size_t chunk) {
+    const size_t begin = chunk * kCastChunkSize;
+    const size_t count = std::min(kCastChunkSize, element_count - begin);
+    cast(input.subspan(begin, count), output.subspan(begin, count));
+  });
+}
+
 struct CpuMemory final : DeviceBuffer {
   CpuMemory(size_t size) : owned_{true} {
     size_in_bytes_ = size;
@@ -70,25 +93,13 @@ struct CpuInterface : DeviceInterface {
       throw std::runtime_error("Cast - input and output types are the same");
 
     if (input_type == Ort::TypeToTensorType<float> && output_type == Ort::TypeToTensorType<Ort::Float16_t>) {
-      auto* fp32 = static_cast<float*>(input_data);
-      auto* fp16 = static_cast<uint16_t*>(output_data);
-      for (size_t i = 0; i < element_count; i++)
-        fp16[i] = FastFloat32ToFloat16(fp32[i]);
+      ParallelCast<float, uint16_t>(input_data, output_data, element_count, cpu::CastFloat32ToFloat16);
     } else if (input_type == Ort::TypeToTensorType<float> && output_type == Ort::TypeToTensorType<Ort::BFloat16_t>) {
-      auto* fp32 = static_cast<float*>(input_data);
-      auto* bf16 = static_cast<uint16_t*>(output_data);
-      for (size_t i = 0; i < element_count; i++)
-        bf16[i] = Float32ToBFloat16(fp32[i]);
+      ParallelCast<float, uint16_t>(input_data, output_data, element_count, cpu::CastFloat32ToBFloat16);
     } else if (input_type == Ort::TypeToTensorType<Ort::Float16_t> && output_type == Ort::TypeToTensorType<float>) {
-      auto* fp16 = static_cast<uint16_t*>(input_data);
-      auto* fp32 = static_cast<float*>(output_data);
-      for (size_t i = 0; i < element_count; i++)
-        fp32[i] = FastFloat16ToFloat32(fp16[i]);
+      ParallelCast<uint16_t, float>(input_data, output_data, element_count, cpu::CastFloat16ToFloat32);
     } else if (input_type == Ort::TypeToTensorType<Ort::BFloat16_t> && output_type == Ort::TypeToTensorType<float>) {
-      auto* bf16 = static_cast<uint16_t*>(input_data);
-      auto* fp32 = static_cast<float*>(output_data);
-      for (size_t i = 0; i < element_count; i++)
-        fp32[i] = BFloat16ToFloat32(bf16[i]);
+      ParallelCast<uint16_t, float>(input_data, output_data, element_count, cpu::CastBFloat16ToFloat32);
     } else if (input_type == Ort::TypeToTensorType<int32_t> && output_type == Ort::TypeToTensorType<int64_t>) {
       auto* int32 = static_cast<int32_t*>(input_data);
       auto* int64 = static_cast<int64_t*>(output_data);
@@ -160,6 +171,11 @@ struct CpuInterface : DeviceInterface {
     return true;
   }
 
+  // Same as the CUDA kernel
+  void UpdateCacheIndirection(int32_t* tgt_indir_cache, const int32_t* src_indir_cache, const int32_t* beam_ids, int batch_size, int beam_width, int input_seq_length, int max_seq_length, int current_length) override {
+    cpu::UpdateCacheIndirection(tgt_indir_cache, src_indir_cache, beam_ids, batch_size, beam_width, input_seq_length, max_seq_length, current_length);
+  }
+
   std::unique_ptr<Search> CreateGreedy(const GeneratorParams& params) override { return std::make_unique<GreedySearch_Cpu>(params); }
   std::unique_ptr<Search> CreateBeam(const GeneratorParams& params) override { return std::make_unique<BeamSearch_Cpu>(params); }
 
@@ -9,6 +9,7 @@
 #include "beam_search_scorer_cuda.cuh"
 #include "beam_search_scorer_cuda.h"
 #include "beam_search_topk.h"
+#include <array>
 #include <queue>
 #include <random>
 
@@ -48,6 +49,19 @@ GreedySearch_Cuda::GreedySearch_Cuda(const GeneratorParams& params)
                                                        sampling_buffer_.Span().data(), sampling_buffer_size);
 }
 
+void GreedySearch_Cuda::ReseedForFork(std::span<const uint32_t> fork_path) {
+  if (params_->search.random_seed == -1)
+    return;  // Already seeded from std::random_device
+
+  // The seed is derived like the CPU search does, the batch entries then use their own curand subsequences of it
+  std::vector<uint32_t> seed{static_cast<uint32_t>(params_->search.random_seed)};
+  seed.insert(seed.end(), fork_path.begin(), fork_path.end());
+  std::seed_seq seq(seed.begin(), seed.end());
+  std::array<uint32_t, 2> random_seed;
+  seq.generate(random_seed.begin(), random_seed.end());
+  samplingdata_->ReInitCurandStates((static_cast<unsigned long long>(random_seed[0]) << 32) | random_seed[1], params_->search.batch_size, GetStream());
+}
+
 BeamSearch_Cuda::BeamSearch_Cuda(const GeneratorParams& params)
     : Search_Cuda{params} {
   assert(params_->search.num_beams > 1);  // If 1, use GreedySearch
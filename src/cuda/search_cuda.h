@@ -54,6 +54,7 @@ struct GreedySearch_Cuda : Search_Cuda {
   void SampleTopKTopP(int k, float p, float t) override;
   void AppendTokens(DeviceSpan<int32_t>& next_tokens) override;  // shape (batch_size, sequence_length)
   void RewindTo(size_t index) override;
+  void ReseedForFork(std::span<const uint32_t> fork_path) override;
 
  private:
   DeviceSpan<uint8_t> sampling_buffer_;
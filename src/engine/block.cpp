@@ -1,11 +1,16 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT License.
 
-#include "../generators.h"
 #include "block.h"
 
-#include <numeric>
+#include <assert.h>
 #include <algorithm>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <string>
 
 namespace Generators {
 
@@ -46,18 +51,76 @@ std::vector<size_t> Block::SlotIds() const {
   return slot_ids;
 }
 
+size_t Block::RefCount() const {
+  return ref_count_;
+}
+
+void Block::IncrementRefCount() {
+  ref_count_++;
+}
+
+void Block::DecrementRefCount() {
+  if (ref_count_ == 0) {
+    throw std::runtime_error("Cannot release a block that is not referenced.");
+  }
+
+  ref_count_--;
+}
+
+std::optional<size_t> Block::Hash() const {
+  return hash_;
+}
+
+bool Block::Matches(size_t parent_hash, std::span<const int32_t> token_ids) const {
+  return hash_.has_value() && parent_hash_ == parent_hash &&
+         std::equal(token_ids.begin(), token_ids.end(), token_ids_.begin(), token_ids_.end());
+}
+
+void Block::SetHash(size_t hash, size_t parent_hash, std::span<const int32_t> token_ids) {
+  if (!IsFull()) {
+    throw std::runtime_error("Only full blocks can be registered for prefix caching.");
+  }
+
+  hash_ = hash;
+  parent_hash_ = parent_hash;
+  token_ids_.assign(token_ids.begin(), token_ids.end());
+}
+
+void Block::ResetHash() {
+  hash_.reset();
+  parent_hash_ = 0;
+  token_ids_.clear();
+}
+
+size_t ComputeBlockHash(size_t parent_hash, std::span<const int32_t> token_ids) {
+  size_t hash = parent_hash;
+  for (const auto token_id : token_ids) {
+    hash ^= std::hash<int32_t>{}(token_id) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+  }
+  return hash;
+}
+
 BlockPool::BlockPool(size_t block_size, size_t num_blocks)
-    : block_size_(block_size), capacity_(num_blocks) {}
+    : block_size_(block_size), capacity_(num_blocks) {
+  // The free list is used as a stack. Push the ids in reverse so that the lowest ids are handed out first.
+  free_block_ids_.resize(capacity_);
+  std::iota(free_block_ids_.rbegin(), free_block_ids_.rend(), size_t{0});
+}
 
 std::vector<std::shared_ptr<Block>> BlockPool::AllocateBlocks(size_t num_slots) {
   const auto allocate_block = [this](size_t num_slots) {
-    for (size_t i = 0; i < Capacity(); ++i) {
-      if (blocks_[i] == nullptr) {
-        blocks_[i] = std::make_shared<Block>(i, num_slots, block_size_);
-        return blocks_[i];
+    if (free_block_ids_.empty()) {
+      if (evictable_blocks_.empty()) {
+        return std::shared_ptr<Block>();
       }
+      // All blocks are in use or cached. Reclaim the least recently freed cached block.
+      EvictBlock();
     }
-    return std::shared_ptr<Block>();
+
+    const size_t block_id = free_block_ids_.back();
+    free_block_ids_.pop_back();
+    blocks_[block_id] = std::make_shared<Block>(block_id, num_slots, block_size_);
+    return blocks_[block_id];
   };
 
   if (BlocksNeeded(num_slots) > AvailableBlocks()) {
@@ -67,6 +130,7 @@ std::vector<std::shared_ptr<Block>> BlockPool::AllocateBlocks(size_t num_slots)
   }
 
   std::vector<std::shared_ptr<Block>> allocated_blocks;
+  allocated_blocks.reserve(BlocksNeeded(num_slots));
   for (size_t i = 0; i < num_slots; i += block_size_) {
     auto block = allocate_block(std::min(block_size_, num_slots - i));
     if (!block) {
@@ -74,17 +138,82 @@ std::vector<std::shared_ptr<Block>> BlockPool::AllocateBlocks(size_t num_slots)
     }
     allocated_blocks.push_back(block);
   }
+
+  stats_.num_allocations += allocated_blocks.size();
+  stats_.high_water_mark = std::max(stats_.high_water_mark, Size());
   return allocated_blocks;
 }
 
 void BlockPool::Free(const std::vector<std::shared_ptr<Block>>& blocks) {
-  for (const auto& block : blocks) {
-    blocks_[block->Id()].reset();
+  // Free in reverse order so that the tail blocks of a sequence are evicted before its prefix blocks.
+  for (auto block_it = blocks.rbegin(); block_it != blocks.rend(); ++block_it) {
+    Release(*block_it);
+  }
+}
+
+void BlockPool::Release(const std::shared_ptr<Block>& block) {
+  block->DecrementRefCount();
+  if (block->RefCount() > 0) {
+    return;
+  }
+
+  stats_.num_frees++;
+  if (block->Hash().has_value()) {
+    evictable_blocks_.push_back(block->Id());
+    evictable_blocks_map_[block->Id()] = std::prev(evictable_blocks_.end());
+    return;
+  }
+
+  blocks_[block->Id()].reset();
+  free_block_ids_.push_back(block->Id());
+}
+
+void BlockPool::EvictBlock() {
+  const size_t block_id = evictable_blocks_.front();
+  evictable_blocks_.pop_front();
+  evictable_blocks_map_.erase(block_id);
+
+  auto& block = blocks_[block_id];
+  cached_blocks_.erase(*block->Hash());
+  block->ResetHash();
+  block.reset();
+  free_block_ids_.push_back(block_id);
+  stats_.num_evictions++;
+}
+
+std::shared_ptr<Block> BlockPool::LookupCachedBlock(size_t hash, size_t parent_hash, std::span<const int32_t> token_ids) const {
+  auto cached_block_it = cached_blocks_.find(hash);
+  if (cached_block_it == cached_blocks_.end() || !cached_block_it->second->Matches(parent_hash, token_ids)) {
+    return nullptr;
+  }
+  return cached_block_it->second;
+}
+
+void BlockPool::AcquireCachedBlock(const std::shared_ptr<Block>& block) {
+  if (block->RefCount() == 0) {
+    auto evictable_block_it = evictable_blocks_map_.find(block->Id());
+    assert(evictable_block_it != evictable_blocks_map_.end());
+    evictable_blocks_.erase(evictable_block_it->second);
+    evictable_blocks_map_.erase(evictable_block_it);
+  }
+  block->IncrementRefCount();
+
+  stats_.num_cache_hits++;
+  stats_.high_water_mark = std::max(stats_.high_water_mark, Size());
+}
+
+bool BlockPool::CacheBlock(const std::shared_ptr<Block>& block, size_t hash, size_t parent_hash, std::span<const int32_t> token_ids) {
+  if (block->Hash().has_value() || cached_blocks_.count(hash)) {
+    return false;
   }
+
+  block->SetHash(hash, parent_hash, token_ids);
+  cached_blocks_[hash] = block;
+  return true;
 }
 
 size_t BlockPool::AvailableBlocks() const {
-  return std::count_if(blocks_.begin(), blocks_.end(), [](const std::shared_ptr<Block>& block) { return block == nullptr; });
+  return free_block_ids_.size() + evictable_blocks_.size();
 }
 
 size_t BlockPool::Size() const {
@@ -95,8 +224,53 @@ size_t BlockPool::Capacity() const {
   return capacity_;
 }
 
-size_t BlockPool::BlocksNeeded(size_t num_slots) {
+size_t BlockPool::BlocksNeeded(size_t num_slots) const {
   return (num_slots + block_size_ - 1) / block_size_;
 }
 
+BlockPoolStats BlockPool::Stats() const {
+  BlockPoolStats stats = stats_;
+  stats.num_blocks = Capacity();
+  stats.num_available_blocks = AvailableBlocks();
+  stats.num_cached_blocks = cached_blocks_.size();
+
+  // Fragmentation is only computed on request since it needs to visit every block in use.
+  size_t num_used_slots = 0, num_reserved_slots = 0;
+  for (const auto& block : blocks_) {
+    if (block && block->RefCount() > 0) {
+      num_used_slots += block->Size();
+      num_reserved_slots += block->Capacity();
+    }
+  }
+  stats.fragmentation = num_reserved_slots == 0
+                            ? 0.0f
+                            : 1.0f - static_cast<float>(num_used_slots) / static_cast<float>(num_reserved_slots);
+  return stats;
+}
+
+size_t ComputeBlockSizeInBytes(size_t block_size, size_t num_kv_heads, size_t head_size, size_t element_size) {
+  return block_size * num_kv_heads * head_size * element_size;
+}
+
+size_t ComputeNumBlocks(size_t bytes_per_block, size_t free_bytes, std::optional<float> gpu_utilization_factor,
+                        std::optional<size_t> max_memory_bytes) {
+  if (!gpu_utilization_factor.has_value() && !max_memory_bytes.has_value()) {
+    throw std::runtime_error("One of num_blocks, gpu_utilization_factor or max_memory_bytes must be set to size the key-value cache.");
+  }
+
+  // The requests can never hold more blocks than the memory budget pays for, so the pool is no larger than that
+  const size_t max_budget_blocks = max_memory_bytes.has_value()
+                                       ? *max_memory_bytes / bytes_per_block
+                                       : std::numeric_limits<size_t>::max();
+  if (!gpu_utilization_factor.has_value()) {
+    return max_budget_blocks;
+  }
+
+  constexpr float memory_fragmentation_factor = 0.9f;
+
+  // Use the free memory to compute the number of blocks needed to achieve the given gpu_utilization_factor.
+  return std::min(static_cast<size_t>(free_bytes * memory_fragmentation_factor * *gpu_utilization_factor) / bytes_per_block,
+                  max_budget_blocks);
+}
+
 }  // namespace Generators
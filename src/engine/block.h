@@ -3,15 +3,26 @@
 
 #pragma once
 
+#include <stdint.h>
+#include <list>
 #include <memory>
+#include <optional>
+#include <unordered_map>
 #include <vector>
 
+#include "../span.h"
+
 namespace Generators {
 
 /*
  * Block represents a contiguous set of slots in the paged key-value cache.
  * Each block has a fixed capacity (number of slots it can hold) and tracks
  * the number of currently used slots.
+ *
+ * A full block whose key-value data has been computed can be registered for prefix caching.
+ * Such a block carries a hash of its token ids chained with the hash of its parent block,
+ * and can be shared by all requests whose prompts start with the same tokens. The block
+ * keeps a count of the requests that reference it.
  */
 struct Block {
   Block(size_t id, size_t slots, size_t block_size);
@@ -30,20 +41,67 @@ struct Block {
 
   std::vector<size_t> SlotIds() const;
 
+  size_t RefCount() const;
+
+  void IncrementRefCount();
+
+  void DecrementRefCount();
+
+  // Returns the prefix hash of this block if the block has been registered for prefix caching.
+  std::optional<size_t> Hash() const;
+
+  // Returns true if this block holds the given token ids and follows a block with the given parent hash.
+  bool Matches(size_t parent_hash, std::span<const int32_t> token_ids) const;
+
+  void SetHash(size_t hash, size_t parent_hash, std::span<const int32_t> token_ids);
+
+  void ResetHash();
+
  private:
   size_t id_;
   size_t size_;
   size_t capacity_;
+  size_t ref_count_{1};
+  std::optional<size_t> hash_;
+  size_t parent_hash_{};
+  std::vector<int32_t> token_ids_;  // Kept to guard against hash collisions
+};
+
+// Computes the prefix hash of a block from its token ids and the prefix hash of the preceding block.
+// The first block in a sequence uses a parent hash of 0.
+size_t ComputeBlockHash(size_t parent_hash, std::span<const int32_t> token_ids);
+
+/*
+ * BlockPoolStats holds the allocation counters of a BlockPool.
+ */
+struct BlockPoolStats {
+  size_t num_blocks{};            // Total number of blocks in the pool
+  size_t num_available_blocks{};  // Number of free blocks plus evictable cached blocks
+  size_t num_cached_blocks{};     // Number of blocks registered for prefix caching
+  size_t num_allocations{};       // Number of blocks allocated since the pool was created
+  size_t num_frees{};             // Number of blocks released since the pool was created
+  size_t num_evictions{};         // Number of cached blocks evicted to serve allocations
+  size_t num_cache_hits{};        // Number of cached blocks reused by new requests
+  size_t high_water_mark{};       // Maximum number of blocks in use at the same time
+  float fragmentation{};          // Fraction of the slots in blocks in use that are empty
 };
 
 /*
  * BlockPool manages a pool of blocks for the paged key-value cache.
  * It allows allocation and deallocation of blocks, and keeps track
  * of the total capacity and currently available blocks.
+ * Free block ids are kept on a free list so that allocating, freeing and counting
+ * the available blocks take constant time regardless of the pool size.
+ *
+ * Blocks registered for prefix caching are not released when their last reference is freed.
+ * They remain in the pool as evictable blocks that can be reused by a later request with
+ * the same prefix, and are evicted in least recently freed order when the pool runs out
+ * of free blocks.
  */
 struct BlockPool {
   BlockPool(size_t block_size, size_t num_blocks);
 
+  // Returns the number of blocks that can be allocated, including evictable cached blocks.
   size_t AvailableBlocks() const;
 
   size_t Size() const;
@@ -54,12 +112,43 @@ struct BlockPool {
 
   void Free(const std::vector<std::shared_ptr<Block>>& blocks);
 
-  size_t BlocksNeeded(size_t num_slots);
+  size_t BlocksNeeded(size_t num_slots) const;
+
+  // Returns the cached block with the given hash if it holds the given token ids, or nullptr otherwise.
+  std::shared_ptr<Block> LookupCachedBlock(size_t hash, size_t parent_hash, std::span<const int32_t> token_ids) const;
+
+  // Adds a reference to a cached block returned by LookupCachedBlock.
+  void AcquireCachedBlock(const std::shared_ptr<Block>& block);
+
+  // Registers a full, computed block for prefix caching. Returns false if a block with the
+  // same hash is already cached, in which case the given block is left unregistered.
+  bool CacheBlock(const std::shared_ptr<Block>& block, size_t hash, size_t parent_hash, std::span<const int32_t> token_ids);
+
+  BlockPoolStats Stats() const;
 
  private:
+  void Release(const std::shared_ptr<Block>& block);
+
+  void EvictBlock();
+
   const size_t block_size_;
   const size_t capacity_;
   std::vector<std::shared_ptr<Block>> blocks_{capacity_};
+  std::vector<size_t> free_block_ids_;                                             // Ids of unallocated blocks, used as a stack
+  std::unordered_map<size_t, std::shared_ptr<Block>> cached_blocks_;               // Prefix hash to cached block
+  std::list<size_t> evictable_blocks_;                                             // Ids of unreferenced cached blocks, least recently freed first
+  std::unordered_map<size_t, std::list<size_t>::iterator> evictable_blocks_map_;  // Block id to position in evictable_blocks_
+  BlockPoolStats stats_;
 };
 
+// Returns the size of one block of the key or the value cache of a layer: block_size slots of num_kv_heads * head_size
+// elements of element_size bytes, the size of the type the cache is stored in.
+size_t ComputeBlockSizeInBytes(size_t block_size, size_t num_kv_heads, size_t head_size, size_t element_size);
+
+// Returns the number of blocks of bytes_per_block bytes, across the key and value caches of all layers, to allocate
+// for the paged key-value cache. The blocks take gpu_utilization_factor of the free_bytes of the device, and no more
+// than max_memory_bytes. One of the two must be set.
+size_t ComputeNumBlocks(size_t bytes_per_block, size_t free_bytes, std::optional<float> gpu_utilization_factor,
+                        std::optional<size_t> max_memory_bytes);
+
 }  // namespace Generators
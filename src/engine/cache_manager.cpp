@@ -97,6 +97,16 @@ std::vector<std::shared_ptr<Request>> StaticCacheManager::AllocatedRequests() co
   return cache_allocated_requests_;
 }
 
+size_t StaticCacheManager::KeyValueCacheSizeInBytes(std::shared_ptr<Request> request) const {
+  if (!key_value_cache_ ||
+      std::find(cache_allocated_requests_.begin(), cache_allocated_requests_.end(), request) == cache_allocated_requests_.end()) {
+    return 0;
+  }
+
+  // The cache is allocated for the whole batch, each request holds an equal share of it
+  return key_value_cache_->SizeInBytes() / cache_allocated_requests_.size();
+}
+
 PagedCacheManager::PagedCacheManager(std::shared_ptr<Model> model)
     : CacheManager(model),
       params_(std::make_shared<GeneratorParams>(*model_)),
@@ -104,8 +114,30 @@ PagedCacheManager::PagedCacheManager(std::shared_ptr<Model> model)
   key_value_cache_state_ = std::make_unique<KeyValueCacheState>(*params_, *model_);
 }
 
+size_t PagedCacheManager::MemoryInUse() const {
+  size_t size_in_bytes = key_value_cache_->SizeInBytes();
+  for (const auto& request : cache_allocated_requests_) {
+    size_in_bytes += request->ScratchSizeInBytes();
+  }
+  return size_in_bytes;
+}
+
+bool PagedCacheManager::FitsMemoryBudget(size_t num_blocks, size_t scratch_size_in_bytes) const {
+  return MemoryInUse() + num_blocks * key_value_cache_->BlockSizeInBytes() + scratch_size_in_bytes <=
+         *model_->config_->engine.dynamic_batching->max_memory_bytes;
+}
+
 bool PagedCacheManager::CanAllocate(const std::vector<std::shared_ptr<Request>>& requests) const {
-  if (cache_allocated_requests_.size() + requests.size() > model_->config_->engine.dynamic_batching->max_batch_size) {
+  if (model_->config_->engine.dynamic_batching->max_memory_bytes.has_value()) {
+    size_t num_blocks = 0, scratch_size_in_bytes = 0;
+    for (const auto& request : requests) {
+      num_blocks += key_value_cache_->BlocksNeeded(request);
+      scratch_size_in_bytes += request->ScratchSizeInBytes();
+    }
+    if (!FitsMemoryBudget(num_blocks, scratch_size_in_bytes)) {
+      return false;
+    }
+  } else if (cache_allocated_requests_.size() + requests.size() > model_->config_->engine.dynamic_batching->max_batch_size) {
     return false;
   }
 
@@ -160,4 +192,114 @@ std::vector<std::shared_ptr<Request>> PagedCacheManager::AllocatedRequests() con
   return cache_allocated_requests_;
 }
 
+bool PagedCacheManager::CanStep() const {
+  std::vector<std::shared_ptr<Request>> requests_to_step;
+  std::copy_if(cache_allocated_requests_.begin(), cache_allocated_requests_.end(), std::back_inserter(requests_to_step),
+               [](const std::shared_ptr<Request>& request) {
+                 return request->status_ != RequestStatus::Completed;
+               });
+
+  if (model_->config_->engine.dynamic_batching->max_memory_bytes.has_value() &&
+      !FitsMemoryBudget(key_value_cache_->BlocksNeededToAppend(requests_to_step), 0)) {
+    return false;
+  }
+
+  return key_value_cache_->CanAppendTokens(requests_to_step);
+}
+
+void PagedCacheManager::Preempt(std::shared_ptr<Request> request) {
+  const auto request_it = std::find(cache_allocated_requests_.begin(), cache_allocated_requests_.end(), request);
+  if (request_it == cache_allocated_requests_.end()) {
+    throw std::runtime_error("Cannot preempt a request that is not allocated in the cache.");
+  }
+
+  // Swapping falls back to recomputation when the host swap space is full.
+  const bool swap = model_->config_->engine.dynamic_batching->preemption_mode == "swap" &&
+                    key_value_cache_->CanSwapOut(request);
+  if (swap) {
+    key_value_cache_->SwapOut(request);
+    num_swapped_preemptions_++;
+  } else {
+    key_value_cache_->Remove(request);
+    num_recomputed_preemptions_++;
+  }
+
+  request->Preempt(!swap);
+  cache_allocated_requests_.erase(request_it);
+}
+
+bool PagedCacheManager::CanResume(std::shared_ptr<Request> request) const {
+  if (model_->config_->engine.dynamic_batching->max_memory_bytes.has_value()) {
+    if (!FitsMemoryBudget(key_value_cache_->BlocksNeeded(request), request->ScratchSizeInBytes())) {
+      return false;
+    }
+  } else if (cache_allocated_requests_.size() >= model_->config_->engine.dynamic_batching->max_batch_size) {
+    return false;
+  }
+
+  if (key_value_cache_->IsSwappedOut(request)) {
+    return key_value_cache_->CanSwapIn(request);
+  }
+
+  return key_value_cache_->CanAdd(request);
+}
+
+void PagedCacheManager::Resume(std::shared_ptr<Request> request) {
+  if (key_value_cache_->IsSwappedOut(request)) {
+    key_value_cache_->SwapIn(request);
+  } else {
+    key_value_cache_->Add(request);
+  }
+
+  request->Resume();
+  cache_allocated_requests_.push_back(request);
+}
+
+void PagedCacheManager::Prefetch(std::shared_ptr<Request> request) {
+  key_value_cache_->Prefetch(request);
+}
+
+size_t PagedCacheManager::KeyValueCacheSizeInBytes(std::shared_ptr<Request> request) const {
+  return key_value_cache_->SizeInBytes(request);
+}
+
+std::optional<double> PagedCacheManager::GetStatistic(std::string_view name) const {
+  const auto stats = key_value_cache_->Stats();
+  const auto swap_stats = key_value_cache_->SwapStats();
+  if (name == "num_blocks") {
+    return static_cast<double>(stats.num_blocks);
+  } else if (name == "num_available_blocks") {
+    return static_cast<double>(stats.num_available_blocks);
+  } else if (name == "num_cached_blocks") {
+    return static_cast<double>(stats.num_cached_blocks);
+  } else if (name == "num_block_allocations") {
+    return static_cast<double>(stats.num_allocations);
+  } else if (name == "num_block_frees") {
+    return static_cast<double>(stats.num_frees);
+  } else if (name == "num_block_evictions") {
+    return static_cast<double>(stats.num_evictions);
+  } else if (name == "num_prefix_cache_hits") {
+    return static_cast<double>(stats.num_cache_hits);
+  } else if (name == "block_high_water_mark") {
+    return static_cast<double>(stats.high_water_mark);
+  } else if (name == "block_fragmentation") {
+    return static_cast<double>(stats.fragmentation);
+  } else if (name == "num_host_swap_blocks") {
+    return static_cast<double>(swap_stats.num_host_blocks);
+  } else if (name == "num_disk_swap_blocks") {
+    return static_cast<double>(swap_stats.num_disk_blocks);
+  } else if (name == "num_spilled_blocks") {
+    return static_cast<double>(swap_stats.num_spilled_blocks);
+  } else if (name == "num_prefetched_blocks") {
+    return static_cast<double>(swap_stats.num_prefetched_blocks);
+  } else if (name == "num_swapped_preemptions") {
+    return static_cast<double>(num_swapped_preemptions_);
+  } else if (name == "num_recomputed_preemptions") {
+    return static_cast<double>(num_recomputed_preemptions_);
+  } else if (name == "memory_in_use_bytes") {
+    return static_cast<double>(MemoryInUse());
+  }
+  return std::nullopt;
+}
+
 }  // namespace Generators
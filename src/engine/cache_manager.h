@@ -38,6 +38,32 @@ struct CacheManager {
 
   virtual std::vector<std::shared_ptr<Request>> AllocatedRequests() const = 0;
 
+  // Returns true if the next Step can append the scheduled tokens of all the allocated requests.
+  virtual bool CanStep() const { return true; }
+
+  // Releases the cache of an allocated request so that its memory can be used by other requests.
+  // Depending on the configured preemption mode, the cache is either swapped to host memory or
+  // discarded and recomputed when the request is resumed.
+  virtual void Preempt(std::shared_ptr<Request> request) {
+    throw std::runtime_error("Preemption is not supported by this cache manager.");
+  }
+
+  virtual bool CanResume(std::shared_ptr<Request> request) const { return false; }
+
+  // Restores the cache of a preempted request and adds it back to the allocated requests.
+  virtual void Resume(std::shared_ptr<Request> request) {
+    throw std::runtime_error("Preemption is not supported by this cache manager.");
+  }
+
+  // Starts bringing the cache of the preempted request that will be resumed next closer to the device.
+  virtual void Prefetch(std::shared_ptr<Request> request) {}
+
+  // Returns the size of the key-value cache held by an allocated request, 0 if it is not allocated.
+  virtual size_t KeyValueCacheSizeInBytes(std::shared_ptr<Request> request) const { return 0; }
+
+  // Returns the value of the named cache statistic, or std::nullopt if the cache does not track it.
+  virtual std::optional<double> GetStatistic(std::string_view name) const { return std::nullopt; }
+
   virtual ~CacheManager() = default;
 
  protected:
@@ -60,6 +86,8 @@ struct StaticCacheManager : CacheManager {
 
   std::vector<std::shared_ptr<Request>> AllocatedRequests() const override;
 
+  size_t KeyValueCacheSizeInBytes(std::shared_ptr<Request> request) const override;
+
  private:
   std::shared_ptr<GeneratorParams> params_;
   std::unique_ptr<KeyValueCache> key_value_cache_;
@@ -81,10 +109,32 @@ struct PagedCacheManager : CacheManager {
 
   std::vector<std::shared_ptr<Request>> AllocatedRequests() const override;
 
+  bool CanStep() const override;
+
+  void Preempt(std::shared_ptr<Request> request) override;
+
+  bool CanResume(std::shared_ptr<Request> request) const override;
+
+  void Resume(std::shared_ptr<Request> request) override;
+
+  void Prefetch(std::shared_ptr<Request> request) override;
+
+  size_t KeyValueCacheSizeInBytes(std::shared_ptr<Request> request) const override;
+
+  std::optional<double> GetStatistic(std::string_view name) const override;
+
  private:
+  // Returns the size of the key-value cache blocks in use and the search state of the allocated requests.
+  size_t MemoryInUse() const;
+
+  // Returns true if the given number of new blocks and search state fit in engine.dynamic_batching.max_memory_bytes.
+  bool FitsMemoryBudget(size_t num_blocks, size_t scratch_size_in_bytes) const;
+
   std::shared_ptr<GeneratorParams> params_;
   std::unique_ptr<PagedKeyValueCache> key_value_cache_;
   std::vector<std::shared_ptr<Request>> cache_allocated_requests_;
+  size_t num_swapped_preemptions_{};     // Number of requests preempted by swapping out their blocks
+  size_t num_recomputed_preemptions_{};  // Number of requests preempted by releasing their blocks, to be recomputed
 };
 
 }  // namespace Generators
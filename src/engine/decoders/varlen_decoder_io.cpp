@@ -28,7 +28,7 @@ VarlenDecoderIO::VarlenDecoderIO(std::shared_ptr<DecoderOnly_Model> model,
 void VarlenDecoderIO::PrepareInputIds(std::shared_ptr<DecoderOnly_Model> model, ScheduledRequests& scheduled_requests) {
   size_t num_tokens = std::accumulate(scheduled_requests.begin(), scheduled_requests.end(), static_cast<size_t>(0),
                                       [](size_t sum, const std::shared_ptr<Request>& request) -> size_t {
-                                        return sum + request->UnprocessedTokens().size();
+                                        return sum + request->ScheduledTokens().size();
                                       });
   const std::vector<int64_t> input_ids_shape = {static_cast<int64_t>(num_tokens)};
   auto input_ids_tensor = std::make_unique<Tensor>(model->p_device_inputs_, Ort::TypeToTensorType<int64_t>);
@@ -51,14 +51,17 @@ void VarlenDecoderIO::PrepareInputIds(std::shared_ptr<DecoderOnly_Model> model,
 
   for (size_t i = 0, running_length = 0; i < scheduled_requests.size(); ++i) {
     auto request = scheduled_requests[i];
-    auto input_ids = request->UnprocessedTokens().CopyDeviceToCpu();
+    auto input_ids = request->ScheduledTokens().CopyDeviceToCpu();
     std::copy(input_ids.begin(), input_ids.end(), cpu_span.begin() + running_length);
 
     if (request->IsPrefill()) {
       // When a request is created, the current sequence length becomes the prompt length.
       // But the kv cache is not updated until the first token is generated.
-      // So we set the past sequence length to current sequence length minus the unprocessed tokens length.
-      sequence_lengths_cpu_span[i] = static_cast<int32_t>(request->CurrentSequenceLength() - input_ids.size());
+      // So we set the past sequence length to the number of tokens that have already been processed.
+      // If the prompt prefix was found in the prefix cache, or earlier chunks of a long prompt were
+      // prefilled in previous steps, those tokens are neither part of the input ids nor recomputed,
+      // and the past sequence length covers them instead.
+      sequence_lengths_cpu_span[i] = static_cast<int32_t>(request->ProcessedTokens().size());
     } else {
       sequence_lengths_cpu_span[i] = static_cast<int32_t>(request->CurrentSequenceLength());
     }
@@ -87,7 +90,7 @@ void VarlenDecoderIO::PrepareInputIds(std::shared_ptr<DecoderOnly_Model> model,
 void VarlenDecoderIO::PrepareLogits(std::shared_ptr<DecoderOnly_Model> model, ScheduledRequests& scheduled_requests) {
   size_t num_tokens = std::accumulate(scheduled_requests.begin(), scheduled_requests.end(), static_cast<size_t>(0),
                                       [](size_t sum, const std::shared_ptr<Request>& request) {
-                                        return sum + request->UnprocessedTokens().size();
+                                        return sum + request->ScheduledTokens().size();
                                       });
   const std::vector<int64_t> logits_shape = {static_cast<int64_t>(num_tokens), static_cast<int64_t>(model->config_->model.vocab_size)};
   logits_ = std::make_unique<Tensor>(model->p_device_inputs_, model->session_info_.GetOutputDataType(model->config_->model.decoder.outputs.logits));
@@ -100,8 +103,8 @@ void VarlenDecoderIO::PrepareLogits(std::shared_ptr<DecoderOnly_Model> model, Sc
 std::vector<DeviceSpan<float>> VarlenDecoderIO::ProcessLogits() {
   std::vector<size_t> valid_token_indices(scheduled_requests_.size());
   for (size_t i = 0, running_length = 0; i < scheduled_requests_.size(); ++i) {
-    valid_token_indices[i] = running_length + scheduled_requests_[i]->UnprocessedTokens().size() - 1;
-    running_length += scheduled_requests_[i]->UnprocessedTokens().size();
+    valid_token_indices[i] = running_length + scheduled_requests_[i]->ScheduledTokens().size() - 1;
+    running_length += scheduled_requests_[i]->ScheduledTokens().size();
   }
 
   // [num_tokens, vocab_size]
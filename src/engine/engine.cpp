@@ -11,16 +11,138 @@ Engine::Engine(std::shared_ptr<Model> model)
       scheduler_{Scheduler::Create(model, cache_manager_)},
       model_executor_{std::make_unique<ModelExecutor>(model, cache_manager_)} {}
 
+Engine::~Engine() {
+  Stop();
+}
+
+void Engine::Start() {
+  if (is_started_) {
+    throw std::runtime_error("The engine has already been started.");
+  }
+
+  if (HasPendingRequests()) {
+    throw std::runtime_error("The engine must be started before any request is added.");
+  }
+
+  is_started_ = true;
+  is_running_ = true;
+  if (model_->config_->engine.async_token_delivery) {
+    delivery_thread_.emplace();
+  }
+  step_thread_ = std::thread(&Engine::StepLoop, this);
+}
+
+void Engine::Stop() {
+  if (!step_thread_.joinable()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    is_running_ = false;
+  }
+  wake_cv_.notify_all();
+  step_thread_.join();
+  delivery_thread_.reset();
+
+  {
+    std::lock_guard<std::mutex> lock(ready_mutex_);
+  }
+  ready_cv_.notify_all();
+}
+
 void Engine::AddRequest(std::shared_ptr<Request> request) {
+  if (is_started_ && !is_running_) {
+    throw std::runtime_error("Cannot add a request to an engine that has been stopped.");
+  }
+
+  const auto deadline = request->Deadline();
+  const double average_step_latency_ms = average_step_latency_ms_;
+  if (deadline && average_step_latency_ms > 0.0 && model_->config_->engine.scheduling.reject_missed_deadlines) {
+    // One step to process the prompt plus one step per token that is yet to be generated.
+    const double estimated_latency_ms = average_step_latency_ms * static_cast<double>(request->RemainingLength() + 1);
+    const auto estimated_completion = std::chrono::steady_clock::now() +
+                                      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                          std::chrono::duration<double, std::milli>(estimated_latency_ms));
+    if (estimated_completion > *deadline) {
+      throw std::runtime_error("The deadline of the request cannot be met. Estimated latency: " +
+                               std::to_string(estimated_latency_ms) + " ms.");
+    }
+  }
+
   request->Assign(shared_from_this());
-  scheduler_->AddRequest(request);
+
+  if (!is_started_) {
+    scheduler_->AddRequest(request);
+    return;
+  }
+
+  request->EnableTokenDelivery();
+  ++num_active_requests_;
+  submission_queue_.Push({request, false});
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+  }
+  wake_cv_.notify_one();
 }
 
 void Engine::RemoveRequest(std::shared_ptr<Request> request) {
-  scheduler_->RemoveRequest(request);
+  if (!is_started_) {
+    scheduler_->RemoveRequest(request);
+    return;
+  }
+
+  submission_queue_.Push({request, true});
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+  }
+  wake_cv_.notify_one();
+}
+
+ScheduledRequests Engine::RunStep() {
+  const auto start = std::chrono::steady_clock::now();
+  auto scheduled_requests = scheduler_->Schedule();
+  if (!scheduled_requests) {
+    return scheduled_requests;
+  }
+
+  model_executor_->Decode(scheduled_requests);
+  scheduled_requests.GenerateNextTokens();
+
+  constexpr double step_latency_smoothing_factor = 0.1;
+  const double step_latency_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  const double average_step_latency_ms = average_step_latency_ms_;
+  average_step_latency_ms_ = average_step_latency_ms > 0.0
+                                 ? (1.0 - step_latency_smoothing_factor) * average_step_latency_ms +
+                                       step_latency_smoothing_factor * step_latency_ms
+                                 : step_latency_ms;
+
+  return scheduled_requests;
 }
 
 std::shared_ptr<Request> Engine::Step() {
+  if (is_started_) {
+    std::unique_lock<std::mutex> lock(ready_mutex_);
+    ready_cv_.wait(lock, [this]() {
+      return !ready_requests_.empty() || num_active_requests_ == 0 || step_error_ || !is_running_;
+    });
+
+    if (step_error_) {
+      std::rethrow_exception(step_error_);
+    }
+
+    if (ready_requests_.empty()) {
+      return nullptr;
+    }
+
+    auto request = ready_requests_.front();
+    ready_requests_.pop();
+    lock.unlock();
+
+    request->OnDequeued();
+    return request;
+  }
+
   if (!HasPendingRequests()) {
     return nullptr;
   }
@@ -31,9 +153,13 @@ std::shared_ptr<Request> Engine::Step() {
     return request;
   }
 
-  if (auto scheduled_requests = scheduler_->Schedule()) {
-    model_executor_->Decode(scheduled_requests);
-    scheduled_requests.GenerateNextTokens();
+  // A step that only prefills chunks of long prompts does not generate any tokens, so keep stepping
+  // until at least one request has new tokens.
+  while (ready_requests_.empty() && scheduler_->HasPendingRequests()) {
+    auto scheduled_requests = RunStep();
+    if (!scheduled_requests) {
+      break;
+    }
 
     for (auto& request : scheduled_requests) {
       if (request->HasUnseenTokens()) {
@@ -51,8 +177,138 @@ std::shared_ptr<Request> Engine::Step() {
   return request;
 }
 
+void Engine::StepLoop() {
+  try {
+    while (is_running_) {
+      size_t num_removed_requests = 0;
+      for (auto& submission : submission_queue_.PopAll()) {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        if (submission.remove) {
+          scheduler_->RemoveRequest(submission.request);
+          num_removed_requests += active_requests_.erase(submission.request.get());
+        } else {
+          scheduler_->AddRequest(submission.request);
+          active_requests_.insert(submission.request.get());
+        }
+      }
+
+      if (num_removed_requests > 0) {
+        WaitForNotification();
+        NotifyApplication({}, num_removed_requests);
+      }
+
+      if (!scheduler_->HasPendingRequests()) {
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        wake_cv_.wait(lock, [this]() { return !submission_queue_.Empty() || !is_running_; });
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(state_mutex_);
+      auto scheduled_requests = RunStep();
+      auto [ready_requests, num_completed_requests] = CollectReadyRequests(scheduled_requests);
+      lock.unlock();
+
+      WaitForNotification();
+      if (delivery_thread_) {
+        pending_notification_ = delivery_thread_->Enqueue(
+            [this, ready_requests = std::move(ready_requests), num_completed_requests = num_completed_requests]() {
+              NotifyApplication(ready_requests, num_completed_requests);
+            });
+      } else {
+        NotifyApplication(ready_requests, num_completed_requests);
+      }
+    }
+
+    WaitForNotification();
+  } catch (...) {
+    if (pending_notification_.valid()) {
+      pending_notification_.wait();
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(ready_mutex_);
+      step_error_ = std::current_exception();
+    }
+    ready_cv_.notify_all();
+  }
+}
+
+std::pair<std::vector<std::shared_ptr<Request>>, size_t> Engine::CollectReadyRequests(ScheduledRequests& scheduled_requests) {
+  // The tokens are captured on the step thread since the next step appends to the sequences of the requests.
+  std::vector<std::shared_ptr<Request>> ready_requests;
+  size_t num_completed_requests = 0;
+  for (auto& request : scheduled_requests) {
+    if (request->DeliverUnseenTokens()) {
+      ready_requests.push_back(request);
+    }
+
+    if (request->status_ == RequestStatus::Completed && active_requests_.erase(request.get())) {
+      ++num_completed_requests;
+    }
+  }
+
+  return {std::move(ready_requests), num_completed_requests};
+}
+
+void Engine::NotifyApplication(const std::vector<std::shared_ptr<Request>>& ready_requests, size_t num_retired_requests) {
+  for (auto& request : ready_requests) {
+    if (!request->InvokeTokenCallback()) {
+      {
+        std::lock_guard<std::mutex> lock(ready_mutex_);
+        ready_requests_.push(request);
+      }
+      ready_cv_.notify_all();
+    }
+  }
+
+  // Completed requests are retired only after their last tokens were delivered, so that Step does
+  // not report that there are no pending requests before they have been handed over.
+  if (num_retired_requests > 0) {
+    {
+      std::lock_guard<std::mutex> lock(ready_mutex_);
+      num_active_requests_ -= num_retired_requests;
+    }
+    ready_cv_.notify_all();
+  }
+}
+
+void Engine::WaitForNotification() {
+  if (pending_notification_.valid()) {
+    pending_notification_.get();
+  }
+}
+
 bool Engine::HasPendingRequests() const {
+  if (is_started_) {
+    std::lock_guard<std::mutex> lock(ready_mutex_);
+    if (step_error_) {
+      std::rethrow_exception(step_error_);
+    }
+    return !ready_requests_.empty() || (is_running_ && num_active_requests_ > 0);
+  }
+
   return !ready_requests_.empty() || scheduler_->HasPendingRequests();
 }
 
+double Engine::GetStatistic(std::string_view name) const {
+  if (name == "average_step_latency_ms") {
+    return average_step_latency_ms_;
+  }
+
+  std::lock_guard<std::mutex> lock(state_mutex_);
+  if (auto value = cache_manager_->GetStatistic(name)) {
+    return *value;
+  }
+
+  throw std::runtime_error("Unknown engine statistic: " + std::string(name));
+}
+
+MemoryUsage Engine::GetMemoryUsage(std::shared_ptr<Request> request) const {
+  std::lock_guard<std::mutex> lock(state_mutex_);
+  MemoryUsage usage;
+  usage.kv_cache = cache_manager_->KeyValueCacheSizeInBytes(request);
+  usage.scratch = request->ScratchSizeInBytes();
+  return usage;
+}
+
 }  // namespace Generators
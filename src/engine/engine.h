@@ -3,9 +3,14 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <thread>
+
 #include "request.h"
 #include "model_executor.h"
 #include "scheduler.h"
+#include "mpsc_queue.h"
+#include "../worker_thread.h"
 
 /**
  * @file engine.h
@@ -24,6 +29,17 @@ namespace Generators {
  * The Engine class is designed to handle multiple requests concurrently, allowing
  * for efficient execution of models by dynamically batching requests.
  * It is the entry point for adding and processing requests.
+ *
+ * By default, the application drives the Engine by calling Step on a single thread.
+ * Once started with Start, the Engine instead steps on its own background thread.
+ * Requests can then be added and removed from any thread: they are handed to the step
+ * thread through a lock-free submission queue, and new tokens are delivered through the
+ * request's token callback or the completion queue that Step waits on.
+ *
+ * With engine.async_token_delivery set, a started Engine delivers tokens asynchronously: the tokens
+ * of a step are captured on the step thread, and the application is notified of them (including
+ * running the token callbacks) on a delivery thread while the next step is scheduled and executed.
+ * Only the delivery overlaps the next step, the steps themselves still run one after the other.
  */
 struct Engine : std::enable_shared_from_this<Engine>,
                 LeakChecked<Engine>,
@@ -35,9 +51,34 @@ struct Engine : std::enable_shared_from_this<Engine>,
    */
   Engine(std::shared_ptr<Model> model);
 
+  /**
+   * @brief Stops the background step thread if the Engine was started.
+   */
+  ~Engine();
+
+  /**
+   * @brief Starts stepping the Engine on a background thread.
+   *
+   * Must be called before any request is added. Once started, AddRequest and RemoveRequest
+   * are thread-safe, and Step blocks until a request has new tokens instead of running the model.
+   */
+  void Start();
+
+  /**
+   * @brief Stops the background step thread after its current step.
+   *
+   * Requests that have not completed are not processed any further. Requests that already
+   * have new tokens can still be retrieved with Step. The Engine cannot be started again.
+   */
+  void Stop();
+
   /**
    * @brief Adds a request to the Engine for processing.
    * @param request A shared pointer to the Request object to be added.
+   *
+   * If the engine is configured to reject missed deadlines, this throws when the request has a
+   * deadline that it could not meet even if it were scheduled right away, based on the average
+   * latency of recent engine steps.
    */
   void AddRequest(std::shared_ptr<Request> request);
 
@@ -56,6 +97,10 @@ struct Engine : std::enable_shared_from_this<Engine>,
    * Once these requests are scheduled, the Engine offloads the execution to the
    * model executor and updates the requests' states with the newly generated
    * tokens.
+   *
+   * If the Engine was started, this instead waits for the background step thread to deliver
+   * a request with new tokens, and returns nullptr once there are no pending requests left.
+   * Requests with a token callback are never returned.
    */
   std::shared_ptr<Request> Step();
 
@@ -65,12 +110,67 @@ struct Engine : std::enable_shared_from_this<Engine>,
    */
   bool HasPendingRequests() const;
 
+  /**
+   * @brief Returns the current value of the named engine statistic.
+   * @param name The name of the statistic (e.g. "num_available_blocks" or "average_step_latency_ms").
+   * @return The value of the statistic.
+   *
+   * Throws if the statistic is not tracked by the engine or its cache manager.
+   */
+  double GetStatistic(std::string_view name) const;
+
+  /**
+   * @brief Returns the memory used by a request added to the Engine, by category.
+   * @param request The request.
+   *
+   * Reports the key-value cache blocks the request holds and its search state as scratch.
+   */
+  MemoryUsage GetMemoryUsage(std::shared_ptr<Request> request) const;
+
  private:
+  // Schedules and runs the model for one batch of requests and returns the scheduled requests.
+  ScheduledRequests RunStep();
+
+  // The loop run by the background step thread.
+  void StepLoop();
+
+  // Hands the new tokens of the stepped requests over to the requests, and returns the requests
+  // the application must be notified of and the number of requests that completed.
+  std::pair<std::vector<std::shared_ptr<Request>>, size_t> CollectReadyRequests(ScheduledRequests& scheduled_requests);
+
+  // Invokes the token callbacks of or queues the ready requests, then retires the completed requests.
+  void NotifyApplication(const std::vector<std::shared_ptr<Request>>& ready_requests, size_t num_retired_requests);
+
+  // Waits until the application has been notified of the previous step when tokens are delivered asynchronously.
+  void WaitForNotification();
+
+  struct Submission {
+    std::shared_ptr<Request> request;
+    bool remove;  // True to remove the request, false to add it
+  };
+
   std::shared_ptr<Model> model_;                         // The model used by the Engine.
   std::shared_ptr<CacheManager> cache_manager_;          // The cache manager for handling cached data.
   std::unique_ptr<Scheduler> scheduler_;                 // The scheduler responsible for managing execution order.
   std::unique_ptr<ModelExecutor> model_executor_;        // The executor responsible for running the model.
   std::queue<std::shared_ptr<Request>> ready_requests_;  // The list of requests that are ready for the application to process.
+  std::atomic<double> average_step_latency_ms_{};        // Moving average of the model step latency, 0 until the first step.
+
+  // Background stepping (see Start).
+  std::atomic<bool> is_started_{};
+  std::atomic<bool> is_running_{};
+  std::thread step_thread_;
+  MpscQueue<Submission> submission_queue_;           // Requests added or removed by the application threads
+  std::unordered_set<Request*> active_requests_;     // Requests on the step thread that have neither completed nor been removed
+  std::atomic<size_t> num_active_requests_{};        // Requests submitted that have neither completed nor been removed
+  std::mutex wake_mutex_;                            // Used with wake_cv_ to put the idle step thread to sleep
+  std::condition_variable wake_cv_;                  // Signaled when requests are submitted or the Engine is stopped
+  mutable std::mutex ready_mutex_;                   // Guards ready_requests_ and step_error_ while the Engine is started
+  std::condition_variable ready_cv_;                 // Signaled when a request is ready or retired
+  std::exception_ptr step_error_;                    // Error that stopped the step thread, rethrown to the application
+  mutable std::mutex state_mutex_;                   // Held by the step thread while it steps, so statistics can be read safely
+  std::optional<WorkerThread> delivery_thread_;      // Notifies the application of a step's tokens when they are delivered asynchronously
+  std::future<void> pending_notification_;           // Notification of the previous step running on the delivery thread
 };
 
 }  // namespace Generators
@@ -0,0 +1,75 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+/**
+ * @file mpsc_queue.h
+ * @brief Defines a lock-free multiple-producer single-consumer queue.
+ */
+
+namespace Generators {
+
+/**
+ * @class MpscQueue
+ * @brief A lock-free queue that any number of threads can push to and a single thread drains.
+ *
+ * Producers push onto an intrusive stack with a compare-and-swap on its head. The consumer takes
+ * the whole stack at once with a single exchange and reverses it, so items come out in the order
+ * they were pushed.
+ */
+template <typename T>
+struct MpscQueue {
+  MpscQueue() = default;
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+
+  ~MpscQueue() {
+    Node* node = head_.load(std::memory_order_acquire);
+    while (node) {
+      Node* next = node->next;
+      delete node;
+      node = next;
+    }
+  }
+
+  // Can be called from any thread.
+  void Push(T value) {
+    Node* node = new Node{std::move(value), head_.load(std::memory_order_relaxed)};
+    while (!head_.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+  }
+
+  // Can be called from any thread.
+  bool Empty() const {
+    return head_.load(std::memory_order_acquire) == nullptr;
+  }
+
+  // Removes and returns all the items in the order they were pushed. Must only be called by the consumer thread.
+  std::vector<T> PopAll() {
+    Node* node = head_.exchange(nullptr, std::memory_order_acquire);
+    std::vector<T> items;
+    while (node) {
+      items.push_back(std::move(node->value));
+      Node* next = node->next;
+      delete node;
+      node = next;
+    }
+    std::reverse(items.begin(), items.end());
+    return items;
+  }
+
+ private:
+  struct Node {
+    T value;
+    Node* next;
+  };
+
+  std::atomic<Node*> head_{nullptr};
+};
+
+}  // namespace Generators
@@ -7,56 +7,146 @@ namespace Generators {
 
 namespace {
 
-size_t ComputeNumBlocks(std::shared_ptr<Model> model) {
-  if (model->config_->engine.dynamic_batching->num_blocks.has_value()) {
-    return *model->config_->engine.dynamic_batching->num_blocks;
+size_t GetNumBlocks(const Model& model, size_t bytes_per_block) {
+  const auto& dynamic_batching = *model.config_->engine.dynamic_batching;
+  if (dynamic_batching.num_blocks.has_value()) {
+    return *dynamic_batching.num_blocks;
   }
 
-  const auto dtype_size = Ort::SizeOf(ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16);
-
-  size_t free_bytes, total_bytes;
-  model->p_device_kvcache_->GetAvailableMemory(free_bytes, total_bytes);
-
-  constexpr float memory_fragmentation_factor = 0.9f;
-  constexpr size_t num_caches_per_layer = 2;  // 2 for key and value caches
+  // The free memory is only needed to apply gpu_utilization_factor
+  size_t free_bytes{}, total_bytes{};
+  if (dynamic_batching.gpu_utilization_factor.has_value()) {
+    model.p_device_kvcache_->GetAvailableMemory(free_bytes, total_bytes);
+  }
 
-  // Use the free memory to compute the number of blocks needed to achieve the given gpu_utilization_factor.
-  return static_cast<size_t>(free_bytes *
-                             memory_fragmentation_factor *
-                             *model->config_->engine.dynamic_batching->gpu_utilization_factor) /
-         (model->config_->engine.dynamic_batching->block_size *
-          model->config_->model.decoder.num_key_value_heads *
-          model->config_->model.decoder.head_size *
-          model->config_->model.decoder.num_hidden_layers *
-          dtype_size *
-          num_caches_per_layer);
+  return ComputeNumBlocks(bytes_per_block, free_bytes, dynamic_batching.gpu_utilization_factor, dynamic_batching.max_memory_bytes);
 }
 
 }  // namespace
 
 PagedKeyValueCache::PagedKeyValueCache(std::shared_ptr<Model> model)
     : model_(model) {
-  const auto num_blocks = ComputeNumBlocks(model_);
+  const auto& decoder = model->config_->model.decoder;
+  // The cache is stored in the type of the model's past key inputs
+  const auto dtype = model->session_info_.GetInputDataType(ComposeKeyValueName(decoder.inputs.past_key_names, 0));
+
+  block_size_in_bytes_ = ComputeBlockSizeInBytes(model->config_->engine.dynamic_batching->block_size,
+                                                 decoder.num_key_value_heads, decoder.head_size, Ort::SizeOf(dtype));
+
+  constexpr size_t num_caches_per_layer = 2;  // 2 for key and value caches
+  const auto num_blocks = GetNumBlocks(*model_, block_size_in_bytes_ * num_caches_per_layer * decoder.num_hidden_layers);
   const std::vector<int64_t> cache_shape_per_layer{static_cast<int64_t>(num_blocks),
                                                    static_cast<int64_t>(model->config_->engine.dynamic_batching->block_size),
-                                                   static_cast<int64_t>(model->config_->model.decoder.num_key_value_heads),
-                                                   static_cast<int64_t>(model->config_->model.decoder.head_size)};
-  const auto dtype = ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16;
-  for (size_t i = 0; i < model->config_->model.decoder.num_hidden_layers; ++i) {
+                                                   static_cast<int64_t>(decoder.num_key_value_heads),
+                                                   static_cast<int64_t>(decoder.head_size)};
+  for (size_t i = 0; i < decoder.num_hidden_layers; ++i) {
     cache_.push_back(LayerCache{
-        OrtValue::CreateTensor(model->p_device_kvcache_->GetAllocator(), cache_shape_per_layer, dtype),      // Key cache
-        OrtValue::CreateTensor(model->p_device_kvcache_->GetAllocator(), cache_shape_per_layer, dtype),      // Value cache
-        ComposeKeyValueName(model->config_->model.decoder.inputs.past_key_names, static_cast<int>(i)),       // Key cache name
-        ComposeKeyValueName(model->config_->model.decoder.inputs.past_value_names, static_cast<int>(i)),     // Value cache name
-        ComposeKeyValueName(model->config_->model.decoder.outputs.present_key_names, static_cast<int>(i)),   // Key cache output name
-        ComposeKeyValueName(model->config_->model.decoder.outputs.present_value_names, static_cast<int>(i))  // Value cache output name
+        OrtValue::CreateTensor(model->p_device_kvcache_->GetAllocator(), cache_shape_per_layer, dtype),  // Key cache
+        OrtValue::CreateTensor(model->p_device_kvcache_->GetAllocator(), cache_shape_per_layer, dtype),  // Value cache
+        ComposeKeyValueName(decoder.inputs.past_key_names, static_cast<int>(i)),                         // Key cache name
+        ComposeKeyValueName(decoder.inputs.past_value_names, static_cast<int>(i)),                       // Value cache name
+        ComposeKeyValueName(decoder.outputs.present_key_names, static_cast<int>(i)),                     // Key cache output name
+        ComposeKeyValueName(decoder.outputs.present_value_names, static_cast<int>(i))                    // Value cache output name
     });
   }
   block_pool_ = std::make_unique<BlockPool>(model->config_->engine.dynamic_batching->block_size, num_blocks);
+  enable_prefix_caching_ = model->config_->engine.dynamic_batching->enable_prefix_caching;
+
+  const size_t num_swap_blocks = model->config_->engine.dynamic_batching->num_swap_blocks;
+  if (model->config_->engine.dynamic_batching->preemption_mode == "swap" && num_swap_blocks > 0) {
+    auto& cpu_device = *GetDeviceInterface(DeviceType::CPU);
+    for (size_t i = 0; i < cache_.size(); ++i) {
+      host_cache_.push_back(HostLayerCache{
+          cpu_device.Allocate<uint8_t>(num_swap_blocks * block_size_in_bytes_),  // Key cache
+          cpu_device.Allocate<uint8_t>(num_swap_blocks * block_size_in_bytes_)   // Value cache
+      });
+    }
+    host_block_pool_ = std::make_unique<BlockPool>(model->config_->engine.dynamic_batching->block_size, num_swap_blocks);
+
+    const size_t num_disk_swap_blocks = model->config_->engine.dynamic_batching->num_disk_swap_blocks;
+    if (num_disk_swap_blocks > 0) {
+      const auto& swap_file = model->config_->engine.dynamic_batching->swap_file;
+      if (swap_file.empty()) {
+        throw std::runtime_error("engine.dynamic_batching.swap_file must be set when num_disk_swap_blocks is greater than 0.");
+      }
+
+      // The file holds the key cache and value cache of every layer one after the other, in the layout of host_cache_
+      const size_t key_cache_size = num_disk_swap_blocks * block_size_in_bytes_;
+      swap_file_ = std::make_unique<SwapFile>(fs::path{swap_file}, cache_.size() * 2 * key_cache_size);
+      auto data = swap_file_->Data();
+      for (size_t i = 0; i < cache_.size(); ++i) {
+        auto layer_data = data.subspan(i * 2 * key_cache_size, 2 * key_cache_size);
+        disk_cache_.push_back(HostLayerCache{
+            cpu_device.WrapMemory<uint8_t>(layer_data.subspan(0, key_cache_size)),             // Key cache
+            cpu_device.WrapMemory<uint8_t>(layer_data.subspan(key_cache_size, key_cache_size))  // Value cache
+        });
+      }
+      disk_block_pool_ = std::make_unique<BlockPool>(model->config_->engine.dynamic_batching->block_size, num_disk_swap_blocks);
+    }
+  }
+}
+
+std::vector<std::shared_ptr<Block>> PagedKeyValueCache::MatchCachedBlocks(std::span<const int32_t> prompt) const {
+  std::vector<std::shared_ptr<Block>> cached_blocks;
+  if (!enable_prefix_caching_ || prompt.empty()) {
+    return cached_blocks;
+  }
+
+  const size_t block_size = model_->config_->engine.dynamic_batching->block_size;
+  const size_t num_matchable_blocks = (prompt.size() - 1) / block_size;
+  size_t parent_hash = 0;
+  for (size_t i = 0; i < num_matchable_blocks; ++i) {
+    const auto block_token_ids = prompt.subspan(i * block_size, block_size);
+    const size_t hash = ComputeBlockHash(parent_hash, block_token_ids);
+    auto block = block_pool_->LookupCachedBlock(hash, parent_hash, block_token_ids);
+    if (!block) {
+      break;
+    }
+    cached_blocks.push_back(std::move(block));
+    parent_hash = hash;
+  }
+
+  return cached_blocks;
+}
+
+void PagedKeyValueCache::CacheComputedBlocks(BlockTable& block_table) {
+  if (!enable_prefix_caching_) {
+    return;
+  }
+
+  const size_t block_size = model_->config_->engine.dynamic_batching->block_size;
+  auto processed_tokens = block_table.request->ProcessedTokens();
+  const size_t num_computed_blocks = std::min(processed_tokens.size() / block_size, block_table.blocks.size());
+  if (num_computed_blocks <= block_table.num_hashed_blocks) {
+    return;
+  }
+
+  auto processed_tokens_cpu = processed_tokens.CopyDeviceToCpu();
+  for (size_t i = block_table.num_hashed_blocks; i < num_computed_blocks; ++i) {
+    const auto block_token_ids = std::span<const int32_t>(processed_tokens_cpu).subspan(i * block_size, block_size);
+    const size_t hash = ComputeBlockHash(block_table.last_block_hash, block_token_ids);
+    // If another request computed the same block first, this block stays private to the request.
+    block_pool_->CacheBlock(block_table.blocks[i], hash, block_table.last_block_hash, block_token_ids);
+    block_table.last_block_hash = hash;
+  }
+  block_table.num_hashed_blocks = num_computed_blocks;
 }
 
 bool PagedKeyValueCache::CanAdd(std::shared_ptr<Request> request) const {
-  return block_pool_->AvailableBlocks() > block_pool_->BlocksNeeded(request->UnprocessedTokens().size());
+  auto unprocessed_tokens = request->UnprocessedTokens();
+  if (!enable_prefix_caching_) {
+    return block_pool_->AvailableBlocks() > block_pool_->BlocksNeeded(unprocessed_tokens.size());
+  }
+
+  const auto cached_blocks = MatchCachedBlocks(unprocessed_tokens.CopyDeviceToCpu());
+  const size_t block_size = model_->config_->engine.dynamic_batching->block_size;
+  // Unreferenced cached blocks are counted as available, but they cannot be evicted when they are reused.
+  const size_t num_reused_available_blocks = std::count_if(cached_blocks.begin(), cached_blocks.end(),
+                                                           [](const std::shared_ptr<Block>& block) {
+                                                             return block->RefCount() == 0;
+                                                           });
+  return block_pool_->AvailableBlocks() - num_reused_available_blocks >
+         block_pool_->BlocksNeeded(unprocessed_tokens.size() - cached_blocks.size() * block_size);
 }
 
 void PagedKeyValueCache::Add(std::shared_ptr<Request> request) {
@@ -64,8 +154,26 @@ void PagedKeyValueCache::Add(std::shared_ptr<Request> request) {
     throw std::runtime_error("Not enough free blocks available to serve the request.");
   }
 
-  auto allocated_blocks = block_pool_->AllocateBlocks(request->UnprocessedTokens().size());
-  block_tables_.emplace_back(BlockTable{request, std::move(allocated_blocks)});
+  auto unprocessed_tokens = request->UnprocessedTokens();
+  auto cached_blocks = enable_prefix_caching_
+                           ? MatchCachedBlocks(unprocessed_tokens.CopyDeviceToCpu())
+                           : std::vector<std::shared_ptr<Block>>{};
+  for (const auto& block : cached_blocks) {
+    block_pool_->AcquireCachedBlock(block);
+  }
+
+  const size_t num_cached_tokens = cached_blocks.size() * model_->config_->engine.dynamic_batching->block_size;
+  auto allocated_blocks = block_pool_->AllocateBlocks(unprocessed_tokens.size() - num_cached_tokens);
+
+  BlockTable block_table{request, std::move(cached_blocks)};
+  block_table.num_hashed_blocks = block_table.blocks.size();
+  block_table.last_block_hash = block_table.blocks.empty() ? 0 : *block_table.blocks.back()->Hash();
+  std::move(allocated_blocks.begin(), allocated_blocks.end(), std::back_inserter(block_table.blocks));
+  block_tables_.emplace_back(std::move(block_table));
+
+  if (num_cached_tokens > 0) {
+    request->SetCachedPrefixLength(num_cached_tokens);
+  }
 }
 
 bool PagedKeyValueCache::CanAppendTokens(std::shared_ptr<Request> request) const {
@@ -77,7 +185,7 @@ bool PagedKeyValueCache::CanAppendTokens(std::shared_ptr<Request> request) const
     throw std::runtime_error("Given request is not found in the cache.");
   }
 
-  const size_t num_required_slots = request->UnprocessedTokens().size();
+  const size_t num_required_slots = request->ScheduledTokens().size();
   const size_t num_slots_available = block_table_it->blocks.back()->EmptySlots() +
                                      block_pool_->AvailableBlocks() * block_table_it->blocks.back()->Capacity();
 
@@ -95,27 +203,289 @@ void PagedKeyValueCache::AppendTokens(std::shared_ptr<Request> request) {
                                            });
   assert(block_table_it != block_tables_.end());
 
-  size_t num_slots = request->UnprocessedTokens().size();
-  if (!block_table_it->blocks.back()->IsFull()) {
-    for (size_t i = 0; i < std::min(num_slots, block_table_it->blocks.back()->EmptySlots()); ++i) {
-      block_table_it->blocks.back()->AddSlot();
-      --num_slots;
-    }
+  // The blocks computed in the previous step can now be shared with other requests.
+  CacheComputedBlocks(*block_table_it);
+
+  size_t num_slots = request->ScheduledTokens().size();
+  const size_t num_slots_in_last_block = std::min(num_slots, block_table_it->blocks.back()->EmptySlots());
+  for (size_t i = 0; i < num_slots_in_last_block; ++i) {
+    block_table_it->blocks.back()->AddSlot();
   }
+  num_slots -= num_slots_in_last_block;
 
   auto allocated_blocks = block_pool_->AllocateBlocks(num_slots);
   std::move(allocated_blocks.begin(), allocated_blocks.end(),
             std::back_inserter(block_table_it->blocks));
 }
 
+size_t PagedKeyValueCache::BlocksNeededToAppend(const BlockTable& block_table) const {
+  const size_t num_slots = block_table.request->ScheduledTokens().size();
+  const size_t num_slots_in_last_block = std::min(num_slots, block_table.blocks.back()->EmptySlots());
+  return block_pool_->BlocksNeeded(num_slots - num_slots_in_last_block);
+}
+
+bool PagedKeyValueCache::CanAppendTokens(const std::vector<std::shared_ptr<Request>>& requests) const {
+  return BlocksNeededToAppend(requests) <= block_pool_->AvailableBlocks();
+}
+
+size_t PagedKeyValueCache::BlocksNeededToAppend(const std::vector<std::shared_ptr<Request>>& requests) const {
+  size_t num_blocks_needed = 0;
+  for (const auto& request : requests) {
+    const auto block_table_it = std::find_if(block_tables_.begin(), block_tables_.end(),
+                                             [&request](const BlockTable& block_table) {
+                                               return block_table.request == request;
+                                             });
+    if (block_table_it == block_tables_.end()) {
+      throw std::runtime_error("Given request is not found in the cache.");
+    }
+    num_blocks_needed += BlocksNeededToAppend(*block_table_it);
+  }
+
+  return num_blocks_needed;
+}
+
+size_t PagedKeyValueCache::BlocksNeeded(std::shared_ptr<Request> request) const {
+  const auto swapped_block_table_it = std::find_if(swapped_block_tables_.begin(), swapped_block_tables_.end(),
+                                                   [&request](const SwappedBlockTable& swapped_block_table) {
+                                                     return swapped_block_table.request == request;
+                                                   });
+  if (swapped_block_table_it != swapped_block_tables_.end()) {
+    return swapped_block_table_it->blocks.size();
+  }
+
+  return block_pool_->BlocksNeeded(request->UnprocessedTokens().size());
+}
+
+size_t PagedKeyValueCache::SizeInBytes(std::shared_ptr<Request> request) const {
+  const auto block_table_it = std::find_if(block_tables_.begin(), block_tables_.end(),
+                                           [&request](const BlockTable& block_table) {
+                                             return block_table.request == request;
+                                           });
+  return block_table_it == block_tables_.end() ? 0 : block_table_it->blocks.size() * BlockSizeInBytes();
+}
+
+size_t PagedKeyValueCache::SizeInBytes() const {
+  const auto stats = block_pool_->Stats();
+  return (stats.num_blocks - stats.num_available_blocks) * BlockSizeInBytes();
+}
+
+void PagedKeyValueCache::CopyBlock(OrtValue& device_cache, size_t device_block_id,
+                                   DeviceSpan<uint8_t> host_cache, size_t host_block_id, bool to_host) {
+  // Wrap only the block itself so that the device interface does not stage the whole cache through the CPU.
+  auto* device_cache_data = static_cast<uint8_t*>(device_cache.GetTensorMutableRawData());
+  auto device_block = model_->p_device_kvcache_->WrapMemory<uint8_t>(
+      std::span<uint8_t>(device_cache_data + device_block_id * block_size_in_bytes_, block_size_in_bytes_));
+  auto host_block = host_cache.subspan(host_block_id * block_size_in_bytes_, block_size_in_bytes_);
+  if (to_host) {
+    host_block.CopyFrom(device_block);
+  } else {
+    device_block.CopyFrom(host_block);
+  }
+}
+
+void PagedKeyValueCache::CopyLayerBlock(size_t layer_idx, size_t device_block_id, const HostLayerCache& swap_layer_cache,
+                                        size_t swap_block_id, bool to_host) {
+  auto& layer_cache = cache_[layer_idx];
+  CopyBlock(*layer_cache.key_cache, device_block_id, swap_layer_cache.key_cache, swap_block_id, to_host);
+  CopyBlock(*layer_cache.value_cache, device_block_id, swap_layer_cache.value_cache, swap_block_id, to_host);
+}
+
+void PagedKeyValueCache::CopySwapBlock(size_t host_block_id, size_t disk_block_id, bool to_disk) {
+  auto copy = [this, to_disk](DeviceSpan<uint8_t> host_cache, size_t host_block_id, DeviceSpan<uint8_t> disk_cache,
+                              size_t disk_block_id) {
+    auto host_block = host_cache.CpuSpan().subspan(host_block_id * block_size_in_bytes_, block_size_in_bytes_);
+    auto disk_block = disk_cache.CpuSpan().subspan(disk_block_id * block_size_in_bytes_, block_size_in_bytes_);
+    if (to_disk) {
+      std::copy(host_block.begin(), host_block.end(), disk_block.begin());
+    } else {
+      std::copy(disk_block.begin(), disk_block.end(), host_block.begin());
+    }
+  };
+
+  for (size_t layer_idx = 0; layer_idx < cache_.size(); ++layer_idx) {
+    auto& host_layer_cache = host_cache_[layer_idx];
+    auto& disk_layer_cache = disk_cache_[layer_idx];
+    copy(host_layer_cache.key_cache, host_block_id, disk_layer_cache.key_cache, disk_block_id);
+    copy(host_layer_cache.value_cache, host_block_id, disk_layer_cache.value_cache, disk_block_id);
+  }
+}
+
+bool PagedKeyValueCache::SpillBlock() {
+  if (!disk_block_pool_ || disk_block_pool_->AvailableBlocks() == 0) {
+    return false;
+  }
+
+  // The requests swapped out first are the coldest, they are resumed last unless the policy says otherwise.
+  for (auto& swapped_block_table : swapped_block_tables_) {
+    for (auto& swapped_block : swapped_block_table.blocks) {
+      if (swapped_block.on_disk) {
+        continue;
+      }
+
+      auto disk_block = std::move(disk_block_pool_->AllocateBlocks(swapped_block.block->Size()).front());
+      CopySwapBlock(swapped_block.block->Id(), disk_block->Id(), true);
+      host_block_pool_->Free({swapped_block.block});
+      swapped_block = SwappedBlock{std::move(disk_block), true};
+      swap_stats_.num_spilled_blocks++;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool PagedKeyValueCache::CanSwapOut(std::shared_ptr<Request> request) const {
+  if (!host_block_pool_) {
+    return false;
+  }
+
+  const auto block_table_it = std::find_if(block_tables_.begin(), block_tables_.end(),
+                                           [&request](const BlockTable& block_table) {
+                                             return block_table.request == request;
+                                           });
+  // Host blocks are spilled to the swap file to make room, so the swap space is the free space of both.
+  const size_t num_available_swap_blocks = host_block_pool_->AvailableBlocks() +
+                                           (disk_block_pool_ ? disk_block_pool_->AvailableBlocks() : 0);
+  return block_table_it != block_tables_.end() &&
+         block_table_it->blocks.size() <= num_available_swap_blocks;
+}
+
+void PagedKeyValueCache::SwapOut(std::shared_ptr<Request> request) {
+  if (!CanSwapOut(request)) {
+    throw std::runtime_error("Not enough free swap blocks available to swap out the request.");
+  }
+
+  const auto block_table_it = std::find_if(block_tables_.begin(), block_tables_.end(),
+                                           [&request](const BlockTable& block_table) {
+                                             return block_table.request == request;
+                                           });
+  assert(block_table_it != block_tables_.end());
+
+  // The prefix hashes of the computed blocks are kept so that the blocks computed after the request is swapped back in
+  // continue the chain
+  CacheComputedBlocks(*block_table_it);
+
+  // The blocks go to host memory, which is made room for by spilling the blocks of older swapped out requests to the
+  // swap file. Once there is nothing left to spill, the remaining blocks are written to the swap file directly.
+  SwappedBlockTable swapped_block_table{request, {}, block_table_it->num_hashed_blocks, block_table_it->last_block_hash};
+  for (const auto& block : block_table_it->blocks) {
+    if (host_block_pool_->AvailableBlocks() == 0) {
+      SpillBlock();
+    }
+
+    const bool on_disk = host_block_pool_->AvailableBlocks() == 0;
+    auto& swap_block_pool = on_disk ? *disk_block_pool_ : *host_block_pool_;
+    SwappedBlock swapped_block{std::move(swap_block_pool.AllocateBlocks(block->Size()).front()), on_disk};
+    for (size_t layer_idx = 0; layer_idx < cache_.size(); ++layer_idx) {
+      CopyLayerBlock(layer_idx, block->Id(), SwapLayerCache(layer_idx, swapped_block), swapped_block.block->Id(), true);
+    }
+    swapped_block_table.blocks.push_back(std::move(swapped_block));
+  }
+
+  Remove(request);
+  swapped_block_tables_.emplace_back(std::move(swapped_block_table));
+}
+
+bool PagedKeyValueCache::CanSwapIn(std::shared_ptr<Request> request) const {
+  const auto block_table_it = std::find_if(swapped_block_tables_.begin(), swapped_block_tables_.end(),
+                                           [&request](const SwappedBlockTable& block_table) {
+                                             return block_table.request == request;
+                                           });
+  if (block_table_it == swapped_block_tables_.end()) {
+    throw std::runtime_error("Given request is not swapped out.");
+  }
+
+  return block_table_it->blocks.size() < block_pool_->AvailableBlocks();
+}
+
+void PagedKeyValueCache::SwapIn(std::shared_ptr<Request> request) {
+  if (!CanSwapIn(request)) {
+    throw std::runtime_error("Not enough free blocks available to swap in the request.");
+  }
+
+  const auto swapped_block_table_it = std::find_if(swapped_block_tables_.begin(), swapped_block_tables_.end(),
+                                                   [&request](const SwappedBlockTable& block_table) {
+                                                     return block_table.request == request;
+                                                   });
+
+  BlockTable block_table{request, {}, swapped_block_table_it->num_hashed_blocks, swapped_block_table_it->last_block_hash};
+  for (const auto& swapped_block : swapped_block_table_it->blocks) {
+    auto block = std::move(block_pool_->AllocateBlocks(swapped_block.block->Size()).front());
+    for (size_t layer_idx = 0; layer_idx < cache_.size(); ++layer_idx) {
+      CopyLayerBlock(layer_idx, block->Id(), SwapLayerCache(layer_idx, swapped_block), swapped_block.block->Id(), false);
+    }
+    (swapped_block.on_disk ? disk_block_pool_ : host_block_pool_)->Free({swapped_block.block});
+    block_table.blocks.push_back(std::move(block));
+  }
+
+  swapped_block_tables_.erase(swapped_block_table_it);
+  block_tables_.emplace_back(std::move(block_table));
+}
+
+bool PagedKeyValueCache::IsSwappedOut(std::shared_ptr<Request> request) const {
+  return std::any_of(swapped_block_tables_.begin(), swapped_block_tables_.end(),
+                     [&request](const SwappedBlockTable& block_table) {
+                       return block_table.request == request;
+                     });
+}
+
+void PagedKeyValueCache::Prefetch(std::shared_ptr<Request> request) {
+  auto swapped_block_table_it = std::find_if(swapped_block_tables_.begin(), swapped_block_tables_.end(),
+                                             [&request](const SwappedBlockTable& block_table) {
+                                               return block_table.request == request;
+                                             });
+  if (swapped_block_table_it == swapped_block_tables_.end()) {
+    return;
+  }
+
+  for (auto& swapped_block : swapped_block_table_it->blocks) {
+    if (!swapped_block.on_disk) {
+      continue;
+    }
+
+    if (host_block_pool_->AvailableBlocks() > 0) {
+      auto host_block = std::move(host_block_pool_->AllocateBlocks(swapped_block.block->Size()).front());
+      CopySwapBlock(host_block->Id(), swapped_block.block->Id(), false);
+      disk_block_pool_->Free({swapped_block.block});
+      swapped_block = SwappedBlock{std::move(host_block), false};
+      swap_stats_.num_prefetched_blocks++;
+      continue;
+    }
+
+    const size_t block_id = swapped_block.block->Id();
+    auto prefetch = [this, block_id](DeviceSpan<uint8_t>& swap_cache) {
+      const size_t offset = static_cast<size_t>(swap_cache.CpuSpan().data() - swap_file_->Data().data());
+      swap_file_->Prefetch(offset + block_id * block_size_in_bytes_, block_size_in_bytes_);
+    };
+    for (auto& disk_layer_cache : disk_cache_) {
+      prefetch(disk_layer_cache.key_cache);
+      prefetch(disk_layer_cache.value_cache);
+    }
+  }
+
+  // The request is about to be resumed, so it is the last one whose blocks should be spilled again
+  std::rotate(swapped_block_table_it, swapped_block_table_it + 1, swapped_block_tables_.end());
+}
+
 void PagedKeyValueCache::Remove(std::shared_ptr<Request> request) {
   for (auto request_it = block_tables_.begin(); request_it != block_tables_.end(); ++request_it) {
     if (request_it->request == request) {
+      CacheComputedBlocks(*request_it);
       block_pool_->Free(request_it->blocks);
       block_tables_.erase(request_it);
       return;
     }
   }
+
+  for (auto request_it = swapped_block_tables_.begin(); request_it != swapped_block_tables_.end(); ++request_it) {
+    if (request_it->request == request) {
+      for (const auto& swapped_block : request_it->blocks) {
+        (swapped_block.on_disk ? disk_block_pool_ : host_block_pool_)->Free({swapped_block.block});
+      }
+      swapped_block_tables_.erase(request_it);
+      return;
+    }
+  }
 }
 
 std::vector<std::pair<OrtValue*, OrtValue*>> PagedKeyValueCache::Cache() {
@@ -175,6 +545,17 @@ std::pair<OrtValue*, const char*> PagedKeyValueCache::BlockTables(const std::vec
   return {block_tables_value_.get(), model_->config_->model.decoder.inputs.block_table.c_str()};
 }
 
+BlockPoolStats PagedKeyValueCache::Stats() const {
+  return block_pool_->Stats();
+}
+
+SwapSpaceStats PagedKeyValueCache::SwapStats() const {
+  SwapSpaceStats stats = swap_stats_;
+  stats.num_host_blocks = host_block_pool_ ? host_block_pool_->Size() : 0;
+  stats.num_disk_blocks = disk_block_pool_ ? disk_block_pool_->Size() : 0;
+  return stats;
+}
+
 void PagedKeyValueCache::UpdateState(State& state, const std::vector<std::shared_ptr<Request>>& requests) {
   auto cache = Cache();
   auto cache_names = Names();
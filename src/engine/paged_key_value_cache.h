@@ -9,9 +9,20 @@
 
 #include "block.h"
 #include "request.h"
+#include "swap_file.h"
 
 namespace Generators {
 
+/*
+ * SwapSpaceStats holds the usage counters of the swap space of a PagedKeyValueCache.
+ */
+struct SwapSpaceStats {
+  size_t num_host_blocks{};        // Number of host blocks holding swapped out blocks
+  size_t num_disk_blocks{};        // Number of swap file blocks holding swapped out blocks
+  size_t num_spilled_blocks{};     // Number of blocks moved from host memory to the swap file since the cache was created
+  size_t num_prefetched_blocks{};  // Number of blocks moved from the swap file back to host memory by Prefetch
+};
+
 /*
  * PagedKeyValueCache manages a paged key-value cache for models that use the PagedAttention operator.
  * The cache is divided into blocks, each containing a fixed number of slots. Each slot holds
@@ -21,6 +32,28 @@ namespace Generators {
  * supports appending tokens to existing requests and removing requests from the cache.
  * The cache also provides methods to retrieve the current key-value cache and block tables
  * for all requests.
+ *
+ * When prefix caching is enabled (engine.dynamic_batching.enable_prefix_caching), every full block
+ * whose key-value data has been computed is registered in the block pool under a hash of its
+ * token ids chained with the hash of the preceding block. A request whose prompt starts with
+ * the same tokens reuses those blocks when it is added to the cache and skips recomputing them.
+ *
+ * When the cache runs out of blocks, a request can be swapped out: the contents of its blocks are
+ * copied to a pool of host memory blocks (engine.dynamic_batching.num_swap_blocks) and its device
+ * blocks are released. The request is swapped back in once enough device blocks are free again.
+ *
+ * The swap space can extend past host memory into a memory mapped swap file (engine.dynamic_batching.swap_file,
+ * num_disk_swap_blocks). When the host blocks run out, the blocks of the requests that were swapped out first are
+ * spilled to the file to make room. Before a request is resumed, Prefetch reads its spilled blocks back into free
+ * host blocks and asks the operating system to read ahead the ones that do not fit, so that swapping it in does
+ * not wait on the disk.
+ *
+ * The host blocks and the swap file only hold requests that were preempted as a whole. A running request keeps all
+ * of its blocks on the device, so the swap space lets more requests be in flight but does not let a single context
+ * grow past the device blocks.
+ *
+ * The cache is stored in the type of the model's past key inputs, and its blocks are sized by the element size of
+ * that type, see ComputeBlockSizeInBytes.
  */
 struct PagedKeyValueCache {
  public:
@@ -34,6 +67,32 @@ struct PagedKeyValueCache {
 
   void AppendTokens(std::shared_ptr<Request> request);
 
+  // Returns true if the scheduled tokens of all the given requests fit in the cache at the same time.
+  bool CanAppendTokens(const std::vector<std::shared_ptr<Request>>& requests) const;
+
+  // Returns the number of new blocks needed to append the scheduled tokens of all the given requests.
+  size_t BlocksNeededToAppend(const std::vector<std::shared_ptr<Request>>& requests) const;
+
+  // Returns the number of blocks that Add, or SwapIn if the request is swapped out, allocates for the request.
+  // Blocks reused from the prefix cache are not subtracted.
+  size_t BlocksNeeded(std::shared_ptr<Request> request) const;
+
+  bool CanSwapOut(std::shared_ptr<Request> request) const;
+
+  // Copies the blocks of the request to host memory and releases its device blocks.
+  void SwapOut(std::shared_ptr<Request> request);
+
+  bool CanSwapIn(std::shared_ptr<Request> request) const;
+
+  // Allocates device blocks for a swapped out request and copies its blocks back from host memory.
+  void SwapIn(std::shared_ptr<Request> request);
+
+  bool IsSwappedOut(std::shared_ptr<Request> request) const;
+
+  // Moves the blocks of a swapped out request that were spilled to the swap file back to host memory, as far as
+  // there are free host blocks, and starts reading the others ahead. Does nothing if the request is not swapped out.
+  void Prefetch(std::shared_ptr<Request> request);
+
   void Remove(std::shared_ptr<Request> request);
 
   // Returns the K, V cache.
@@ -65,6 +124,20 @@ struct PagedKeyValueCache {
 
   void UpdateState(State& state, const std::vector<std::shared_ptr<Request>>& requests);
 
+  // Returns the allocation counters of the underlying block pool.
+  BlockPoolStats Stats() const;
+
+  SwapSpaceStats SwapStats() const;
+
+  // Returns the size of one block across the key and value caches of all layers.
+  size_t BlockSizeInBytes() const { return cache_.size() * 2 * block_size_in_bytes_; }
+
+  // Returns the size of the device blocks held by the request, 0 if it is not in the cache.
+  size_t SizeInBytes(std::shared_ptr<Request> request) const;
+
+  // Returns the size of the device blocks in use by all the requests.
+  size_t SizeInBytes() const;
+
  private:
   struct LayerCache {
     std::unique_ptr<OrtValue> key_cache;    // Shape: [num_blocks, block_size, num_kv_heads, head_size]
@@ -101,13 +174,69 @@ struct PagedKeyValueCache {
   struct BlockTable {
     std::shared_ptr<Request> request;
     std::vector<std::shared_ptr<Block>> blocks;
+    size_t num_hashed_blocks{};  // Number of leading blocks whose prefix hash has been computed
+    size_t last_block_hash{};    // Prefix hash of the last hashed block
+  };
+
+  // Returns the longest run of cached blocks matching the start of the given prompt.
+  // The last prompt token is never matched since its logits must be computed.
+  std::vector<std::shared_ptr<Block>> MatchCachedBlocks(std::span<const int32_t> prompt) const;
+
+  // Registers the full blocks of the request whose key-value data has been computed for prefix caching.
+  void CacheComputedBlocks(BlockTable& block_table);
+
+  // Returns the number of new blocks needed to append the scheduled tokens of the request.
+  size_t BlocksNeededToAppend(const BlockTable& block_table) const;
+
+  // Copies one block between the device cache and the host swap space.
+  void CopyBlock(OrtValue& device_cache, size_t device_block_id, DeviceSpan<uint8_t> host_cache, size_t host_block_id, bool to_host);
+
+  // Swap space of one layer, in host memory or in the swap file
+  struct HostLayerCache {
+    DeviceSpan<uint8_t> key_cache;    // Shape: [num_swap_blocks, block_size, num_kv_heads, head_size]
+    DeviceSpan<uint8_t> value_cache;  // Shape: [num_swap_blocks, block_size, num_kv_heads, head_size]
+  };
+
+  // A block of a swapped out request
+  struct SwappedBlock {
+    std::shared_ptr<Block> block;  // Allocated from disk_block_pool_ if on_disk, from host_block_pool_ otherwise
+    bool on_disk{};
+  };
+
+  struct SwappedBlockTable {
+    std::shared_ptr<Request> request;
+    std::vector<SwappedBlock> blocks;
+    size_t num_hashed_blocks{};  // Hash state of the BlockTable of the request when it was swapped out
+    size_t last_block_hash{};
   };
 
+  // Copies one block of a layer between the device cache and the swap space.
+  void CopyLayerBlock(size_t layer_idx, size_t device_block_id, const HostLayerCache& swap_layer_cache, size_t swap_block_id, bool to_host);
+
+  // Copies one block of every layer between the host swap space and the swap file.
+  void CopySwapBlock(size_t host_block_id, size_t disk_block_id, bool to_disk);
+
+  // Moves one host block of the request swapped out first to the swap file. Returns false if there is none to move.
+  bool SpillBlock();
+
+  const HostLayerCache& SwapLayerCache(size_t layer_idx, const SwappedBlock& block) const {
+    return block.on_disk ? disk_cache_[layer_idx] : host_cache_[layer_idx];
+  }
+
   std::shared_ptr<Model> model_;
   std::vector<LayerCache> cache_;                 // Pair of key and value caches for all layers
   std::unique_ptr<BlockPool> block_pool_;         // Allocator for blocks
   std::vector<BlockTable> block_tables_;          // Block table for all requests in the cache
+  std::vector<HostLayerCache> host_cache_;        // Host swap space for all layers
+  std::unique_ptr<BlockPool> host_block_pool_;    // Allocator for host swap blocks
+  std::unique_ptr<SwapFile> swap_file_;           // Backs the disk tier of the swap space
+  std::vector<HostLayerCache> disk_cache_;        // Swap file space for all layers
+  std::unique_ptr<BlockPool> disk_block_pool_;    // Allocator for swap file blocks
+  std::vector<SwappedBlockTable> swapped_block_tables_;  // Swap block table for all swapped out requests, in the order they were swapped out
+  SwapSpaceStats swap_stats_;
+  size_t block_size_in_bytes_{};                  // Size of one block of a key or value cache
   std::unique_ptr<OrtValue> block_tables_value_;  // Block tables for all requests in the cache
+  bool enable_prefix_caching_{};                  // Share blocks of identical prompt prefixes across requests
 };
 
 }  // namespace Generators
\ No newline at end of file
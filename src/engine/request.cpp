@@ -30,6 +30,7 @@ void Request::Assign(std::shared_ptr<Engine> engine) {
   }
   engine_ = engine;
   status_ = RequestStatus::Assigned;
+  arrival_time_ = std::chrono::steady_clock::now();
 
   auto device_tokens = AllocateOnDevice(*params_, prefill_input_ids_);
   processed_sequence_length_ = CurrentSequenceLength();
@@ -50,10 +51,34 @@ void Request::Schedule() {
   status_ = RequestStatus::InProgress;
 }
 
+void Request::Preempt(bool recompute) {
+  if (status_ != RequestStatus::InProgress) {
+    throw std::runtime_error("Only requests that are in progress can be preempted.");
+  }
+
+  if (recompute) {
+    processed_sequence_length_ = 0;
+    is_prefill_ = true;
+  }
+  num_scheduled_tokens_.reset();
+
+  status_ = RequestStatus::Preempted;
+}
+
+void Request::Resume() {
+  if (status_ != RequestStatus::Preempted) {
+    throw std::runtime_error("Only preempted requests can be resumed.");
+  }
+
+  status_ = RequestStatus::InProgress;
+}
+
 void Request::Remove() {
-  auto engine = engine_.lock();
-  if (engine) {
+  if (auto engine = engine_.lock()) {
+    // The scheduler resets the status once it has dropped the request. A started engine does that on its step
+    // thread, so the request must not be touched here.
     engine->RemoveRequest(shared_from_this());
+    return;
   }
   status_ = RequestStatus::Unassigned;
 }
@@ -70,7 +95,7 @@ void Request::AddTokens(std::span<const int32_t> tokens) {
 
   if (status_ == RequestStatus::Unassigned) {
     std::copy(tokens.begin(), tokens.end(), std::back_inserter(prefill_input_ids_));
-  } else if (status_ == RequestStatus::InProgress) {
+  } else if (status_ == RequestStatus::InProgress || status_ == RequestStatus::Preempted) {
     throw std::runtime_error("Cannot add tokens to a request that is in progress.");
   } else if (status_ == RequestStatus::Completed) {
     auto device_tokens = AllocateOnDevice(*params_, tokens);
@@ -83,6 +108,16 @@ int64_t Request::CurrentSequenceLength() const {
 }
 
 int32_t Request::UnseenToken() {
+  if (delivers_tokens_) {
+    std::lock_guard<std::mutex> lock(delivery_mutex_);
+    if (delivered_tokens_.empty())
+      throw std::runtime_error("All tokens have been seen.");
+
+    const int32_t token = delivered_tokens_.front();
+    delivered_tokens_.pop_front();
+    return token;
+  }
+
   auto sequence = search_->GetSequence(0).CopyDeviceToCpu();
   if (static_cast<size_t>(seen_sequence_length_) >= sequence.size())
     throw std::runtime_error("All tokens have been seen.");
@@ -91,6 +126,11 @@ int32_t Request::UnseenToken() {
 }
 
 bool Request::HasUnseenTokens() const {
+  if (delivers_tokens_) {
+    std::lock_guard<std::mutex> lock(delivery_mutex_);
+    return !delivered_tokens_.empty();
+  }
+
   return seen_sequence_length_ < CurrentSequenceLength();
 }
 
@@ -100,7 +140,46 @@ DeviceSpan<int32_t> Request::UnprocessedTokens() {
   return unprocessed_tokens;
 }
 
+void Request::SetNumScheduledTokens(size_t num_tokens) {
+  if (num_tokens == 0) {
+    throw std::runtime_error("At least one token must be scheduled for the request.");
+  }
+
+  num_scheduled_tokens_ = num_tokens;
+}
+
+DeviceSpan<int32_t> Request::ScheduledTokens() {
+  auto unprocessed_tokens = UnprocessedTokens();
+  if (!num_scheduled_tokens_ || *num_scheduled_tokens_ >= unprocessed_tokens.size()) {
+    return unprocessed_tokens;
+  }
+  return unprocessed_tokens.subspan(0, *num_scheduled_tokens_);
+}
+
+DeviceSpan<int32_t> Request::ProcessedTokens() {
+  return search_->GetSequence(0).subspan(0, processed_sequence_length_);
+}
+
+void Request::SetCachedPrefixLength(size_t num_tokens) {
+  if (!is_prefill_ || processed_sequence_length_ != 0) {
+    throw std::runtime_error("The cached prefix length can only be set before the prompt is processed.");
+  }
+
+  if (static_cast<int64_t>(num_tokens) >= CurrentSequenceLength()) {
+    throw std::runtime_error("The cached prefix length (" + std::to_string(num_tokens) +
+                             ") must be less than the prompt length (" +
+                             std::to_string(CurrentSequenceLength()) + ").");
+  }
+
+  processed_sequence_length_ = static_cast<int64_t>(num_tokens);
+}
+
 bool Request::IsDone() const {
+  if (delivers_tokens_) {
+    std::lock_guard<std::mutex> lock(delivery_mutex_);
+    return is_delivered_done_;
+  }
+
   return status_ == RequestStatus::Completed;
 }
 
@@ -109,6 +188,14 @@ bool Request::IsPrefill() const {
 }
 
 void Request::GenerateNextTokens(DeviceSpan<float> logits) {
+  const auto num_scheduled_tokens = static_cast<int64_t>(ScheduledTokens().size());
+  num_scheduled_tokens_.reset();
+  if (is_prefill_ && processed_sequence_length_ + num_scheduled_tokens < CurrentSequenceLength()) {
+    // Only a chunk of the prompt has been processed, so the logits are not those of the last prompt token.
+    processed_sequence_length_ += num_scheduled_tokens;
+    return;
+  }
+
   processed_sequence_length_ = search_->GetSequence(0).size();
   is_prefill_ = false;
 
@@ -149,6 +236,92 @@ std::shared_ptr<GeneratorParams> Request::Params() {
   return params_;
 }
 
+void Request::SetPriority(int32_t priority) {
+  priority_ = priority;
+}
+
+int32_t Request::Priority() const {
+  return priority_;
+}
+
+void Request::SetDeadline(std::chrono::steady_clock::time_point deadline) {
+  deadline_ = deadline;
+}
+
+std::optional<std::chrono::steady_clock::time_point> Request::Deadline() const {
+  return deadline_;
+}
+
+std::chrono::steady_clock::time_point Request::ArrivalTime() const {
+  return arrival_time_;
+}
+
+int64_t Request::RemainingLength() const {
+  const int64_t sequence_length = CurrentSequenceLength() + static_cast<int64_t>(prefill_input_ids_.size());
+  return std::max<int64_t>(params_->search.max_length - sequence_length, 0);
+}
+
+void Request::SetTokenCallback(TokenCallback callback) {
+  if (status_ != RequestStatus::Unassigned) {
+    throw std::runtime_error("The token callback must be set before the request is added to the engine.");
+  }
+
+  token_callback_ = std::move(callback);
+}
+
+void Request::EnableTokenDelivery() {
+  delivers_tokens_ = true;
+}
+
+bool Request::DeliverUnseenTokens() {
+  std::vector<int32_t> new_tokens;
+  if (seen_sequence_length_ < CurrentSequenceLength()) {
+    auto sequence = search_->GetSequence(0).CopyDeviceToCpu();
+    new_tokens.assign(sequence.begin() + seen_sequence_length_, sequence.end());
+    seen_sequence_length_ = CurrentSequenceLength();
+  }
+
+  std::lock_guard<std::mutex> lock(delivery_mutex_);
+  delivered_tokens_.insert(delivered_tokens_.end(), new_tokens.begin(), new_tokens.end());
+  const bool is_done = status_ == RequestStatus::Completed;
+  const bool has_news = !new_tokens.empty() || is_done != is_delivered_done_;
+  is_delivered_done_ = is_done;
+  if (!has_news || is_queued_) {
+    return false;
+  }
+
+  is_queued_ = !token_callback_;
+  return true;
+}
+
+void Request::OnDequeued() {
+  std::lock_guard<std::mutex> lock(delivery_mutex_);
+  is_queued_ = false;
+}
+
+bool Request::InvokeTokenCallback() {
+  if (!token_callback_) {
+    return false;
+  }
+
+  token_callback_(*this);
+  return true;
+}
+
+size_t Request::ScratchSizeInBytes() const {
+  return (search_ ? search_->ScratchSizeInBytes() : 0) + prefill_input_ids_.capacity() * sizeof(int32_t);
+}
+
+MemoryUsage Request::GetMemoryUsage() {
+  if (auto engine = engine_.lock()) {
+    return engine->GetMemoryUsage(shared_from_this());
+  }
+
+  MemoryUsage usage;
+  usage.scratch = ScratchSizeInBytes();
+  return usage;
+}
+
 void Request::SetOpaqueData(void* data) {
   opaque_data_ = data;
 }
@@ -3,6 +3,9 @@
 
 #pragma once
 
+#include <chrono>
+#include <deque>
+
 #include "../generators.h"
 
 /**
@@ -18,6 +21,8 @@ enum class RequestStatus {
                // This is the state of a request when it is first created.
   Assigned,    // The request has been added to the engine and is waiting to be scheduled.
   InProgress,  // The request has been scheduled and is currently being processed.
+  Preempted,   // The request was evicted from the key-value cache to make room for other requests
+               // and is waiting to be resumed.
   Completed,   // The request has been completed successfully.
 };
 
@@ -53,6 +58,20 @@ struct Request : std::enable_shared_from_this<Request>,
    */
   void Schedule();
 
+  /**
+   * @brief Updates the status of the request to Preempted.
+   * @param recompute True if the key-value cache of the request was discarded and must be recomputed on resumption.
+   *
+   * A request preempted for recomputation is reset to prefill mode so that all of its tokens, including
+   * the generated ones, are processed again when it is resumed.
+   */
+  void Preempt(bool recompute);
+
+  /**
+   * @brief Updates the status of a preempted request back to InProgress.
+   */
+  void Resume();
+
   /**
    * @brief Adds a sequence of tokens to the request for processing.
    * @param tokens Span of token IDs to be added.
@@ -83,6 +102,42 @@ struct Request : std::enable_shared_from_this<Request>,
    */
   DeviceSpan<int32_t> UnprocessedTokens();
 
+  /**
+   * @brief Limits the number of unprocessed tokens that are processed in the next step.
+   * @param num_tokens Number of leading unprocessed tokens to process. Must be at least 1.
+   *
+   * The scheduler uses this to split a long prompt into chunks that are prefilled over several
+   * steps. The limit only applies to the next step and is cleared once its tokens are processed.
+   */
+  void SetNumScheduledTokens(size_t num_tokens);
+
+  /**
+   * @brief Returns a span of the unprocessed tokens that are processed in the next step.
+   * @return DeviceSpan containing the scheduled token IDs.
+   *
+   * These are all the unprocessed tokens unless the scheduler limited them with SetNumScheduledTokens.
+   */
+  DeviceSpan<int32_t> ScheduledTokens();
+
+  /**
+   * @brief Returns a span of processed tokens on the device.
+   * @return DeviceSpan containing processed token IDs.
+   *
+   * Processed tokens are those tokens whose key-value cache has already been
+   * computed by the model (or reused from the prefix cache).
+   */
+  DeviceSpan<int32_t> ProcessedTokens();
+
+  /**
+   * @brief Marks the leading prompt tokens as processed since their key-value cache is already available.
+   * @param num_tokens Number of leading prompt tokens found in the prefix cache.
+   *
+   * This is only valid before the prompt has been processed. The cached tokens are skipped
+   * when preparing the model inputs, and at least one prompt token must remain unprocessed
+   * so that the logits for the next token can be computed.
+   */
+  void SetCachedPrefixLength(size_t num_tokens);
+
   /**
    * @brief Checks if there are any unseen tokens in the request.
    * @return True if there are unseen tokens, false otherwise.
@@ -92,6 +147,9 @@ struct Request : std::enable_shared_from_this<Request>,
   /**
    * @brief Generates the next set of tokens based on the provided logits.
    * @param logits DeviceSpan containing logits for token generation.
+   *
+   * If only a chunk of the prompt was processed, the scheduled tokens are marked as processed
+   * and no token is generated until the rest of the prompt has been processed.
    */
   void GenerateNextTokens(DeviceSpan<float> logits);
 
@@ -126,6 +184,94 @@ struct Request : std::enable_shared_from_this<Request>,
    */
   std::shared_ptr<GeneratorParams> Params();
 
+  /**
+   * @brief Sets the priority of the request.
+   * @param priority The priority of the request. Requests with a higher priority are served first
+   *                 when the engine is configured with the "priority" scheduling policy. Defaults to 0.
+   */
+  void SetPriority(int32_t priority);
+
+  int32_t Priority() const;
+
+  /**
+   * @brief Sets the point in time by which the request should be completed.
+   * @param deadline The deadline of the request.
+   *
+   * Requests with an earlier deadline are served first when the engine is configured with the
+   * "earliest_deadline_first" scheduling policy. If the engine rejects missed deadlines, adding
+   * a request whose deadline cannot be met fails.
+   */
+  void SetDeadline(std::chrono::steady_clock::time_point deadline);
+
+  std::optional<std::chrono::steady_clock::time_point> Deadline() const;
+
+  /**
+   * @brief Gets the point in time at which the request was added to the engine.
+   */
+  std::chrono::steady_clock::time_point ArrivalTime() const;
+
+  /**
+   * @brief Gets the number of tokens the request has yet to generate at most.
+   */
+  int64_t RemainingLength() const;
+
+  /**
+   * @brief Callback invoked by an engine running in the background when the request has new tokens.
+   *
+   * The callback runs on the engine's step thread, or on its delivery thread if engine.async_token_delivery is set.
+   * It should retrieve the unseen tokens and return quickly, since the engine does not make progress
+   * on other requests while it runs (or, with asynchronous delivery, beyond the step that is already running).
+   */
+  using TokenCallback = std::function<void(Request& request)>;
+
+  /**
+   * @brief Sets the callback that receives the new tokens of the request.
+   * @param callback The callback, or an empty function to deliver the request through the engine's completion queue.
+   *
+   * Only used when the engine runs in the background (see Engine::Start). Must be set before the
+   * request is added to the engine.
+   */
+  void SetTokenCallback(TokenCallback callback);
+
+  /**
+   * @brief Switches the request to tokens handed over by an engine running in the background.
+   *
+   * Called by the engine when the request is added. From then on, HasUnseenTokens, UnseenToken and
+   * IsDone only read the tokens and state handed over by DeliverUnseenTokens, so the application can
+   * call them from any thread while the engine keeps stepping.
+   */
+  void EnableTokenDelivery();
+
+  /**
+   * @brief Hands the unseen tokens of the request over to the application.
+   * @return True if the request has new tokens or has completed, and is not already waiting in the
+   *         engine's completion queue.
+   */
+  bool DeliverUnseenTokens();
+
+  /**
+   * @brief Marks the request as taken from the engine's completion queue.
+   */
+  void OnDequeued();
+
+  /**
+   * @brief Invokes the token callback, if one is set.
+   * @return True if the callback was invoked.
+   */
+  bool InvokeTokenCallback();
+
+  /**
+   * @brief Gets the size of the search state of the request: its sequences, prompt and sampling buffers.
+   */
+  size_t ScratchSizeInBytes() const;
+
+  /**
+   * @brief Gets the memory used by the request, by category.
+   * @return The search state as scratch and, once the request is added to an engine, the key-value cache
+   *         blocks it holds on the device.
+   */
+  MemoryUsage GetMemoryUsage();
+
   /**
    * @brief Sets the opaque data for user-defined purposes.
    * @param data Pointer to the opaque data.
@@ -150,12 +296,24 @@ struct Request : std::enable_shared_from_this<Request>,
   std::vector<int32_t> prefill_input_ids_;
   int64_t seen_sequence_length_{};
   int64_t processed_sequence_length_{};
+  std::optional<size_t> num_scheduled_tokens_;  // Number of unprocessed tokens to process in the next step, all if not set
   std::shared_ptr<GeneratorParams> params_;
   std::unique_ptr<Search> search_;
   std::weak_ptr<Engine> engine_;
   bool is_prefill_{true};
+  int32_t priority_{};
+  std::optional<std::chrono::steady_clock::time_point> deadline_;
+  std::chrono::steady_clock::time_point arrival_time_;
 
   void* opaque_data_{nullptr};  // Opaque data for user-defined purposes, can be set and retrieved by the application
+
+  // State handed over to the application by an engine running in the background, guarded by delivery_mutex_.
+  mutable std::mutex delivery_mutex_;
+  std::atomic<bool> delivers_tokens_{};  // True if the request is served by an engine running in the background
+  std::deque<int32_t> delivered_tokens_;
+  bool is_delivered_done_{};
+  bool is_queued_{};  // True while the request is waiting in the engine's completion queue
+  TokenCallback token_callback_;
 };
 
 }  // namespace Generators
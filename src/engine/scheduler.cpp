@@ -3,10 +3,13 @@
 
 #include "engine.h"
 
+#include <limits>
+
 namespace Generators {
 
-StaticBatchScheduler::StaticBatchScheduler(std::shared_ptr<Model> model, std::shared_ptr<CacheManager> cache_manager)
-    : model_{model}, cache_manager_{cache_manager} {}
+StaticBatchScheduler::StaticBatchScheduler(std::shared_ptr<Model> model, std::shared_ptr<CacheManager> cache_manager,
+                                           std::unique_ptr<SchedulingPolicy> policy)
+    : model_{model}, cache_manager_{cache_manager}, policy_{std::move(policy)} {}
 
 void StaticBatchScheduler::AddRequest(std::shared_ptr<Request> request) {
   requests_pool_.push_back(request);
@@ -15,10 +18,31 @@ void StaticBatchScheduler::AddRequest(std::shared_ptr<Request> request) {
 void StaticBatchScheduler::RemoveRequest(std::shared_ptr<Request> request) {
   // For statically batched requests, memory is managed as a single block for the entire batch,
   // so individual requests cannot be deallocated until the whole batch is completed.
-  // Therefore, deallocation is only performed for dynamically batched requests below.
-  // we simply mark the request to be removed and it will be deallocated when the
-  // entire batch is completed.
-  to_be_removed_requests_.insert(request);
+  // If the batch of the request is still generating, we simply mark the request to be removed
+  // and it will be deallocated when the entire batch is completed.
+  auto allocated_requests = cache_manager_->AllocatedRequests();
+  if (std::find(allocated_requests.begin(), allocated_requests.end(), request) != allocated_requests.end()) {
+    if (!std::all_of(allocated_requests.begin(), allocated_requests.end(),
+                     [](const std::shared_ptr<Request>& allocated_request) {
+                       return allocated_request->status_ == RequestStatus::Completed;
+                     })) {
+      to_be_removed_requests_.insert(request);
+      return;
+    }
+
+    // The batch is done, so it can be retired right away. This keeps the request from holding on to
+    // the completed status, which would otherwise make the next AddTokens continue its old sequence.
+    cache_manager_->Deallocate(allocated_requests);
+    for (auto& allocated_request : allocated_requests) {
+      requests_pool_.erase(std::remove(requests_pool_.begin(), requests_pool_.end(), allocated_request),
+                           requests_pool_.end());
+      if (to_be_removed_requests_.erase(allocated_request))
+        allocated_request->status_ = RequestStatus::Unassigned;
+    }
+  }
+
+  requests_pool_.erase(std::remove(requests_pool_.begin(), requests_pool_.end(), request), requests_pool_.end());
+  request->status_ = RequestStatus::Unassigned;
 }
 
 ScheduledRequests StaticBatchScheduler::Schedule() {
@@ -28,6 +52,7 @@ ScheduledRequests StaticBatchScheduler::Schedule() {
       requests_to_schedule.push_back(request);
     }
   }
+  policy_->Sort(requests_to_schedule);
 
   constexpr size_t static_batch_size = 4;
   for (size_t batch_size = std::min(static_batch_size, requests_to_schedule.size());
@@ -43,6 +68,8 @@ ScheduledRequests StaticBatchScheduler::Schedule() {
           throw std::runtime_error("Encountered a request that was removed from the engine but was not completed.");
         }
         requests_pool_.erase(std::remove(requests_pool_.begin(), requests_pool_.end(), request), requests_pool_.end());
+        if (to_be_removed_requests_.erase(request))
+          request->status_ = RequestStatus::Unassigned;
       }
 
       cache_manager_->Allocate(batch_requests);
@@ -72,8 +99,9 @@ bool StaticBatchScheduler::HasPendingRequests() const {
   return false;
 }
 
-DynamicBatchScheduler::DynamicBatchScheduler(std::shared_ptr<Model> model, std::shared_ptr<CacheManager> cache_manager)
-    : model_{model}, cache_manager_{cache_manager} {}
+DynamicBatchScheduler::DynamicBatchScheduler(std::shared_ptr<Model> model, std::shared_ptr<CacheManager> cache_manager,
+                                             std::unique_ptr<SchedulingPolicy> policy)
+    : model_{model}, cache_manager_{cache_manager}, policy_{std::move(policy)} {}
 
 void DynamicBatchScheduler::AddRequest(std::shared_ptr<Request> request) {
   requests_pool_.push_back(request);
@@ -84,23 +112,105 @@ void DynamicBatchScheduler::RemoveRequest(std::shared_ptr<Request> request) {
   cache_manager_->Deallocate(requests_to_remove);
 
   requests_pool_.erase(std::remove(requests_pool_.begin(), requests_pool_.end(), request), requests_pool_.end());
+  preempted_requests_.erase(std::remove(preempted_requests_.begin(), preempted_requests_.end(), request),
+                            preempted_requests_.end());
+  request->status_ = RequestStatus::Unassigned;
 }
 
-ScheduledRequests DynamicBatchScheduler::Schedule() {
-  std::vector<std::shared_ptr<Request>> requests_to_schedule;
-  for (auto& request : requests_pool_) {
-    if (request->status_ == RequestStatus::Assigned) {
-      requests_to_schedule.push_back(request);
+void DynamicBatchScheduler::PreemptRequests() {
+  while (!cache_manager_->CanStep()) {
+    std::vector<std::shared_ptr<Request>> running_requests;
+    for (auto& request : cache_manager_->AllocatedRequests()) {
+      if (request->status_ == RequestStatus::InProgress) {
+        running_requests.push_back(request);
+      }
+    }
+
+    if (running_requests.size() <= 1) {
+      // The swap space only holds preempted requests, so it cannot make room for the last running one.
+      throw std::runtime_error("Not enough free blocks available to make progress on a single request. "
+                               "Every request must fit in engine.dynamic_batching.num_blocks.");
+    }
+
+    policy_->Sort(running_requests);
+    cache_manager_->Preempt(running_requests.back());
+    preempted_requests_.push_back(running_requests.back());
+  }
+}
+
+size_t DynamicBatchScheduler::AssignTokenBudget() {
+  const auto& max_num_batched_tokens = model_->config_->engine.dynamic_batching->max_num_batched_tokens;
+  if (!max_num_batched_tokens) {
+    return std::numeric_limits<size_t>::max();
+  }
+
+  // Decoding requests are served first so that a long prompt cannot stall their inter-token latency.
+  const auto allocated_requests = cache_manager_->AllocatedRequests();
+  size_t token_budget = *max_num_batched_tokens;
+  for (auto& request : allocated_requests) {
+    if (!request->IsPrefill()) {
+      token_budget -= std::min(token_budget, request->UnprocessedTokens().size());
+    }
+  }
+
+  // The rest of the budget goes to prefilling requests in the order they were admitted. Every allocated
+  // request is part of the batch, so each one processes at least one token even if the budget is spent.
+  for (auto& request : allocated_requests) {
+    if (request->IsPrefill()) {
+      const size_t num_tokens = std::clamp(token_budget, size_t{1}, request->UnprocessedTokens().size());
+      request->SetNumScheduledTokens(num_tokens);
+      token_budget -= std::min(token_budget, num_tokens);
     }
   }
 
-  for (auto& request : requests_to_schedule) {
-    if (cache_manager_->CanAllocate({request})) {
-      cache_manager_->Allocate({request});
-      request->Schedule();
+  return token_budget;
+}
+
+ScheduledRequests DynamicBatchScheduler::Schedule() {
+  // Make room for the requests that are already running before admitting any more.
+  AssignTokenBudget();
+  PreemptRequests();
+
+  // Preempted requests are resumed in policy order, and ahead of new requests.
+  policy_->Sort(preempted_requests_);
+  while (!preempted_requests_.empty() && cache_manager_->CanResume(preempted_requests_.front())) {
+    cache_manager_->Resume(preempted_requests_.front());
+    preempted_requests_.erase(preempted_requests_.begin());
+  }
+
+  // The next request to resume has the blocks it spilled to disk read back ahead of time.
+  if (!preempted_requests_.empty()) {
+    cache_manager_->Prefetch(preempted_requests_.front());
+  }
+
+  if (preempted_requests_.empty()) {
+    std::vector<std::shared_ptr<Request>> requests_to_schedule;
+    for (auto& request : requests_pool_) {
+      if (request->status_ == RequestStatus::Assigned) {
+        requests_to_schedule.push_back(request);
+      }
+    }
+    policy_->Sort(requests_to_schedule);
+
+    // New requests are only admitted while the token budget of the step is not spent.
+    size_t token_budget = AssignTokenBudget();
+    for (auto& request : requests_to_schedule) {
+      if (token_budget == 0) {
+        break;
+      }
+
+      if (cache_manager_->CanAllocate({request})) {
+        cache_manager_->Allocate({request});
+        request->Schedule();
+        token_budget = AssignTokenBudget();
+      }
     }
   }
 
+  // Admitted or resumed requests may not leave enough room for every request to append its tokens.
+  AssignTokenBudget();
+  PreemptRequests();
+
   ScheduledRequests scheduled_requests(cache_manager_->AllocatedRequests(), model_);
 
   if (!scheduled_requests) {
@@ -120,11 +230,12 @@ bool DynamicBatchScheduler::HasPendingRequests() const {
 }
 
 std::unique_ptr<Scheduler> Scheduler::Create(std::shared_ptr<Model> model, std::shared_ptr<CacheManager> cache_manager) {
+  auto policy = SchedulingPolicy::Create(model->config_->engine.scheduling.policy);
   if (cache_manager->SupportsDynamicBatching()) {
-    return std::make_unique<DynamicBatchScheduler>(model, cache_manager);
+    return std::make_unique<DynamicBatchScheduler>(model, cache_manager, std::move(policy));
   }
 
-  return std::make_unique<StaticBatchScheduler>(model, cache_manager);
+  return std::make_unique<StaticBatchScheduler>(model, cache_manager, std::move(policy));
 }
 
 }  // namespace Generators
@@ -6,6 +6,7 @@
 #include "request.h"
 #include "scheduled_requests.h"
 #include "cache_manager.h"
+#include "scheduling_policy.h"
 
 /**
  * @file scheduler.h
@@ -39,6 +40,7 @@ struct Scheduler {
    * @param request A shared pointer to the Request object to be removed.
    *
    * This function marks the request for removal and cleans up any associated resources.
+   * The status of the request is reset to unassigned once the scheduler no longer holds it.
    */
   virtual void RemoveRequest(std::shared_ptr<Request> request) = 0;
 
@@ -64,7 +66,8 @@ struct Scheduler {
 };
 
 struct StaticBatchScheduler : Scheduler {
-  StaticBatchScheduler(std::shared_ptr<Model> model, std::shared_ptr<CacheManager> cache_manager);
+  StaticBatchScheduler(std::shared_ptr<Model> model, std::shared_ptr<CacheManager> cache_manager,
+                       std::unique_ptr<SchedulingPolicy> policy);
 
   void AddRequest(std::shared_ptr<Request> request) override;
 
@@ -77,12 +80,14 @@ struct StaticBatchScheduler : Scheduler {
  private:
   std::shared_ptr<Model> model_;
   std::shared_ptr<CacheManager> cache_manager_;
+  std::unique_ptr<SchedulingPolicy> policy_;
   std::vector<std::shared_ptr<Request>> requests_pool_;
   std::set<std::shared_ptr<Request>> to_be_removed_requests_;
 };
 
 struct DynamicBatchScheduler : Scheduler {
-  DynamicBatchScheduler(std::shared_ptr<Model> model, std::shared_ptr<CacheManager> cache_manager);
+  DynamicBatchScheduler(std::shared_ptr<Model> model, std::shared_ptr<CacheManager> cache_manager,
+                        std::unique_ptr<SchedulingPolicy> policy);
 
   void AddRequest(std::shared_ptr<Request> request) override;
 
@@ -93,9 +98,17 @@ struct DynamicBatchScheduler : Scheduler {
   bool HasPendingRequests() const override;
 
  private:
+  // Preempts the allocated requests that come last in policy order until the remaining ones can be stepped.
+  void PreemptRequests();
+
+  // Splits the token budget of the next step between the allocated requests and returns the unused budget.
+  size_t AssignTokenBudget();
+
   std::shared_ptr<Model> model_;
   std::shared_ptr<CacheManager> cache_manager_;
+  std::unique_ptr<SchedulingPolicy> policy_;
   std::vector<std::shared_ptr<Request>> requests_pool_;
+  std::vector<std::shared_ptr<Request>> preempted_requests_;
 };
 
 std::unique_ptr<Scheduler> CreateScheduler(std::shared_ptr<Model> model, std::shared_ptr<CacheManager> cache_manager);
@@ -0,0 +1,54 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "scheduling_policy.h"
+
+#include <stdexcept>
+#include <string>
+
+namespace Generators {
+
+std::unique_ptr<SchedulingPolicy> SchedulingPolicy::Create(std::string_view name) {
+  if (name == "fcfs") {
+    return std::make_unique<FirstComeFirstServedPolicy>();
+  } else if (name == "priority") {
+    return std::make_unique<PriorityPolicy>();
+  } else if (name == "shortest_prompt_first") {
+    return std::make_unique<ShortestPromptFirstPolicy>();
+  } else if (name == "earliest_deadline_first") {
+    return std::make_unique<EarliestDeadlineFirstPolicy>();
+  }
+
+  throw std::runtime_error("Unsupported scheduling policy: " + std::string(name));
+}
+
+bool SchedulingPolicy::ServesFirst(const SchedulingKey& a, const SchedulingKey& b) const {
+  if (Precedes(a, b)) {
+    return true;
+  }
+  if (Precedes(b, a)) {
+    return false;
+  }
+  return a.arrival_time < b.arrival_time;
+}
+
+bool FirstComeFirstServedPolicy::Precedes(const SchedulingKey& a, const SchedulingKey& b) const {
+  return false;
+}
+
+bool PriorityPolicy::Precedes(const SchedulingKey& a, const SchedulingKey& b) const {
+  return a.priority > b.priority;
+}
+
+bool ShortestPromptFirstPolicy::Precedes(const SchedulingKey& a, const SchedulingKey& b) const {
+  return a.num_unprocessed_tokens < b.num_unprocessed_tokens;
+}
+
+bool EarliestDeadlineFirstPolicy::Precedes(const SchedulingKey& a, const SchedulingKey& b) const {
+  if (a.deadline && b.deadline) {
+    return *a.deadline < *b.deadline;
+  }
+  return a.deadline.has_value() && !b.deadline.has_value();
+}
+
+}  // namespace Generators
@@ -0,0 +1,98 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+/**
+ * @file scheduling_policy.h
+ * @brief Defines the SchedulingPolicy class, which decides the order in which the
+ *        scheduler serves requests.
+ */
+
+namespace Generators {
+
+/**
+ * @struct SchedulingKey
+ * @brief The properties of a request that the scheduling policies order requests by.
+ */
+struct SchedulingKey {
+  int32_t priority{};
+  size_t num_unprocessed_tokens{};
+  std::optional<std::chrono::steady_clock::time_point> deadline;
+  std::chrono::steady_clock::time_point arrival_time;
+};
+
+/**
+ * @class SchedulingPolicy
+ * @brief Orders requests for the scheduler.
+ *
+ * Waiting requests are admitted and preempted requests are resumed in policy order,
+ * and running requests are preempted in reverse policy order. Requests that the policy
+ * considers equal are served in the order they were added to the engine.
+ */
+struct SchedulingPolicy {
+  /**
+   * @brief Creates the scheduling policy with the given name.
+   * @param name One of "fcfs", "priority", "shortest_prompt_first" or "earliest_deadline_first".
+   */
+  static std::unique_ptr<SchedulingPolicy> Create(std::string_view name);
+
+  /**
+   * @brief Sorts the given requests so that the request to serve first comes first.
+   * @param requests The requests to sort, pointers to Request or to any type with the same accessors.
+   */
+  template <typename RequestPtr>
+  void Sort(std::vector<RequestPtr>& requests) const {
+    const auto key = [](const RequestPtr& request) {
+      return SchedulingKey{request->Priority(), request->UnprocessedTokens().size(), request->Deadline(), request->ArrivalTime()};
+    };
+    std::stable_sort(requests.begin(), requests.end(),
+                     [this, &key](const RequestPtr& a, const RequestPtr& b) { return ServesFirst(key(a), key(b)); });
+  }
+
+  /**
+   * @brief Returns true if the request with key a is served before the request with key b.
+   *        Requests that the policy considers equal are served in arrival order.
+   */
+  bool ServesFirst(const SchedulingKey& a, const SchedulingKey& b) const;
+
+  virtual ~SchedulingPolicy() = default;
+
+ protected:
+  // Returns true if a should be served before b, false if b should be served first or both are equal.
+  virtual bool Precedes(const SchedulingKey& a, const SchedulingKey& b) const = 0;
+};
+
+// Serves requests in the order they were added to the engine.
+struct FirstComeFirstServedPolicy : SchedulingPolicy {
+ protected:
+  bool Precedes(const SchedulingKey& a, const SchedulingKey& b) const override;
+};
+
+// Serves requests with a higher priority first.
+struct PriorityPolicy : SchedulingPolicy {
+ protected:
+  bool Precedes(const SchedulingKey& a, const SchedulingKey& b) const override;
+};
+
+// Serves requests with fewer unprocessed tokens first.
+struct ShortestPromptFirstPolicy : SchedulingPolicy {
+ protected:
+  bool Precedes(const SchedulingKey& a, const SchedulingKey& b) const override;
+};
+
+// Serves requests with an earlier deadline first. Requests without a deadline are served last.
+struct EarliestDeadlineFirstPolicy : SchedulingPolicy {
+ protected:
+  bool Precedes(const SchedulingKey& a, const SchedulingKey& b) const override;
+};
+
+}  // namespace Generators
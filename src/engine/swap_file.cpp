@@ -0,0 +1,78 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "swap_file.h"
+
+#include <stdexcept>
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace Generators {
+
+SwapFile::SwapFile(const fs::path& path, size_t size) : size_{size} {
+  if (size == 0)
+    throw std::runtime_error("The swap file " + path.string() + " must not be empty");
+
+#ifdef _WIN32
+  file_handle_ = ::CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                               FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+  if (file_handle_ == INVALID_HANDLE_VALUE) {
+    file_handle_ = nullptr;
+    throw std::runtime_error("Could not create the swap file " + path.string());
+  }
+  const auto size64 = static_cast<uint64_t>(size);
+  mapping_handle_ = ::CreateFileMappingW(file_handle_, nullptr, PAGE_READWRITE, static_cast<DWORD>(size64 >> 32),
+                                         static_cast<DWORD>(size64 & 0xFFFFFFFF), nullptr);
+  mapped_data_ = mapping_handle_ ? ::MapViewOfFile(mapping_handle_, FILE_MAP_ALL_ACCESS, 0, 0, 0) : nullptr;
+  if (!mapped_data_) {
+    if (mapping_handle_)
+      ::CloseHandle(mapping_handle_);
+    ::CloseHandle(file_handle_);
+    throw std::runtime_error("Could not map the swap file " + path.string());
+  }
+#else
+  const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd == -1)
+    throw std::runtime_error("Could not create the swap file " + path.string());
+  ::unlink(path.c_str());  // The mapping keeps the file alive until it is unmapped
+  if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+    ::close(fd);
+    throw std::runtime_error("Could not allocate " + std::to_string(size) + " bytes for the swap file " + path.string());
+  }
+  mapped_data_ = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mapped_data_ == MAP_FAILED) {
+    mapped_data_ = nullptr;
+    throw std::runtime_error("Could not map the swap file " + path.string());
+  }
+#endif
+}
+
+SwapFile::~SwapFile() {
+#ifdef _WIN32
+  ::UnmapViewOfFile(mapped_data_);
+  ::CloseHandle(mapping_handle_);
+  ::CloseHandle(file_handle_);
+#else
+  ::munmap(mapped_data_, size_);
+#endif
+}
+
+void SwapFile::Prefetch(size_t offset, size_t size) const {
+#ifdef _WIN32
+  WIN32_MEMORY_RANGE_ENTRY range{static_cast<uint8_t*>(mapped_data_) + offset, size};
+  ::PrefetchVirtualMemory(::GetCurrentProcess(), 1, &range, 0);
+#else
+  // madvise needs a page aligned address
+  static const size_t page_size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+  const size_t begin = offset / page_size * page_size;
+  ::madvise(static_cast<uint8_t*>(mapped_data_) + begin, size + offset - begin, MADV_WILLNEED);
+#endif
+}
+
+}  // namespace Generators
@@ -0,0 +1,42 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stdint.h>
+
+#include "../filesystem.h"
+#include "../span.h"
+
+namespace Generators {
+
+/*
+ * SwapFile is a scratch file of a fixed size that is memory mapped for reading and writing. It backs the disk tier
+ * of the paged key-value cache swap space, which holds the blocks of preempted requests that do not fit in host
+ * memory. The operating system pages the blocks in and out as they are copied, so a swap file can be much larger
+ * than the host memory.
+ *
+ * The file is deleted when it is closed, including when the process exits without destroying it.
+ */
+struct SwapFile {
+  SwapFile(const fs::path& path, size_t size);
+  ~SwapFile();
+
+  std::span<uint8_t> Data() const { return {static_cast<uint8_t*>(mapped_data_), size_}; }
+
+  // Asks the operating system to start reading a range of the file into memory ahead of its use
+  void Prefetch(size_t offset, size_t size) const;
+
+ private:
+  SwapFile(const SwapFile&) = delete;
+  SwapFile& operator=(const SwapFile&) = delete;
+
+  size_t size_;
+#ifdef _WIN32
+  void* file_handle_{};
+  void* mapping_handle_{};
+#endif
+  void* mapped_data_{};
+};
+
+}  // namespace Generators
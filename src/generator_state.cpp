@@ -0,0 +1,170 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "generator_state.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace Generators {
+
+GeneratorStateWriter::GeneratorStateWriter(const fs::path& path)
+    : path_{path}, file_{path.open_for_write(std::ios::binary | std::ios::trunc)} {
+  if (!file_)
+    throw std::runtime_error("Could not open " + path.string() + " to write the generator state");
+
+  // The header is written by Finish once the table offset is known
+  Pad(sizeof(GeneratorStateHeader));
+}
+
+void GeneratorStateWriter::Pad(uint64_t offset) {
+  static constexpr std::array<char, GeneratorStateHeader::PageSize> zeros{};
+  while (offset_ < offset) {
+    const auto count = std::min<uint64_t>(offset - offset_, zeros.size());
+    file_.write(zeros.data(), static_cast<std::streamsize>(count));
+    offset_ += count;
+  }
+}
+
+void GeneratorStateWriter::Write(std::string_view name, std::span<const uint8_t> data) {
+  GeneratorStateSection section{};
+  if (name.size() >= section.name.size())
+    throw std::runtime_error("Generator state section name is too long: " + std::string(name));
+  std::copy(name.begin(), name.end(), section.name.begin());
+
+  constexpr uint64_t alignment = GeneratorStateHeader::PageSize;
+  Pad((offset_ + alignment - 1) / alignment * alignment);
+  section.offset = offset_;
+  section.size = data.size();
+
+  file_.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+  offset_ += data.size();
+  sections_.push_back(section);
+
+  if (!file_)
+    throw std::runtime_error("Could not write the generator state to " + path_.string());
+}
+
+void GeneratorStateWriter::Finish() {
+  Pad((offset_ + alignof(GeneratorStateSection) - 1) / alignof(GeneratorStateSection) * alignof(GeneratorStateSection));
+
+  GeneratorStateHeader header{GeneratorStateHeader::Magic, GeneratorStateHeader::CurrentVersion, GeneratorStateHeader::PageSize,
+                              offset_, sections_.size()};
+  file_.write(reinterpret_cast<const char*>(sections_.data()), static_cast<std::streamsize>(sections_.size() * sizeof(GeneratorStateSection)));
+  file_.seekp(0);
+  file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file_.close();
+
+  if (!file_)
+    throw std::runtime_error("Could not write the generator state to " + path_.string());
+}
+
+GeneratorStateReader::GeneratorStateReader(const fs::path& path) {
+  size_t size{};
+#ifdef _WIN32
+  file_handle_ = ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file_handle_ == INVALID_HANDLE_VALUE) {
+    file_handle_ = nullptr;
+    throw std::runtime_error("Could not open the generator state " + path.string());
+  }
+  LARGE_INTEGER file_size;
+  if (::GetFileSizeEx(file_handle_, &file_size))
+    size = static_cast<size_t>(file_size.QuadPart);
+  mapping_handle_ = size > 0 ? ::CreateFileMappingW(file_handle_, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+  mapped_data_ = mapping_handle_ ? ::MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0) : nullptr;
+  if (!mapped_data_) {
+    Unmap();
+    throw std::runtime_error("Could not map the generator state " + path.string());
+  }
+#else
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd == -1)
+    throw std::runtime_error("Could not open the generator state " + path.string());
+  size = static_cast<size_t>(::lseek(fd, 0, SEEK_END));
+  mapped_data_ = size > 0 ? ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+  ::close(fd);  // The mapping keeps the file open
+  if (mapped_data_ == MAP_FAILED) {
+    mapped_data_ = nullptr;
+    throw std::runtime_error("Could not map the generator state " + path.string());
+  }
+#endif
+
+  data_ = std::span<const uint8_t>{static_cast<const uint8_t*>(mapped_data_), size};
+  try {
+    ReadTable();
+  } catch (...) {
+    Unmap();
+    throw;
+  }
+}
+
+GeneratorStateReader::GeneratorStateReader(std::span<const uint8_t> data) : data_{data} {
+  ReadTable();
+}
+
+GeneratorStateReader::~GeneratorStateReader() {
+  Unmap();
+}
+
+void GeneratorStateReader::Unmap() {
+#ifdef _WIN32
+  if (mapped_data_)
+    ::UnmapViewOfFile(mapped_data_);
+  if (mapping_handle_)
+    ::CloseHandle(mapping_handle_);
+  if (file_handle_)
+    ::CloseHandle(file_handle_);
+  mapping_handle_ = file_handle_ = nullptr;
+#else
+  if (mapped_data_)
+    ::munmap(mapped_data_, data_.size());
+#endif
+  mapped_data_ = nullptr;
+}
+
+void GeneratorStateReader::ReadTable() {
+  GeneratorStateHeader header;
+  if (data_.size() < sizeof(header))
+    throw std::runtime_error("Generator state is truncated");
+  std::memcpy(&header, data_.data(), sizeof(header));
+
+  if (header.magic != GeneratorStateHeader::Magic)
+    throw std::runtime_error("Not a generator state");
+  if (header.version != GeneratorStateHeader::CurrentVersion)
+    throw std::runtime_error("Unsupported generator state version " + std::to_string(header.version) +
+                             ", expected " + std::to_string(GeneratorStateHeader::CurrentVersion));
+  if (header.table_offset > data_.size() ||
+      header.num_sections > (data_.size() - header.table_offset) / sizeof(GeneratorStateSection))
+    throw std::runtime_error("Generator state is truncated");
+
+  sections_.resize(header.num_sections);
+  std::memcpy(sections_.data(), data_.data() + header.table_offset, sections_.size() * sizeof(GeneratorStateSection));
+  for (auto& section : sections_) {
+    section.name.back() = '\0';
+    if (section.offset > data_.size() || section.size > data_.size() - section.offset)
+      throw std::runtime_error("Generator state section " + std::string(section.name.data()) + " is truncated");
+  }
+}
+
+bool GeneratorStateReader::Has(std::string_view name) const {
+  return std::any_of(sections_.begin(), sections_.end(),
+                     [name](const GeneratorStateSection& section) { return name == section.name.data(); });
+}
+
+std::span<const uint8_t> GeneratorStateReader::Get(std::string_view name) const {
+  auto it = std::find_if(sections_.begin(), sections_.end(),
+                         [name](const GeneratorStateSection& section) { return name == section.name.data(); });
+  if (it == sections_.end())
+    throw std::runtime_error("Generator state has no section " + std::string(name));
+  return data_.subspan(it->offset, it->size);
+}
+
+}  // namespace Generators
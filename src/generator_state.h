@@ -0,0 +1,110 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "filesystem.h"
+#include "span.h"
+
+namespace Generators {
+
+/*
+ * A generator state file holds a snapshot of a Generator that can be restored into a new Generator of the same
+ * model and parameters, see Generator::SaveState and Generator::LoadState. The file is made of:
+ *
+ *   GeneratorStateHeader                 at offset 0
+ *   The data of every section            each starting at a multiple of GeneratorStateHeader::alignment
+ *   GeneratorStateSection[num_sections]  at table_offset
+ *
+ * Sections start on page boundaries so that a memory mapped file is read in place, straight into the tensors
+ * being restored. Values are stored in the byte order of the machine that wrote the file.
+ */
+struct GeneratorStateHeader {
+  static constexpr std::array<char, 8> Magic{'O', 'G', 'A', 'S', 'T', 'A', 'T', 'E'};
+  static constexpr uint32_t CurrentVersion = 1;
+  static constexpr uint32_t PageSize = 4096;
+
+  std::array<char, 8> magic;
+  uint32_t version;
+  uint32_t alignment;
+  uint64_t table_offset;
+  uint64_t num_sections;
+};
+
+struct GeneratorStateSection {
+  std::array<char, 48> name;  // Null terminated
+  uint64_t offset;
+  uint64_t size;
+};
+
+// Writes the sections of a generator state to a file as they are added, so the whole state is never held in memory.
+struct GeneratorStateWriter {
+  GeneratorStateWriter(const fs::path& path);
+
+  void Write(std::string_view name, std::span<const uint8_t> data);
+
+  template <typename T>
+  void Write(std::string_view name, std::span<const T> data) {
+    Write(name, std::span<const uint8_t>{reinterpret_cast<const uint8_t*>(data.data()), data.size_bytes()});
+  }
+
+  // Writes the table of sections and the header. The file is not a valid state until this is called.
+  void Finish();
+
+ private:
+  void Pad(uint64_t offset);
+
+  fs::path path_;
+  std::ofstream file_;
+  uint64_t offset_{};
+  std::vector<GeneratorStateSection> sections_;
+};
+
+// Reads the sections of a generator state, either from a memory mapped file or from a caller owned buffer.
+struct GeneratorStateReader {
+  GeneratorStateReader(const fs::path& path);
+  GeneratorStateReader(std::span<const uint8_t> data);  // data must outlive the reader
+  ~GeneratorStateReader();
+
+  bool Has(std::string_view name) const;
+
+  // Returns the data of the named section. Throws if the state has no such section.
+  std::span<const uint8_t> Get(std::string_view name) const;
+
+  // Copies the named section into destination, which must be exactly the size of the section.
+  template <typename T>
+  void CopyTo(std::string_view name, std::span<T> destination) const {
+    auto data = Get(name);
+    if (data.size() != destination.size_bytes())
+      throw std::runtime_error("Generator state section " + std::string(name) + " has " + std::to_string(data.size()) +
+                               " bytes, expected " + std::to_string(destination.size_bytes()));
+    std::copy(data.begin(), data.end(), reinterpret_cast<uint8_t*>(destination.data()));
+  }
+
+ private:
+  GeneratorStateReader(const GeneratorStateReader&) = delete;
+  GeneratorStateReader& operator=(const GeneratorStateReader&) = delete;
+
+  void ReadTable();
+  void Unmap();
+
+  std::span<const uint8_t> data_;
+  std::vector<GeneratorStateSection> sections_;
+
+  // Set when the state is a memory mapped file
+#ifdef _WIN32
+  void* file_handle_{};
+  void* mapping_handle_{};
+#endif
+  void* mapped_data_{};
+};
+
+}  // namespace Generators
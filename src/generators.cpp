@@ -60,7 +60,8 @@ static OrtLoggingLevel GetDefaultOrtLoggingLevel() {
 }
 
 OrtGlobals::OrtGlobals()
-    : env_{OrtEnv::Create(GetDefaultOrtLoggingLevel())} {
+    : env_{OrtEnv::Create(GetDefaultOrtLoggingLevel())},
+      thread_pool_{std::max(std::thread::hardware_concurrency(), 1u) - 1} {  // The calling thread is part of the pool
   const char* keys[] = {"max_mem", "arena_extend_strategy", "initial_chunk_size_bytes", "max_dead_bytes_per_chunk"};
   const size_t values[] = {static_cast<size_t>(0), static_cast<size_t>(-1), static_cast<size_t>(-1), static_cast<size_t>(-1)};
   auto arena_config = OrtArenaCfg::Create(keys, values, 4);
@@ -108,6 +109,10 @@ OrtEnv& GetOrtEnv() {
   return *GetOrtGlobals()->env_;
 }
 
+ThreadPool& GetThreadPool() {
+  return GetOrtGlobals()->thread_pool_;
+}
+
 // Fallback to copy between two separate device buffers by going through CPU memory (slow unless we're the CPU device)
 void CopyThroughCpu(DeviceBuffer& dest, size_t begin_dest, DeviceBuffer& source, size_t begin_source, size_t size_in_bytes) {
   source.CopyDeviceToCpu();
@@ -429,10 +434,37 @@ void Generator::AppendTokens(cpu_span<const int32_t> input_ids) {
     set_extra_inputs_ = false;
   }
 
-  auto input_ids_device = AllocateInputIdsOnDevice(input_ids);
+  // Continue from the longest cached prefix of the prompt, leaving at least one token to run for the logits
+  auto* prompt_cache = GetPromptCache();
+  size_t cached_length = 0;
+  if (prompt_cache && search_->GetSequenceLength() == 0) {
+    auto [entry, length] = prompt_cache->Lookup(input_ids, input_ids.size() - 1);
+    if (entry) {
+      auto prefix_device = AllocateInputIdsOnDevice(cpu_span<const int32_t>{input_ids.subspan(0, length)});
+      search_->AppendTokens(prefix_device);
+      state_->RestoreSnapshot(*entry, prefix_device, static_cast<int>(length));
+      cached_length = length;
+    }
+  }
+
+  auto input_ids_device = AllocateInputIdsOnDevice(cpu_span<const int32_t>{input_ids.subspan(cached_length, input_ids.size() - cached_length)});
   search_->AppendTokens(input_ids_device);
   computed_logits_ = false;
   ComputeLogits(input_ids_device);
+
+  if (prompt_cache) {
+    const int length = search_->GetSequenceLength();
+    if (static_cast<size_t>(length) >= model_->config_->prompt_cache.min_length)
+      prompt_cache->Insert(GetSequence(0).CopyDeviceToCpu(), state_->TakeSnapshot(length));
+  }
+}
+
+PromptCache* Generator::GetPromptCache() const {
+  const auto& search = state_->params_->search;
+  if (!model_->prompt_cache_ || search.batch_size != 1 || search.num_beams != 1 || guidance_logits_processor_ ||
+      !extra_inputs_.empty() || !state_->adapter_names_.empty() || !state_->SupportsSnapshots())
+    return nullptr;
+  return model_->prompt_cache_.get();
 }
 
 void Generator::SetInputs(const NamedTensors& named_tensors) {
@@ -664,4 +696,137 @@ DeviceSpan<int32_t> Generator::GetSequence(size_t index) const {
   return search_->GetSequence(index);
 }
 
+namespace {
+
+// The "generator" section of a generator state, checked against the generator it is loaded into
+struct GeneratorStateInfo {
+  int32_t batch_size;
+  int32_t num_beams;
+  int32_t vocab_size;
+  int32_t sequence_length;
+};
+
+}  // namespace
+
+void Generator::PrepareStateCopy(const char* operation) {
+  ThrowErrorIfSessionTerminated(state_->session_terminated_);
+
+  const auto& search = state_->params_->search;
+  if (search.batch_size != 1 || search.num_beams != 1)
+    throw std::runtime_error(std::string(operation) + " is only supported for a batch size of 1 without beam search");
+  if (guidance_logits_processor_)
+    throw std::runtime_error(std::string(operation) + " is not supported with guidance");
+  if (search_->GetSequenceLength() == 0)
+    throw std::runtime_error(std::string(operation) + " called with no prior state. Please call AppendTokens first.");
+  if (!computed_logits_ && last_action_ == Action::rewound)
+    throw std::runtime_error(std::string(operation) + " cannot be called right after RewindToLength. Please call AppendTokens or GenerateNextToken first.");
+
+  // The key-value cache is copied for the whole sequence, so the last generated token is run first
+  if (!computed_logits_)
+    ComputeLogits(search_->GetNextTokens());
+}
+
+void Generator::SaveState(const fs::path& path) {
+  PrepareStateCopy("SaveState");
+
+  const auto& search = state_->params_->search;
+  const int length = search_->GetSequenceLength();
+  const GeneratorStateInfo info{search.batch_size, search.num_beams, model_->config_->model.vocab_size, length};
+  const auto& model_type = model_->config_->model.type;
+  const auto random_state = search_->GetRandomState();
+
+  GeneratorStateWriter writer{path};
+  writer.Write("generator", std::span<const GeneratorStateInfo>{&info, 1});
+  writer.Write("model_type", std::span<const char>{model_type.data(), model_type.size()});
+  writer.Write("sequence", std::span<const int32_t>{GetSequence(0).CopyDeviceToCpu()});
+  writer.Write("logits", std::span<const float>{search_->GetLogits().CopyDeviceToCpu()});
+  writer.Write("random", std::span<const char>{random_state.data(), random_state.size()});
+  state_->SaveState(writer, length);
+  writer.Finish();
+}
+
+std::unique_ptr<Generator> Generator::Fork() {
+  PrepareStateCopy("Fork");
+
+  auto fork = std::make_unique<Generator>(*model_, *state_->params_);
+  if (!set_extra_inputs_) {
+    fork->extra_inputs_ = extra_inputs_;
+    fork->state_->SetExtraInputs(fork->extra_inputs_);
+    fork->set_extra_inputs_ = false;
+  }
+
+  fork->fork_path_ = fork_path_;
+  fork->fork_path_.push_back(++fork_count_);
+  fork->search_->ReseedForFork(fork->fork_path_);
+
+  // The sequence is small and copied, the key-value cache is shared
+  const int length = search_->GetSequenceLength();
+  auto tokens = state_->params_->p_device->Allocate<int32_t>(length);
+  copy(std::span<const int32_t>{GetSequence(0).CopyDeviceToCpu()}, tokens.CpuSpan());
+  tokens.CopyCpuToDevice();
+  fork->search_->AppendTokens(tokens);
+  fork->state_->ForkFrom(*state_, tokens, length);
+
+  // The search modifies the logits in place, so each generator has its own
+  auto logits = search_->GetLogits();
+  auto fork_logits = model_->p_device_inputs_->Allocate<float>(logits.size());
+  fork_logits.CopyFrom(logits);
+  fork->SetLogits(fork_logits);
+  return fork;
+}
+
+MemoryUsage Generator::GetMemoryUsage() const {
+  auto usage = state_->GetMemoryUsage();
+  usage.scratch += search_->ScratchSizeInBytes();
+  return usage;
+}
+
+void Generator::LoadState(const fs::path& path) {
+  LoadState(GeneratorStateReader{path});
+}
+
+void Generator::LoadState(std::span<const uint8_t> data) {
+  LoadState(GeneratorStateReader{data});
+}
+
+void Generator::LoadState(const GeneratorStateReader& reader) {
+  ThrowErrorIfSessionTerminated(state_->session_terminated_);
+
+  if (search_->GetSequenceLength() != 0)
+    throw std::runtime_error("LoadState must be called on a generator with no tokens. Please call RewindToLength(0) first.");
+  if (guidance_logits_processor_)
+    throw std::runtime_error("LoadState is not supported with guidance");
+
+  GeneratorStateInfo info;
+  reader.CopyTo("generator", std::span<GeneratorStateInfo>{&info, 1});
+  const auto model_type = reader.Get("model_type");
+  const auto& search = state_->params_->search;
+  if (!std::equal(model_type.begin(), model_type.end(), model_->config_->model.type.begin(), model_->config_->model.type.end()))
+    throw std::runtime_error("The generator state was saved for another model type");
+  if (info.batch_size != search.batch_size || info.num_beams != search.num_beams || info.vocab_size != model_->config_->model.vocab_size)
+    throw std::runtime_error("The generator state was saved with a different batch size, number of beams or vocabulary size");
+  if (info.sequence_length <= 0 || info.sequence_length > search.max_length)
+    throw std::runtime_error("The generator state sequence length (" + std::to_string(info.sequence_length) + ") exceeds max length (" + std::to_string(search.max_length) + ")");
+
+  if (set_extra_inputs_) {
+    state_->SetExtraInputs(extra_inputs_);
+    set_extra_inputs_ = false;
+  }
+
+  auto tokens = state_->params_->p_device->Allocate<int32_t>(info.sequence_length);
+  reader.CopyTo("sequence", tokens.CpuSpan());
+  tokens.CopyCpuToDevice();
+  search_->AppendTokens(tokens);
+  state_->LoadState(reader, tokens, info.sequence_length);
+
+  const auto random_state = reader.Get("random");
+  search_->SetRandomState(std::string_view{reinterpret_cast<const char*>(random_state.data()), random_state.size()});
+
+  auto logits = model_->p_device_inputs_->Allocate<float>(static_cast<size_t>(info.batch_size) * info.num_beams * info.vocab_size);
+  reader.CopyTo("logits", logits.CpuSpan());
+  logits.CopyCpuToDevice();
+  SetLogits(logits);
+  last_action_ = Action::standard;
+}
+
 }  // namespace Generators
@@ -34,6 +34,9 @@
 #include "logging.h"
 #include "runtime_settings.h"
 #include "tensor.h"
+#include "models/threadpool.h"
+#include "generator_state.h"
+#include "memory_usage.h"
 
 void ThrowErrorIfSessionTerminated(bool is_session_terminated);
 
@@ -43,6 +46,7 @@ struct State;
 struct Search;
 struct Tokenizer;
 struct ConstrainedLogitsProcessor;
+struct PromptCache;
 struct ExtraInput {  // Extra inputs provided via SetInputs()
   std::string name;
   std::shared_ptr<Tensor> tensor;
@@ -111,6 +115,20 @@ struct Generator : LeakChecked<Generator> {
 
   DeviceSpan<int32_t> GetSequence(size_t index) const;
 
+  // Saves the sequence, logits, key-value cache and random state, so generation can continue later in another generator
+  void SaveState(const fs::path& path);
+  // Restores a saved state into a generator of the same model and search options that has no tokens yet.
+  // The file is memory mapped and the buffer must stay valid during the call.
+  void LoadState(const fs::path& path);
+  void LoadState(std::span<const uint8_t> data);
+
+  // Returns a generator that continues from the same sequence, sharing the key-value cache of the sequence until
+  // either generator writes over it. The fork samples with its own random stream.
+  std::unique_ptr<Generator> Fork();
+
+  // Returns the memory held by the generator, which does not include the model weights
+  MemoryUsage GetMemoryUsage() const;
+
   // A list of extra model inputs that will be matched at runtime based on name
   std::vector<ExtraInput> extra_inputs_;
   void SetInputs(const NamedTensors& inputs);
@@ -126,10 +144,16 @@ struct Generator : LeakChecked<Generator> {
  private:
   DeviceSpan<int32_t> AllocateInputIdsOnDevice(cpu_span<const int32_t> input_ids);
   void ComputeLogits(DeviceSpan<int32_t> next_tokens);
+  void LoadState(const GeneratorStateReader& reader);
+  void PrepareStateCopy(const char* operation);  // Checks that the state can be copied and runs the last token if needed
+  PromptCache* GetPromptCache() const;           // Returns the prompt cache of the model if this generator can use it
   enum Action { standard,   // Default, set in any other case
                 generated,  // Set after GenerateNextToken
                 rewound };  // Set after RewindToLength
   Action last_action_{standard};
+
+  std::vector<uint32_t> fork_path_;  // Fork index of this generator and of each of its parents, see Search::ReseedForFork
+  uint32_t fork_count_{};            // Number of generators forked from this one
 };
 
 struct OrtGlobals {
@@ -151,6 +175,9 @@ struct OrtGlobals {
   };
   SessionCache graph_session_cache_;
 
+  // Worker threads shared by the CPU work of all generators (sampling, logits processing, multimodal preprocessing)
+  ThreadPool thread_pool_;
+
  private:
   OrtGlobals(const OrtGlobals&) = delete;
   void operator=(const OrtGlobals&) = delete;
@@ -159,6 +186,7 @@ struct OrtGlobals {
 std::unique_ptr<OrtGlobals>& GetOrtGlobals();
 void Shutdown();  // Do this once at exit, Ort code will fail after this call
 OrtEnv& GetOrtEnv();
+ThreadPool& GetThreadPool();
 
 std::shared_ptr<Model> CreateModel(OrtEnv& ort_env, const char* config_path, const RuntimeSettings* settings = nullptr);
 std::shared_ptr<Model> CreateModel(OrtEnv& ort_env, std::unique_ptr<Config> config);
@@ -8,6 +8,8 @@
 // On process exit, ValidateShutdown() will call LeakTypeList::Dump() and print out any types that have leaked.
 
 namespace Generators {
+struct BatchTokenizerStream;
+struct ChatEncoder;
 struct Engine;
 struct GeneratorParams;
 struct Generator;
@@ -26,7 +28,7 @@ struct LeakTypeList {
   static bool Dump();
 };
 
-using LeakTypes = LeakTypeList<Engine, GeneratorParams, Generator, Model, Request, Search, StreamingProcessor, Tensor, Tokenizer, TokenizerStream>;
+using LeakTypes = LeakTypeList<BatchTokenizerStream, ChatEncoder, Engine, GeneratorParams, Generator, Model, Request, Search, StreamingProcessor, Tensor, Tokenizer, TokenizerStream>;
 
 template <typename T>
 struct LeakChecked {
@@ -0,0 +1,45 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+#pragma once
+
+#include <stddef.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace Generators {
+
+/*
+ * MemoryUsage holds the bytes of memory held by a model, a generator or a request, by what the memory is used for.
+ * The sizes are of the buffers allocated by onnxruntime-genai and of the model files, they do not include the
+ * memory onnxruntime uses internally while running a session.
+ */
+struct MemoryUsage {
+  size_t weights{};      // Model weights, the size of the model files
+  size_t kv_cache{};     // Key-value cache, including the memory reserved for it to grow
+  size_t activations{};  // Other model inputs and outputs, such as the input ids, attention mask and logits
+  size_t scratch{};      // Search and sampling buffers, such as the sequences
+
+  size_t Total() const { return weights + kv_cache + activations + scratch; }
+
+  MemoryUsage& operator+=(const MemoryUsage& other) {
+    weights += other.weights;
+    kv_cache += other.kv_cache;
+    activations += other.activations;
+    scratch += other.scratch;
+    return *this;
+  }
+
+  // Returns the bytes of a category: "weights", "kv_cache", "activations", "scratch" or "total"
+  size_t Get(std::string_view category) const {
+    if (category == "weights") return weights;
+    if (category == "kv_cache") return kv_cache;
+    if (category == "activations") return activations;
+    if (category == "scratch") return scratch;
+    if (category == "total") return Total();
+    throw std::runtime_error("Unknown memory usage category: " + std::string(category) +
+                             ". Expected weights, kv_cache, activations, scratch or total.");
+  }
+};
+
+}  // namespace Generators
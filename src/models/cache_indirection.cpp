@@ -0,0 +1,62 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include <numeric>
+#include "../generators.h"
+#include "model.h"
+#include "cache_indirection.h"
+
+namespace Generators {
+
+CacheIndirection::CacheIndirection(State& state)
+    : state_{state},
+      shape_{state_.params_->search.batch_size, state_.params_->search.num_beams, state_.params_->search.max_length} {
+  const auto type = model_.session_info_.GetInputDataType(model_.config_->model.decoder.inputs.cache_indirection);
+  if (type != Ort::TypeToTensorType<int32_t>)
+    throw std::runtime_error("cache_indirection only supports the int32 type");
+
+  // Zero means every token so far comes from beam 0, which holds the prompt shared by all beams
+  cache_indirection_ = OrtValue::CreateTensor(model_.p_device_inputs_->GetAllocator(), shape_, type);
+  cache_indirection_next_ = OrtValue::CreateTensor(model_.p_device_inputs_->GetAllocator(), shape_, type);
+  ByteWrapTensor(*model_.p_device_inputs_, *cache_indirection_).Zero();
+  ByteWrapTensor(*model_.p_device_inputs_, *cache_indirection_next_).Zero();
+}
+
+bool CacheIndirection::IsNeeded(const Model& model) {
+  return model.session_info_.HasInput(model.config_->model.decoder.inputs.cache_indirection);
+}
+
+void CacheIndirection::Add() {
+  input_index_ = state_.inputs_.size();
+  state_.inputs_.push_back(cache_indirection_.get());
+  state_.input_names_.push_back(model_.config_->model.decoder.inputs.cache_indirection.c_str());
+}
+
+void CacheIndirection::Update(DeviceSpan<int32_t> beam_indices, int new_length, int total_length) {
+  if (state_.params_->search.num_beams == 1)
+    return;
+
+  if (beam_indices.empty()) {
+    if (identity_beam_indices_.empty()) {
+      identity_beam_indices_ = model_.p_device_inputs_->Allocate<int32_t>(state_.params_->BatchBeamSize());
+      auto beam_indices_cpu = identity_beam_indices_.CpuSpan();
+      std::iota(beam_indices_cpu.begin(), beam_indices_cpu.end(), 0);
+      identity_beam_indices_.CopyCpuToDevice();
+    }
+    beam_indices = identity_beam_indices_;
+  }
+
+  model_.p_device_inputs_->UpdateCacheIndirection(cache_indirection_next_->GetTensorMutableData<int32_t>(),
+                                                  cache_indirection_->GetTensorData<int32_t>(),
+                                                  beam_indices.Span().data(),
+                                                  static_cast<int>(shape_[0]),  // batch size
+                                                  static_cast<int>(shape_[1]),  // num beams
+                                                  new_length,
+                                                  static_cast<int>(shape_[2]),  // max sequence length
+                                                  total_length);
+
+  std::swap(cache_indirection_, cache_indirection_next_);
+  state_.inputs_[input_index_] = cache_indirection_.get();
+}
+
+}  // namespace Generators
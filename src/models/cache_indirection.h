@@ -0,0 +1,37 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "model.h"
+
+namespace Generators {
+
+// Manages the cache_indirection input of models whose attention reads the key-value cache through a beam table.
+// Entry [batch, beam, t] is the beam whose cache holds the key and value of token t for that beam. Beam search
+// reorders this table instead of copying the past key-value cache of every layer between beams.
+struct CacheIndirection {
+  CacheIndirection(State& state);
+
+  static bool IsNeeded(const Model& model);
+
+  void Add();
+
+  // Reorders the table by the beams picked in the last step. new_length is the number of tokens of the step and
+  // total_length is the sequence length after it. Empty beam_indices keep every beam in place.
+  void Update(DeviceSpan<int32_t> beam_indices, int new_length, int total_length);
+
+  const int32_t* GetData() const { return cache_indirection_->GetTensorData<int32_t>(); }
+
+ private:
+  State& state_;
+  const Model& model_{state_.model_};
+  size_t input_index_{~0U};
+
+  std::array<int64_t, 3> shape_;  // {batch_size, num_beams, max_length}
+  std::unique_ptr<OrtValue> cache_indirection_;
+  std::unique_ptr<OrtValue> cache_indirection_next_;  // Written by Update, then swapped with cache_indirection_
+  DeviceSpan<int32_t> identity_beam_indices_;         // Every beam picking itself, allocated on the first Update without beam indices
+};
+
+}  // namespace Generators
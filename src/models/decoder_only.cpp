@@ -23,6 +23,10 @@ DecoderOnly_State::DecoderOnly_State(const DecoderOnly_Model& model, DeviceSpan<
   logits_.Add();
   if (kv_cache_)
     kv_cache_->Add();
+  if (CacheIndirection::IsNeeded(model_)) {
+    cache_indirection_ = std::make_unique<CacheIndirection>(*this);
+    cache_indirection_->Add();
+  }
   if (recurrent_state_)
     recurrent_state_->Add();
 }
@@ -90,6 +94,70 @@ void DecoderOnly_State::RewindTo(size_t index) {
     recurrent_state_->RewindTo(index);
 }
 
+bool DecoderOnly_State::IsStateSupported() const {
+  const auto& sliding_window = model_.config_->model.decoder.sliding_window;
+  return kv_cache_ && !recurrent_state_ && !cache_indirection_ && !(sliding_window.has_value() && sliding_window->window_size > 0);
+}
+
+void DecoderOnly_State::CheckStateSupported() const {
+  if (!IsStateSupported())
+    throw std::runtime_error("Saving and loading the generator state requires a key-value cache without recurrent state, cache indirection or sliding window");
+}
+
+// Updates the inputs other than the key-value cache as if the whole sequence had just been run as a prompt
+void DecoderOnly_State::UpdateInputsForSequence(DeviceSpan<int32_t>& tokens, int total_length) {
+  input_ids_.Update(tokens);
+  position_inputs_->Update(tokens, total_length, total_length);
+  logits_.Update(tokens, total_length);
+}
+
+void DecoderOnly_State::SaveState(GeneratorStateWriter& writer, int total_length) {
+  CheckStateSupported();
+  kv_cache_->SaveState(writer, total_length);
+}
+
+// The inputs are updated as if the whole sequence had just been run as a prompt, but the session is not run.
+// Instead the presents are filled from the saved state, so the next Run continues after the sequence.
+void DecoderOnly_State::LoadState(const GeneratorStateReader& reader, DeviceSpan<int32_t>& tokens, int total_length) {
+  CheckStateSupported();
+  UpdateInputsOutputs(tokens, {}, total_length);
+  kv_cache_->LoadState(reader, total_length);
+}
+
+// Same as LoadState, except that the presents are shared with the source instead of being created by Update
+void DecoderOnly_State::ForkFrom(const State& source, DeviceSpan<int32_t>& tokens, int total_length) {
+  CheckStateSupported();
+  const auto* source_state = dynamic_cast<const DecoderOnly_State*>(&source);
+  if (!source_state)
+    throw std::runtime_error("Cannot fork a generator from a state of another model type");
+
+  UpdateInputsForSequence(tokens, total_length);
+  kv_cache_->ShareFrom(*source_state->kv_cache_, total_length);
+}
+
+bool DecoderOnly_State::SupportsSnapshots() const {
+  return IsStateSupported() && kv_cache_->SupportsSnapshots();
+}
+
+std::shared_ptr<PromptCacheEntry> DecoderOnly_State::TakeSnapshot(int total_length) const {
+  if (!SupportsSnapshots())
+    return nullptr;
+  return kv_cache_->TakeSnapshot(total_length);
+}
+
+void DecoderOnly_State::RestoreSnapshot(const PromptCacheEntry& snapshot, DeviceSpan<int32_t>& tokens, int total_length) {
+  CheckStateSupported();
+  UpdateInputsForSequence(tokens, total_length);
+  kv_cache_->RestoreSnapshot(snapshot, total_length);
+}
+
+MemoryUsage DecoderOnly_State::GetMemoryUsage() const {
+  auto usage = State::GetMemoryUsage();
+  if (kv_cache_ && kv_cache_->SizeInBytes() > 0)
+    usage.kv_cache = kv_cache_->SizeInBytes();
+  return usage;
+}
+
 void DecoderOnly_State::UpdateInputsOutputs(DeviceSpan<int32_t>& next_tokens, DeviceSpan<int32_t> beam_indices, int total_length) {
   input_ids_.Update(next_tokens);
   size_t new_length = static_cast<size_t>(input_ids_.GetShape()[1]);
@@ -116,6 +184,8 @@ void DecoderOnly_State::UpdateInputsOutputs(DeviceSpan<int32_t>& next_tokens, De
   position_inputs_->Update(next_tokens, position_length, static_cast<int>(new_length));
   if (kv_cache_)
     kv_cache_->Update(beam_indices, kv_cache_length);
+  if (cache_indirection_)
+    cache_indirection_->Update(beam_indices, static_cast<int>(new_length), total_length);
   if (recurrent_state_)
     recurrent_state_->Update();
   logits_.Update(next_tokens, new_length);
@@ -3,6 +3,7 @@
 #include "input_ids.h"
 #include "logits.h"
 #include "kv_cache.h"
+#include "cache_indirection.h"
 #include "position_inputs.h"
 #include "extra_inputs.h"
 #include "recurrent_state.h"
@@ -26,7 +27,19 @@ struct DecoderOnly_State : State {
 
   void RewindTo(size_t index) override;
 
+  void SaveState(GeneratorStateWriter& writer, int total_length) override;
+  void LoadState(const GeneratorStateReader& reader, DeviceSpan<int32_t>& tokens, int total_length) override;
+  void ForkFrom(const State& source, DeviceSpan<int32_t>& tokens, int total_length) override;
+  bool SupportsSnapshots() const override;
+  std::shared_ptr<PromptCacheEntry> TakeSnapshot(int total_length) const override;
+  void RestoreSnapshot(const PromptCacheEntry& snapshot, DeviceSpan<int32_t>& tokens, int total_length) override;
+  MemoryUsage GetMemoryUsage() const override;
+
  private:
+  bool IsStateSupported() const;
+  void CheckStateSupported() const;
+  void UpdateInputsForSequence(DeviceSpan<int32_t>& tokens, int total_length);
+
   DeviceSpan<float> RunWithChunking(int total_length, DeviceSpan<int32_t>& next_tokens,
                                     DeviceSpan<int32_t> next_indices, size_t chunk_size);
 
@@ -37,6 +50,7 @@ struct DecoderOnly_State : State {
   DefaultInputIDs input_ids_{*this};
   Logits logits_{*this};
   std::unique_ptr<KeyValueCache> kv_cache_;
+  std::unique_ptr<CacheIndirection> cache_indirection_;
   std::unique_ptr<RecurrentState> recurrent_state_;
   std::unique_ptr<PositionInputs> position_inputs_;
   ExtraInputs extra_inputs_{*this};
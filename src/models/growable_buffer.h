@@ -0,0 +1,73 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+namespace Generators {
+
+/*
+ * GrowableBuffer is a device buffer that backs a tensor whose size grows a little on every step, such as a
+ * key-value cache growing along its sequence axis. When the buffer is too small it is replaced by one at least
+ * twice its size, so a tensor that grows by one token per step is reallocated O(log n) times over n steps
+ * instead of on every step. Tensors are created over the buffer with the size they need.
+ *
+ * AllocatorType only needs Alloc(size_t) and Free(void*), such as Ort::Allocator.
+ */
+template <typename AllocatorType>
+struct GrowableBuffer {
+  explicit GrowableBuffer(AllocatorType& allocator) : allocator_{&allocator} {}
+  ~GrowableBuffer() { Release(); }
+
+  GrowableBuffer(GrowableBuffer&& other) noexcept
+      : allocator_{other.allocator_}, data_{other.data_}, capacity_{other.capacity_} {
+    other.data_ = nullptr;
+    other.capacity_ = 0;
+  }
+
+  GrowableBuffer& operator=(GrowableBuffer&& other) noexcept {
+    if (this != &other) {
+      Release();
+      allocator_ = other.allocator_;
+      data_ = other.data_;
+      capacity_ = other.capacity_;
+      other.data_ = nullptr;
+      other.capacity_ = 0;
+    }
+    return *this;
+  }
+
+  // Returns a buffer of at least size_in_bytes. The contents are not preserved when the buffer grows.
+  void* Reserve(size_t size_in_bytes) {
+    if (size_in_bytes > capacity_) {
+      const size_t new_capacity = std::max(size_in_bytes, 2 * capacity_);
+      Release();
+      data_ = allocator_->Alloc(new_capacity);
+      capacity_ = new_capacity;
+    }
+    return data_;
+  }
+
+  void* Data() const { return data_; }
+  size_t Capacity() const { return capacity_; }
+
+ private:
+  GrowableBuffer(const GrowableBuffer&) = delete;
+  GrowableBuffer& operator=(const GrowableBuffer&) = delete;
+
+  void Release() {
+    if (data_ != nullptr) {
+      allocator_->Free(data_);
+      data_ = nullptr;
+      capacity_ = 0;
+    }
+  }
+
+  AllocatorType* allocator_;
+  void* data_{};
+  size_t capacity_{};
+};
+
+}  // namespace Generators
@@ -32,6 +32,12 @@ CombinedKeyValueCache::CombinedKeyValueCache(State& state)
   for (int i = 0; i < layer_count_; ++i) {
     presents_.push_back(OrtValue::CreateTensor(Allocator(), shape_, type_));
   }
+
+  buffers_.reserve(layer_count_ * 2);
+  for (int i = 0; i < layer_count_ * 2; ++i) {
+    buffers_.emplace_back(Allocator());
+  }
+  present_buffers_.resize(layer_count_);
 }
 
 void CombinedKeyValueCache::Add() {
@@ -51,8 +57,9 @@ void CombinedKeyValueCache::Update(DeviceSpan<int32_t> beam_indices, int total_l
 
   if (!is_first_update_) {
     for (int i = 0; i < layer_count_; i++) {
-      if (beam_indices.empty()) {
+      if (beam_indices.empty() || uses_cache_indirection_) {
         pasts_[i] = std::move(presents_[i]);
+        present_buffers_[i] ^= 1;
       } else {
         PickPastState(beam_indices, i);
       }
@@ -62,7 +69,7 @@ void CombinedKeyValueCache::Update(DeviceSpan<int32_t> beam_indices, int total_l
 
   shape_[3] = total_length;
   for (int i = 0; i < layer_count_; i++) {
-    presents_[i] = OrtValue::CreateTensor(Allocator(), shape_, type_);
+    presents_[i] = CreateTensorInBuffer(i, present_buffers_[i], shape_);
     state_.outputs_[output_index_ + i] = presents_[i].get();
   }
 
@@ -97,9 +104,10 @@ void CombinedKeyValueCache::RewindPastTensorsTo(size_t index) {
   auto old_length_x_head_size = shape_[3] * new_shape[4];
   shape_[3] = new_shape[3];
 
+  // Compact each past into the buffer its present is not in
   for (int i = 0; i < layer_count_; i++) {
     OrtValue& present = *presents_[i];
-    std::unique_ptr<OrtValue> past = OrtValue::CreateTensor(Allocator(), shape_, type_);
+    std::unique_ptr<OrtValue> past = CreateTensorInBuffer(i, present_buffers_[i] ^ 1, shape_);
     auto present_span = WrapTensor<T>(Device(), present);
     auto past_span = WrapTensor<T>(Device(), *past);
 
@@ -121,7 +129,7 @@ void CombinedKeyValueCache::PickPastState(DeviceSpan<int32_t> beam_indices_devic
   auto past_key_size = shape_[1] * block_size_per_beam;
 
   OrtValue& present = *presents_[index];
-  std::unique_ptr<OrtValue> past = OrtValue::CreateTensor<ScoreType>(Allocator(), shape_);
+  std::unique_ptr<OrtValue> past = CreateTensorInBuffer(index, present_buffers_[index] ^ 1, shape_);
 
   auto past_span = WrapTensor<ScoreType>(Device(), *past);
   auto present_span = WrapTensor<ScoreType>(Device(), present);
@@ -148,6 +156,19 @@ void CombinedKeyValueCache::PickPastState(DeviceSpan<int32_t> beam_indices, int
   }
 }
 
+std::unique_ptr<OrtValue> CombinedKeyValueCache::CreateTensorInBuffer(int i, int buffer, std::span<const int64_t> shape) {
+  const size_t size_in_bytes = static_cast<size_t>(ElementCountFromShape(shape)) * Ort::SizeOf(type_);
+  void* data = buffers_[i * 2 + buffer].Reserve(size_in_bytes);
+  return OrtValue::CreateTensor(Allocator().GetInfo(), data, size_in_bytes, shape, type_);
+}
+
+size_t CombinedKeyValueCache::SizeInBytes() const {
+  size_t size{};
+  for (const auto& buffer : buffers_)
+    size += buffer.Capacity();
+  return size;
+}
+
 DefaultKeyValueCache::DefaultKeyValueCache(State& state)
     : state_{state},
       layer_count_{model_.config_->model.decoder.num_hidden_layers},
@@ -253,6 +274,14 @@ DefaultKeyValueCache::DefaultKeyValueCache(State& state)
     shape_[2] = state_.params_->search.max_length;
   }
 
+  if (!past_present_share_buffer_) {
+    buffers_.reserve(layer_count_ * 2 * 2);
+    for (int i = 0; i < layer_count_ * 2 * 2; ++i) {
+      buffers_.push_back(std::make_shared<GrowableBuffer<Ort::Allocator>>(Allocator()));
+    }
+    present_buffers_.resize(layer_count_ * 2);
+  }
+
   try {
     // Allocate KV cache tensors - 2 per layer (key and value)
     // For per-layer shapes: alternates between key and value for each layer
@@ -307,8 +336,11 @@ void DefaultKeyValueCache::Update(DeviceSpan<int32_t> beam_indices, int total_le
 
   if (!is_first_update_) {
     for (int i = 0; i < layer_count_ * 2; i++) {
-      if (beam_indices.empty()) {
+      if (beam_indices.empty() || uses_cache_indirection_) {
+        // The present becomes the past in place, and the next present goes to the other buffer. With a cache
+        // indirection the beams stay where they are and the model follows the table instead.
         pasts_[i] = std::move(presents_[i]);
+        present_buffers_[i] ^= 1;
       } else {
         PickPastState(beam_indices, i);
       }
@@ -324,18 +356,18 @@ void DefaultKeyValueCache::Update(DeviceSpan<int32_t> beam_indices, int total_le
       current_shape[2] = std::min(total_length, max_cache_length);
 
       // Key tensor
-      presents_[layer_idx * 2] = OrtValue::CreateTensor(Allocator(), current_shape, type_);
+      presents_[layer_idx * 2] = CreateTensorInBuffer(layer_idx * 2, present_buffers_[layer_idx * 2], current_shape);
       state_.outputs_[output_index_ + layer_idx * 2] = presents_[layer_idx * 2].get();
 
       // Value tensor
-      presents_[layer_idx * 2 + 1] = OrtValue::CreateTensor(Allocator(), current_shape, type_);
+      presents_[layer_idx * 2 + 1] = CreateTensorInBuffer(layer_idx * 2 + 1, present_buffers_[layer_idx * 2 + 1], current_shape);
       state_.outputs_[output_index_ + layer_idx * 2 + 1] = presents_[layer_idx * 2 + 1].get();
     }
   } else {
     // Uniform allocation
     shape_[2] = total_length;
     for (int i = 0; i < layer_count_ * 2; i++) {
-      presents_[i] = OrtValue::CreateTensor(Allocator(), shape_, type_);
+      presents_[i] = CreateTensorInBuffer(i, present_buffers_[i], shape_);
       state_.outputs_[output_index_ + i] = presents_[i].get();
     }
   }
@@ -363,6 +395,8 @@ void DefaultKeyValueCache::RewindTo(size_t index) {
   }
 }
 
+// The past is compacted into the buffer the present is not in, so rewinding does not allocate.
+// The next present is then created over the buffer of the current present.
 template <typename T>
 void DefaultKeyValueCache::RewindPastTensorsTo(size_t index) {
   assert(index > 0 && !past_present_share_buffer_);
@@ -394,7 +428,7 @@ void DefaultKeyValueCache::RewindPastTensorsTo(size_t index) {
       const auto present_shape = present.GetTensorTypeAndShapeInfo()->GetShape();
       const auto old_length_x_head_size = present_shape[2] * new_shape[3];
 
-      std::unique_ptr<OrtValue> past = OrtValue::CreateTensor(Allocator(), new_shape, type_);
+      std::unique_ptr<OrtValue> past = CreateTensorInBuffer(i, present_buffers_[i] ^ 1, new_shape);
       auto past_span = WrapTensor<T>(Device(), *past);
       auto present_span = WrapTensor<T>(Device(), present);
 
@@ -418,7 +452,7 @@ void DefaultKeyValueCache::RewindPastTensorsTo(size_t index) {
 
     for (int i = 0; i < layer_count_ * 2; i++) {
       OrtValue& present = *presents_[i];
-      std::unique_ptr<OrtValue> past = OrtValue::CreateTensor(Allocator(), shape_, type_);
+      std::unique_ptr<OrtValue> past = CreateTensorInBuffer(i, present_buffers_[i] ^ 1, shape_);
 
       auto past_span = WrapTensor<T>(Device(), *past);
       auto present_span = WrapTensor<T>(Device(), present);
@@ -451,8 +485,9 @@ void DefaultKeyValueCache::PickPastState(DeviceSpan<int32_t> beam_indices_device
 
   auto block_size_per_beam = tensor_shape[1] * tensor_shape[2] * tensor_shape[3];
 
+  // The past goes to the buffer the present is not in, the next present then reuses the present's buffer
   OrtValue& present_value = *presents_[index];
-  std::unique_ptr<OrtValue> past_value = OrtValue::CreateTensor<ScoreType>(Allocator(), tensor_shape);
+  std::unique_ptr<OrtValue> past_value = CreateTensorInBuffer(index, present_buffers_[index] ^ 1, tensor_shape);
 
   auto past_span = WrapTensor<ScoreType>(Device(), *past_value);
   auto present_span = WrapTensor<ScoreType>(Device(), present_value);
@@ -475,6 +510,146 @@ void DefaultKeyValueCache::PickPastState(DeviceSpan<int32_t> beam_indices, int i
   }
 }
 
+size_t DefaultKeyValueCache::SizeInBytes() const {
+  size_t size{};
+  for (const auto& buffer : buffers_)
+    size += buffer ? buffer->Capacity() : 0;
+  return size;
+}
+
+// The presents of a DefaultKeyValueCache at some length, with the buffers they are in
+struct DefaultKeyValueCache::Snapshot : PromptCacheEntry {
+  // The whole buffers are kept alive, not only the part the presents use
+  size_t SizeInBytes() const override {
+    size_t size{};
+    for (const auto& buffer : buffers)
+      size += buffer->Capacity();
+    return size;
+  }
+
+  std::array<int64_t, 4> shape;
+  size_t size_in_bytes;  // Of each present
+  std::vector<int> present_buffers;
+  std::vector<std::shared_ptr<GrowableBuffer<Ort::Allocator>>> buffers;  // The buffer of each present
+};
+
+// A shared buffer holds max_length tokens that later steps write into, and per layer shapes have no single snapshot shape
+bool DefaultKeyValueCache::SupportsSnapshots() const {
+  return !past_present_share_buffer_ && layer_shapes_.empty();
+}
+
+std::shared_ptr<PromptCacheEntry> DefaultKeyValueCache::TakeSnapshot(int total_length) const {
+  if (!SupportsSnapshots() || is_first_update_ || shape_[2] != total_length)
+    return nullptr;
+
+  auto snapshot = std::make_shared<Snapshot>();
+  snapshot->shape = shape_;
+  snapshot->size_in_bytes = static_cast<size_t>(ElementCountFromShape(shape_)) * Ort::SizeOf(type_);
+  snapshot->present_buffers = present_buffers_;
+  for (int i = 0; i < layer_count_ * 2; i++)
+    snapshot->buffers.push_back(buffers_[i * 2 + present_buffers_[i]]);
+  return snapshot;
+}
+
+// The presents are created over the snapshot's buffers. Every cache holding them only reads them until it writes
+// there again, at which point CreateTensorInBuffer gives that cache a buffer of its own.
+void DefaultKeyValueCache::RestoreSnapshot(const PromptCacheEntry& entry, int total_length) {
+  const auto* snapshot = dynamic_cast<const Snapshot*>(&entry);
+  if (!snapshot || snapshot->shape[2] != total_length || snapshot->buffers.size() != presents_.size() || !SupportsSnapshots())
+    throw std::runtime_error("The key-value cache snapshot does not match this cache");
+
+  shape_ = snapshot->shape;
+  for (int i = 0; i < layer_count_ * 2; i++) {
+    const int buffer = snapshot->present_buffers[i];
+    present_buffers_[i] = buffer;
+    buffers_[i * 2 + buffer] = snapshot->buffers[i];
+    presents_[i] = OrtValue::CreateTensor(Allocator().GetInfo(), buffers_[i * 2 + buffer]->Data(), snapshot->size_in_bytes, shape_, type_);
+    state_.outputs_[output_index_ + i] = presents_[i].get();
+  }
+  is_first_update_ = false;
+}
+
+void DefaultKeyValueCache::ShareFrom(const KeyValueCache& source, int total_length) {
+  const auto* source_cache = dynamic_cast<const DefaultKeyValueCache*>(&source);
+  if (!source_cache || source_cache->is_first_update_ || !layer_shapes_.empty() || source_cache->shape_[2] < total_length)
+    throw std::runtime_error("The key-value cache does not hold the whole sequence and cannot be shared");
+
+  if (past_present_share_buffer_) {
+    // Every generator writes its next token in place, so the presents cannot be shared and are copied
+    for (int i = 0; i < layer_count_ * 2; i++)
+      ByteWrapTensor(Device(), *presents_[i]).CopyFrom(ByteWrapTensor(Device(), *source_cache->presents_[i]));
+    return;
+  }
+
+  auto snapshot = source_cache->TakeSnapshot(total_length);
+  if (!snapshot)
+    throw std::runtime_error("The key-value cache does not hold the whole sequence and cannot be shared");
+  RestoreSnapshot(*snapshot, total_length);
+}
+
+// Each present is saved as its own section of batch_beam_size * num_heads rows of total_length * head_size values.
+// With a shared buffer a present holds max_length tokens per row, of which only the first total_length are saved.
+void DefaultKeyValueCache::SaveState(GeneratorStateWriter& writer, int total_length) {
+  if (!layer_shapes_.empty() || shape_[2] < total_length)
+    throw std::runtime_error("The key-value cache does not hold the whole sequence and cannot be saved");
+
+  const size_t row_count = static_cast<size_t>(shape_[0] * shape_[1]);
+  const size_t row_size = static_cast<size_t>(total_length * shape_[3]) * Ort::SizeOf(type_);
+  const size_t row_stride = static_cast<size_t>(shape_[2] * shape_[3]) * Ort::SizeOf(type_);
+
+  std::vector<uint8_t> rows;
+  for (int i = 0; i < layer_count_ * 2; i++) {
+    auto present = ByteWrapTensor(Device(), *presents_[i]).CopyDeviceToCpu();
+    const std::string name = "kv." + std::to_string(i);
+    if (row_size == row_stride) {
+      writer.Write(name, std::span<const uint8_t>{present.data(), row_count * row_size});
+      continue;
+    }
+
+    rows.resize(row_count * row_size);
+    for (size_t row = 0; row < row_count; row++)
+      std::copy_n(present.data() + row * row_stride, row_size, rows.data() + row * row_size);
+    writer.Write(name, std::span<const uint8_t>{rows});
+  }
+}
+
+void DefaultKeyValueCache::LoadState(const GeneratorStateReader& reader, int total_length) {
+  if (!layer_shapes_.empty() || shape_[2] < total_length)
+    throw std::runtime_error("The key-value cache cannot hold the saved sequence");
+
+  const size_t row_count = static_cast<size_t>(shape_[0] * shape_[1]);
+  const size_t row_size = static_cast<size_t>(total_length * shape_[3]) * Ort::SizeOf(type_);
+  const size_t row_stride = static_cast<size_t>(shape_[2] * shape_[3]) * Ort::SizeOf(type_);
+
+  for (int i = 0; i < layer_count_ * 2; i++) {
+    auto present = ByteWrapTensor(Device(), *presents_[i]);
+    const std::string name = "kv." + std::to_string(i);
+    if (row_size == row_stride) {
+      reader.CopyTo(name, present.CpuSpan());
+    } else {
+      auto rows = reader.Get(name);
+      if (rows.size() != row_count * row_size)
+        throw std::runtime_error("Generator state section " + name + " does not match the key-value cache shape");
+
+      auto data = present.CpuSpan();
+      std::fill(data.begin(), data.end(), uint8_t{0});  // The tokens past the sequence are zero, as after allocation
+      for (size_t row = 0; row < row_count; row++)
+        std::copy_n(rows.data() + row * row_size, row_size, data.data() + row * row_stride);
+    }
+    present.CopyCpuToDevice();
+  }
+}
+
+std::unique_ptr<OrtValue> DefaultKeyValueCache::CreateTensorInBuffer(int i, int buffer, std::span<const int64_t> shape) {
+  const size_t size_in_bytes = static_cast<size_t>(ElementCountFromShape(shape)) * Ort::SizeOf(type_);
+  auto& growable_buffer = buffers_[i * 2 + buffer];
+  // Copy on write: a buffer still shared with a forked cache is left to it, and this cache writes to a new one
+  if (growable_buffer.use_count() > 1)
+    growable_buffer = std::make_shared<GrowableBuffer<Ort::Allocator>>(Allocator());
+  void* data = growable_buffer->Reserve(size_in_bytes);
+  return OrtValue::CreateTensor(Allocator().GetInfo(), data, size_in_bytes, shape, type_);
+}
+
 CrossCache::CrossCache(State& state, int sequence_length) {
   const Model& model = state.model_;
   auto& allocator = state.model_.p_device_kvcache_->GetAllocator();
@@ -4,6 +4,9 @@
 #pragma once
 
 #include "model.h"
+#include "growable_buffer.h"
+#include "cache_indirection.h"
+#include "prompt_cache.h"
 
 namespace Generators {
 
@@ -26,6 +29,38 @@ struct KeyValueCache {
                              std::span<const size_t> layer_indices_to_update) {
     throw std::runtime_error("PartialUpdate is not supported.");
   }
+
+  // Writes the presents holding total_length tokens to a generator state
+  virtual void SaveState(GeneratorStateWriter& writer, int total_length) {
+    throw std::runtime_error("Saving the state of this key-value cache is not supported.");
+  }
+
+  // Restores the presents written by SaveState, after Update(beam_indices, total_length) created them
+  virtual void LoadState(const GeneratorStateReader& reader, int total_length) {
+    throw std::runtime_error("Loading the state of this key-value cache is not supported.");
+  }
+
+  // Takes the presents of a cache of the same model holding total_length tokens, instead of calling Update.
+  // The caches share the memory of those tokens until either of them writes over it.
+  virtual void ShareFrom(const KeyValueCache& source, int total_length) {
+    throw std::runtime_error("Sharing this key-value cache is not supported.");
+  }
+
+  // Returns true if the cache can take snapshots and restore them, see TakeSnapshot and RestoreSnapshot
+  virtual bool SupportsSnapshots() const { return false; }
+
+  // Returns the presents holding total_length tokens, sharing their memory until this cache writes over it,
+  // or nullptr if the cache cannot share its presents
+  virtual std::shared_ptr<PromptCacheEntry> TakeSnapshot(int total_length) const { return nullptr; }
+
+  // Takes the presents of a snapshot of a cache of the same model, instead of calling Update
+  virtual void RestoreSnapshot(const PromptCacheEntry& snapshot, int total_length) {
+    throw std::runtime_error("Restoring a snapshot of this key-value cache is not supported.");
+  }
+
+  // Returns the bytes of memory held by the cache, including what it reserves to grow, or 0 if the cache does not
+  // reserve memory beyond its tensors
+  virtual size_t SizeInBytes() const { return 0; }
 };
 
 struct CombinedKeyValueCache : KeyValueCache {
@@ -34,6 +69,7 @@ struct CombinedKeyValueCache : KeyValueCache {
   void Add() override;  // Add to state inputs/outputs
   void Update(DeviceSpan<int32_t> beam_indices, int total_length) override;
   void RewindTo(size_t index) override;
+  size_t SizeInBytes() const override;
 
  private:
   template <typename ScoreType>
@@ -43,6 +79,9 @@ struct CombinedKeyValueCache : KeyValueCache {
   template <typename T>
   void RewindPastTensorsTo(size_t index);
 
+  // Creates a tensor over one of the two growable buffers of layer i
+  std::unique_ptr<OrtValue> CreateTensorInBuffer(int i, int buffer, std::span<const int64_t> shape);
+
   DeviceInterface& Device() { return *model_.p_device_kvcache_; }
   Ort::Allocator& Allocator() { return model_.p_device_kvcache_->GetAllocator(); }
 
@@ -50,12 +89,17 @@ struct CombinedKeyValueCache : KeyValueCache {
   const Model& model_{state_.model_};
   int layer_count_;
   size_t input_index_{~0U}, output_index_{~0U};
+  bool uses_cache_indirection_{CacheIndirection::IsNeeded(model_)};  // Beams read the past through the cache indirection instead of being reordered
 
   bool is_first_update_{true};
 
   std::array<int64_t, 5> shape_;
   ONNXTensorElementDataType type_;
 
+  // The past and present of a layer are created over two growable buffers, as in DefaultKeyValueCache
+  std::vector<GrowableBuffer<Ort::Allocator>> buffers_;  // shape (layer_count_, 2)
+  std::vector<int> present_buffers_;                     // Index of the buffer holding each present tensor, shape (layer_count_)
+
   std::unique_ptr<OrtValue> empty_past_;
   std::vector<std::unique_ptr<OrtValue>> pasts_, presents_;
   std::vector<std::string> input_name_strings_, output_name_strings_;
@@ -75,7 +119,17 @@ struct DefaultKeyValueCache : KeyValueCache {
   void Update(DeviceSpan<int32_t> beam_indices, int total_length) override;
   void RewindTo(size_t index) override;
 
+  void SaveState(GeneratorStateWriter& writer, int total_length) override;
+  void LoadState(const GeneratorStateReader& reader, int total_length) override;
+  void ShareFrom(const KeyValueCache& source, int total_length) override;
+  bool SupportsSnapshots() const override;
+  std::shared_ptr<PromptCacheEntry> TakeSnapshot(int total_length) const override;
+  void RestoreSnapshot(const PromptCacheEntry& snapshot, int total_length) override;
+  size_t SizeInBytes() const override;
+
  private:
+  struct Snapshot;
+
   template <typename ScoreType>
   void PickPastState(DeviceSpan<int32_t> beam_indices, int index);
   void PickPastState(DeviceSpan<int32_t> beam_indices, int index);
@@ -83,6 +137,9 @@ struct DefaultKeyValueCache : KeyValueCache {
   template <typename T>
   void RewindPastTensorsTo(size_t index);
 
+  // Creates a tensor over one of the two growable buffers of key-value tensor i
+  std::unique_ptr<OrtValue> CreateTensorInBuffer(int i, int buffer, std::span<const int64_t> shape);
+
   DeviceInterface& Device() { return *model_.p_device_kvcache_; }
   Ort::Allocator& Allocator() { return model_.p_device_kvcache_->GetAllocator(); }
 
@@ -91,6 +148,7 @@ struct DefaultKeyValueCache : KeyValueCache {
   int layer_count_;
   size_t input_index_{~0U}, output_index_{~0U};
   bool past_present_share_buffer_;  // True if model.decoder.past_present_share_buffer is set to true, and we're using cuda, and not beam search
+  bool uses_cache_indirection_{CacheIndirection::IsNeeded(model_)};  // Beams read the past through the cache indirection instead of being reordered
 
   bool is_first_update_{true};
 
@@ -103,6 +161,13 @@ struct DefaultKeyValueCache : KeyValueCache {
   // Support for per-layer KV cache shapes (for models with alternating attention patterns)
   std::vector<std::array<int64_t, 4>> layer_shapes_;
 
+  // Without a shared buffer, every past and present tensor is created over one of two growable buffers
+  // per key-value tensor, so the tensors are not reallocated on every token. The present is written to
+  // one buffer while the past is read from the other. buffers_ has shape (layer_count_ * 2, 2).
+  // A buffer is shared with the caches forked from this one (see ShareFrom) until it is written again.
+  std::vector<std::shared_ptr<GrowableBuffer<Ort::Allocator>>> buffers_;
+  std::vector<int> present_buffers_;  // Index of the buffer holding each present tensor, shape (layer_count_ * 2)
+
   std::unique_ptr<OrtValue> empty_past_;
   std::vector<std::unique_ptr<OrtValue>> pasts_, presents_;
   std::vector<std::string> input_name_strings_, output_name_strings_;
@@ -8,6 +8,7 @@
 #include <set>
 #include <string>
 #include <thread>
+#include <unordered_set>
 
 #include "../generators.h"
 #include "../search.h"
@@ -115,6 +116,15 @@ void State::DumpOutputs() {
 void State::Run(OrtSession& session, bool graph_capture_this_run) {
   DurationTrace trace{"State::Run"};
 
+  BeginRun(session, graph_capture_this_run);
+
+  session.Run(run_options_.get(), input_names_.data(), inputs_.data(), input_names_.size(),
+              output_names_.data(), outputs_.data(), output_names_.size());
+
+  EndRun();
+}
+
+void State::BeginRun(OrtSession& session, bool graph_capture_this_run) {
   if (params_->use_graph_capture) {
     if (graph_capture_this_run) {
       run_options_->AddConfigEntry("gpu_graph_id", graph_id_.c_str());
@@ -153,10 +163,9 @@ void State::Run(OrtSession& session, bool graph_capture_this_run) {
   if (model_.p_device_ && model_.p_device_->GetType() == DeviceType::NvTensorRtRtx) {
     run_options_->AddConfigEntry("disable_synchronize_execution_providers", "1");
   }
+}
 
-  session.Run(run_options_.get(), input_names_.data(), inputs_.data(), input_names_.size(),
-              output_names_.data(), outputs_.data(), output_names_.size());
-
+void State::EndRun() {
   extra_outputs_.RegisterOutputs();
 
   DumpOutputs();
@@ -252,6 +261,62 @@ State::~State() {
   }
 }
 
+void State::SaveState(GeneratorStateWriter& /*writer*/, int /*total_length*/) {
+  throw std::runtime_error("Saving the generator state is not supported for model type " + model_.config_->model.type);
+}
+
+void State::LoadState(const GeneratorStateReader& /*reader*/, DeviceSpan<int32_t>& /*tokens*/, int /*total_length*/) {
+  throw std::runtime_error("Loading the generator state is not supported for model type " + model_.config_->model.type);
+}
+
+void State::ForkFrom(const State& /*source*/, DeviceSpan<int32_t>& /*tokens*/, int /*total_length*/) {
+  throw std::runtime_error("Forking the generator is not supported for model type " + model_.config_->model.type);
+}
+
+void State::RestoreSnapshot(const PromptCacheEntry& /*snapshot*/, DeviceSpan<int32_t>& /*tokens*/, int /*total_length*/) {
+  throw std::runtime_error("The prompt cache is not supported for model type " + model_.config_->model.type);
+}
+
+// Returns true if name is one of the names of template_string, such as past_key_values.3.key for past_key_values.%d.key
+static bool MatchesKeyValueName(std::string_view template_string, std::string_view name) {
+  const auto index = template_string.find("%d");
+  if (index == std::string_view::npos)
+    return !template_string.empty() && name == template_string;
+
+  const auto prefix = template_string.substr(0, index), suffix = template_string.substr(index + 2);
+  if (name.size() <= prefix.size() + suffix.size() || name.substr(0, prefix.size()) != prefix ||
+      name.substr(name.size() - suffix.size()) != suffix)
+    return false;
+  const auto layer = name.substr(prefix.size(), name.size() - prefix.size() - suffix.size());
+  return std::all_of(layer.begin(), layer.end(), [](char c) { return c >= '0' && c <= '9'; });
+}
+
+MemoryUsage State::GetMemoryUsage() const {
+  const auto& decoder = model_.config_->model.decoder;
+  const std::array<std::string_view, 8> key_value_names{decoder.inputs.past_key_names, decoder.inputs.past_value_names,
+                                                        decoder.inputs.past_names, decoder.outputs.present_key_names,
+                                                        decoder.outputs.present_value_names, decoder.outputs.present_names,
+                                                        decoder.inputs.cross_past_key_names, decoder.inputs.cross_past_value_names};
+
+  MemoryUsage usage;
+  std::unordered_set<const void*> counted;  // Pasts and presents can share a buffer, so each buffer is counted once
+  auto count = [&](const char* name, const OrtValue* value) {
+    if (!value || !value->IsTensor() || !counted.insert(value->GetTensorRawData()).second)
+      return;
+    auto info = value->GetTensorTypeAndShapeInfo();
+    const size_t size = info->GetElementCount() * Ort::SizeOf(info->GetElementType());
+    const bool is_key_value = std::any_of(key_value_names.begin(), key_value_names.end(),
+                                          [name](std::string_view template_string) { return MatchesKeyValueName(template_string, name); });
+    (is_key_value ? usage.kv_cache : usage.activations) += size;
+  };
+
+  for (size_t i = 0; i < inputs_.size() && i < input_names_.size(); i++)
+    count(input_names_[i], inputs_[i]);
+  for (size_t i = 0; i < outputs_.size() && i < output_names_.size(); i++)
+    count(output_names_[i], outputs_[i]);
+  return usage;
+}
+
 std::vector<int32_t> PadInputs(std::span<std::span<const int32_t>> sequences, int32_t pad_token_id) {
   bool pad_right_{true};
 
@@ -297,6 +362,136 @@ const std::string& TokenizerStream::Decode(int32_t token) {
   return chunk_;
 }
 
+namespace {
+
+// Whether text is valid UTF-8 without the replacement character that decoders emit for incomplete characters
+bool IsCompleteUtf8(std::string_view text) {
+  for (size_t i = 0; i < text.size();) {
+    const auto lead = static_cast<unsigned char>(text[i]);
+    const size_t length = lead < 0x80 ? 1 : (lead & 0xe0) == 0xc0 ? 2
+                                         : (lead & 0xf0) == 0xe0   ? 3
+                                         : (lead & 0xf8) == 0xf0   ? 4
+                                                                   : 0;
+    if (length == 0 || i + length > text.size())
+      return false;
+    for (size_t j = 1; j < length; j++) {
+      if ((static_cast<unsigned char>(text[i + j]) & 0xc0) != 0x80)
+        return false;
+    }
+    if (text.substr(i, length) == "\xef\xbf\xbd")  // U+FFFD
+      return false;
+    i += length;
+  }
+  return true;
+}
+
+}  // namespace
+
+BatchTokenizerStream::BatchTokenizerStream(const Tokenizer& tokenizer)
+    : tokenizer_{tokenizer.shared_from_this()} {
+  ResetPieces();
+}
+
+void BatchTokenizerStream::ResetPieces() {
+  options_version_ = tokenizer_->GetOptionsVersion();
+  anchors_.clear();
+  anchor_texts_.clear();
+  pieces_.clear();
+  piece_text_.clear();
+
+  for (const char* text : {"a", "0"}) {
+    const auto tokens = tokenizer_->Encode(text);
+    if (tokens.empty())
+      continue;
+    anchors_.push_back(tokens.back());
+    anchor_texts_.push_back(tokenizer_->Decode(std::span<const int32_t>{&tokens.back(), 1}));
+  }
+}
+
+void BatchTokenizerStream::Decode(std::span<const uint64_t> stream_ids, std::span<const int32_t> tokens) {
+  if (stream_ids.size() != tokens.size())
+    throw std::runtime_error("BatchTokenizerStream: stream_ids and tokens must have the same size");
+
+  // Options such as skip_special_tokens change the text of tokens in the table
+  if (tokenizer_->GetOptionsVersion() != options_version_)
+    ResetPieces();
+
+  text_.clear();
+  offsets_.assign(1, 0);
+  for (size_t i = 0; i < tokens.size(); i++) {
+    DecodeToken(streams_[stream_ids[i]], tokens[i]);
+    offsets_.push_back(text_.size());
+  }
+}
+
+void BatchTokenizerStream::Remove(uint64_t stream_id) {
+  streams_.erase(stream_id);
+}
+
+const BatchTokenizerStream::Piece& BatchTokenizerStream::GetPiece(int32_t token) {
+  if (token < 0)
+    throw std::runtime_error("BatchTokenizerStream: Invalid token id " + std::to_string(token));
+  if (static_cast<size_t>(token) >= pieces_.size())
+    pieces_.resize(token + 1);
+
+  auto& piece = pieces_[token];
+  if (piece.decoded)
+    return piece;
+  piece.decoded = true;
+
+  // The text of a token is context free if it is the same complete text after every anchor
+  std::optional<std::string> text;
+  for (size_t i = 0; i < anchors_.size(); i++) {
+    const std::array<int32_t, 2> anchored{anchors_[i], token};
+    const auto anchored_text = tokenizer_->Decode(anchored);
+    if (anchored_text.compare(0, anchor_texts_[i].size(), anchor_texts_[i]) != 0)
+      return piece;
+    auto piece_text = anchored_text.substr(anchor_texts_[i].size());
+    if (!IsCompleteUtf8(piece_text) || (text && *text != piece_text))
+      return piece;
+    text = std::move(piece_text);
+  }
+  if (!text)
+    return piece;
+
+  piece.context_free = true;
+  piece.offset = static_cast<uint32_t>(piece_text_.size());
+  piece.size = static_cast<uint32_t>(text->size());
+  piece_text_ += *text;
+  return piece;
+}
+
+void BatchTokenizerStream::DecodeToken(Stream& stream, int32_t token) {
+  // Most tokens follow complete text, and their text comes from the table
+  if (!stream.tokens.empty() && stream.read_offset == stream.tokens.size()) {
+    if (const auto& piece = GetPiece(token); piece.context_free) {
+      text_.append(piece_text_, piece.offset, piece.size);
+      stream.tokens.assign(1, token);
+      stream.prefix_offset = 0;
+      stream.read_offset = 1;
+      return;
+    }
+  }
+
+  // Otherwise decode the pending tokens after the tokens of the last text, and return the new text once it is complete.
+  // A stream of tokens that never completes is flushed after as many tokens as the bytes of the longest character.
+  constexpr size_t kMaxPendingTokens = 4;
+
+  stream.tokens.push_back(token);
+  const std::span<const int32_t> window{stream.tokens.data() + stream.prefix_offset, stream.tokens.size() - stream.prefix_offset};
+  const auto prefix_text = stream.read_offset > stream.prefix_offset ? tokenizer_->Decode(window.subspan(0, stream.read_offset - stream.prefix_offset)) : std::string{};
+  const auto new_text = tokenizer_->Decode(window);
+  const bool complete = new_text.size() > prefix_text.size() && IsCompleteUtf8(std::string_view{new_text}.substr(prefix_text.size()));
+  if (!complete && stream.tokens.size() - stream.read_offset < kMaxPendingTokens)
+    return;
+
+  if (new_text.size() > prefix_text.size())
+    text_.append(new_text, prefix_text.size());
+  stream.tokens.erase(stream.tokens.begin(), stream.tokens.begin() + stream.read_offset);
+  stream.prefix_offset = 0;
+  stream.read_offset = stream.tokens.size();
+}
+
 Tokenizer::Tokenizer(Config& config) : bos_token_id_{config.model.bos_token_id},
                                        eos_token_id_{config.model.eos_token_id},
                                        pad_token_id_{config.model.pad_token_id} {
@@ -314,6 +509,7 @@ std::unique_ptr<TokenizerStream> Tokenizer::CreateStream() const {
 void Tokenizer::UpdateOptions(const char* const* keys, const char* const* values, size_t num_options) {
   // Tap into ORT Extensions API
   CheckResult(OrtxUpdateTokenizerOptions(tokenizer_, const_cast<const char**>(keys), const_cast<const char**>(values), num_options));
+  options_version_++;
 }
 
 std::vector<int32_t> Tokenizer::Encode(const char* text) const {
@@ -348,42 +544,236 @@ std::string Tokenizer::ApplyChatTemplate(const char* template_str, const char* m
   return text_ptr;
 }
 
-std::vector<int32_t> Tokenizer::EncodeBatch(std::span<const std::string> strings) const {
-  std::vector<std::vector<int32_t>> sequences;
-  std::vector<std::span<const int32_t>> span_sequences;
-  for (size_t i = 0; i < strings.size(); i++) {
-    sequences.emplace_back(Encode(strings[i].c_str()));
-    span_sequences.emplace_back(sequences.back());
+namespace {
+
+uint64_t HashBytes(uint64_t hash, std::string_view bytes) {
+  for (unsigned char byte : bytes)
+    hash = (hash ^ byte) * 0x100000001b3ull;  // FNV-1a
+  return hash;
+}
+
+// Returns the hashes of the first 1, 2, ... n messages of a JSON array of chat messages, each message hashed as written.
+// The hashes continue from seed, so conversations with different templates or tools never share a hash.
+std::vector<uint64_t> HashMessages(std::string_view messages, uint64_t seed) {
+  auto is_space = [](char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; };
+
+  size_t i = 0;
+  while (i < messages.size() && is_space(messages[i]))
+    i++;
+  if (i == messages.size() || messages[i] != '[')
+    throw std::runtime_error("Chat messages must be a JSON array");
+
+  std::vector<uint64_t> hashes;
+  uint64_t hash = seed;
+  size_t begin = std::string_view::npos, end = 0;  // Of the current message, without the whitespace around it
+  int depth = 0;
+  bool in_string = false;
+  for (i++; i < messages.size(); i++) {
+    const char c = messages[i];
+    if (in_string) {
+      if (c == '\\')
+        i++;
+      else if (c == '"')
+        in_string = false;
+      end = i + 1;
+      continue;
+    }
+    if (is_space(c))
+      continue;
+
+    if (depth == 0 && (c == ',' || c == ']')) {
+      if (begin != std::string_view::npos) {
+        hash = HashBytes(hash, messages.substr(begin, end - begin));
+        hash = HashBytes(hash, std::string_view{"\0", 1});
+        hashes.push_back(hash);
+      }
+      begin = std::string_view::npos;
+      if (c == ']')
+        return hashes;
+      continue;
+    }
+
+    if (begin == std::string_view::npos)
+      begin = i;
+    end = i + 1;
+    if (c == '"')
+      in_string = true;
+    else if (c == '{' || c == '[')
+      depth++;
+    else if (c == '}' || c == ']')
+      depth--;
+  }
+  throw std::runtime_error("Chat messages must be a JSON array");
+}
+
+}  // namespace
+
+ChatEncoder::ChatEncoder(const Tokenizer& tokenizer, size_t max_conversations)
+    : tokenizer_{tokenizer.shared_from_this()}, max_conversations_{max_conversations} {}
+
+std::vector<int32_t> ChatEncoder::Encode(const char* template_str, const char* messages, const char* tools, bool add_generation_prompt) {
+  const auto text = tokenizer_->ApplyChatTemplate(template_str, messages, tools, add_generation_prompt);
+
+  uint64_t seed = 0xcbf29ce484222325ull;
+  seed = HashBytes(seed, template_str ? std::string_view{template_str, std::strlen(template_str) + 1} : std::string_view{});
+  seed = HashBytes(seed, tools ? std::string_view{tools, std::strlen(tools) + 1} : std::string_view{});
+  seed = HashBytes(seed, add_generation_prompt ? "1" : "0");
+  const auto hashes = HashMessages(messages, seed);
+
+  // Take the cached conversation with the most messages in common out of the cache, it goes back in with the new messages
+  std::optional<Conversation> conversation;
+  {
+    std::scoped_lock lock{mutex_};
+    for (auto hash = hashes.rbegin(); hash != hashes.rend(); ++hash) {
+      auto found = conversations_by_hash_.find(*hash);
+      if (found == conversations_by_hash_.end())
+        continue;
+      if (text.compare(0, found->second->second.text.size(), found->second->second.text) == 0) {  // False when the template renders earlier messages differently now
+        conversation = std::move(found->second->second);
+        conversations_.erase(found->second);
+        conversations_by_hash_.erase(found);
+      }
+      break;
+    }
   }
 
-  return PadInputs(span_sequences, pad_token_id_);
+  if (!conversation || !Continue(*conversation, text))
+    conversation = Conversation{text, tokenizer_->Encode(text.c_str())};
+  auto tokens = conversation->tokens;
+
+  if (hashes.empty() || max_conversations_ == 0)
+    return tokens;
+
+  std::scoped_lock lock{mutex_};
+  if (auto found = conversations_by_hash_.find(hashes.back()); found != conversations_by_hash_.end()) {
+    conversations_.erase(found->second);
+    conversations_by_hash_.erase(found);
+  }
+  conversations_.emplace_front(hashes.back(), std::move(*conversation));
+  conversations_by_hash_[hashes.back()] = conversations_.begin();
+  while (conversations_.size() > max_conversations_) {
+    conversations_by_hash_.erase(conversations_.back().first);
+    conversations_.pop_back();
+  }
+  return tokens;
 }
 
-std::shared_ptr<Tensor> Tokenizer::EncodeBatch(std::span<const char*> strings) const {
-  std::vector<std::vector<int32_t>> sequences;
-  std::vector<std::span<const int32_t>> span_sequences;
-  for (size_t i = 0; i < strings.size(); i++) {
-    sequences.emplace_back(Encode(strings[i]));
-    span_sequences.emplace_back(sequences.back());
+bool ChatEncoder::Continue(Conversation& conversation, const std::string& text) const {
+  // The text after the seam is tokenized after the last few bytes before it. If the tokens of those bytes alone come
+  // first, no token crosses the seam and the tokens after them are the new tokens.
+  constexpr size_t kSeamContext = 256;
+
+  const size_t seam = conversation.text.size();
+  size_t context_begin = seam - std::min(seam, kSeamContext);
+  while (context_begin < seam && (static_cast<unsigned char>(text[context_begin]) & 0xc0) == 0x80)
+    context_begin++;  // Start on a UTF-8 character
+
+  if (seam < text.size()) {
+    const auto context_tokens = tokenizer_->Encode(text.substr(context_begin, seam - context_begin).c_str());
+    const auto joined_tokens = tokenizer_->Encode(text.substr(context_begin).c_str());
+    if (joined_tokens.size() < context_tokens.size() || !std::equal(context_tokens.begin(), context_tokens.end(), joined_tokens.begin()))
+      return false;
+    conversation.tokens.insert(conversation.tokens.end(), joined_tokens.begin() + context_tokens.size(), joined_tokens.end());
+  }
+  conversation.text = text;
+  return true;
+}
+
+// The token ids of a batch of strings. The strings are tokenized on the thread pool with one OrtxTokenize call
+// per range of strings, and the ids are read in place from the results instead of being copied out.
+struct TokenizedBatch {
+  TokenizedBatch(const OrtxTokenizer* tokenizer, std::span<const char*> strings) : sequences_(strings.size()) {
+    const size_t num_chunks = std::min(strings.size(), GetThreadPool().NumThreads() * 4);  // Several per thread to even out the string lengths
+    const size_t chunk_size = num_chunks == 0 ? 0 : (strings.size() + num_chunks - 1) / num_chunks;
+    chunks_ = std::vector<OrtxPtr<OrtxTokenId2DArray>>(num_chunks);
+    GetThreadPool().ParallelFor(num_chunks, [&](size_t chunk) {
+      const size_t begin = chunk * chunk_size;
+      const size_t count = std::min(chunk_size, strings.size() - begin);
+      if (count == 0)
+        return;
+      CheckResult(OrtxTokenize(tokenizer, strings.data() + begin, count, chunks_[chunk].Address()));
+      for (size_t i = 0; i < count; i++) {
+        const extTokenId_t* tokens;
+        size_t token_count;
+        CheckResult(OrtxTokenId2DArrayGetItem(chunks_[chunk], i, &tokens, &token_count));
+        sequences_[begin + i] = {reinterpret_cast<const int32_t*>(tokens), token_count};
+      }
+    });
+  }
+
+  std::span<const std::span<const int32_t>> Sequences() const { return sequences_; }
+
+  size_t MaxLength() const {
+    size_t max_length = 0;
+    for (const auto& sequence : sequences_)
+      max_length = std::max(max_length, sequence.size());
+    return max_length;
   }
 
-  auto encoded = PadInputs(span_sequences, pad_token_id_);  // TODO: Pad directly into tensor vs copying?
+  // Copies the sequences into the rows of output, each max_length long and padded on the right
+  void PadInto(std::span<int32_t> output, size_t max_length, int32_t pad_token_id) const {
+    GetThreadPool().ParallelFor(sequences_.size(), [&](size_t i) {
+      auto row = output.subspan(i * max_length, max_length);
+      std::copy(sequences_[i].begin(), sequences_[i].end(), row.begin());
+      std::fill(row.begin() + sequences_[i].size(), row.end(), pad_token_id);
+    });
+  }
+
+ private:
+  std::vector<OrtxPtr<OrtxTokenId2DArray>> chunks_;
+  std::vector<std::span<const int32_t>> sequences_;
+};
+
+std::vector<int32_t> Tokenizer::EncodeBatch(std::span<const std::string> strings) const {
+  std::vector<const char*> c_strings;
+  for (const auto& string : strings)
+    c_strings.push_back(string.c_str());
+
+  TokenizedBatch batch{tokenizer_, c_strings};
+  const size_t max_length = batch.MaxLength();
+  std::vector<int32_t> result(max_length * strings.size());
+  batch.PadInto(result, max_length, pad_token_id_);
+  return result;
+}
 
-  auto shape = std::array<int64_t, 2>{static_cast<int64_t>(strings.size()), static_cast<int64_t>(encoded.size() / strings.size())};
-  auto ort_tensor_ = OrtValue::CreateTensor<int32_t>(Ort::Allocator::GetWithDefaultOptions(), shape);
-  auto tensor = std::make_shared<Tensor>(std::move(ort_tensor_));
-  std::copy(encoded.begin(), encoded.end(), tensor->GetMutableData<int32_t>());
+std::shared_ptr<Tensor> Tokenizer::EncodeBatch(std::span<const char*> strings) const {
+  TokenizedBatch batch{tokenizer_, strings};
+  const size_t max_length = batch.MaxLength();
 
+  auto shape = std::array<int64_t, 2>{static_cast<int64_t>(strings.size()), static_cast<int64_t>(max_length)};
+  auto tensor = std::make_shared<Tensor>(OrtValue::CreateTensor<int32_t>(Ort::Allocator::GetWithDefaultOptions(), shape));
+  batch.PadInto(std::span<int32_t>{tensor->GetMutableData<int32_t>(), max_length * strings.size()}, max_length, pad_token_id_);
   return tensor;
 }
 
+std::pair<std::shared_ptr<Tensor>, std::shared_ptr<Tensor>> Tokenizer::EncodeBatchRagged(std::span<const char*> strings) const {
+  TokenizedBatch batch{tokenizer_, strings};
+  const auto sequences = batch.Sequences();
+
+  auto offsets_shape = std::array<int64_t, 1>{static_cast<int64_t>(sequences.size() + 1)};
+  auto offsets = std::make_shared<Tensor>(OrtValue::CreateTensor<int64_t>(Ort::Allocator::GetWithDefaultOptions(), offsets_shape));
+  auto* offsets_data = offsets->GetMutableData<int64_t>();
+  offsets_data[0] = 0;
+  for (size_t i = 0; i < sequences.size(); i++)
+    offsets_data[i + 1] = offsets_data[i] + static_cast<int64_t>(sequences[i].size());
+
+  auto token_ids_shape = std::array<int64_t, 1>{offsets_data[sequences.size()]};
+  auto token_ids = std::make_shared<Tensor>(OrtValue::CreateTensor<int32_t>(Ort::Allocator::GetWithDefaultOptions(), token_ids_shape));
+  auto* token_ids_data = token_ids->GetMutableData<int32_t>();
+  GetThreadPool().ParallelFor(sequences.size(), [&](size_t i) {
+    std::copy(sequences[i].begin(), sequences[i].end(), token_ids_data + offsets_data[i]);
+  });
+  return {std::move(token_ids), std::move(offsets)};
+}
+
 std::vector<std::string> Tokenizer::DecodeBatch(std::span<const int32_t> sequences, size_t count) const {
   if (sequences.size() % count != 0)
     throw std::runtime_error("DecodeBatch: sequences must be evenly divisible by the count");
   size_t sequence_length = sequences.size() / count;
-  std::vector<std::string> strings;
-  for (size_t i = 0; i < count; i++)
-    strings.emplace_back(Decode(sequences.subspan(sequence_length * i, sequence_length)));
+  std::vector<std::string> strings(count);
+  GetThreadPool().ParallelFor(count, [&](size_t i) {
+    strings[i] = Decode(sequences.subspan(sequence_length * i, sequence_length));
+  });
   return strings;
 }
 
@@ -579,6 +969,43 @@ Model::Model(std::unique_ptr<Config> config) : config_{std::move(config)} {
 
   // The kvcache is always allocated in device memory
   p_device_kvcache_ = p_device_;
+
+  if (config_->prompt_cache.max_bytes > 0)
+    prompt_cache_ = std::make_unique<PromptCache>(config_->prompt_cache.max_bytes, config_->prompt_cache.min_length);
+  if (config_->vision_cache.max_bytes > 0)
+    vision_cache_ = std::make_shared<VisionCache>(config_->vision_cache.max_bytes);
+}
+
+MemoryUsage Model::GetMemoryUsage() const {
+  MemoryUsage usage;
+  usage.weights = weights_size_in_bytes_;
+  if (prompt_cache_)
+    usage.kv_cache = prompt_cache_->Stats().size_in_bytes;
+  if (vision_cache_)
+    usage.activations = vision_cache_->Stats().size_in_bytes;
+  return usage;
+}
+
+double Model::GetStatistic(std::string_view name) const {
+  if (prompt_cache_) {
+    const auto stats = prompt_cache_->Stats();
+    if (name == "prompt_cache_entries") return static_cast<double>(stats.num_entries);
+    if (name == "prompt_cache_bytes") return static_cast<double>(stats.size_in_bytes);
+    if (name == "prompt_cache_hits") return static_cast<double>(stats.num_hits);
+    if (name == "prompt_cache_misses") return static_cast<double>(stats.num_misses);
+    if (name == "prompt_cache_hit_tokens") return static_cast<double>(stats.num_hit_tokens);
+    if (name == "prompt_cache_evictions") return static_cast<double>(stats.num_evictions);
+  }
+  if (vision_cache_) {
+    const auto stats = vision_cache_->Stats();
+    if (name == "vision_cache_entries") return static_cast<double>(stats.num_entries);
+    if (name == "vision_cache_bytes") return static_cast<double>(stats.size_in_bytes);
+    if (name == "vision_cache_hits") return static_cast<double>(stats.num_hits);
+    if (name == "vision_cache_misses") return static_cast<double>(stats.num_misses);
+    if (name == "vision_cache_evictions") return static_cast<double>(stats.num_evictions);
+  }
+
+  throw std::runtime_error("Unknown model statistic: " + std::string(name));
 }
 
 Model::~Model() {
@@ -783,12 +1210,21 @@ std::unique_ptr<OrtSession> Model::CreateSession(OrtEnv& ort_env, const std::str
     DirGuard dir_guard;
     dir_guard.ChangeTo(config_->config_path);
     auto session = OrtSession::Create(ort_env, model_data_it->second.data(), model_data_it->second.size(), session_options);
+    weights_size_in_bytes_ += model_data_it->second.size();
 
     return session;
   }
 
   // Otherwise, load the model from the file system
-  return OrtSession::Create(ort_env, (config_->config_path / fs::path(model_filename)).c_str(), session_options);
+  const auto model_path = config_->config_path / fs::path(model_filename);
+  auto session = OrtSession::Create(ort_env, model_path.c_str(), session_options);
+
+  // The weights are usually in an external data file named after the model
+  for (const auto& path : {model_path, fs::path(model_path.string() + ".data")}) {
+    if (std::ifstream file = path.open(std::ios::binary | std::ios::ate))
+      weights_size_in_bytes_ += static_cast<size_t>(file.tellg());
+  }
+  return session;
 }
 
 std::shared_ptr<Tokenizer> Model::CreateTokenizer() const {
@@ -796,7 +1232,7 @@ std::shared_ptr<Tokenizer> Model::CreateTokenizer() const {
 }
 
 std::shared_ptr<MultiModalProcessor> Model::CreateMultiModalProcessor() const {
-  return std::make_shared<MultiModalProcessor>(*config_, session_info_);
+  return std::make_shared<MultiModalProcessor>(*config_, session_info_, vision_cache_);
 }
 
 bool Model::IsPruned() const {
@@ -911,7 +1347,7 @@ std::unique_ptr<OrtValue> Model::ExpandInputs(std::unique_ptr<OrtValue>& input,
   return expanded;
 }
 
-MultiModalProcessor::MultiModalProcessor(Config& config, const SessionInfo& session_info)
+MultiModalProcessor::MultiModalProcessor(Config& config, const SessionInfo& session_info, std::shared_ptr<VisionCache> vision_cache)
     : tokenizer_{std::make_shared<Tokenizer>(config)},
       processor_factory_{
           {"phi3v", Processor::Create<PhiImageProcessor>},
@@ -921,23 +1357,51 @@ MultiModalProcessor::MultiModalProcessor(Config& config, const SessionInfo& sess
           {"fara", Processor::Create<QwenImageProcessor>},
           {"qwen2_5_vl", Processor::Create<QwenImageProcessor>},
           {"qwen3_vl", Processor::Create<QwenImageProcessor>},
-          {"qwen3_5", Processor::Create<QwenImageProcessor>}} {
+          {"qwen3_5", Processor::Create<QwenImageProcessor>}},
+      vision_cache_{std::move(vision_cache)} {
   auto processor = processor_factory_.find(config.model.type);
   if (processor != processor_factory_.end()) {
     processor_ = processor->second(config, session_info);
   } else {
     throw std::runtime_error("MultiModalProcessor cannot be created. " + config.model.type + " is not a registered multi-modal model type.");
   }
+
+  if (vision_cache_) {
+    processor_key_ = HashContent(config.model.type.data(), config.model.type.size());
+    const auto processor_config = config.config_path / fs::path(config.model.vision.config_filename);
+    if (!config.model.vision.config_filename.empty() && processor_config.exists())
+      processor_key_ = HashFile(processor_config, processor_key_);
+  }
 }
 
 std::unique_ptr<NamedTensors> MultiModalProcessor::Process(const std::string& prompt, const Images* images, const Audios* audios) const {
   Payload payload{prompt, {}, images, audios};
-  return processor_->Process(*tokenizer_, payload);
+  return Process(payload);
 }
 
 std::unique_ptr<NamedTensors> MultiModalProcessor::Process(std::span<const char*> prompts, const Images* images, const Audios* audios) const {
   Payload payload{"", prompts, images, audios};
-  return processor_->Process(*tokenizer_, payload);
+  return Process(payload);
+}
+
+std::unique_ptr<NamedTensors> MultiModalProcessor::Process(Payload& payload) const {
+  const Images* images = payload.images;
+  if (!vision_cache_ || !images || images->num_images_ == 0)
+    return processor_->Process(*tokenizer_, payload);
+
+  const auto& hashes = images->Hashes();
+  if (hashes.size() != images->num_images_)
+    return processor_->Process(*tokenizer_, payload);
+
+  payload.vision_cache = vision_cache_.get();
+  payload.images_key = HashContent(hashes.data(), hashes.size() * sizeof(uint64_t), processor_key_);
+  auto named_tensors = processor_->Process(*tokenizer_, payload);
+
+  // Passed on to the vision stage, which caches the image features under it
+  auto vision_cache_key = OrtValue::CreateTensor<int64_t>(Ort::Allocator::GetWithDefaultOptions(), std::vector<int64_t>{1});
+  *vision_cache_key->GetTensorMutableData<int64_t>() = static_cast<int64_t>(payload.images_key);
+  named_tensors->emplace(std::string(Config::Defaults::VisionCacheKeyName), std::make_shared<Tensor>(std::move(vision_cache_key)));
+  return named_tensors;
 }
 
 }  // namespace Generators
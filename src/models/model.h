@@ -13,6 +13,8 @@
 #include "gemma_image_processor.h"
 #include "adapters.h"
 #include "extra_outputs.h"
+#include "prompt_cache.h"
+#include "vision_cache.h"
 
 namespace Generators {
 
@@ -39,6 +41,24 @@ struct State {
   void SetRunOptions(const Config::RunOptions& config_run_options);
   virtual void SetExtraInputs(const std::vector<ExtraInput>& extra_inputs) {}
 
+  // Writes the model state of a sequence of total_length tokens whose logits have been computed, see Generator::SaveState
+  virtual void SaveState(GeneratorStateWriter& writer, int total_length);
+  // Restores a state written by SaveState into a state that has not run yet, tokens being the whole sequence
+  virtual void LoadState(const GeneratorStateReader& reader, DeviceSpan<int32_t>& tokens, int total_length);
+  // Continues from a state of the same model that has run the whole sequence of tokens, sharing its memory where possible
+  virtual void ForkFrom(const State& source, DeviceSpan<int32_t>& tokens, int total_length);
+  // Returns true if the state can take snapshots and restore them. A generator whose state cannot restore one must
+  // not look up the prompt cache, which holds the snapshots of every generator of the model.
+  virtual bool SupportsSnapshots() const { return false; }
+  // Returns the model state after the whole sequence of total_length tokens for the prompt cache, or nullptr if the
+  // state cannot be cached
+  virtual std::shared_ptr<PromptCacheEntry> TakeSnapshot(int total_length) const { return nullptr; }
+  // Same as ForkFrom, continuing from a snapshot taken by TakeSnapshot after the sequence of tokens
+  virtual void RestoreSnapshot(const PromptCacheEntry& snapshot, DeviceSpan<int32_t>& tokens, int total_length);
+
+  // Returns the memory of the tensors bound as inputs and outputs. The key-value cache is recognized by name.
+  virtual MemoryUsage GetMemoryUsage() const;
+
   void DumpInputs();
   void DumpOutputs();
 
@@ -54,6 +74,10 @@ struct State {
 
  protected:
   void Run(OrtSession& session, bool graph_capture_this_run = false);
+  // The bookkeeping of Run before and after the session run, for states that run the session themselves, such as on
+  // slices of the inputs and outputs from several threads. The run options are not changed between the two.
+  void BeginRun(OrtSession& session, bool graph_capture_this_run = false);
+  void EndRun();
   bool first_run_{true};
 
   std::unique_ptr<OrtRunOptions> run_options_;
@@ -75,6 +99,92 @@ struct TokenizerStream : LeakChecked<TokenizerStream> {
   std::string chunk_;
 };
 
+/*
+ * BatchTokenizerStream decodes the new tokens of many streams at once, such as the tokens of all the requests of an
+ * Engine step. Streams are identified by ids chosen by the caller: a stream starts with the first token of its id and
+ * ends when it is removed. Every Decode returns the new text of all the tokens in one buffer, where the text of each
+ * token ends on a complete UTF-8 character. Text that is not complete yet is returned with a later token of the stream.
+ *
+ * The text of most tokens is the same whatever tokens come before them, so it is decoded once per token id into a
+ * table shared by all the streams. Only the other tokens, like the bytes of a character split across tokens, are
+ * decoded together with the last tokens of their stream. The table is decoded again after the options of the
+ * tokenizer are updated.
+ *
+ * Not thread safe, like TokenizerStream.
+ */
+struct BatchTokenizerStream : LeakChecked<BatchTokenizerStream> {
+  BatchTokenizerStream(const Tokenizer& tokenizer);
+
+  // Decodes tokens[i] of the stream stream_ids[i], in order. The new text of tokens[i] is Text()[Offsets()[i], Offsets()[i + 1]).
+  void Decode(std::span<const uint64_t> stream_ids, std::span<const int32_t> tokens);
+  const std::string& Text() const { return text_; }
+  const std::vector<size_t>& Offsets() const { return offsets_; }
+
+  // Forgets a stream, its id can be used again to start a new stream
+  void Remove(uint64_t stream_id);
+
+ private:
+  struct Stream {
+    std::vector<int32_t> tokens;  // The last tokens of the stream, new text is decoded after them
+    size_t prefix_offset{};       // The text of tokens [prefix_offset, read_offset) was returned last, the tokens after it are pending
+    size_t read_offset{};
+  };
+
+  struct Piece {
+    bool decoded{};       // Whether the token was decoded into the table yet
+    bool context_free{};  // Whether the token's text after any complete text is piece_text_[offset, offset + size)
+    uint32_t offset{}, size{};
+  };
+
+  void ResetPieces();  // Decodes the anchors with the current options of the tokenizer and empties the table
+  const Piece& GetPiece(int32_t token);
+  void DecodeToken(Stream& stream, int32_t token);  // Appends the new text of token to text_
+
+  std::shared_ptr<const Tokenizer> tokenizer_;
+  std::vector<int32_t> anchors_;  // Tokens of plain text that pieces are decoded after
+  std::vector<std::string> anchor_texts_;
+  std::vector<Piece> pieces_;  // Indexed by token id
+  std::string piece_text_;
+  size_t options_version_{};  // Options version of the tokenizer the table was decoded with
+  std::unordered_map<uint64_t, Stream> streams_;
+
+  std::string text_;
+  std::vector<size_t> offsets_;
+};
+
+/*
+ * ChatEncoder applies the chat template to conversations and tokenizes the result, for conversations that grow by a
+ * few messages every turn. The rendered text and token ids of each conversation are cached under the hash of its
+ * messages, so when the messages continue a cached conversation only the text after its cached prefix is tokenized.
+ *
+ * Tokens can merge across the seam between the cached prefix and the new text, so the new text is tokenized together
+ * with the end of the prefix, and the cached ids are only reused when that tokenization splits exactly at the seam.
+ * Otherwise the whole text is tokenized again.
+ *
+ * All methods are thread safe.
+ */
+struct ChatEncoder : LeakChecked<ChatEncoder> {
+  ChatEncoder(const Tokenizer& tokenizer, size_t max_conversations);
+
+  std::vector<int32_t> Encode(const char* template_str, const char* messages, const char* tools, bool add_generation_prompt);
+
+ private:
+  struct Conversation {
+    std::string text;
+    std::vector<int32_t> tokens;
+  };
+
+  // Appends the tokens of the text after the conversation's text, which text starts with. Returns false if a token crosses the seam.
+  bool Continue(Conversation& conversation, const std::string& text) const;
+
+  std::shared_ptr<const Tokenizer> tokenizer_;
+  size_t max_conversations_;
+
+  std::mutex mutex_;
+  std::list<std::pair<uint64_t, Conversation>> conversations_;  // Most recently used first, keyed by the hash of their messages
+  std::unordered_map<uint64_t, std::list<std::pair<uint64_t, Conversation>>::iterator> conversations_by_hash_;
+};
+
 // Turn an array of ragged token sequences into a 2D input suitable for batching. Handles padding for the model
 // Sequence length is vector.size()/count
 std::vector<int32_t> PadInputs(std::span<std::span<const int32_t>> sequences, int32_t pad_token_id);
@@ -91,12 +201,16 @@ struct Tokenizer : std::enable_shared_from_this<Tokenizer>, LeakChecked<Tokenize
 
   std::vector<int32_t> EncodeBatch(std::span<const std::string> strings) const;
   std::shared_ptr<Tensor> EncodeBatch(std::span<const char*> strings) const;
+  // Returns the token ids of all the strings one after the other, and the count + 1 offsets where each string's ids start
+  std::pair<std::shared_ptr<Tensor>, std::shared_ptr<Tensor>> EncodeBatchRagged(std::span<const char*> strings) const;
   std::vector<std::string> DecodeBatch(std::span<const int32_t> sequences, size_t count) const;
 
   int32_t TokenToTokenId(const char* token) const;
   int32_t GetBosTokenId() const { return bos_token_id_; }
   const std::vector<int32_t>& GetEosTokenIds() const { return eos_token_id_; }
   int32_t GetPadTokenId() const { return pad_token_id_; }
+  // Changes whenever UpdateOptions is called, so that text decoded with the previous options can be dropped
+  size_t GetOptionsVersion() const { return options_version_; }
 
   OrtxPtr<OrtxTokenizer> tokenizer_;
 
@@ -104,10 +218,11 @@ struct Tokenizer : std::enable_shared_from_this<Tokenizer>, LeakChecked<Tokenize
   int32_t bos_token_id_;
   std::vector<int32_t> eos_token_id_;
   int32_t pad_token_id_;
+  size_t options_version_{};
 };
 
 struct MultiModalProcessor : std::enable_shared_from_this<MultiModalProcessor>, ExternalRefCounted<MultiModalProcessor> {
-  MultiModalProcessor(Config& config, const SessionInfo& session_info);
+  MultiModalProcessor(Config& config, const SessionInfo& session_info, std::shared_ptr<VisionCache> vision_cache = {});
 
   std::unique_ptr<NamedTensors> Process(const std::string& prompt, const Images* images, const Audios* audios) const;
   std::unique_ptr<NamedTensors> Process(std::span<const char*> prompts, const Images* images, const Audios* audios) const;
@@ -116,7 +231,11 @@ struct MultiModalProcessor : std::enable_shared_from_this<MultiModalProcessor>,
   std::shared_ptr<Processor> processor_;
 
  private:
+  std::unique_ptr<NamedTensors> Process(Payload& payload) const;
+
   std::unordered_map<std::string, std::function<std::shared_ptr<Processor>(Config&, const SessionInfo&)>> processor_factory_;
+  std::shared_ptr<VisionCache> vision_cache_;
+  uint64_t processor_key_{};  // Hash of the model type and image processor configuration, which the cached results depend on
 };
 
 struct SessionInfo {
@@ -160,6 +279,12 @@ struct Model : std::enable_shared_from_this<Model>, LeakChecked<Model>, External
 
   bool IsPruned() const;
 
+  // Returns the named statistic of the prompt or vision cache, such as "prompt_cache_hits". Throws if it is not known.
+  double GetStatistic(std::string_view name) const;
+
+  // Returns the size of the weights and of the prompt and vision caches
+  MemoryUsage GetMemoryUsage() const;
+
   std::unique_ptr<Config> config_;
   std::unique_ptr<OrtSessionOptions> session_options_;
 
@@ -172,6 +297,10 @@ struct Model : std::enable_shared_from_this<Model>, LeakChecked<Model>, External
 
   SessionInfo session_info_;
 
+  std::unique_ptr<PromptCache> prompt_cache_;  // Set when config_->prompt_cache.max_bytes > 0
+  std::shared_ptr<VisionCache> vision_cache_;  // Set when config_->vision_cache.max_bytes > 0, shared with the multi-modal processors
+  size_t weights_size_in_bytes_{};             // Size of the model files of all the sessions created by CreateSession
+
   /// Create session options from config. Public so components like VAD can create
   /// properly configured sessions using the GenAI infrastructure.
   void CreateSessionOptionsFromConfig(const Config::SessionOptions& config_session_options,
@@ -3,6 +3,7 @@
 
 #include "../generators.h"
 #include "multi_modal.h"
+#include "vision_runs.h"
 #include <numeric>
 
 namespace Generators {
@@ -138,6 +139,17 @@ void VisionState::SetExtraInputs(const std::vector<ExtraInput>& extra_inputs, co
                                                          num_images_, num_image_tokens_);
   image_features_->Add();
   extra_inputs_.Add(extra_inputs, model_.vision_session_->GetInputNames());
+
+  features_key_.reset();
+  if (model_.vision_cache_) {
+    for (const auto& extra_input : extra_inputs) {
+      if (extra_input.name == Config::Defaults::VisionCacheKeyName) {
+        // The processor keyed the preprocessing result of the same images with it, rehash it to key the features
+        const auto images_key = static_cast<uint64_t>(*extra_input.tensor->ort_tensor_->GetTensorData<int64_t>());
+        features_key_ = HashContent(&images_key, sizeof(images_key));
+      }
+    }
+  }
 }
 
 DeviceSpan<float> VisionState::Run(int current_length, DeviceSpan<int32_t>& next_tokens, DeviceSpan<int32_t> next_indices) {
@@ -145,23 +157,65 @@ DeviceSpan<float> VisionState::Run(int current_length, DeviceSpan<int32_t>& next
     State::SetRunOptions(model_.config_->model.vision.run_options.value());
   }
 
-  State::Run(*model_.vision_session_);
+  if (features_key_ && CopyCachedFeatures())
+    return {};
+
+  RunVisionSession();
+  if (features_key_)
+    CacheFeatures();
   return {};
 }
 
+void VisionState::RunVisionSession() {
+  State::Run(*model_.vision_session_);
+}
+
+namespace {
+
+// The image features of some images, kept on the device they were computed on
+struct CachedImageFeatures : VisionCacheEntry {
+  size_t SizeInBytes() const override { return size_in_bytes_; }
+
+  std::unique_ptr<OrtValue> features_;
+  size_t size_in_bytes_{};
+};
+
+}  // namespace
+
+bool VisionState::CopyCachedFeatures() {
+  auto entry = std::dynamic_pointer_cast<const CachedImageFeatures>(model_.vision_cache_->Lookup(*features_key_));
+  if (!entry)
+    return false;
+
+  auto features = ByteWrapTensor(*model_.p_device_, *image_features_->Get());
+  if (features.size() != entry->size_in_bytes_)
+    return false;  // Only happens on a hash collision between images with different numbers of image tokens
+
+  features.CopyFrom(ByteWrapTensor(*model_.p_device_, *entry->features_));
+  return true;
+}
+
+void VisionState::CacheFeatures() {
+  auto& features = *image_features_->Get();
+  auto type_and_shape = features.GetTensorTypeAndShapeInfo();
+
+  auto entry = std::make_shared<CachedImageFeatures>();
+  entry->features_ = OrtValue::CreateTensor(model_.p_device_->GetAllocator(), type_and_shape->GetShape(), type_and_shape->GetElementType());
+  auto cached = ByteWrapTensor(*model_.p_device_, *entry->features_);
+  cached.CopyFrom(ByteWrapTensor(*model_.p_device_, features));
+  entry->size_in_bytes_ = cached.size();
+  model_.vision_cache_->Insert(*features_key_, std::move(entry));
+}
+
 // ---------------------------------------------------------------------------
 // QwenVisionState: per-image slicing loop
 // ---------------------------------------------------------------------------
 
-DeviceSpan<float> QwenVisionState::Run(int current_length, DeviceSpan<int32_t>& next_tokens, DeviceSpan<int32_t> next_indices) {
-  if (model_.config_->model.vision.run_options.has_value()) {
-    State::SetRunOptions(model_.config_->model.vision.run_options.value());
-  }
-
+void QwenVisionState::RunVisionSession() {
   // Single image (or no image data): run the ONNX session directly.
   if (num_images_ <= 1) {
     State::Run(*model_.vision_session_);
-    return {};
+    return;
   }
 
   // Multi-image: vision.onnx is exported for exactly one image at a time.
@@ -189,7 +243,7 @@ DeviceSpan<float> QwenVisionState::Run(int current_length, DeviceSpan<int32_t>&
   if (pv_idx == SIZE_MAX || grid_idx == SIZE_MAX) {
     // Couldn't find expected inputs – fall back to single Run.
     State::Run(*model_.vision_session_);
-    return {};
+    return;
   }
 
   OrtValue* grid_full = inputs_[grid_idx];
@@ -230,10 +284,10 @@ DeviceSpan<float> QwenVisionState::Run(int current_length, DeviceSpan<int32_t>&
     // same grid.  Pass all N images' pixel_values and the full [N, 3]
     // grid_thw in one call — the ONNX graph was vectorized to handle this.
     State::Run(*model_.vision_session_);
-    return {};
+    return;
   }
 
-  // --- Per-image loop path (fallback for different-sized images or static models) ---
+  // --- Per-image (or packed) loop path (fallback for different-sized images or static models) ---
   OrtValue* pv_full = inputs_[pv_idx];
   OrtValue* feat_full = outputs_[0];  // pre-allocated image_features output
 
@@ -271,92 +325,72 @@ DeviceSpan<float> QwenVisionState::Run(int current_length, DeviceSpan<int32_t>&
 
   auto cpu_mem = OrtMemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
 
-  int64_t total_patches = pv_shape[0];
-  int64_t total_feats = feat_shape[0];
-  int64_t merge_sq = spatial_merge_size * spatial_merge_size;
-
-  // Detect temporal padding: processor may produce more rows than sum(t*h*w)
-  int64_t total_grid_tokens = 0;
-  int64_t total_hw = 0;
-  for (int64_t img = 0; img < num_images_; ++img) {
-    total_grid_tokens += grid_data[img * 3] * grid_data[img * 3 + 1] * grid_data[img * 3 + 2];
-    total_hw += grid_data[img * 3 + 1] * grid_data[img * 3 + 2];
-  }
-  bool temporal_padded = (total_patches != total_grid_tokens && total_hw > 0 && total_patches % total_hw == 0);
-  int64_t hw_multiplier = temporal_padded ? (total_patches / total_hw) : 0;
-
-  // Validate that the pre-allocated output buffer is large enough for all images
-  int64_t expected_total_feats = total_grid_tokens / merge_sq;
-  if (total_feats < expected_total_feats)
-    throw std::runtime_error("pre-allocated image_features dim 0 (" + std::to_string(total_feats) +
-                             ") is smaller than expected (" + std::to_string(expected_total_feats) +
-                             ") for " + std::to_string(num_images_) + " images");
-
-  int64_t patch_offset = 0;
-  int64_t feat_offset = 0;
-  for (int64_t img = 0; img < num_images_; ++img) {
-    int64_t t = grid_data[img * 3];
-    int64_t h = grid_data[img * 3 + 1];
-    int64_t w = grid_data[img * 3 + 2];
-    int64_t grid_tokens = t * h * w;
-    int64_t num_patches = temporal_padded ? (hw_multiplier * h * w) : grid_tokens;
-    int64_t num_feats = grid_tokens / merge_sq;
-
-    if (grid_tokens % merge_sq != 0)
-      throw std::runtime_error("grid tokens (" + std::to_string(grid_tokens) +
-                               ") is not divisible by spatial_merge_size^2 (" +
-                               std::to_string(merge_sq) + ") for image " + std::to_string(img));
-    if (patch_offset + num_patches > total_patches)
-      throw std::runtime_error("patch_offset (" + std::to_string(patch_offset) + ") + num_patches (" +
-                               std::to_string(num_patches) + ") exceeds pixel_values dim 0 (" +
-                               std::to_string(total_patches) + ")");
-    if (feat_offset + num_feats > total_feats)
-      throw std::runtime_error("feat_offset (" + std::to_string(feat_offset) + ") + num_feats (" +
-                               std::to_string(num_feats) + ") exceeds image_features dim 0 (" +
-                               std::to_string(total_feats) + ")");
-
-    // Create non-owning sub-tensors (zero-copy views into the original buffers).
-    std::vector<int64_t> sub_pv_shape = {num_patches, patch_dim};
-    std::vector<int64_t> sub_grid_shape = {1LL, 3LL};  // vision.onnx expects [1, 3] per image
-    std::vector<int64_t> sub_feat_shape = {num_feats, hidden_size};
-
-    auto sub_pv = OrtValue::CreateTensor(
+  // Split the images into runs of vision.onnx, packing consecutive images of the same size, see SplitVisionRuns
+  std::vector<VisionRun> runs = SplitVisionRuns(grid_data, num_images_, pv_shape[0], feat_shape[0], spatial_merge_size,
+                                                model_.config_->model.vision.max_packed_patches);
+
+  // Create non-owning sub-tensors (zero-copy views into the original buffers) for every run.
+  std::vector<std::unique_ptr<OrtValue>> sub_pvs, sub_grids, sub_feats;
+  for (auto& run : runs) {
+    std::vector<int64_t> sub_pv_shape = {run.num_patches, patch_dim};
+    std::vector<int64_t> sub_grid_shape = {1LL, 3LL};  // vision.onnx expects [1, 3] per run
+    std::vector<int64_t> sub_feat_shape = {run.num_feats, hidden_size};
+
+    sub_pvs.push_back(OrtValue::CreateTensor(
         *cpu_mem,
-        static_cast<uint8_t*>(pv_raw) + static_cast<size_t>(patch_offset * patch_dim) * pv_element_size,
-        static_cast<size_t>(num_patches * patch_dim) * pv_element_size,
-        std::span<const int64_t>(sub_pv_shape), pv_type);
+        static_cast<uint8_t*>(pv_raw) + static_cast<size_t>(run.patch_offset * patch_dim) * pv_element_size,
+        static_cast<size_t>(run.num_patches * patch_dim) * pv_element_size,
+        std::span<const int64_t>(sub_pv_shape), pv_type));
 
-    auto sub_grid = OrtValue::CreateTensor(
+    sub_grids.push_back(OrtValue::CreateTensor(
         *cpu_mem,
-        const_cast<void*>(static_cast<const void*>(grid_data + img * 3)),
+        run.grid,
         3 * sizeof(int64_t),
         std::span<const int64_t>(sub_grid_shape),
-        ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64);
+        ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64));
 
-    auto sub_feat = OrtValue::CreateTensor(
+    sub_feats.push_back(OrtValue::CreateTensor(
         *cpu_mem,
-        static_cast<uint8_t*>(feat_raw) + static_cast<size_t>(feat_offset * hidden_size) * feat_element_size,
-        static_cast<size_t>(num_feats * hidden_size) * feat_element_size,
-        std::span<const int64_t>(sub_feat_shape), feat_type);
+        static_cast<uint8_t*>(feat_raw) + static_cast<size_t>(run.feat_offset * hidden_size) * feat_element_size,
+        static_cast<size_t>(run.num_feats * hidden_size) * feat_element_size,
+        std::span<const int64_t>(sub_feat_shape), feat_type));
+  }
+
+  // The runs write to disjoint slices of image_features, so they can be in flight at once. Each task runs every
+  // num_tasks-th run with its own input and output arrays, as the State's arrays are shared, and the bookkeeping of
+  // State::Run is done once around all the runs. Other outputs than image_features would be shared by the runs too,
+  // so those models run one at a time.
+  const size_t num_tasks = std::min(runs.size(), static_cast<size_t>(std::max(model_.config_->model.vision.max_concurrent_runs, 1)));
+  if (num_tasks > 1 && model_.vision_session_->GetOutputNames().size() == 1) {
+    BeginRun(*model_.vision_session_);
+    GetThreadPool().ParallelFor(num_tasks, [&](size_t task) {
+      std::vector<OrtValue*> inputs = inputs_;
+      std::vector<OrtValue*> outputs = outputs_;
+      for (size_t i = task; i < runs.size(); i += num_tasks) {
+        inputs[pv_idx] = sub_pvs[i].get();
+        inputs[grid_idx] = sub_grids[i].get();
+        outputs[0] = sub_feats[i].get();
+        model_.vision_session_->Run(run_options_.get(), input_names_.data(), inputs.data(), input_names_.size(),
+                                    output_names_.data(), outputs.data(), output_names_.size());
+      }
+    });
+    EndRun();
+    return;
+  }
 
-    // Temporarily point the State's inputs/output to the per-image slices,
-    // run the session, then advance offsets.
-    inputs_[pv_idx] = sub_pv.get();
-    inputs_[grid_idx] = sub_grid.get();
-    outputs_[0] = sub_feat.get();
+  for (size_t i = 0; i < runs.size(); ++i) {
+    // Temporarily point the State's inputs/output to the slices of the run.
+    inputs_[pv_idx] = sub_pvs[i].get();
+    inputs_[grid_idx] = sub_grids[i].get();
+    outputs_[0] = sub_feats[i].get();
 
     State::Run(*model_.vision_session_);
-
-    patch_offset += num_patches;
-    feat_offset += num_feats;
   }
 
   // Restore original pointers so the State remains valid after this call.
   inputs_[pv_idx] = pv_full;
   inputs_[grid_idx] = grid_full;
   outputs_[0] = feat_full;
-
-  return {};
 }
 
 // ---------------------------------------------------------------------------
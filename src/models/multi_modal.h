@@ -34,6 +34,8 @@ struct MultiModalLanguageModel : Model {
 
 // Base VisionState: runs vision.onnx with a single State::Run() call.
 // Works for models whose vision encoder accepts batched input (Phi, Gemma).
+// When the model has a vision cache and the processor keyed the images in it, the image features are
+// copied from the cache instead of running vision.onnx again for the same images.
 struct VisionState : State {
   VisionState(const MultiModalLanguageModel& model, const GeneratorParams& params);
   VisionState(const VisionState&) = delete;
@@ -45,11 +47,18 @@ struct VisionState : State {
  protected:
   friend struct MultiModalPipelineState;
 
+  // Runs vision.onnx to fill image_features_
+  virtual void RunVisionSession();
+
+  bool CopyCachedFeatures();  // Returns false if the features of the images are not cached
+  void CacheFeatures();
+
   const MultiModalLanguageModel& model_;
   int64_t num_image_tokens_;
   int64_t num_images_{};
   ExtraInputs extra_inputs_{*this};  // Model inputs
   std::unique_ptr<MultiModalFeatures> image_features_;
+  std::optional<uint64_t> features_key_;  // Key of the image features in the vision cache, if they are cached
 };
 
 // QwenVisionState: per-image slicing loop for Qwen2.5-VL / Qwen3-VL.
@@ -59,11 +68,14 @@ struct VisionState : State {
 // works for that exact N).  This subclass iterates over images in C++,
 // creating zero-copy sub-tensor views of pixel_values / image_grid_thw and
 // writing each result into the correct offset of the pre-allocated
-// image_features output buffer.
+// image_features output buffer.  Consecutive same-sized images can be
+// packed into one run and the runs can be in flight concurrently, see
+// max_packed_patches and max_concurrent_runs in Config::Model::Vision.
 struct QwenVisionState : VisionState {
   using VisionState::VisionState;  // inherit constructor
 
-  DeviceSpan<float> Run(int current_length, DeviceSpan<int32_t>& next_tokens, DeviceSpan<int32_t> next_indices = {}) override;
+ protected:
+  void RunVisionSession() override;
 };
 
 // Factory: pick the right VisionState subclass based on model type.
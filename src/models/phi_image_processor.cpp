@@ -106,17 +106,17 @@ std::unique_ptr<NamedTensors> PhiImageProcessor::Process(const Tokenizer& tokeni
     return named_tensors;
   }
 
-  ort_extensions::OrtxObjectPtr<OrtxTensorResult> result;
-  CheckResult(OrtxImagePreProcess(processor_.get(), images->images_.get(), result.ToBeAssigned()));
+  const auto preprocessed = PreprocessImages(processor_.get(), payload);
+  OrtxTensorResult* result = preprocessed->result_.get();
 
   OrtxTensor* pixel_values = nullptr;
-  CheckResult(OrtxTensorResultGetAt(result.get(), 0, &pixel_values));
+  CheckResult(OrtxTensorResultGetAt(result, 0, &pixel_values));
 
   OrtxTensor* image_sizes = nullptr;
-  CheckResult(OrtxTensorResultGetAt(result.get(), 1, &image_sizes));
+  CheckResult(OrtxTensorResultGetAt(result, 1, &image_sizes));
 
   OrtxTensor* num_img_tokens = nullptr;
-  CheckResult(OrtxTensorResultGetAt(result.get(), 2, &num_img_tokens));
+  CheckResult(OrtxTensorResultGetAt(result, 2, &num_img_tokens));
 
   named_tensors->emplace(std::string(Config::Defaults::InputIdsName),
                          std::make_shared<Tensor>(ProcessImagePrompt(tokenizer, prompt, num_img_tokens, allocator)));
@@ -127,15 +127,15 @@ std::unique_ptr<NamedTensors> PhiMultiModalProcessor::Process(const Tokenizer& t
   Ort::Allocator& allocator{Ort::Allocator::GetWithDefaultOptions()};
   auto named_tensors = std::make_unique<NamedTensors>();
 
-  ort_extensions::OrtxObjectPtr<OrtxTensorResult> image_result;
+  std::shared_ptr<const PreprocessedImages> image_result;
   OrtxTensor *pixel_values{}, *image_sizes{}, *image_attention_mask{}, *num_img_tokens{};
   if (payload.images) {
-    CheckResult(OrtxImagePreProcess(image_processor_.get(), payload.images->images_.get(), image_result.ToBeAssigned()));
+    image_result = PreprocessImages(image_processor_.get(), payload);
 
-    CheckResult(OrtxTensorResultGetAt(image_result.get(), 0, &pixel_values));
-    CheckResult(OrtxTensorResultGetAt(image_result.get(), 1, &image_sizes));
-    CheckResult(OrtxTensorResultGetAt(image_result.get(), 2, &image_attention_mask));
-    CheckResult(OrtxTensorResultGetAt(image_result.get(), 3, &num_img_tokens));
+    CheckResult(OrtxTensorResultGetAt(image_result->result_.get(), 0, &pixel_values));
+    CheckResult(OrtxTensorResultGetAt(image_result->result_.get(), 1, &image_sizes));
+    CheckResult(OrtxTensorResultGetAt(image_result->result_.get(), 2, &image_attention_mask));
+    CheckResult(OrtxTensorResultGetAt(image_result->result_.get(), 3, &num_img_tokens));
   }
 
   ort_extensions::OrtxObjectPtr<OrtxTensorResult> audio_result;
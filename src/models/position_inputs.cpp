@@ -380,21 +380,18 @@ void DefaultPositionInputs::InitializeSequenceLengths(std::array<int64_t, 2> sha
 }
 
 void DefaultPositionInputs::RewindMask(size_t index) {
-  if (state_.params_->use_graph_capture) {
-    throw std::runtime_error("PositionInputs::RewindMask - Static buffer is not supported for continuous decoding.");
-#if 0  // TODO: Fix implementation, cudaMemsetAsync of 1 is setting bytes of 1 vs int32's of 1
-    int past_length = static_cast<int>(index);
-    int max_length = static_cast<int>(state_.params_->search.max_length);
-    cudaMemsetAsync(attention_mask_->GetTensorMutableRawData(),
-                    0,
-                    (type_ == Ort::TypeToTensorType<int32_t> ? sizeof(int32_t) : sizeof(int64_t)) * max_length,
-                    model_.cuda_stream_);
-    cudaMemsetAsync(attention_mask_->GetTensorMutableRawData(),
-                    1,
-                    (type_ == Ort::TypeToTensorType<int32_t> ? sizeof(int32_t) : sizeof(int64_t)) * past_length,
-                    model_.cuda_stream_);
-#endif
-  }
+  // A dynamic mask is recreated for the total length on the next update, so only a static mask needs rewinding.
+  // It keeps its max_length buffer and only the positions from index on are cleared.
+  if (!ShouldUseStaticMaskHandling())
+    return;
+
+  const size_t element_size = Ort::SizeOf(type_);
+  auto mask = attention_mask_->GetByteSpan();
+  auto cpu_mask = mask.CopyDeviceToCpu();
+  if (index * element_size > cpu_mask.size())
+    throw std::runtime_error("PositionInputs::RewindMask - Requested length of rewind is greater than max_length.");
+  std::fill(cpu_mask.begin() + index * element_size, cpu_mask.end(), uint8_t{0});
+  mask.CopyCpuToDevice();
 }
 
 bool DefaultPositionInputs::ShouldUseStaticMaskHandling() const {
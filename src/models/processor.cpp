@@ -19,7 +19,8 @@ std::unique_ptr<Images> LoadImages(std::span<const char* const> image_paths) {
   size_t num_images{};
   CheckResult(OrtxLoadImages(images.ToBeAssigned(), const_cast<const char**>(image_paths.data()), image_paths.size(), &num_images));
 
-  return std::make_unique<Images>(std::move(images), num_images);
+  // The files are only hashed if the images are looked up in a vision cache, see Images::Hashes
+  return std::make_unique<Images>(std::move(images), num_images, std::vector<std::string>(image_paths.begin(), image_paths.end()));
 }
 
 std::unique_ptr<Images> LoadImagesFromBuffers(std::span<const void*> image_data,
@@ -30,13 +31,76 @@ std::unique_ptr<Images> LoadImagesFromBuffers(std::span<const void*> image_data,
     throw std::runtime_error("Number of image data buffers does not match the number of image data sizes");
 
   std::vector<int64_t> sizes;
-  for (size_t i = 0; i < image_data_sizes.size(); ++i)
+  for (size_t i = 0; i < image_data_sizes.size(); ++i) {
     sizes.push_back(image_data_sizes[i]);
+  }
 
   ort_extensions::OrtxObjectPtr<OrtxRawImages> images;
   CheckResult(OrtxCreateRawImages(images.ToBeAssigned(), image_data.data(), sizes.data(), image_data.size()));
 
-  return std::make_unique<Images>(std::move(images), image_data.size());
+  // The buffers belong to the caller and are gone by the time the images are looked up in a vision cache, so they
+  // are hashed now. That is a small cost next to decoding them, unlike reading image files a second time.
+  std::vector<uint64_t> hashes;
+  for (size_t i = 0; i < image_data.size(); ++i) {
+    hashes.push_back(HashContent(image_data[i], image_data_sizes[i]));
+  }
+
+  return std::make_unique<Images>(std::move(images), image_data.size(), std::vector<std::string>{}, std::move(hashes));
+}
+
+const std::vector<uint64_t>& Images::Hashes() const {
+  std::call_once(hashes_once_, [this] {
+    if (!hashes_.empty() || paths_.size() != num_images_)
+      return;
+    std::vector<uint64_t> hashes;
+    for (const auto& path : paths_)
+      hashes.push_back(HashFile(fs::path(path)));
+    hashes_ = std::move(hashes);
+  });
+  return hashes_;
+}
+
+uint64_t HashFile(const fs::path& path, uint64_t seed) {
+  std::ifstream file = path.open(std::ios::binary | std::ios::ate);
+  if (!file.is_open())
+    throw std::runtime_error("Error opening " + path.string());
+  std::vector<char> buffer(static_cast<size_t>(file.tellg()));
+  file.seekg(0, std::ios::beg);
+  if (!file.read(buffer.data(), static_cast<std::streamsize>(buffer.size())))
+    throw std::runtime_error("Error reading " + path.string());
+
+  return HashContent(buffer.data(), buffer.size(), seed);
+}
+
+PreprocessedImages::PreprocessedImages(ort_extensions::OrtxObjectPtr<OrtxTensorResult> result)
+    : result_{std::move(result)} {
+  // The element types of the tensors are not exposed, so they are counted as 4 bytes: the pixel values, which make up
+  // nearly all of the size, are floats.
+  OrtxTensor* tensor{};
+  for (size_t i = 0; OrtxTensorResultGetAt(result_.get(), i, &tensor) == kOrtxOK; i++) {
+    const void* data{};
+    const int64_t* shape{};
+    size_t num_dims{};
+    CheckResult(OrtxGetTensorData(tensor, &data, &shape, &num_dims));
+    size_t element_count = 1;
+    for (size_t dim = 0; dim < num_dims; dim++)
+      element_count *= static_cast<size_t>(shape[dim]);
+    size_in_bytes_ += element_count * sizeof(float);
+  }
+}
+
+std::shared_ptr<const PreprocessedImages> PreprocessImages(OrtxProcessor* processor, const Payload& payload) {
+  if (payload.vision_cache) {
+    if (auto entry = std::dynamic_pointer_cast<const PreprocessedImages>(payload.vision_cache->Lookup(payload.images_key)))
+      return entry;
+  }
+
+  ort_extensions::OrtxObjectPtr<OrtxTensorResult> result;
+  CheckResult(OrtxImagePreProcess(processor, payload.images->images_.get(), result.ToBeAssigned()));
+  auto preprocessed = std::make_shared<const PreprocessedImages>(std::move(result));
+  if (payload.vision_cache)
+    payload.vision_cache->Insert(payload.images_key, preprocessed);
+  return preprocessed;
 }
 
 std::unique_ptr<Audios> LoadAudios(const std::span<const char* const>& audio_paths) {
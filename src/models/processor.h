@@ -6,6 +6,7 @@
 #include "ortx_cpp_helper.h"
 #include "speech_extractor.h"
 #include "utils.h"
+#include "vision_cache.h"
 #include "../generators.h"
 #include "model.h"
 
@@ -13,13 +14,26 @@ namespace Generators {
 
 struct Images {
   Images() = delete;
-  Images(ort_extensions::OrtxObjectPtr<OrtxRawImages> images, size_t num_images)
-      : images_(std::move(images)), num_images_{num_images} {}
+  Images(ort_extensions::OrtxObjectPtr<OrtxRawImages> images, size_t num_images, std::vector<std::string> paths = {},
+         std::vector<uint64_t> hashes = {})
+      : images_(std::move(images)), num_images_{num_images}, paths_{std::move(paths)}, hashes_{std::move(hashes)} {}
+
+  // Returns the hash of the encoded bytes of every image, which keys them in the vision cache, or an empty vector if
+  // the images cannot be hashed. Images loaded from files are hashed on the first call, by reading the files again.
+  const std::vector<uint64_t>& Hashes() const;
 
   ort_extensions::OrtxObjectPtr<OrtxRawImages> images_;
   size_t num_images_{};
+
+ private:
+  std::vector<std::string> paths_;        // Files the images were loaded from, if they were
+  mutable std::vector<uint64_t> hashes_;  // Computed up front for images loaded from buffers, as the buffers are not kept
+  mutable std::once_flag hashes_once_;
 };
 
+// Returns the HashContent of the contents of a file
+uint64_t HashFile(const fs::path& path, uint64_t seed = 0);
+
 std::unique_ptr<Images> LoadImages(std::span<const char* const> image_paths);
 std::unique_ptr<Images> LoadImagesFromBuffers(std::span<const void*> image_data, std::span<const size_t> image_data_sizes);
 
@@ -43,8 +57,24 @@ struct Payload {
   std::span<const char*> prompts;
   const Images* images;
   const Audios* audios;
+  VisionCache* vision_cache{};  // Set when the preprocessing results of the images are cached
+  uint64_t images_key{};        // Key of the images in vision_cache, from their hashes and the processor configuration
+};
+
+// The preprocessing result of some images, as cached in the vision cache
+struct PreprocessedImages : VisionCacheEntry {
+  explicit PreprocessedImages(ort_extensions::OrtxObjectPtr<OrtxTensorResult> result);
+
+  size_t SizeInBytes() const override { return size_in_bytes_; }
+
+  ort_extensions::OrtxObjectPtr<OrtxTensorResult> result_;
+  size_t size_in_bytes_{};
 };
 
+// Runs the image preprocessing of processor on the images of the payload, or returns the cached result for the same
+// images when the payload has a vision cache. The result is shared with the cache, so it must not be modified.
+std::shared_ptr<const PreprocessedImages> PreprocessImages(OrtxProcessor* processor, const Payload& payload);
+
 struct Config;
 struct SessionInfo;
 
@@ -0,0 +1,212 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "prompt_cache.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace Generators {
+
+struct PromptCache::Node {
+  std::vector<int32_t> tokens;  // Tokens on the edge from the parent
+  Node* parent{};
+  std::map<int32_t, std::unique_ptr<Node>> children;  // Keyed by the first token of the child's edge
+
+  std::shared_ptr<const PromptCacheEntry> entry;
+  std::list<Node*>::iterator lru_position;  // Valid when entry is set
+  size_t pin_count{};
+};
+
+PromptCache::PromptCache(size_t max_bytes, size_t min_length)
+    : max_bytes_{max_bytes}, min_length_{std::max<size_t>(min_length, 1)}, root_{std::make_unique<Node>()} {}
+
+PromptCache::~PromptCache() = default;
+
+PromptCache::Node& PromptCache::FindOrAddNode(std::span<const int32_t> all_tokens) {
+  Node* node = root_.get();
+  for (size_t offset = 0; offset < all_tokens.size();) {
+    const auto tokens = all_tokens.subspan(offset, all_tokens.size() - offset);
+    auto it = node->children.find(tokens[0]);
+    if (it == node->children.end()) {
+      auto child = std::make_unique<Node>();
+      child->tokens.assign(tokens.begin(), tokens.end());
+      child->parent = node;
+      return *(node->children[tokens[0]] = std::move(child));
+    }
+
+    Node* child = it->second.get();
+    const auto mismatch = std::mismatch(child->tokens.begin(), child->tokens.end(), tokens.begin(), tokens.end());
+    const size_t common = static_cast<size_t>(mismatch.first - child->tokens.begin());
+    if (common < child->tokens.size()) {
+      // Split the edge, the new node takes the common tokens and the child keeps the rest
+      auto middle = std::make_unique<Node>();
+      middle->tokens.assign(child->tokens.begin(), child->tokens.begin() + common);
+      middle->parent = node;
+      child->tokens.erase(child->tokens.begin(), child->tokens.begin() + common);
+      child->parent = middle.get();
+      middle->children[child->tokens[0]] = std::move(it->second);
+      it->second = std::move(middle);
+      child = it->second.get();
+    }
+    node = child;
+    offset += common;
+  }
+  return *node;
+}
+
+PromptCache::Node* PromptCache::FindNode(std::span<const int32_t> tokens) const {
+  Node* node = root_.get();
+  for (size_t offset = 0; offset < tokens.size();) {
+    auto it = node->children.find(tokens[offset]);
+    if (it == node->children.end())
+      return nullptr;
+    Node* child = it->second.get();
+    if (child->tokens.size() > tokens.size() - offset ||
+        !std::equal(child->tokens.begin(), child->tokens.end(), tokens.begin() + offset))
+      return nullptr;
+    node = child;
+    offset += child->tokens.size();
+  }
+  return node;
+}
+
+std::pair<std::shared_ptr<const PromptCacheEntry>, size_t> PromptCache::Lookup(std::span<const int32_t> all_tokens, size_t max_length) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  const auto tokens = all_tokens.subspan(0, std::min(all_tokens.size(), max_length));
+  Node* node = root_.get();
+  Node* best{};
+  size_t length{}, best_length{};
+  while (length < tokens.size()) {
+    auto it = node->children.find(tokens[length]);
+    if (it == node->children.end())
+      break;
+    Node* child = it->second.get();
+    if (child->tokens.size() > tokens.size() - length ||
+        !std::equal(child->tokens.begin(), child->tokens.end(), tokens.begin() + length))
+      break;
+    node = child;
+    length += child->tokens.size();
+    if (node->entry) {
+      best = node;
+      best_length = length;
+    }
+  }
+
+  if (!best) {
+    stats_.num_misses++;
+    return {nullptr, 0};
+  }
+
+  lru_.splice(lru_.begin(), lru_, best->lru_position);
+  stats_.num_hits++;
+  stats_.num_hit_tokens += best_length;
+  return {best->entry, best_length};
+}
+
+void PromptCache::Insert(std::span<const int32_t> tokens, std::shared_ptr<const PromptCacheEntry> entry) {
+  if (tokens.size() < min_length_ || !entry)
+    return;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (entry->SizeInBytes() > max_bytes_) {
+    // Caching it would evict every other entry, and then itself, unless it is pinned
+    const Node* node = FindNode(tokens);
+    if (!node || node->pin_count == 0)
+      return;
+  }
+
+  Node& node = FindOrAddNode(tokens);
+  if (node.entry)
+    RemoveEntry(node);
+
+  node.entry = std::move(entry);
+  lru_.push_front(&node);
+  node.lru_position = lru_.begin();
+  stats_.num_entries++;
+  stats_.size_in_bytes += node.entry->SizeInBytes();
+  EvictToBudget();
+}
+
+void PromptCache::Pin(std::span<const int32_t> tokens) {
+  if (tokens.empty())
+    throw std::runtime_error("Cannot pin an empty prompt");
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  FindOrAddNode(tokens).pin_count++;
+}
+
+void PromptCache::Unpin(std::span<const int32_t> tokens) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Node* node = tokens.empty() ? nullptr : FindNode(tokens);
+  if (!node || node->pin_count == 0)
+    throw std::runtime_error("Cannot unpin a prompt that is not pinned");
+
+  if (--node->pin_count == 0) {
+    RemoveIfUnused(node);
+    EvictToBudget();  // The entry may have been kept over the budget while it was pinned
+  }
+}
+
+void PromptCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = lru_.begin(); it != lru_.end();) {
+    Node* node = *it++;
+    if (node->pin_count == 0) {
+      RemoveEntry(*node);
+      RemoveIfUnused(node);
+    }
+  }
+}
+
+PromptCacheStats PromptCache::Stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void PromptCache::RemoveEntry(Node& node) {
+  stats_.num_entries--;
+  stats_.size_in_bytes -= node.entry->SizeInBytes();
+  lru_.erase(node.lru_position);
+  node.entry.reset();
+}
+
+void PromptCache::RemoveIfUnused(Node* node) {
+  while (node != root_.get() && !node->entry && node->pin_count == 0) {
+    Node* parent = node->parent;
+    const int32_t key = node->tokens[0];
+    auto& slot = parent->children[key];
+
+    if (node->children.empty()) {
+      parent->children.erase(key);
+      node = parent;  // The parent may now be unused too
+      continue;
+    }
+
+    if (node->children.size() == 1) {
+      // Merge the node into its only child, which takes its place under the parent
+      auto child = std::move(node->children.begin()->second);
+      child->tokens.insert(child->tokens.begin(), node->tokens.begin(), node->tokens.end());
+      child->parent = parent;
+      slot = std::move(child);
+    }
+    break;
+  }
+}
+
+void PromptCache::EvictToBudget() {
+  auto it = lru_.end();
+  while (stats_.size_in_bytes > max_bytes_ && it != lru_.begin()) {
+    Node* node = *--it;
+    if (node->pin_count != 0)
+      continue;
+
+    it = std::next(it);  // RemoveEntry erases the node from lru_, so keep the iterator after it
+    RemoveEntry(*node);
+    RemoveIfUnused(node);
+    stats_.num_evictions++;
+  }
+}
+
+}  // namespace Generators
@@ -0,0 +1,88 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stdint.h>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "../span.h"
+
+namespace Generators {
+
+// The state of a model after running a sequence of tokens, such as a snapshot of its key-value cache
+struct PromptCacheEntry {
+  virtual ~PromptCacheEntry() = default;
+
+  virtual size_t SizeInBytes() const = 0;
+};
+
+/*
+ * PromptCacheStats holds the counters of a PromptCache.
+ */
+struct PromptCacheStats {
+  size_t num_entries{};     // Number of cached prefixes
+  size_t size_in_bytes{};   // Total size of the cached entries
+  size_t num_hits{};        // Number of lookups that found a cached prefix
+  size_t num_misses{};      // Number of lookups that found none
+  size_t num_hit_tokens{};  // Total length of the prefixes found, which did not have to be run again
+  size_t num_evictions{};   // Number of entries evicted to stay within the memory budget
+};
+
+/*
+ * PromptCache keeps the model state after prompts that generators have run, so that generators of the same model
+ * whose prompts start with the same tokens (a chat template header, a system prompt, earlier turns of a chat)
+ * continue from the longest cached prefix instead of running it again.
+ *
+ * The prefixes are stored in a radix tree keyed by token ids: every node holds the tokens on the edge from its
+ * parent, and nodes where a prefix ends hold its entry. The entries are evicted least recently used first when
+ * their total size exceeds the memory budget. Pinned prefixes are never evicted.
+ *
+ * All methods are thread safe, the cache is shared by all the generators of a model.
+ */
+struct PromptCache {
+  PromptCache(size_t max_bytes, size_t min_length);
+  ~PromptCache();
+
+  // Returns the entry of the longest cached prefix of tokens that is at most max_length tokens long, and its length.
+  // Returns {nullptr, 0} if there is none.
+  std::pair<std::shared_ptr<const PromptCacheEntry>, size_t> Lookup(std::span<const int32_t> tokens, size_t max_length);
+
+  // Caches the entry of a prefix, replacing any previous entry of the same tokens. Prefixes shorter than min_length are not cached.
+  void Insert(std::span<const int32_t> tokens, std::shared_ptr<const PromptCacheEntry> entry);
+
+  // Keeps the entry of a prefix, or the entry it will get once inserted, from being evicted until it is unpinned.
+  // A prefix can be pinned several times and stays pinned until unpinned as many times.
+  void Pin(std::span<const int32_t> tokens);
+  void Unpin(std::span<const int32_t> tokens);
+
+  // Removes all the unpinned entries
+  void Clear();
+
+  PromptCacheStats Stats() const;
+
+ private:
+  struct Node;
+
+  // Returns the node of tokens, splitting an edge or adding a node if it does not exist yet
+  Node& FindOrAddNode(std::span<const int32_t> tokens);
+  Node* FindNode(std::span<const int32_t> tokens) const;
+
+  void RemoveEntry(Node& node);
+  void RemoveIfUnused(Node* node);  // Removes a node without an entry or pin, or merges it with its only child
+  void EvictToBudget();
+
+  size_t max_bytes_;
+  size_t min_length_;
+  std::unique_ptr<Node> root_;
+  std::list<Node*> lru_;  // Nodes with an entry, most recently used first
+  PromptCacheStats stats_;
+  mutable std::mutex mutex_;
+};
+
+}  // namespace Generators
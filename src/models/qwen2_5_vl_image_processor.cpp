@@ -197,15 +197,15 @@ std::unique_ptr<NamedTensors> QwenImageProcessor::Process(const Tokenizer& token
     return named_tensors;
   }
 
-  ort_extensions::OrtxObjectPtr<OrtxTensorResult> result;
-  CheckResult(OrtxImagePreProcess(processor_.get(), images->images_.get(), result.ToBeAssigned()));
+  const auto preprocessed = PreprocessImages(processor_.get(), payload);
+  OrtxTensorResult* result = preprocessed->result_.get();
 
   OrtxTensor* pixel_values = nullptr;
-  CheckResult(OrtxTensorResultGetAt(result.get(), 0, &pixel_values));
+  CheckResult(OrtxTensorResultGetAt(result, 0, &pixel_values));
 
   OrtxTensor* image_grid_thw = nullptr;
   // Try to get image_grid_thw from processor (second output)
-  auto status = OrtxTensorResultGetAt(result.get(), 1, &image_grid_thw);
+  auto status = OrtxTensorResultGetAt(result, 1, &image_grid_thw);
 
   // Get pixel_values data and shape
   const float* pixel_values_data{};
@@ -242,12 +242,14 @@ std::unique_ptr<NamedTensors> QwenImageProcessor::Process(const Tokenizer& token
 
     // Extract patches from single image in HWC format
     // Each spatial patch is replicated kTemporalPatchSize times
-    int64_t patch_idx = 0;
-    for (int64_t ph = 0; ph < height_patches; ++ph) {
+    // Every row of patches writes its own part of the output, so the rows are extracted in parallel
+    GetThreadPool().ParallelFor(static_cast<size_t>(height_patches), [&](size_t patch_row) {
+      const int64_t ph = static_cast<int64_t>(patch_row);
       for (int64_t pw = 0; pw < width_patches; ++pw) {
         int64_t h_start = ph * kPatchSize;
         int64_t w_start = pw * kPatchSize;
 
+        int64_t patch_idx = ph * width_patches + pw;
         int64_t write_idx = patch_idx * patch_dim;
 
         // Repeat the same spatial patch kTemporalPatchSize times
@@ -263,9 +265,8 @@ std::unique_ptr<NamedTensors> QwenImageProcessor::Process(const Tokenizer& token
             }
           }
         }
-        patch_idx++;
       }
-    }
+    });
 
     // Create image_grid_thw: [1, 3] for single image
     if (status != kOrtxOK || !image_grid_thw) {
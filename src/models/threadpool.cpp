@@ -3,20 +3,157 @@
 
 #include "threadpool.h"
 
+#include <algorithm>
+#include <optional>
+
 namespace Generators {
 
-ThreadPool::ThreadPool(size_t num_threads) : num_threads_{num_threads} {}
+namespace {
 
-void ThreadPool::Compute(const std::function<void(size_t)>& func) {
-  for (size_t i = 0; i < num_threads_; ++i) {
-    threads_.emplace_back([&, i] { func(i); });
+// The pool and queue owned by the current thread when it is a worker thread
+thread_local const void* current_pool{};
+thread_local size_t current_queue_index{};
+
+// Number of tasks per thread that a ParallelFor is split into, so that threads finishing early can steal the rest
+constexpr size_t tasks_per_thread = 4;
+
+}  // namespace
+
+ThreadPool::ThreadPool(size_t num_threads) : num_threads_{num_threads} {
+  for (size_t i = 0; i < num_threads_ + 1; ++i) {
+    queues_.push_back(std::make_unique<Queue>());
   }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::scoped_lock lock{wake_mutex_};
+    stop_ = true;
+  }
+  wake_cv_.notify_all();
 
   for (auto& thread : threads_) {
     thread.join();
   }
+}
+
+void ThreadPool::Start() {
+  for (size_t i = 0; i < num_threads_; ++i) {
+    threads_.emplace_back([this, i] { WorkerLoop(i); });
+  }
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& func) {
+  if (count == 0) {
+    return;
+  }
+
+  if (num_threads_ == 0 || count == 1) {
+    for (size_t i = 0; i < count; ++i) {
+      func(i);
+    }
+    return;
+  }
+
+  std::call_once(start_flag_, [this] { Start(); });
+
+  const size_t num_tasks = std::min(count, NumThreads() * tasks_per_thread);
+  Batch batch;
+  batch.func = &func;
+  batch.num_pending_tasks = num_tasks;
+
+  // Tasks are dealt round robin over the queues, starting with the queue of the calling thread
+  const size_t own_queue = current_pool == this ? current_queue_index : num_threads_;
+  {
+    std::scoped_lock lock{wake_mutex_};
+    num_queued_tasks_ += num_tasks;
+  }
+  for (size_t task = 0; task < num_tasks; ++task) {
+    auto& queue = *queues_[(own_queue + task) % queues_.size()];
+    std::scoped_lock lock{queue.mutex};
+    queue.tasks.push_back({&batch, task * count / num_tasks, (task + 1) * count / num_tasks});
+  }
+  wake_cv_.notify_all();
 
-  threads_.clear();
+  // Help with the work of this batch until none is queued, then wait for its tasks still running on other threads
+  while (batch.num_pending_tasks.load() != 0 && TryRunTask(own_queue, &batch)) {
+  }
+  {
+    std::unique_lock lock{batch.mutex};
+    batch.done_cv.wait(lock, [&batch] { return batch.num_pending_tasks.load() == 0; });
+  }
+
+  if (batch.error) {
+    std::rethrow_exception(batch.error);
+  }
+}
+
+bool ThreadPool::TryRunTask(size_t queue_index, const Batch* batch) {
+  std::optional<Task> task;
+  {
+    auto& queue = *queues_[queue_index];
+    std::scoped_lock lock{queue.mutex};
+    auto it = std::find_if(queue.tasks.rbegin(), queue.tasks.rend(), [batch](const Task& t) { return !batch || t.batch == batch; });
+    if (it != queue.tasks.rend()) {
+      task = *it;
+      queue.tasks.erase(std::next(it).base());
+    }
+  }
+
+  for (size_t i = 1; !task && i < queues_.size(); ++i) {
+    auto& queue = *queues_[(queue_index + i) % queues_.size()];
+    std::scoped_lock lock{queue.mutex};
+    auto it = std::find_if(queue.tasks.begin(), queue.tasks.end(), [batch](const Task& t) { return !batch || t.batch == batch; });
+    if (it != queue.tasks.end()) {
+      task = *it;
+      queue.tasks.erase(it);
+    }
+  }
+
+  if (!task) {
+    return false;
+  }
+
+  --num_queued_tasks_;
+  RunTask(*task);
+  return true;
+}
+
+void ThreadPool::RunTask(const Task& task) {
+  Batch& batch = *task.batch;
+  try {
+    for (size_t i = task.begin; i < task.end; ++i) {
+      (*batch.func)(i);
+    }
+  } catch (...) {
+    std::scoped_lock lock{batch.mutex};
+    if (!batch.error) {
+      batch.error = std::current_exception();
+    }
+  }
+
+  // The last task notifies under the lock, since the batch lives on the stack of the waiting thread
+  std::scoped_lock lock{batch.mutex};
+  if (--batch.num_pending_tasks == 0) {
+    batch.done_cv.notify_all();
+  }
+}
+
+void ThreadPool::WorkerLoop(size_t worker_index) {
+  current_pool = this;
+  current_queue_index = worker_index;
+
+  while (true) {
+    if (TryRunTask(worker_index)) {
+      continue;
+    }
+
+    std::unique_lock lock{wake_mutex_};
+    wake_cv_.wait(lock, [this] { return stop_ || num_queued_tasks_.load() != 0; });
+    if (stop_) {
+      return;
+    }
+  }
 }
 
-}  // namespace Generators
\ No newline at end of file
+}  // namespace Generators
@@ -1,20 +1,79 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT License.
 
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <thread>
 
 namespace Generators {
 
+/*
+ * ThreadPool is a persistent pool of worker threads shared by the CPU work of a process, such as
+ * sampling, logits processing and multimodal preprocessing. The threads are started on first use
+ * and live until the pool is destroyed.
+ *
+ * Work is split into tasks that are pushed onto per worker queues. A worker takes tasks from the
+ * back of its own queue and, when that is empty, steals from the front of the other queues.
+ * The thread that calls ParallelFor runs tasks too while it waits, so ParallelFor may be called
+ * from inside a task without deadlocking.
+ */
 struct ThreadPool {
   ThreadPool(size_t num_threads);
+  ~ThreadPool();
+
+  // Returns the number of threads that run tasks, counting the calling thread.
+  size_t NumThreads() const { return num_threads_ + 1; }
 
-  void Compute(const std::function<void(size_t)>& func);
+  // Calls func(i) for every i in [0, count) and returns when all calls have completed.
+  // The calls run concurrently in any order. If any call throws, the first exception is rethrown here.
+  // While it waits, the calling thread only runs tasks of this call, so a short call is never held up behind
+  // the long tasks (such as vision model runs) of another caller. It can still wait for its own tasks that
+  // workers are busy with.
+  void ParallelFor(size_t count, const std::function<void(size_t)>& func);
 
  private:
-  size_t num_threads_;
+  struct Batch {
+    const std::function<void(size_t)>* func{};
+    std::atomic<size_t> num_pending_tasks{};
+    std::mutex mutex;
+    std::condition_variable done_cv;
+    std::exception_ptr error;
+  };
+
+  struct Task {
+    Batch* batch;
+    size_t begin;
+    size_t end;
+  };
+
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  void Start();
+  // Runs a task, preferring the queue at queue_index. Only runs tasks of batch when it is set.
+  bool TryRunTask(size_t queue_index, const Batch* batch = nullptr);
+  void RunTask(const Task& task);
+  void WorkerLoop(size_t worker_index);
+
+  const size_t num_threads_;
+  std::once_flag start_flag_;
+  std::vector<std::unique_ptr<Queue>> queues_;  // One per worker, plus one for threads outside the pool
   std::vector<std::thread> threads_;
+
+  std::mutex wake_mutex_;
+  std::condition_variable wake_cv_;
+  std::atomic<size_t> num_queued_tasks_{};
+  bool stop_{};  // Guarded by wake_mutex_
 };
 
 }  // namespace Generators
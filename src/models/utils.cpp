@@ -38,6 +38,8 @@ const char* TypeToString(ONNXTensorElementDataType type) {
       return "float16";
     case Ort::TypeToTensorType<Ort::BFloat16_t>:
       return "bfloat16";
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT8E4M3FN:
+      return "float8e4m3fn";
     default:
       return "(unsupported type, please add)";
   }
@@ -0,0 +1,136 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "vision_cache.h"
+
+#include <cstring>
+
+namespace Generators {
+
+VisionCache::VisionCache(size_t max_bytes) : max_bytes_{max_bytes} {}
+
+std::shared_ptr<const VisionCacheEntry> VisionCache::Lookup(uint64_t key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    stats_.num_misses++;
+    return nullptr;
+  }
+
+  lru_.splice(lru_.begin(), lru_, it->second);
+  stats_.num_hits++;
+  return it->second->second;
+}
+
+void VisionCache::Insert(uint64_t key, std::shared_ptr<const VisionCacheEntry> entry) {
+  if (!entry || entry->SizeInBytes() > max_bytes_)
+    return;  // Caching it would evict every other entry, and then itself
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (auto it = entries_.find(key); it != entries_.end())
+    Remove(it->second);
+
+  stats_.num_entries++;
+  stats_.size_in_bytes += entry->SizeInBytes();
+  lru_.emplace_front(key, std::move(entry));
+  entries_[key] = lru_.begin();
+
+  while (stats_.size_in_bytes > max_bytes_) {
+    Remove(std::prev(lru_.end()));
+    stats_.num_evictions++;
+  }
+}
+
+void VisionCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  lru_.clear();
+  entries_.clear();
+  stats_.num_entries = 0;
+  stats_.size_in_bytes = 0;
+}
+
+VisionCacheStats VisionCache::Stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void VisionCache::Remove(Lru::iterator it) {
+  stats_.num_entries--;
+  stats_.size_in_bytes -= it->second->SizeInBytes();
+  entries_.erase(it->first);
+  lru_.erase(it);
+}
+
+namespace {
+
+// The primes and rounds of xxHash64, which hashes 32 bytes per iteration in four independent lanes
+constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+uint64_t RotateLeft(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+uint64_t Read64(const uint8_t* p) {
+  uint64_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+uint32_t Read32(const uint8_t* p) {
+  uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+uint64_t Round(uint64_t accumulator, uint64_t input) {
+  return RotateLeft(accumulator + input * kPrime2, 31) * kPrime1;
+}
+
+uint64_t MergeRound(uint64_t accumulator, uint64_t value) {
+  return (accumulator ^ Round(0, value)) * kPrime1 + kPrime4;
+}
+
+}  // namespace
+
+uint64_t HashContent(const void* data, size_t size, uint64_t seed) {
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  const uint8_t* const end = p + size;
+
+  uint64_t hash;
+  if (size >= 32) {
+    uint64_t v1 = seed + kPrime1 + kPrime2, v2 = seed + kPrime2, v3 = seed, v4 = seed - kPrime1;
+    for (; end - p >= 32; p += 32) {
+      v1 = Round(v1, Read64(p));
+      v2 = Round(v2, Read64(p + 8));
+      v3 = Round(v3, Read64(p + 16));
+      v4 = Round(v4, Read64(p + 24));
+    }
+    hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+    hash = MergeRound(MergeRound(MergeRound(MergeRound(hash, v1), v2), v3), v4);
+  } else {
+    hash = seed + kPrime5;
+  }
+  hash += size;
+
+  for (; end - p >= 8; p += 8)
+    hash = RotateLeft(hash ^ Round(0, Read64(p)), 27) * kPrime1 + kPrime4;
+  if (end - p >= 4) {
+    hash = RotateLeft(hash ^ (Read32(p) * kPrime1), 23) * kPrime2 + kPrime3;
+    p += 4;
+  }
+  for (; p < end; p++)
+    hash = RotateLeft(hash ^ (*p * kPrime5), 11) * kPrime1;
+
+  hash ^= hash >> 33;
+  hash *= kPrime2;
+  hash ^= hash >> 29;
+  hash *= kPrime3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+}  // namespace Generators
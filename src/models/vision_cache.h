@@ -0,0 +1,72 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stdint.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace Generators {
+
+// A cached result of the vision stage, such as the preprocessed pixel values or the image features of some images
+struct VisionCacheEntry {
+  virtual ~VisionCacheEntry() = default;
+
+  virtual size_t SizeInBytes() const = 0;
+};
+
+/*
+ * VisionCacheStats holds the counters of a VisionCache.
+ */
+struct VisionCacheStats {
+  size_t num_entries{};    // Number of cached results
+  size_t size_in_bytes{};  // Total size of the cached entries
+  size_t num_hits{};       // Number of lookups that found a cached result
+  size_t num_misses{};     // Number of lookups that found none
+  size_t num_evictions{};  // Number of entries evicted to stay within the memory budget
+};
+
+/*
+ * VisionCache keeps the image preprocessing results and vision encoder outputs of the images a model has seen, so
+ * that the same images sent again (as every turn of a chat about an image does) are neither preprocessed nor
+ * encoded again.
+ *
+ * The entries are keyed by a hash of the image contents and of the processor configuration, see HashContent, and
+ * are evicted least recently used first when their total size exceeds the memory budget.
+ *
+ * All methods are thread safe, the cache is shared by all the processors and generators of a model.
+ */
+struct VisionCache {
+  explicit VisionCache(size_t max_bytes);
+
+  // Returns the entry of key, or nullptr if it is not cached
+  std::shared_ptr<const VisionCacheEntry> Lookup(uint64_t key);
+
+  // Caches the entry of key, replacing any previous entry. Entries larger than the memory budget are not cached.
+  void Insert(uint64_t key, std::shared_ptr<const VisionCacheEntry> entry);
+
+  void Clear();
+
+  VisionCacheStats Stats() const;
+
+ private:
+  using Lru = std::list<std::pair<uint64_t, std::shared_ptr<const VisionCacheEntry>>>;
+
+  void Remove(Lru::iterator it);
+
+  size_t max_bytes_;
+  Lru lru_;  // Most recently used first
+  std::unordered_map<uint64_t, Lru::iterator> entries_;
+  VisionCacheStats stats_;
+  mutable std::mutex mutex_;
+};
+
+// Returns a 64-bit hash of size bytes of data, continuing from seed. Chain calls through seed to hash several buffers.
+// It is not cryptographic, but fast enough to hash every image sent to a model (several GB/s).
+uint64_t HashContent(const void* data, size_t size, uint64_t seed = 0);
+
+}  // namespace Generators
@@ -0,0 +1,74 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "vision_runs.h"
+
+#include <stdexcept>
+#include <string>
+
+namespace Generators {
+
+std::vector<VisionRun> SplitVisionRuns(const int64_t* grid_thw, int64_t num_images, int64_t total_patches, int64_t total_feats,
+                                       int64_t spatial_merge_size, int64_t max_packed_patches) {
+  const int64_t merge_sq = spatial_merge_size * spatial_merge_size;
+
+  // Detect temporal padding: processor may produce more rows than sum(t*h*w)
+  int64_t total_grid_tokens = 0;
+  int64_t total_hw = 0;
+  for (int64_t img = 0; img < num_images; ++img) {
+    total_grid_tokens += grid_thw[img * 3] * grid_thw[img * 3 + 1] * grid_thw[img * 3 + 2];
+    total_hw += grid_thw[img * 3 + 1] * grid_thw[img * 3 + 2];
+  }
+  const bool temporal_padded = (total_patches != total_grid_tokens && total_hw > 0 && total_patches % total_hw == 0);
+  const int64_t hw_multiplier = temporal_padded ? (total_patches / total_hw) : 0;
+  if (temporal_padded)
+    max_packed_patches = 0;
+
+  // Validate that the pre-allocated output buffer is large enough for all images
+  const int64_t expected_total_feats = total_grid_tokens / merge_sq;
+  if (total_feats < expected_total_feats)
+    throw std::runtime_error("pre-allocated image_features dim 0 (" + std::to_string(total_feats) +
+                             ") is smaller than expected (" + std::to_string(expected_total_feats) +
+                             ") for " + std::to_string(num_images) + " images");
+
+  std::vector<VisionRun> runs;
+  int64_t patch_offset = 0;
+  int64_t feat_offset = 0;
+  for (int64_t img = 0; img < num_images; ++img) {
+    int64_t t = grid_thw[img * 3];
+    int64_t h = grid_thw[img * 3 + 1];
+    int64_t w = grid_thw[img * 3 + 2];
+    int64_t grid_tokens = t * h * w;
+    int64_t num_patches = temporal_padded ? (hw_multiplier * h * w) : grid_tokens;
+    int64_t num_feats = grid_tokens / merge_sq;
+
+    if (grid_tokens % merge_sq != 0)
+      throw std::runtime_error("grid tokens (" + std::to_string(grid_tokens) +
+                               ") is not divisible by spatial_merge_size^2 (" +
+                               std::to_string(merge_sq) + ") for image " + std::to_string(img));
+    if (patch_offset + num_patches > total_patches)
+      throw std::runtime_error("patch_offset (" + std::to_string(patch_offset) + ") + num_patches (" +
+                               std::to_string(num_patches) + ") exceeds pixel_values dim 0 (" +
+                               std::to_string(total_patches) + ")");
+    if (feat_offset + num_feats > total_feats)
+      throw std::runtime_error("feat_offset (" + std::to_string(feat_offset) + ") + num_feats (" +
+                               std::to_string(num_feats) + ") exceeds image_features dim 0 (" +
+                               std::to_string(total_feats) + ")");
+
+    VisionRun* last = runs.empty() ? nullptr : &runs.back();
+    if (last && last->grid[1] == h && last->grid[2] == w && last->num_patches + num_patches <= max_packed_patches) {
+      last->grid[0] += t;
+      last->num_patches += num_patches;
+      last->num_feats += num_feats;
+    } else {
+      runs.push_back({{t, h, w}, patch_offset, num_patches, feat_offset, num_feats});
+    }
+
+    patch_offset += num_patches;
+    feat_offset += num_feats;
+  }
+
+  return runs;
+}
+
+}  // namespace Generators
@@ -0,0 +1,32 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+namespace Generators {
+
+// A run of a Qwen VL vision session that takes one image_grid_thw row per run, over consecutive rows of
+// pixel_values and image_features
+struct VisionRun {
+  int64_t grid[3];       // image_grid_thw of the run
+  int64_t patch_offset;  // First row of pixel_values
+  int64_t num_patches;
+  int64_t feat_offset;  // First row of image_features
+  int64_t num_feats;
+};
+
+// Splits the images of grid_thw [num_images, 3] into the runs of the vision session, total_patches and total_feats
+// being dim 0 of pixel_values and image_features. Consecutive images of the same size are packed into one run as the
+// frames of a single [sum(t), h, w] grid, up to max_packed_patches patches: attention and the window index never
+// cross frames, so the run produces the features of every image in order. A max_packed_patches of 0 runs every image
+// separately.
+//
+// The processor may pad pixel_values to the same number of frames for every image, in which case it has rows outside
+// of the grids and its images are never packed. Throws if the grids do not fit pixel_values or image_features.
+std::vector<VisionRun> SplitVisionRuns(const int64_t* grid_thw, int64_t num_images, int64_t total_patches, int64_t total_feats,
+                                       int64_t spatial_merge_size, int64_t max_packed_patches);
+
+}  // namespace Generators
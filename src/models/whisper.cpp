@@ -74,15 +74,8 @@ WhisperDecoderState::WhisperDecoderState(const WhisperModel& model, const Genera
 
   // Add cache indirection
   if (HasCacheIndirectionInput()) {
-    auto cache_indirection_type = model_.session_info_.GetInputDataType(model_.config_->model.decoder.inputs.cache_indirection);
-    auto cache_indirection_shape = std::array<int64_t, 3>{params_->search.batch_size, params_->search.num_beams, params_->search.max_length};
-    cache_indirection_ = OrtValue::CreateTensor(model_.p_device_inputs_->GetAllocator(), cache_indirection_shape, cache_indirection_type);
-    cache_indirection_index_ = inputs_.size();
-
-    input_names_.push_back(model_.config_->model.decoder.inputs.cache_indirection.c_str());
-    inputs_.push_back(cache_indirection_.get());
-
-    ByteWrapTensor(*model_.p_device_inputs_, *cache_indirection_).Zero();
+    cache_indirection_ = std::make_unique<CacheIndirection>(*this);
+    cache_indirection_->Add();
   }
 
   output_cross_qk_name_ = ComposeKeyValueName(model_.config_->model.decoder.outputs.output_cross_qk_names, 0);
@@ -131,30 +124,9 @@ void WhisperDecoderState::UpdateInputsOutputs(DeviceSpan<int32_t>& next_tokens,
     *data = current_length - 1;
   }
 
-  if (cache_indirection_ && params_->search.num_beams > 1 && !first_update) {
+  if (cache_indirection_ && !first_update) {
     // Only update after having run one pass through the decoder with past KV caches
-    auto beam_indices_span = beam_indices.Span();
-    if (beam_indices_span.empty()) {
-      auto beam_indices_cpu = beam_indices.CpuSpan();
-      std::iota(beam_indices_cpu.begin(), beam_indices_cpu.end(), 0);
-      beam_indices.CopyCpuToDevice();
-    }
-    std::unique_ptr<OrtValue> new_cache_indirection;
-    auto cache_indirection_type = model_.session_info_.GetInputDataType(model_.config_->model.decoder.inputs.cache_indirection);
-    auto cache_indirection_shape = std::array<int64_t, 3>{params_->search.batch_size, params_->search.num_beams, params_->search.max_length};
-    new_cache_indirection = OrtValue::CreateTensor(model_.p_device_inputs_->GetAllocator(), cache_indirection_shape, cache_indirection_type);
-
-    model_.p_device_inputs_->UpdateCacheIndirection(new_cache_indirection->GetTensorMutableData<int32_t>(),
-                                                    cache_indirection_->GetTensorData<int32_t>(),
-                                                    beam_indices_span.data(),
-                                                    params_->search.batch_size,
-                                                    params_->search.num_beams,
-                                                    static_cast<int>(new_length),  // sequence length in input ids & logits during each forward pass
-                                                    params_->search.max_length,    // max sequence length
-                                                    current_length);               // total sequence length after N iterations (prompt's sequence length + number of generated tokens)
-
-    cache_indirection_ = std::move(new_cache_indirection);
-    inputs_[cache_indirection_index_] = cache_indirection_.get();
+    cache_indirection_->Update(beam_indices, static_cast<int>(new_length), current_length);
   }
 
   if (output_cross_qk_.size() && output_cross_qk_shape_[2] != 1) {
@@ -313,7 +285,7 @@ void WhisperState::FinalizeCrossQK(int current_length) {
                                              cross_qk_search_buffer_->GetTensorData<T>(),
                                              cross_qk_final_->GetTensorMutableData<T>(),
                                              params_->search.num_return_sequences,
-                                             decoder_state_->cache_indirection_->GetTensorData<int32_t>());
+                                             decoder_state_->cache_indirection_->GetData());
   }
 }
 
@@ -5,6 +5,7 @@
 #include "input_ids.h"
 #include "logits.h"
 #include "kv_cache.h"
+#include "cache_indirection.h"
 #include "extra_inputs.h"
 
 namespace Generators {
@@ -52,7 +53,7 @@ struct WhisperDecoderState : State {
   DeviceSpan<float> Run(int current_length, DeviceSpan<int32_t>& next_tokens, DeviceSpan<int32_t> next_indices) override;
 
   bool HasPastSequenceLengthInput() { return model_.session_info_.HasInput(model_.config_->model.decoder.inputs.past_sequence_length); }
-  bool HasCacheIndirectionInput() { return model_.session_info_.HasInput(model_.config_->model.decoder.inputs.cache_indirection); }
+  bool HasCacheIndirectionInput() { return CacheIndirection::IsNeeded(model_); }
   bool UsesDecoderMaskedMHA() { return HasPastSequenceLengthInput() && HasCacheIndirectionInput(); }
 
  private:
@@ -68,7 +69,7 @@ struct WhisperDecoderState : State {
   
   // Inputs for beam search attention
   std::unique_ptr<OrtValue> past_sequence_length_;          // Model input
-  std::unique_ptr<OrtValue> cache_indirection_;             // Model input { batch_size, num_beams, max_sequence_length }
+  std::unique_ptr<CacheIndirection> cache_indirection_;     // Model input { batch_size, num_beams, max_sequence_length }
 
   Logits logits_{*this};                                    // Model output
   std::vector<std::unique_ptr<OrtValue>> output_cross_qk_;  // Model output { batch_size, num_heads, sequence_length, num_frames / 2 }
@@ -80,7 +81,6 @@ struct WhisperDecoderState : State {
   ONNXTensorElementDataType output_cross_qk_type_;          // Type of cross attention's QK outputs
 
   const int num_frames_{};
-  size_t cache_indirection_index_{~0U};
   size_t output_cross_qk_index_{~0U};
   // clang-format on
 };
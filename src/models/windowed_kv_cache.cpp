@@ -8,7 +8,6 @@
 #include "../make_string.h"
 #include "../narrow.h"
 #include "model.h"
-#include "threadpool.h"
 #include "utils.h"
 
 namespace Generators {
@@ -326,8 +325,7 @@ void WindowedKeyValueCache::Update(DeviceSpan<int32_t> beam_indices, int current
 
 void WindowedKeyValueCache::PartialUpdate(DeviceSpan<int32_t> beam_indices, int total_length,
                                           std::span<const size_t> layer_indices) {
-  ThreadPool thread_pool{layer_indices.size()};
-  thread_pool.Compute([&](size_t i) {
+  GetThreadPool().ParallelFor(layer_indices.size(), [&](size_t i) {
     UpdateLayer(beam_indices, total_length, layer_indices[i]);
   });
 }
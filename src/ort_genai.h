@@ -5,6 +5,7 @@
 
 #include <memory>
 #include <stdexcept>
+#include <utility>
 #include <vector>
 
 #if __cplusplus >= 202002L
@@ -253,6 +254,26 @@ struct OgaModel : OgaAbstract {
     return p;
   }
 
+  void PinPrompt(std::span<const int32_t> tokens) {
+    OgaCheckResult(OgaModelPinPrompt(this, tokens.data(), tokens.size()));
+  }
+
+  void UnpinPrompt(std::span<const int32_t> tokens) {
+    OgaCheckResult(OgaModelUnpinPrompt(this, tokens.data(), tokens.size()));
+  }
+
+  double GetStatistic(const char* name) const {
+    double value;
+    OgaCheckResult(OgaModelGetStatistic(this, name, &value));
+    return value;
+  }
+
+  size_t GetMemoryUsage(const char* category) const {
+    size_t value;
+    OgaCheckResult(OgaModelGetMemoryUsage(this, category, &value));
+    return value;
+  }
+
   static void operator delete(void* p) { OgaDestroyModel(reinterpret_cast<OgaModel*>(p)); }
 };
 
@@ -347,6 +368,14 @@ struct OgaTokenizer : OgaAbstract {
     return std::unique_ptr<OgaTensor>(out);
   }
 
+  // Returns the token ids of all the strings one after the other, and the offsets where each string's ids start
+  std::pair<std::unique_ptr<OgaTensor>, std::unique_ptr<OgaTensor>> EncodeBatchRagged(const char** strings, size_t count) const {
+    OgaTensor* token_ids;
+    OgaTensor* offsets;
+    OgaCheckResult(OgaTokenizerEncodeBatchRagged(this, strings, count, &token_ids, &offsets));
+    return {std::unique_ptr<OgaTensor>(token_ids), std::unique_ptr<OgaTensor>(offsets)};
+  }
+
   int32_t ToTokenId(const char* str) const {
     int32_t token_id;
     OgaCheckResult(OgaTokenizerToTokenId(this, str, &token_id));
@@ -409,6 +438,43 @@ struct OgaTokenizerStream : OgaAbstract {
   static void operator delete(void* p) { OgaDestroyTokenizerStream(reinterpret_cast<OgaTokenizerStream*>(p)); }
 };
 
+struct OgaBatchTokenizerStream : OgaAbstract {
+  static std::unique_ptr<OgaBatchTokenizerStream> Create(const OgaTokenizer& tokenizer) {
+    OgaBatchTokenizerStream* p;
+    OgaCheckResult(OgaCreateBatchTokenizerStream(&tokenizer, &p));
+    return std::unique_ptr<OgaBatchTokenizerStream>(p);
+  }
+
+  /*
+   * Decode tokens[i] of the stream stream_ids[i] for every i. The new text of tokens[i] is text[offsets[i], offsets[i + 1]).
+   * 'text' and 'offsets' are valid until the next call to Decode or when the OgaBatchTokenizerStream is destroyed
+   */
+  void Decode(const uint64_t* stream_ids, const int32_t* tokens, size_t count, const char*& text, const size_t*& offsets) {
+    OgaCheckResult(OgaBatchTokenizerStreamDecode(this, stream_ids, tokens, count, &text, &offsets));
+  }
+
+  void Remove(uint64_t stream_id) {
+    OgaCheckResult(OgaBatchTokenizerStreamRemove(this, stream_id));
+  }
+
+  static void operator delete(void* p) { OgaDestroyBatchTokenizerStream(reinterpret_cast<OgaBatchTokenizerStream*>(p)); }
+};
+
+struct OgaChatEncoder : OgaAbstract {
+  static std::unique_ptr<OgaChatEncoder> Create(const OgaTokenizer& tokenizer, size_t max_conversations) {
+    OgaChatEncoder* p;
+    OgaCheckResult(OgaCreateChatEncoder(&tokenizer, max_conversations, &p));
+    return std::unique_ptr<OgaChatEncoder>(p);
+  }
+
+  // Same as Encode(ApplyChatTemplate(...)), tokenizing only the messages added since the conversation was last encoded
+  void Encode(const char* template_str, const char* messages, const char* tools, bool add_generation_prompt, OgaSequences& sequences) {
+    OgaCheckResult(OgaChatEncoderEncode(this, template_str, messages, tools, add_generation_prompt, &sequences));
+  }
+
+  static void operator delete(void* p) { OgaDestroyChatEncoder(reinterpret_cast<OgaChatEncoder*>(p)); }
+};
+
 struct OgaGeneratorParams : OgaAbstract {
   static std::unique_ptr<OgaGeneratorParams> Create(const OgaModel& model) {
     OgaGeneratorParams* p;
@@ -508,6 +574,30 @@ struct OgaGenerator : OgaAbstract {
     OgaCheckResult(OgaGenerator_RewindTo(this, new_length));
   }
 
+  void SaveState(const char* path) {
+    OgaCheckResult(OgaGenerator_SaveState(this, path));
+  }
+
+  void LoadState(const char* path) {
+    OgaCheckResult(OgaGenerator_LoadState(this, path));
+  }
+
+  void LoadStateFromBuffer(const void* data, size_t size) {
+    OgaCheckResult(OgaGenerator_LoadStateFromBuffer(this, data, size));
+  }
+
+  std::unique_ptr<OgaGenerator> Fork() {
+    OgaGenerator* p;
+    OgaCheckResult(OgaGenerator_Fork(this, &p));
+    return std::unique_ptr<OgaGenerator>(p);
+  }
+
+  size_t GetMemoryUsage(const char* category) const {
+    size_t value;
+    OgaCheckResult(OgaGenerator_GetMemoryUsage(this, category, &value));
+    return value;
+  }
+
   void SetRuntimeOption(const char* key, const char* value) {
     OgaCheckResult(OgaGenerator_SetRuntimeOption(this, key, value));
   }
@@ -820,6 +910,24 @@ struct OgaRequest : OgaAbstract {
     return data;
   }
 
+  void SetPriority(int32_t priority) {
+    OgaCheckResult(OgaRequestSetPriority(this, priority));
+  }
+
+  void SetDeadline(double deadline_ms) {
+    OgaCheckResult(OgaRequestSetDeadline(this, deadline_ms));
+  }
+
+  size_t GetMemoryUsage(const char* category) {
+    size_t value;
+    OgaCheckResult(OgaRequestGetMemoryUsage(this, category, &value));
+    return value;
+  }
+
+  void SetTokenCallback(void (*callback)(OgaRequest* request, void* user_data), void* user_data) {
+    OgaCheckResult(OgaRequestSetTokenCallback(this, callback, user_data));
+  }
+
   static void operator delete(void* p) { OgaDestroyRequest(reinterpret_cast<OgaRequest*>(p)); }
 };
 
@@ -830,6 +938,14 @@ struct OgaEngine : OgaAbstract {
     return std::unique_ptr<OgaEngine>(p);
   }
 
+  void Start() {
+    OgaCheckResult(OgaEngineStart(this));
+  }
+
+  void Stop() {
+    OgaCheckResult(OgaEngineStop(this));
+  }
+
   bool HasPendingRequests() {
     bool f;
     OgaCheckResult(OgaEngineHasPendingRequests(this, &f));
@@ -850,6 +966,12 @@ struct OgaEngine : OgaAbstract {
     return request ? std::unique_ptr<OgaRequest>(request) : nullptr;
   }
 
+  double GetStatistic(const char* name) const {
+    double value;
+    OgaCheckResult(OgaEngineGetStatistic(this, name, &value));
+    return value;
+  }
+
   static void operator delete(void* p) { OgaDestroyEngine(reinterpret_cast<OgaEngine*>(p)); }
 };
 
@@ -61,6 +61,8 @@ struct OgaStringArray : std::vector<std::string>, OgaAbstract {};
 struct OgaTensor : Generators::Tensor, OgaAbstract {};
 struct OgaTokenizer : Generators::Tokenizer, OgaAbstract {};
 struct OgaTokenizerStream : Generators::TokenizerStream, OgaAbstract {};
+struct OgaBatchTokenizerStream : Generators::BatchTokenizerStream, OgaAbstract {};
+struct OgaChatEncoder : Generators::ChatEncoder, OgaAbstract {};
 struct OgaEngine : Generators::Engine, OgaAbstract {};
 struct OgaRequest : Generators::Request, OgaAbstract {};
 struct OgaStreamingProcessor : Generators::StreamingProcessor, OgaAbstract {};
@@ -363,6 +365,38 @@ OgaResult* OGA_API_CALL OgaModelGetDeviceType(const OgaModel* model, const char*
   OGA_CATCH
 }
 
+OgaResult* OGA_API_CALL OgaModelPinPrompt(OgaModel* model, const int32_t* tokens, size_t token_count) {
+  OGA_TRY
+  if (!model->prompt_cache_)
+    throw std::runtime_error("The model has no prompt cache, set prompt_cache.max_bytes in its config");
+  model->prompt_cache_->Pin(std::span<const int32_t>(tokens, token_count));
+  return nullptr;
+  OGA_CATCH
+}
+
+OgaResult* OGA_API_CALL OgaModelUnpinPrompt(OgaModel* model, const int32_t* tokens, size_t token_count) {
+  OGA_TRY
+  if (!model->prompt_cache_)
+    throw std::runtime_error("The model has no prompt cache, set prompt_cache.max_bytes in its config");
+  model->prompt_cache_->Unpin(std::span<const int32_t>(tokens, token_count));
+  return nullptr;
+  OGA_CATCH
+}
+
+OgaResult* OGA_API_CALL OgaModelGetStatistic(const OgaModel* model, const char* name, double* out) {
+  OGA_TRY
+  *out = model->GetStatistic(name);
+  return nullptr;
+  OGA_CATCH
+}
+
+OgaResult* OGA_API_CALL OgaModelGetMemoryUsage(const OgaModel* model, const char* category, size_t* out) {
+  OGA_TRY
+  *out = model->GetMemoryUsage().Get(category);
+  return nullptr;
+  OGA_CATCH
+}
+
 OgaResult* OGA_API_CALL OgaCreateGeneratorParams(const OgaModel* model, OgaGeneratorParams** out) {
   OGA_TRY
   auto params = std::make_shared<Generators::GeneratorParams>(*model);
@@ -502,6 +536,41 @@ OgaResult* OGA_API_CALL OgaGenerator_RewindTo(OgaGenerator* generator, size_t ne
   OGA_CATCH
 }
 
+OgaResult* OGA_API_CALL OgaGenerator_SaveState(OgaGenerator* generator, const char* path) {
+  OGA_TRY
+  generator->SaveState(fs::path(path));
+  return nullptr;
+  OGA_CATCH
+}
+
+OgaResult* OGA_API_CALL OgaGenerator_LoadState(OgaGenerator* generator, const char* path) {
+  OGA_TRY
+  generator->LoadState(fs::path(path));
+  return nullptr;
+  OGA_CATCH
+}
+
+OgaResult* OGA_API_CALL OgaGenerator_LoadStateFromBuffer(OgaGenerator* generator, const void* data, size_t size) {
+  OGA_TRY
+  generator->LoadState(std::span<const uint8_t>{static_cast<const uint8_t*>(data), size});
+  return nullptr;
+  OGA_CATCH
+}
+
+OgaResult* OGA_API_CALL OgaGenerator_Fork(OgaGenerator* generator, OgaGenerator** out) {
+  OGA_TRY
+  *out = ReturnUnique<OgaGenerator>(generator->Fork());
+  return nullptr;
+  OGA_CATCH
+}
+
+OgaResult* OGA_API_CALL OgaGenerator_GetMemoryUsage(const OgaGenerator* generator, const char* category, size_t* out) {
+  OGA_TRY
+  *out = generator->GetMemoryUsage().Get(category);
+  return nullptr;
+  OGA_CATCH
+}
+
 OgaResult* OGA_API_CALL OgaGenerator_SetRuntimeOption(OgaGenerator* generator, const char* key, const char* value) {
   OGA_TRY
   generator->SetRuntimeOption(key, value);
@@ -658,6 +727,16 @@ OgaResult* OGA_API_CALL OgaTokenizerEncodeBatch(const OgaTokenizer* tokenizer, c
   OGA_CATCH
 }
 
+OgaResult* OGA_API_CALL OgaTokenizerEncodeBatchRagged(const OgaTokenizer* tokenizer, const char** strings, size_t count,
+                                                      OgaTensor** token_ids, OgaTensor** offsets) {
+  OGA_TRY
+  auto [token_ids_tensor, offsets_tensor] = tokenizer->EncodeBatchRagged(std::span<const char*>(strings, count));
+  *token_ids = ReturnShared<OgaTensor>(token_ids_tensor);
+  *offsets = ReturnShared<OgaTensor>(offsets_tensor);
+  return nullptr;
+  OGA_CATCH
+}
+
 OgaResult* OGA_API_CALL OgaTokenizerToTokenId(const OgaTokenizer* tokenizer, const char* str, int32_t* token_id) {
   OGA_TRY
   *token_id = tokenizer->TokenToTokenId(str);
@@ -679,6 +758,20 @@ OgaResult* OGA_API_CALL OgaTokenizerApplyChatTemplate(const OgaTokenizer* tokeni
   OGA_CATCH
 }
 
+OgaResult* OGA_API_CALL OgaCreateChatEncoder(const OgaTokenizer* tokenizer, size_t max_conversations, OgaChatEncoder** out) {
+  OGA_TRY
+  *out = ReturnUnique<OgaChatEncoder>(std::make_unique<Generators::ChatEncoder>(*tokenizer, max_conversations));
+  return nullptr;
+  OGA_CATCH
+}
+
+OgaResult* OGA_API_CALL OgaChatEncoderEncode(OgaChatEncoder* chat_encoder, const char* template_str, const char* messages, const char* tools, bool add_generation_prompt, OgaSequences* sequences) {
+  OGA_TRY
+  sequences->emplace_back(chat_encoder->Encode(template_str, messages, tools, add_generation_prompt));
+  return nullptr;
+  OGA_CATCH
+}
+
 OgaResult* OGA_API_CALL OgaTokenizerDecodeBatch(const OgaTokenizer* tokenizer, const OgaTensor* tensor, OgaStringArray** out) {
   OGA_TRY
   auto shape = tensor->GetShape();
@@ -718,6 +811,29 @@ OgaResult* OGA_API_CALL OgaTokenizerStreamDecode(OgaTokenizerStream* p, int32_t
   OGA_CATCH
 }
 
+OgaResult* OGA_API_CALL OgaCreateBatchTokenizerStream(const OgaTokenizer* tokenizer, OgaBatchTokenizerStream** out) {
+  OGA_TRY
+  *out = ReturnUnique<OgaBatchTokenizerStream>(std::make_unique<Generators::BatchTokenizerStream>(*tokenizer));
+  return nullptr;
+  OGA_CATCH
+}
+
+OgaResult* OGA_API_CALL OgaBatchTokenizerStreamDecode(OgaBatchTokenizerStream* stream, const uint64_t* stream_ids, const int32_t* tokens, size_t count, const char** text, const size_t** offsets) {
+  OGA_TRY
+  stream->Decode({stream_ids, count}, {tokens, count});
+  *text = stream->Text().data();
+  *offsets = stream->Offsets().data();
+  return nullptr;
+  OGA_CATCH
+}
+
+OgaResult* OGA_API_CALL OgaBatchTokenizerStreamRemove(OgaBatchTokenizerStream* stream, uint64_t stream_id) {
+  OGA_TRY
+  stream->Remove(stream_id);
+  return nullptr;
+  OGA_CATCH
+}
+
 OgaResult* OGA_API_CALL OgaCreateTensorFromBuffer(void* data, const int64_t* shape_dims, size_t shape_dims_count, OgaElementType element_type, OgaTensor** out) {
   OGA_TRY
   auto p_memory_info = OrtMemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
@@ -985,6 +1101,20 @@ OgaResult* OgaCreateEngine(OgaModel* model, OgaEngine** out) {
   OGA_CATCH
 }
 
+OgaResult* OgaEngineStart(OgaEngine* engine) {
+  OGA_TRY
+  engine->Start();
+  return nullptr;
+  OGA_CATCH
+}
+
+OgaResult* OgaEngineStop(OgaEngine* engine) {
+  OGA_TRY
+  engine->Stop();
+  return nullptr;
+  OGA_CATCH
+}
+
 OgaResult* OgaEngineStep(OgaEngine* engine, OgaRequest** request) {
   OGA_TRY
   auto ready_request = engine->Step();
@@ -1014,6 +1144,13 @@ OgaResult* OgaEngineRemoveRequest(OgaEngine* engine, OgaRequest* request) {
   OGA_CATCH
 }
 
+OgaResult* OgaEngineGetStatistic(const OgaEngine* engine, const char* name, double* out) {
+  OGA_TRY
+  *out = engine->GetStatistic(name);
+  return nullptr;
+  OGA_CATCH
+}
+
 OgaResult* OgaCreateRequest(OgaGeneratorParams* params, OgaRequest** out) {
   OGA_TRY
   auto request = std::make_shared<Generators::Request>(params->shared_from_this());
@@ -1067,6 +1204,44 @@ OgaResult* OGA_API_CALL OgaRequestGetOpaqueData(OgaRequest* request, void** data
   OGA_CATCH
 }
 
+OgaResult* OGA_API_CALL OgaRequestSetPriority(OgaRequest* request, int32_t priority) {
+  OGA_TRY
+  request->SetPriority(priority);
+  return nullptr;
+  OGA_CATCH
+}
+
+OgaResult* OGA_API_CALL OgaRequestSetTokenCallback(OgaRequest* request,
+                                                   void (*callback)(OgaRequest* request, void* user_data),
+                                                   void* user_data) {
+  OGA_TRY
+  if (!callback) {
+    request->SetTokenCallback({});
+  } else {
+    request->SetTokenCallback([callback, user_data](Generators::Request& request) {
+      callback(static_cast<OgaRequest*>(&request), user_data);
+    });
+  }
+  return nullptr;
+  OGA_CATCH
+}
+
+OgaResult* OGA_API_CALL OgaRequestSetDeadline(OgaRequest* request, double deadline_ms) {
+  OGA_TRY
+  request->SetDeadline(std::chrono::steady_clock::now() +
+                       std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                           std::chrono::duration<double, std::milli>(deadline_ms)));
+  return nullptr;
+  OGA_CATCH
+}
+
+OgaResult* OGA_API_CALL OgaRequestGetMemoryUsage(OgaRequest* request, const char* category, size_t* out) {
+  OGA_TRY
+  *out = request->GetMemoryUsage().Get(category);
+  return nullptr;
+  OGA_CATCH
+}
+
 void OGA_API_CALL OgaDestroyStringArray(OgaStringArray* string_array) { delete string_array; }
 void OGA_API_CALL OgaDestroyResult(OgaResult* p) { delete p; }
 void OGA_API_CALL OgaDestroyString(const char* p) { delete[] p; }
@@ -1077,6 +1252,8 @@ void OGA_API_CALL OgaDestroyGeneratorParams(OgaGeneratorParams* p) { p->External
 void OGA_API_CALL OgaDestroyGenerator(OgaGenerator* p) { delete p; }
 void OGA_API_CALL OgaDestroyTokenizer(OgaTokenizer* p) { p->ExternalRelease(); }
 void OGA_API_CALL OgaDestroyTokenizerStream(OgaTokenizerStream* p) { delete p; }
+void OGA_API_CALL OgaDestroyBatchTokenizerStream(OgaBatchTokenizerStream* p) { delete p; }
+void OGA_API_CALL OgaDestroyChatEncoder(OgaChatEncoder* p) { delete p; }
 void OGA_API_CALL OgaDestroyTensor(OgaTensor* p) { p->ExternalRelease(); }
 void OGA_API_CALL OgaDestroyMultiModalProcessor(OgaMultiModalProcessor* p) { p->ExternalRelease(); }
 void OGA_API_CALL OgaDestroyImages(OgaImages* p) { delete p; }
@@ -70,6 +70,8 @@ typedef struct OgaModel OgaModel;
 typedef struct OgaSequences OgaSequences;
 typedef struct OgaTokenizer OgaTokenizer;
 typedef struct OgaTokenizerStream OgaTokenizerStream;
+typedef struct OgaBatchTokenizerStream OgaBatchTokenizerStream;
+typedef struct OgaChatEncoder OgaChatEncoder;
 typedef struct OgaTensor OgaTensor;
 typedef struct OgaImages OgaImages;
 typedef struct OgaNamedTensors OgaNamedTensors;
@@ -386,6 +388,46 @@ OGA_EXPORT OgaResult* OGA_API_CALL OgaModelGetType(const OgaModel* model, const
  */
 OGA_EXPORT OgaResult* OGA_API_CALL OgaModelGetDeviceType(const OgaModel* model, const char** out);
 
+/**
+ * \brief Keeps the prompt cache entry of a prompt prefix from being evicted, such as a system prompt shared by many
+ *        generators. The prefix is cached by the first generator that runs it and stays cached until it is unpinned.
+ * \param[in] model The model whose prompt cache is configured with "prompt_cache" in its config.
+ * \param[in] tokens The tokens of the prompt prefix.
+ * \param[in] token_count The number of tokens.
+ * \return OgaResult containing the error message if the model has no prompt cache, or nullptr on success.
+ */
+OGA_EXPORT OgaResult* OGA_API_CALL OgaModelPinPrompt(OgaModel* model, const int32_t* tokens, size_t token_count);
+
+/**
+ * \brief Lets a prompt prefix pinned by OgaModelPinPrompt be evicted again.
+ * \param[in] model The model the prefix was pinned on.
+ * \param[in] tokens The tokens of the prompt prefix.
+ * \param[in] token_count The number of tokens.
+ * \return OgaResult containing the error message if the prefix is not pinned, or nullptr on success.
+ */
+OGA_EXPORT OgaResult* OGA_API_CALL OgaModelUnpinPrompt(OgaModel* model, const int32_t* tokens, size_t token_count);
+
+/**
+ * \brief Returns the current value of a model statistic, such as "prompt_cache_hits", "prompt_cache_misses",
+ *        "prompt_cache_hit_tokens", "prompt_cache_entries", "prompt_cache_bytes" or "prompt_cache_evictions", and
+ *        the same "vision_cache_*" statistics (but hit_tokens) of the cache of image preprocessing and vision encoder outputs.
+ * \param[in] model The model to get the statistic from.
+ * \param[in] name The name of the statistic.
+ * \param[out] out Pointer to where the value of the statistic will be stored.
+ * \return OgaResult containing the error message if the statistic is not known to the model, or nullptr on success.
+ */
+OGA_EXPORT OgaResult* OGA_API_CALL OgaModelGetStatistic(const OgaModel* model, const char* name, double* out);
+
+/**
+ * \brief Returns the memory used by the model in one category: "weights" (the size of its model files),
+ *        "kv_cache" (the entries of its prompt cache), "activations", "scratch" or "total".
+ * \param[in] model The model to get the memory usage of.
+ * \param[in] category The category of memory.
+ * \param[out] out Pointer to where the number of bytes will be stored.
+ * \return OgaResult containing the error message if the category is not known, or nullptr on success.
+ */
+OGA_EXPORT OgaResult* OGA_API_CALL OgaModelGetMemoryUsage(const OgaModel* model, const char* category, size_t* out);
+
 /**
  * \brief Destroys the given config
  * \param[in] config The config to be destroyed.
@@ -561,6 +603,56 @@ OGA_EXPORT OgaResult* OGA_API_CALL OgaGenerator_SetRuntimeOption(OgaGenerator* g
  */
 OGA_EXPORT OgaResult* OGA_API_CALL OgaGenerator_RewindTo(OgaGenerator* generator, size_t new_length);
 
+/**
+ * \brief Saves the state of the generator to a file: the sequence, the logits of the next token, the key-value cache and the
+ *        random number generator state. Another generator of the same model and search options can continue from it.
+ *        Only decoder-only models with a batch size of 1 and no beam search are supported.
+ * \param[in] generator The generator to save.
+ * \param[in] path The file to write the state to.
+ * \return OgaResult containing the error message if saving the state failed.
+ */
+OGA_EXPORT OgaResult* OGA_API_CALL OgaGenerator_SaveState(OgaGenerator* generator, const char* path);
+
+/**
+ * \brief Loads a state saved by OgaGenerator_SaveState into a generator that has no tokens yet.
+ *        The file is memory mapped and copied from the mapping into the generator.
+ * \param[in] generator The generator to load the state into.
+ * \param[in] path The file to read the state from.
+ * \return OgaResult containing the error message if loading the state failed.
+ */
+OGA_EXPORT OgaResult* OGA_API_CALL OgaGenerator_LoadState(OgaGenerator* generator, const char* path);
+
+/**
+ * \brief Loads a state saved by OgaGenerator_SaveState from the contents of the file in memory.
+ * \param[in] generator The generator to load the state into.
+ * \param[in] data The state. It is only used during the call.
+ * \param[in] size The size of the state in bytes.
+ * \return OgaResult containing the error message if loading the state failed.
+ */
+OGA_EXPORT OgaResult* OGA_API_CALL OgaGenerator_LoadStateFromBuffer(OgaGenerator* generator, const void* data, size_t size);
+
+/**
+ * \brief Creates a generator that continues from the current sequence of the given generator, without running the sequence
+ *        through the model again. The key-value cache of the sequence is shared by both generators until either writes over it,
+ *        and the new generator samples with its own random stream. If the last generated token has not been run yet, it is run first.
+ *        Only decoder-only models with a batch size of 1 and no beam search are supported.
+ * \param[in] generator The generator to fork.
+ * \param[out] out The created generator. It is destroyed with OgaDestroyGenerator and can outlive the forked generator.
+ * \return OgaResult containing the error message if forking the generator failed.
+ */
+OGA_EXPORT OgaResult* OGA_API_CALL OgaGenerator_Fork(OgaGenerator* generator, OgaGenerator** out);
+
+/**
+ * \brief Returns the memory used by the generator in one category: "kv_cache" (its key-value cache), "activations"
+ *        (the other inputs and outputs of the model, such as the logits), "scratch" (its sequences and search buffers),
+ *        "weights" (always 0, see OgaModelGetMemoryUsage) or "total".
+ * \param[in] generator The generator to get the memory usage of.
+ * \param[in] category The category of memory.
+ * \param[out] out Pointer to where the number of bytes will be stored.
+ * \return OgaResult containing the error message if the category is not known, or nullptr on success.
+ */
+OGA_EXPORT OgaResult* OGA_API_CALL OgaGenerator_GetMemoryUsage(const OgaGenerator* generator, const char* category, size_t* out);
+
 /**
  * \brief Returns a copy of the model input identified by the given name as an OgaTensor on CPU. The buffer is owned by returned OgaTensor
  *       and will be released when the OgaTensor is destroyed
@@ -699,6 +791,18 @@ OGA_EXPORT OgaResult* OGA_API_CALL OgaTokenizerEncode(const OgaTokenizer*, const
  */
 OGA_EXPORT OgaResult* OGA_API_CALL OgaTokenizerEncodeBatch(const OgaTokenizer*, const char** strings, size_t count, OgaTensor** out);
 
+/**
+ * \brief Batch encodes an array of strings without padding them to the same length.
+ * \param[in] tokenizer The tokenizer to use.
+ * \param[in] strings The strings to encode.
+ * \param[in] count The number of strings.
+ * \param[out] token_ids A 1D int32 tensor with the token ids of all the strings, one string after the other.
+ * \param[out] offsets A 1D int64 tensor of count + 1 elements. The token ids of string i are token_ids[offsets[i], offsets[i + 1]).
+ * \return OgaResult containing the error message if the encoding failed, or nullptr on success.
+ */
+OGA_EXPORT OgaResult* OGA_API_CALL OgaTokenizerEncodeBatchRagged(const OgaTokenizer* tokenizer, const char** strings, size_t count,
+                                                                 OgaTensor** token_ids, OgaTensor** offsets);
+
 /**
  * Batch decode a tensor of token ids and return an array of strings
  */
@@ -791,6 +895,26 @@ OGA_EXPORT OgaResult* OGA_API_CALL OgaProcessorDecode(const OgaMultiModalProcess
  */
 OGA_EXPORT OgaResult* OGA_API_CALL OgaTokenizerApplyChatTemplate(const OgaTokenizer*, const char* template_str, const char* messages, const char* tools, bool add_generation_prompt, const char** out_string);
 
+/** OgaChatEncoder applies the chat template to conversations and tokenizes the result like OgaTokenizerApplyChatTemplate
+ * followed by OgaTokenizerEncode. It caches the tokens of the last max_conversations conversations it encoded, keyed
+ * by the hash of their messages, so a conversation that continues with new messages only has the new messages tokenized.
+ */
+OGA_EXPORT OgaResult* OGA_API_CALL OgaCreateChatEncoder(const OgaTokenizer*, size_t max_conversations, OgaChatEncoder** out);
+OGA_EXPORT void OGA_API_CALL OgaDestroyChatEncoder(OgaChatEncoder*);
+
+/**
+ * @brief Applies a chat template to input messages and appends the token ids of the result to sequences
+ *
+ * \param[in] chat_encoder OgaChatEncoder created from the tokenizer to use.
+ * \param[in] template_str Null-terminated string representing the chat template. Use nullptr to fall back to the default chat template from the tokenizer config.
+ * \param[in] messages Null-terminated string containing the JSON array of the conversation's messages.
+ * \param[in] tools Null-terminated string containing the chat function calls if any. Use nullptr if none.
+ * \param[in] add_generation_prompt Indicates whether to add a generation prompt to the output.
+ * \param[out] sequences OgaSequences the token ids are appended to as a new sequence.
+ * \return OgaResult* containing the error message if the function fails
+ */
+OGA_EXPORT OgaResult* OGA_API_CALL OgaChatEncoderEncode(OgaChatEncoder*, const char* template_str, const char* messages, const char* tools, bool add_generation_prompt, OgaSequences* sequences);
+
 /** OgaTokenizerStream is to decoded token strings incrementally, one token at a time.
  */
 OGA_EXPORT OgaResult* OGA_API_CALL OgaCreateTokenizerStream(const OgaTokenizer*, OgaTokenizerStream** out);
@@ -804,6 +928,35 @@ OGA_EXPORT void OGA_API_CALL OgaDestroyTokenizerStream(OgaTokenizerStream*);
  */
 OGA_EXPORT OgaResult* OGA_API_CALL OgaTokenizerStreamDecode(OgaTokenizerStream*, int32_t token, const char** out);
 
+/** OgaBatchTokenizerStream decodes the tokens of many streams incrementally in one call, such as the new tokens of all
+ * the requests of an engine step. Streams are identified by ids chosen by the caller. A stream starts with the first
+ * token of its id and ends with OgaBatchTokenizerStreamRemove.
+ */
+OGA_EXPORT OgaResult* OGA_API_CALL OgaCreateBatchTokenizerStream(const OgaTokenizer*, OgaBatchTokenizerStream** out);
+OGA_EXPORT void OGA_API_CALL OgaDestroyBatchTokenizerStream(OgaBatchTokenizerStream*);
+
+/**
+ * @brief Decodes tokens[i] of the stream stream_ids[i] for every i, in order
+ *
+ * The new text of all the tokens is returned one after the other in 'text', and the new text of tokens[i] is
+ * text[offsets[i], offsets[i + 1]). The text of each token ends on a complete UTF-8 character, text that is not
+ * complete yet is returned with a later token of the same stream.
+ *
+ * \param[in] stream OgaBatchTokenizerStream to decode with.
+ * \param[in] stream_ids The id of the stream of each token. A stream can have several tokens in one call.
+ * \param[in] tokens The tokens to decode.
+ * \param[in] count The number of stream ids and tokens.
+ * \param[out] text The new text of all the tokens. It is not null terminated.
+ * \param[out] offsets The count + 1 offsets of the text of each token in 'text'.
+ * 'text' and 'offsets' are valid until the next call to OgaBatchTokenizerStreamDecode or when the OgaBatchTokenizerStream is destroyed
+ * \return OgaResult* containing the error message if the function fails
+ */
+OGA_EXPORT OgaResult* OGA_API_CALL OgaBatchTokenizerStreamDecode(OgaBatchTokenizerStream* stream, const uint64_t* stream_ids, const int32_t* tokens, size_t count, const char** text, const size_t** offsets);
+
+/** Forgets a stream of an OgaBatchTokenizerStream, such as the stream of a completed request. Its id can be used again for a new stream.
+ */
+OGA_EXPORT OgaResult* OGA_API_CALL OgaBatchTokenizerStreamRemove(OgaBatchTokenizerStream* stream, uint64_t stream_id);
+
 /** Create an OgaTensor from an optional user owned buffer. If a user owned buffer is supplied, the OgaTensor does
  * not own the memory (as it has no way to free it) so the 'data' parameter must be valid for the lifetime of the OgaTensor.
  *  If the 'data' parameter is nullptr, the OgaTensor will allocate its own memory.
@@ -980,6 +1133,30 @@ OGA_EXPORT OgaResult* OGA_API_CALL OgaCreateEngine(OgaModel* model, OgaEngine**
  */
 OGA_EXPORT void OGA_API_CALL OgaDestroyEngine(OgaEngine* engine);
 
+/**
+ * \brief Starts running the engine on a background thread.
+ *
+ * Once started, the engine steps on its own thread, and OgaEngineAddRequest and OgaEngineRemoveRequest can be
+ * called from any thread. New tokens are delivered through the callback set with OgaRequestSetTokenCallback,
+ * or else through OgaEngineStep, which then blocks until a request has new tokens instead of running the model.
+ * Must be called before any request is added to the engine.
+ *
+ * \param[in] engine The engine to start.
+ * \return OgaResult containing the error message if the engine could not be started, or nullptr on success.
+ */
+OGA_EXPORT OgaResult* OGA_API_CALL OgaEngineStart(OgaEngine* engine);
+
+/**
+ * \brief Stops the background thread of a started engine after its current step.
+ *
+ * Requests that have not completed are not processed any further. The engine cannot be started again.
+ * Destroying a started engine also stops it.
+ *
+ * \param[in] engine The engine to stop.
+ * \return OgaResult containing the error message if the engine could not be stopped, or nullptr on success.
+ */
+OGA_EXPORT OgaResult* OGA_API_CALL OgaEngineStop(OgaEngine* engine);
+
 /**
  * \brief Returns a ready request of runs one step of the OgaEngine if there are pending requests.
  *
@@ -990,6 +1167,8 @@ OGA_EXPORT void OGA_API_CALL OgaDestroyEngine(OgaEngine* engine);
  * If the engine has ready requests from a previous call, it will return one of them in the request parameter.
  * If there are no ready requests, a new subset of requests will be scheduled for processing and the request parameter
  * will be set to the first request from this subset that is ready to be queried for results.
+ * If the engine was started with OgaEngineStart, this instead blocks until the background thread delivers a request
+ * with new tokens, and sets the request parameter to nullptr once there are no pending requests left.
  *
  * \param[in] engine The engine instance to run a processing step on.
  * \param[out] request A request that has been processed by the engine and is ready to be queried for results.
@@ -1033,6 +1212,26 @@ OGA_EXPORT OgaResult* OGA_API_CALL OgaEngineAddRequest(OgaEngine* engine, OgaReq
  */
 OGA_EXPORT OgaResult* OGA_API_CALL OgaEngineRemoveRequest(OgaEngine* engine, OgaRequest* request);
 
+/**
+ * \brief Gets the current value of a named engine statistic.
+ *
+ * This function queries the resource usage counters kept by the engine. All engines report
+ * "average_step_latency_ms", the moving average latency of an engine step. The engines that use dynamic batching
+ * also report the following statistics of their paged key-value cache:
+ * "num_blocks", "num_available_blocks", "num_cached_blocks", "num_block_allocations", "num_block_frees",
+ * "num_block_evictions", "num_prefix_cache_hits", "block_high_water_mark" and "block_fragmentation", the usage of
+ * their swap space: "num_host_swap_blocks", "num_disk_swap_blocks", "num_spilled_blocks" and "num_prefetched_blocks",
+ * the number of requests preempted so far: "num_swapped_preemptions" and "num_recomputed_preemptions",
+ * and "memory_in_use_bytes", the key-value cache blocks in use and the scratch memory of the allocated requests
+ * that engine.dynamic_batching.max_memory_bytes budgets.
+ *
+ * \param[in] engine The engine instance to query.
+ * \param[in] name The name of the statistic.
+ * \param[out] out Pointer to where the value of the statistic will be stored.
+ * \return OgaResult containing the error message if the statistic is not known to the engine, or nullptr on success.
+ */
+OGA_EXPORT OgaResult* OGA_API_CALL OgaEngineGetStatistic(const OgaEngine* engine, const char* name, double* out);
+
 /**
  * \brief Creates a new request for the OgaEngine.
  *
@@ -1093,6 +1292,65 @@ OGA_EXPORT OgaResult* OGA_API_CALL OgaRequestSetOpaqueData(OgaRequest* request,
  */
 OGA_EXPORT OgaResult* OGA_API_CALL OgaRequestGetOpaqueData(OgaRequest* request, void** opaque_data);
 
+/**
+ * \brief Sets the priority of the request.
+ *
+ * Requests with a higher priority are served first when the engine is configured with the "priority"
+ * scheduling policy (engine.scheduling.policy in genai_config.json). The default priority is 0.
+ *
+ * \param[in] request The request to set the priority on.
+ * \param[in] priority The priority of the request.
+ * \return OgaResult containing the error message if the setting of the priority failed, or nullptr on success.
+ */
+OGA_EXPORT OgaResult* OGA_API_CALL OgaRequestSetPriority(OgaRequest* request, int32_t priority);
+
+/**
+ * \brief Sets the deadline of the request.
+ *
+ * Requests with an earlier deadline are served first when the engine is configured with the
+ * "earliest_deadline_first" scheduling policy. If engine.scheduling.reject_missed_deadlines is set,
+ * OgaEngineAddRequest fails for a request whose deadline cannot be met. The deadline must be set
+ * before the request is added to the engine for admission control to take it into account.
+ *
+ * \param[in] request The request to set the deadline on.
+ * \param[in] deadline_ms The number of milliseconds from now by which the request should be completed.
+ * \return OgaResult containing the error message if the setting of the deadline failed, or nullptr on success.
+ */
+OGA_EXPORT OgaResult* OGA_API_CALL OgaRequestSetDeadline(OgaRequest* request, double deadline_ms);
+
+/**
+ * \brief Returns the memory used by the request in one category: "kv_cache" (the key-value cache blocks it holds in
+ *        the engine), "scratch" (its sequences and search buffers), "weights", "activations" or "total".
+ *
+ * The engine budgets the key-value cache and scratch memory of its requests when
+ * engine.dynamic_batching.max_memory_bytes is set, see the "memory_in_use_bytes" engine statistic.
+ *
+ * \param[in] request The request to get the memory usage of.
+ * \param[in] category The category of memory.
+ * \param[out] out Pointer to where the number of bytes will be stored.
+ * \return OgaResult containing the error message if the category is not known, or nullptr on success.
+ */
+OGA_EXPORT OgaResult* OGA_API_CALL OgaRequestGetMemoryUsage(OgaRequest* request, const char* category, size_t* out);
+
+/**
+ * \brief Sets the callback that receives the new tokens of a request served by a started engine.
+ *
+ * The callback is invoked on the engine's background thread whenever the request has new tokens or has completed.
+ * Within the callback, the tokens can be retrieved with OgaRequestGetUnseenToken. The callback should return
+ * quickly since the engine does not make progress while it runs. With engine.async_token_delivery set in the config,
+ * the callback runs on a separate thread while the next step runs instead. Requests with a callback are not returned
+ * by OgaEngineStep. Must be set before the request is added to the engine.
+ *
+ * \param[in] request The request to set the callback on.
+ * \param[in] callback The callback, or nullptr to deliver the request through OgaEngineStep.
+ *                     The request passed to the callback is only valid for the duration of the call.
+ * \param[in] user_data Opaque pointer passed to the callback.
+ * \return OgaResult containing the error message if the setting of the callback failed, or nullptr on success.
+ */
+OGA_EXPORT OgaResult* OGA_API_CALL OgaRequestSetTokenCallback(OgaRequest* request,
+                                                              void (*callback)(OgaRequest* request, void* user_data),
+                                                              void* user_data);
+
 /**
  * \brief Checks if the request has any unseen tokens.
  *
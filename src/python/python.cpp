@@ -226,6 +226,8 @@ struct PyGenerator {
     generator_ = OgaGenerator::Create(model, *params.params_);
   }
 
+  PyGenerator(std::unique_ptr<OgaGenerator> generator) : generator_{std::move(generator)} {}
+
   pybind11::array_t<int32_t> GetNextTokens() {
     return ToPython(generator_->GetNextTokens());
   }
@@ -278,6 +280,27 @@ struct PyGenerator {
     generator_->RewindTo(new_length);
   }
 
+  void SaveState(const std::string& path) {
+    generator_->SaveState(path.c_str());
+  }
+
+  void LoadState(const std::string& path) {
+    generator_->LoadState(path.c_str());
+  }
+
+  PyGenerator Fork() {
+    return PyGenerator{generator_->Fork()};
+  }
+
+  size_t GetMemoryUsage(const std::string& category) const {
+    return generator_->GetMemoryUsage(category.c_str());
+  }
+
+  void LoadStateFromBuffer(const pybind11::bytes& data) {
+    auto view = static_cast<std::string_view>(data);
+    generator_->LoadStateFromBuffer(view.data(), view.size());
+  }
+
   bool IsDone() {
     return generator_->IsDone();
   }
@@ -351,6 +374,21 @@ PYBIND11_MODULE(onnxruntime_genai, m) {
   pybind11::class_<OgaTokenizerStream>(m, "TokenizerStream")
       .def("decode", [](OgaTokenizerStream& t, int32_t token) { return t.Decode(token); });
 
+  pybind11::class_<OgaBatchTokenizerStream>(m, "BatchTokenizerStream")
+      .def("decode", [](OgaBatchTokenizerStream& t, pybind11::array_t<uint64_t> stream_ids, pybind11::array_t<int32_t> tokens) {
+        auto stream_ids_span = ToSpan(stream_ids);
+        auto tokens_span = ToSpan(tokens);
+        if (stream_ids_span.size() != tokens_span.size())
+          throw std::runtime_error("stream_ids and tokens must have the same size");
+        const char* text;
+        const size_t* offsets;
+        t.Decode(stream_ids_span.data(), tokens_span.data(), tokens_span.size(), text, offsets);
+        std::vector<std::string> strings;
+        for (size_t i = 0; i < tokens_span.size(); i++)
+          strings.emplace_back(text + offsets[i], offsets[i + 1] - offsets[i]);
+        return strings; })
+      .def("remove", &OgaBatchTokenizerStream::Remove);
+
   pybind11::class_<OgaNamedTensors>(m, "NamedTensors")
       .def(pybind11::init([]() { return OgaNamedTensors::Create(); }))
       .def("__getitem__", [](OgaNamedTensors& named_tensors, const std::string& name) {
@@ -425,13 +463,27 @@ PYBIND11_MODULE(onnxruntime_genai, m) {
         for (const auto& s : strings)
           c_strings.push_back(s.c_str());
         return t.EncodeBatch(c_strings.data(), c_strings.size()); })
+      .def("encode_batch_ragged", [](const OgaTokenizer& t, std::vector<std::string> strings) {
+        std::vector<const char*> c_strings;
+        for (const auto& s : strings)
+          c_strings.push_back(s.c_str());
+        auto [token_ids, offsets] = t.EncodeBatchRagged(c_strings.data(), c_strings.size());
+        return pybind11::make_tuple(ToNumpy(*token_ids), ToNumpy(*offsets)); })
       .def("decode_batch", [](const OgaTokenizer& t, const OgaTensor& tokens) {
         std::vector<std::string> strings;
         auto decoded = t.DecodeBatch(tokens);
         for (size_t i = 0; i < decoded->Count(); i++)
           strings.push_back(decoded->Get(i));
         return strings; })
-      .def("create_stream", [](const OgaTokenizer& t) { return OgaTokenizerStream::Create(t); });
+      .def("create_stream", [](const OgaTokenizer& t) { return OgaTokenizerStream::Create(t); })
+      .def("create_batch_stream", [](const OgaTokenizer& t) { return OgaBatchTokenizerStream::Create(t); });
+
+  pybind11::class_<OgaChatEncoder>(m, "ChatEncoder")
+      .def(pybind11::init([](const OgaTokenizer& tokenizer, size_t max_conversations) { return OgaChatEncoder::Create(tokenizer, max_conversations); }), pybind11::arg("tokenizer"), pybind11::arg("max_conversations") = 64)
+      .def("encode", [](OgaChatEncoder& encoder, const char* messages, const char* template_str, const char* tools, bool add_generation_prompt) -> pybind11::array_t<int32_t> {
+        auto sequences = OgaSequences::Create();
+        encoder.Encode(template_str, messages, tools, add_generation_prompt, *sequences);
+        return ToPython(sequences->Get(0)); }, pybind11::arg("messages"), pybind11::kw_only(), pybind11::arg("template_str") = nullptr, pybind11::arg("tools") = nullptr, pybind11::arg("add_generation_prompt") = true);
 
   pybind11::class_<OgaConfig>(m, "Config")
       .def(pybind11::init([](const std::string& config_path) { return OgaConfig::Create(config_path.c_str()); }))
@@ -477,7 +529,11 @@ PYBIND11_MODULE(onnxruntime_genai, m) {
       .def_property_readonly(
           "device_type", [](const OgaModel& model) -> std::string { return model.GetDeviceType().p_; }, "The device type the model is running on")
       .def("create_multimodal_processor", [](const OgaModel& model) { return OgaMultiModalProcessor::Create(model); })
-      .def("create_streaming_processor", [](OgaModel& model) { return OgaStreamingProcessor::Create(model); }, "Create a StreamingProcessor for mel spectrogram extraction from raw audio.");
+      .def("create_streaming_processor", [](OgaModel& model) { return OgaStreamingProcessor::Create(model); }, "Create a StreamingProcessor for mel spectrogram extraction from raw audio.")
+      .def("pin_prompt", [](OgaModel& model, pybind11::array_t<int32_t> tokens) { model.PinPrompt(ToSpan(tokens)); }, "Keep the prompt cache entry of a prompt prefix from being evicted.")
+      .def("unpin_prompt", [](OgaModel& model, pybind11::array_t<int32_t> tokens) { model.UnpinPrompt(ToSpan(tokens)); })
+      .def("get_statistic", [](const OgaModel& model, const std::string& name) { return model.GetStatistic(name.c_str()); })
+      .def("get_memory_usage", [](const OgaModel& model, const std::string& category) { return model.GetMemoryUsage(category.c_str()); });
 
   pybind11::class_<PyGenerator>(m, "Generator")
       .def(pybind11::init<const OgaModel&, PyGeneratorParams&>())
@@ -493,6 +549,11 @@ PYBIND11_MODULE(onnxruntime_genai, m) {
       .def("set_logits", &PyGenerator::SetLogits)
       .def("generate_next_token", &PyGenerator::GenerateNextToken)
       .def("rewind_to", &PyGenerator::RewindTo)
+      .def("save_state", &PyGenerator::SaveState)
+      .def("load_state", &PyGenerator::LoadState)
+      .def("load_state_from_buffer", &PyGenerator::LoadStateFromBuffer)
+      .def("fork", &PyGenerator::Fork)
+      .def("get_memory_usage", &PyGenerator::GetMemoryUsage)
       .def("get_next_tokens", &PyGenerator::GetNextTokens)
       .def("get_sequence", &PyGenerator::GetSequence)
       .def("set_active_adapter", &PyGenerator::SetActiveAdapter)
@@ -623,14 +684,20 @@ PYBIND11_MODULE(onnxruntime_genai, m) {
         if (!opaque_data)
           return pybind11::none();
         return pybind11::reinterpret_borrow<pybind11::object>(static_cast<PyObject*>(opaque_data));
-      });
+      })
+      .def("set_priority", &OgaRequest::SetPriority)
+      .def("set_deadline", &OgaRequest::SetDeadline)
+      .def("get_memory_usage", [](OgaRequest& request, const std::string& category) { return request.GetMemoryUsage(category.c_str()); });
 
   pybind11::class_<OgaEngine>(m, "Engine")
       .def(pybind11::init([](OgaModel& model) { return OgaEngine::Create(model); }))
       .def("add_request", &OgaEngine::Add)
-      .def("step", &OgaEngine::Step)
+      .def("step", &OgaEngine::Step, pybind11::call_guard<pybind11::gil_scoped_release>())
       .def("remove_request", &OgaEngine::Remove)
-      .def("has_pending_requests", &OgaEngine::HasPendingRequests);
+      .def("has_pending_requests", &OgaEngine::HasPendingRequests)
+      .def("start", &OgaEngine::Start)
+      .def("stop", &OgaEngine::Stop, pybind11::call_guard<pybind11::gil_scoped_release>())
+      .def("get_statistic", [](const OgaEngine& engine, const std::string& name) { return engine.GetStatistic(name.c_str()); });
 
   pybind11::class_<OgaStreamingProcessor>(m, "StreamingProcessor")
       .def(pybind11::init([](OgaModel& model) { return OgaStreamingProcessor::Create(model); }),
@@ -1,11 +1,10 @@
 #include "generators.h"
-#include "softmax.h"
 #include "search.h"
 #include "beam_search_scorer.h"
 #include "cpu/interface.h"
-#include <queue>
 #include <algorithm>
 #include <limits>
+#include <sstream>
 #include <unordered_set>
 
 namespace Generators {
@@ -20,14 +19,28 @@ Search_Cpu::Search_Cpu(const GeneratorParams& params)
 
 GreedySearch_Cpu::GreedySearch_Cpu(const GeneratorParams& params)
     : Search_Cpu(params) {
-  if (params_->search.random_seed != -1)
-    gen_.seed(params_->search.random_seed);
-  else {
+  const size_t num_tasks = std::min(static_cast<size_t>(params.search.batch_size), GetThreadPool().NumThreads());
+  sampling_data_.reserve(num_tasks);
+  for (size_t i = 0; i < num_tasks; i++) {
+    sampling_data_.emplace_back(static_cast<size_t>(params.config.model.vocab_size));
+  }
+
+  generators_.resize(params.search.batch_size);
+  if (params_->search.random_seed != -1) {
+    // The first row is seeded with the seed itself, so a batch of one samples the same tokens as before
+    generators_[0].seed(params_->search.random_seed);
+    for (size_t batch_id = 1; batch_id < generators_.size(); batch_id++) {
+      std::seed_seq seq{static_cast<uint32_t>(params_->search.random_seed), static_cast<uint32_t>(batch_id)};
+      generators_[batch_id].seed(seq);
+    }
+  } else {
     std::random_device rd;
-    std::array<uint32_t, decltype(gen_)::state_size> data;
-    std::generate(data.begin(), data.end(), std::ref(rd));
-    std::seed_seq seq(data.begin(), data.end());
-    gen_.seed(seq);
+    for (auto& gen : generators_) {
+      std::array<uint32_t, std::mt19937::state_size> data;
+      std::generate(data.begin(), data.end(), std::ref(rd));
+      std::seed_seq seq(data.begin(), data.end());
+      gen.seed(seq);
+    }
   }
 
   next_tokens_ptr_ = cpu_device_.Allocate<int32_t>(params.search.batch_size);
@@ -45,6 +58,23 @@ BeamSearch_Cpu::BeamSearch_Cpu(const GeneratorParams& params)
 
   next_tokens_buffer_ = AllocateArray<int32_t>(params.BatchBeamSize(), &next_tokens_);
   memset(next_tokens_buffer_.get(), 0, next_tokens_.size_bytes());
+
+  // The per beam top k only needs room for its candidates, the indices buffer grows to the vocabulary size on first use
+  const size_t num_tasks = std::min(static_cast<size_t>(params.BatchBeamSize()), GetThreadPool().NumThreads());
+  sampling_data_.reserve(num_tasks);
+  for (size_t i = 0; i < num_tasks; i++) {
+    sampling_data_.emplace_back(0);
+  }
+
+  // Each beam contributes its top 2*num_beams tokens, or all of them when the vocabulary is smaller
+  const size_t top_k = 2 * static_cast<size_t>(params.search.num_beams);
+  const size_t num_candidates = std::min(top_k, static_cast<size_t>(params.config.model.vocab_size));
+  candidate_scores_.resize(params.BatchBeamSize() * num_candidates);
+  candidate_tokens_.resize(params.BatchBeamSize() * num_candidates);
+  candidate_order_.resize(params.search.num_beams * num_candidates);
+  top_scores_.resize(params.search.batch_size * top_k);
+  top_tokens_.resize(params.search.batch_size * top_k);
+  top_indices_.resize(params.search.batch_size * top_k);
 }
 
 BeamSearch_Cpu::~BeamSearch_Cpu() = default;
@@ -82,66 +112,42 @@ DeviceSpan<int32_t> BeamSearch_Cpu::GetNextIndices() {
 }
 
 void BeamSearch_Cpu::SelectTop() {
-  auto next_token_scores = next_token_scores_.CpuSpan();
-
-  // Normalize next token scores
-  for (size_t i = 0; i < params_->BatchBeamSize(); i++) {
-    std::span<float> const scores = next_token_scores.subspan(i * static_cast<size_t>(params_->config.model.vocab_size), params_->config.model.vocab_size);
-    LogSoftMax(scores, 1.0);
-  }
+  const size_t vocab_size = params_->config.model.vocab_size;
+  const size_t num_beams = params_->search.num_beams;
+  const size_t batch_beam_size = params_->BatchBeamSize();
+  const size_t top_k = 2 * num_beams;
+  const size_t num_candidates = std::min(top_k, vocab_size);
 
+  auto next_token_scores = next_token_scores_.CpuSpan();
   auto beam_scores = beam_scorer_->GetNextScores().Span();
-
-  // Add beam score to next token scores. Corresponding python code is like:
-  //    next_token_scores = next_token_scores + beam_scores[:, None].expand_as(next_token_scores)
-  // TODO(aciddelgado): use thread pool to parallel
-  int offset = 0;
-  int batch_beam_index = 0;
-  for (int i = 0; i < params_->search.batch_size; i++) {
-    for (int j = 0; j < params_->search.num_beams; j++, batch_beam_index++) {
-      for (int k = 0; k < params_->config.model.vocab_size; k++, offset++) {
-        next_token_scores[offset] += beam_scores[batch_beam_index];
-      }
+  std::span<float> const candidate_scores{candidate_scores_};
+  std::span<int32_t> const candidate_tokens{candidate_tokens_};
+
+  // The score of a token is its log softmax plus the beam score. Corresponding python code is like:
+  //    next_token_scores = log_softmax(next_token_scores) + beam_scores[:, None].expand_as(next_token_scores)
+  // The top k of a batch entry is among the top k of its beams, so each beam selects its own candidates first.
+  const size_t num_tasks = sampling_data_.size();
+  GetThreadPool().ParallelFor(num_tasks, [&](size_t task) {
+    for (size_t i = task; i < batch_beam_size; i += num_tasks) {
+      cpu::SelectBeamCandidates(next_token_scores.subspan(i * vocab_size, vocab_size), beam_scores[i], sampling_data_[task],
+                                candidate_scores.subspan(i * num_candidates, num_candidates),
+                                candidate_tokens.subspan(i * num_candidates, num_candidates));
     }
-  }
-
-  const size_t top_k = 2 * params_->search.num_beams;
-
-  struct ScoreIndex {
-    float score;
-    int32_t index;
+  });
 
-    bool operator<(const ScoreIndex& s) const { return score < s.score; }
-  };
-
-  auto scores = std::make_unique<float[]>(top_k * params_->search.batch_size);     // Score of top_k tokens
-  auto indices = std::make_unique<int32_t[]>(top_k * params_->search.batch_size);  // beam index of top_k tokens
-  auto tokens = std::make_unique<int32_t[]>(top_k * params_->search.batch_size);   // token id of top_k tokens
-
-  auto next_scores = std::span<float>(scores.get(), top_k * params_->search.batch_size);
-  auto next_indices = std::span<int32_t>(indices.get(), top_k * params_->search.batch_size);
-  auto next_tokens = std::span<int32_t>(tokens.get(), top_k * params_->search.batch_size);
-
-  // TODO(aciddelgado): Optimize this top k with partial sort
   for (size_t batch_index = 0; batch_index < static_cast<size_t>(params_->search.batch_size); batch_index++) {
-    std::priority_queue<ScoreIndex, std::vector<ScoreIndex>> queue;
-    auto token_scores_sub = next_token_scores.subspan(batch_index * params_->search.num_beams * params_->config.model.vocab_size, static_cast<size_t>(params_->search.num_beams) * params_->config.model.vocab_size);
-    for (int i = 0; i < token_scores_sub.size(); i++) {
-      queue.push({token_scores_sub[i], i});
-    }
-
-    auto next_indices_sub = next_indices.subspan(top_k * batch_index, top_k);
-    auto next_tokens_sub = next_tokens.subspan(top_k * batch_index, top_k);
-    auto next_scores_sub = next_scores.subspan(top_k * batch_index, top_k);
-    for (unsigned i = 0; i < top_k; i++) {
-      auto v = queue.top();
-      next_indices_sub[i] = v.index / params_->config.model.vocab_size;
-      next_tokens_sub[i] = v.index % params_->config.model.vocab_size;
-      next_scores_sub[i] = v.score;
-      queue.pop();
-    }
+    const size_t candidate_offset = batch_index * num_beams * num_candidates;
+    cpu::MergeBeamCandidates(candidate_scores.subspan(candidate_offset, num_beams * num_candidates),
+                             candidate_tokens.subspan(candidate_offset, num_beams * num_candidates), num_beams, candidate_order_,
+                             std::span<float>{top_scores_}.subspan(batch_index * top_k, top_k),
+                             std::span<int32_t>{top_tokens_}.subspan(batch_index * top_k, top_k),
+                             std::span<int32_t>{top_indices_}.subspan(batch_index * top_k, top_k));
   }
 
+  std::span<const float> const next_scores{top_scores_};
+  std::span<const int32_t> const next_tokens{top_tokens_};
+  std::span<const int32_t> const next_indices{top_indices_};
+
 #if 0  // TODO(ryanhill): Use logging option
   DumpSpan(std::cout, next_tokens);
   DumpSpan(std::cout, next_indices_);
@@ -156,137 +162,57 @@ void BeamSearch_Cpu::SelectTop() {
 
 void GreedySearch_Cpu::SelectTop() {
   // next_tokens = torch.argmax(scores, dim=-1)
-  for (size_t batch_id = 0; batch_id < params_->search.batch_size; batch_id++) {
-    if (PadIfAlreadyEOS(batch_id)) {
-      continue;
-    }
-
-    std::span<float> const scores = next_token_scores_.CpuSpan().subspan(batch_id * params_->config.model.vocab_size, params_->config.model.vocab_size);
-    auto const token = static_cast<int32_t>(std::distance(scores.begin(), std::max_element(scores.begin(), scores.end())));
-    SetNextToken(batch_id, token);
-  }
-
-  if (!done_)
-    AppendNextTokensToSequences();
+  SampleRows([](cpu::SamplingData&, std::mt19937&, std::span<const float> scores) {
+    return cpu::ArgMax(scores);
+  });
 }
 
 void GreedySearch_Cpu::SampleTopK(int k, float temperature) {
-  for (size_t batch_id = 0; batch_id < params_->search.batch_size; batch_id++) {
-    if (PadIfAlreadyEOS(batch_id)) {
-      continue;
-    }
-    std::span<float> const scores = next_token_scores_.CpuSpan().subspan(batch_id * params_->config.model.vocab_size, params_->config.model.vocab_size);
-    // Find the top K scores
-    std::vector<int> indices(scores.size());
-    std::iota(indices.begin(), indices.end(), 0);
-    std::partial_sort(indices.begin(), indices.begin() + k, indices.end(), [scores = scores.data()](int i, int j) { return scores[i] > scores[j]; });
-    std::vector<float> top_k_scores(k);
-    for (int i = 0; i < k; i++)
-      top_k_scores[i] = scores[indices[i]];
-    // Sample a token from the top K
-    Softmax(top_k_scores, temperature);
-    std::discrete_distribution<> dis(top_k_scores.begin(), top_k_scores.end());
-    SetNextToken(batch_id, indices[dis(gen_)]);
-  }
-  if (!done_)
-    AppendNextTokensToSequences();
+  SampleRows([k, temperature](cpu::SamplingData& data, std::mt19937& gen, std::span<const float> scores) {
+    return cpu::SampleTopK(data, gen, scores, k, temperature);
+  });
 }
 
 void GreedySearch_Cpu::SampleTopP(float p, float temperature) {
-  for (size_t batch_id = 0; batch_id < params_->search.batch_size; batch_id++) {
-    if (PadIfAlreadyEOS(batch_id)) {
-      continue;
-    }
-
-    std::span<float> scores = next_token_scores_.CpuSpan().subspan(batch_id * params_->config.model.vocab_size, params_->config.model.vocab_size);
-
-    // 1. Apply temperature and softmax to get probabilities
-    Softmax(scores, temperature);
-
-    // 2. Sort indices by probability
-    std::vector<int32_t> indices(scores.size());
-    std::iota(indices.begin(), indices.end(), 0);
-    std::sort(indices.begin(), indices.end(),
-              [&scores](int32_t i, int32_t j) { return scores[i] > scores[j]; });
-
-    // 3. Find nucleus and mute probabilities of tokens outside it
-    float cumulative_prob = 0.0f;
-    for (size_t i = 0; i < indices.size(); ++i) {
-      cumulative_prob += scores[indices[i]];
-      if (cumulative_prob >= p) {
-        for (size_t j = i + 1; j < indices.size(); ++j) {
-          scores[indices[j]] = 0.0f;
-        }
-        break;
-      }
-    }
-
-    // 4. Sample
-    std::discrete_distribution<> dist(scores.begin(), scores.end());
-    int32_t token = dist(gen_);
-
-    SetNextToken(batch_id, token);
-  }
-  if (!done_)
-    AppendNextTokensToSequences();
+  SampleRows([p, temperature](cpu::SamplingData& data, std::mt19937& gen, std::span<const float> scores) {
+    return cpu::SampleTopP(data, gen, scores, p, temperature);
+  });
 }
 
 void GreedySearch_Cpu::SampleTopKTopP(int k, float p, float temperature) {
   assert(temperature > 0.0f);
 
-  // --- Buffers allocated once to avoid re-allocations in the batch loop ---
-  std::vector<int32_t> indices(params_->config.model.vocab_size);
-
-  // Buffer for the top-k logits
-  std::vector<float> top_k_logits;
-  top_k_logits.reserve(k);
-
-  // Buffer for probabilities used in Top-P filtering
-  std::vector<float> temp_probs;
-  temp_probs.reserve(k);
-
-  for (size_t batch_id = 0; batch_id < params_->search.batch_size; batch_id++) {
-    if (PadIfAlreadyEOS(batch_id)) {
-      continue;
-    }
+  SampleRows([k, p, temperature](cpu::SamplingData& data, std::mt19937& gen, std::span<const float> scores) {
+    return cpu::SampleTopKTopP(data, gen, scores, k, p, temperature);
+  });
+}
 
-    std::span<float> scores = next_token_scores_.CpuSpan().subspan(batch_id * params_->config.model.vocab_size, params_->config.model.vocab_size);
+void GreedySearch_Cpu::SampleRows(const SampleRowFunction& sample) {
+  const size_t batch_size = params_->search.batch_size;
+  const size_t vocab_size = params_->config.model.vocab_size;
+  auto next_token_scores = next_token_scores_.CpuSpan();
 
-    std::iota(indices.begin(), indices.end(), 0);
-    std::partial_sort(indices.begin(), indices.begin() + k, indices.end(),
-                      [&scores](int32_t i, int32_t j) { return scores[i] > scores[j]; });
+  // Rows are dealt round robin to one task per scratch buffer, so no two threads share a buffer
+  const size_t num_tasks = sampling_data_.size();
+  GetThreadPool().ParallelFor(num_tasks, [&](size_t task) {
+    for (size_t batch_id = task; batch_id < batch_size; batch_id += num_tasks) {
+      if (eos_seen_[batch_id]) {
+        continue;
+      }
 
-    // 2. Populate top K logits, applying temperature.
-    top_k_logits.clear();
-    for (int i = 0; i < k; ++i) {
-      top_k_logits.push_back(scores[indices[i]] / temperature);
+      std::span<const float> const scores = next_token_scores.subspan(batch_id * vocab_size, vocab_size);
+      next_tokens_[batch_id] = sample(sampling_data_[task], generators_[batch_id], scores);
     }
+  });
 
-    // 3. Top-p (nucleus) filtering.
-    temp_probs.assign(top_k_logits.begin(), top_k_logits.end());
-    Softmax(temp_probs, 1.0f);  // Temperature is already baked into top_k_logits
-
-    float cumulative_prob = 0.0f;
-    int cutoff_index = k;  // Default to keeping all top-k tokens
-    for (int i = 0; i < k; ++i) {
-      cumulative_prob += temp_probs[i];
-      if (cumulative_prob >= p) {
-        cutoff_index = i + 1;
-        break;
-      }
+  // The done state is shared by all rows, so it is updated after sampling on this thread
+  for (size_t batch_id = 0; batch_id < batch_size; batch_id++) {
+    if (PadIfAlreadyEOS(batch_id)) {
+      continue;
     }
-
-    // 4. Resize logits to the nucleus, re-normalize, and sample.
-    top_k_logits.resize(cutoff_index);
-    Softmax(top_k_logits, 1.0f);
-
-    std::discrete_distribution<> dist(top_k_logits.begin(), top_k_logits.end());
-    int32_t sampled_k_index = dist(gen_);
-
-    // The final token is the one from the original vocab indices.
-    int32_t token = indices[sampled_k_index];
-    SetNextToken(batch_id, token);
+    SetNextToken(batch_id, next_tokens_[batch_id]);
   }
+
   if (!done_)
     AppendNextTokensToSequences();
 }
@@ -361,6 +287,53 @@ void GreedySearch_Cpu::RewindTo(size_t index) {
   sequences_.RewindTo(index);
 }
 
+std::string GreedySearch_Cpu::GetRandomState() const {
+  std::ostringstream stream;
+  for (const auto& gen : generators_)
+    stream << gen << ' ';
+  return stream.str();
+}
+
+void GreedySearch_Cpu::SetRandomState(std::string_view state) {
+  if (state.empty())
+    return;  // Saved by a search without random state, keep the seeded generators
+
+  std::istringstream stream{std::string{state}};
+  for (auto& gen : generators_)
+    stream >> gen;
+  if (!stream)
+    throw std::runtime_error("The random state does not match the batch size of the search");
+}
+
+void GreedySearch_Cpu::ReseedForFork(std::span<const uint32_t> fork_path) {
+  if (params_->search.random_seed == -1)
+    return;  // Already seeded from std::random_device
+
+  for (size_t batch_id = 0; batch_id < generators_.size(); batch_id++) {
+    std::vector<uint32_t> seed{static_cast<uint32_t>(params_->search.random_seed), static_cast<uint32_t>(batch_id)};
+    seed.insert(seed.end(), fork_path.begin(), fork_path.end());
+    std::seed_seq seq(seed.begin(), seed.end());
+    generators_[batch_id].seed(seq);
+  }
+}
+
+static size_t SizeInBytes(const std::vector<cpu::SamplingData>& sampling_data) {
+  size_t size{};
+  for (const auto& data : sampling_data)
+    size += (data.indices.capacity() + data.candidates.capacity()) * sizeof(int32_t) + data.probs.capacity() * sizeof(float) + sizeof(data.masses);
+  return size;
+}
+
+size_t GreedySearch_Cpu::ScratchSizeInBytes() const {
+  return Search::ScratchSizeInBytes() + SizeInBytes(sampling_data_);
+}
+
+size_t BeamSearch_Cpu::ScratchSizeInBytes() const {
+  return Search::ScratchSizeInBytes() + SizeInBytes(sampling_data_) +
+         (candidate_scores_.capacity() + top_scores_.capacity()) * sizeof(float) +
+         (candidate_tokens_.capacity() + candidate_order_.capacity() + top_tokens_.capacity() + top_indices_.capacity()) * sizeof(int32_t);
+}
+
 void BeamSearch_Cpu::AppendTokens(DeviceSpan<int32_t>& next_tokens) {
   // Set user-defined next tokens
   auto next_tokens_cpu = next_tokens.CpuSpan();
@@ -460,9 +433,14 @@ void Search_Cpu::ApplyRepetitionPenalty(float penalty) {
     return;
 
   const int batch_beam_size = params_->BatchBeamSize();
+  std::vector<std::span<const int32_t>> sequences(batch_beam_size);
   for (int i = 0; i < batch_beam_size; i++) {
-    std::span<float> const beam_token_scores = GetScores(i);
-    std::span<const int32_t> const sequence = sequences_.GetSequence(i).CopyDeviceToCpu();
+    sequences[i] = sequences_.GetSequence(i).CopyDeviceToCpu();
+  }
+
+  GetThreadPool().ParallelFor(batch_beam_size, [&](size_t i) {
+    std::span<float> const beam_token_scores = GetScores(static_cast<int>(i));
+    std::span<const int32_t> const sequence = sequences[i];
 
     // Find unique word IDs in sequence.
     std::unordered_set<int32_t> unique_word_ids;
@@ -477,7 +455,7 @@ void Search_Cpu::ApplyRepetitionPenalty(float penalty) {
       // This assumes that scores are either positive (like ctrl) or negative (like GPT-2), but not a mixture.
       beam_token_scores[word_id] = (score < 0 ? score * penalty : score / penalty);
     }
-  }
+  });
 }
 
 }  // namespace Generators
@@ -1,6 +1,7 @@
 #include "sequences.h"
 #include <random>
 #include "beam_search_scorer.h"
+#include "cpu/cpu_sampling.h"
 #pragma once
 
 namespace Generators {
@@ -34,6 +35,23 @@ struct Search : LeakChecked<Search> {
   // To be used for rewind
   virtual void RewindTo(size_t index) { assert(false); };
 
+  // The state of the random number generators as text, so a restored generator samples the same tokens
+  virtual std::string GetRandomState() const { return {}; }
+  virtual void SetRandomState(std::string_view state) {
+    if (!state.empty())
+      throw std::runtime_error("The random state cannot be restored by this search");
+  }
+  // Gives a forked generator its own random stream. With a fixed random_seed the stream is derived from the seed
+  // and the path of fork indices from the first generator, so forks are reproducible and differ from each other.
+  // A search that cannot reseed would repeat the tokens of its parent, so it refuses to fork with a fixed seed.
+  virtual void ReseedForFork(std::span<const uint32_t> /*fork_path*/) {
+    if (params_->search.random_seed != -1)
+      throw std::runtime_error("Fork with a fixed random_seed is not supported by this search");
+  }
+
+  // Returns the bytes of the buffers of the search, see MemoryUsage::scratch
+  virtual size_t ScratchSizeInBytes() const { return sequences_.SizeInBytes(); }
+
   std::shared_ptr<const GeneratorParams> params_;
   Sequences sequences_;
 };
@@ -80,20 +98,31 @@ struct GreedySearch_Cpu : Search_Cpu {
   void AppendTokens(DeviceSpan<int32_t>& next_tokens) override;
   void RewindTo(size_t index) override;
 
+  std::string GetRandomState() const override;
+  void SetRandomState(std::string_view state) override;
+  void ReseedForFork(std::span<const uint32_t> fork_path) override;
+
+  size_t ScratchSizeInBytes() const override;
+
  protected:
   void SetNextToken(size_t batch_id, int32_t token);
   void AppendNextTokensToSequences();
 
   bool PadIfAlreadyEOS(size_t batch_id);
 
+  // Picks the next token of every batch entry that has not seen EOS by calling sample on its scores.
+  // The rows are spread over the shared thread pool, then the tokens are appended to the sequences.
+  using SampleRowFunction = std::function<int32_t(cpu::SamplingData&, std::mt19937&, std::span<const float>)>;
+  void SampleRows(const SampleRowFunction& sample);
+
   DeviceSpan<int32_t> next_tokens_ptr_;
-  std::unique_ptr<int32_t[]> temp_topk_buffer_;
+  std::vector<cpu::SamplingData> sampling_data_;  // Scratch buffers reused by every sampling call, one per concurrent task
 
   std::span<bool> eos_seen_;  // shape (batch_size)
   std::unique_ptr<bool[]> eos_seen_buffer_;
   int not_done_count_{params_->search.batch_size};  // When zero, every batch entry is done (starts at batch_size_)
 
-  std::mt19937 gen_;
+  std::vector<std::mt19937> generators_;  // shape (batch_size), one stream per row so results do not depend on the thread count
 };
 
 struct BeamSearch_Cpu : Search_Cpu {
@@ -112,6 +141,8 @@ struct BeamSearch_Cpu : Search_Cpu {
 
   void AppendTokens(DeviceSpan<int32_t>& next_tokens) override;
 
+  size_t ScratchSizeInBytes() const override;
+
  private:
   void AppendNextTokensToSequences();
   void Finalize(size_t num_return_sequences);
@@ -121,6 +152,15 @@ struct BeamSearch_Cpu : Search_Cpu {
   std::unique_ptr<int32_t[]> next_tokens_buffer_;  // prevents freeing of next_tokens buffer for setting user tokens
 
   std::unique_ptr<BeamSearchScorer> beam_scorer_;
+
+  // Buffers of SelectTop, allocated once instead of on every step
+  std::vector<cpu::SamplingData> sampling_data_;  // Scratch buffers of the per beam top k, one per concurrent task
+  std::vector<float> candidate_scores_;           // shape (batch_size*num_beams, min(2*num_beams, vocab_size)), best scores of each beam
+  std::vector<int32_t> candidate_tokens_;         // shape (batch_size*num_beams, min(2*num_beams, vocab_size)), token ids of those scores
+  std::vector<int32_t> candidate_order_;          // shape (num_beams*min(2*num_beams, vocab_size)), used to merge the candidates of a batch entry
+  std::vector<float> top_scores_;                 // shape (batch_size, 2*num_beams), score of the top tokens
+  std::vector<int32_t> top_tokens_;               // shape (batch_size, 2*num_beams), token id of the top tokens
+  std::vector<int32_t> top_indices_;              // shape (batch_size, 2*num_beams), beam index of the top tokens
 };
 
 }  // namespace Generators
\ No newline at end of file
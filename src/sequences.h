@@ -23,6 +23,8 @@ struct Sequences {
   // Returns current sequence length.
   int GetSequenceLength() const { return current_length_; }
 
+  size_t SizeInBytes() const { return (sequences_.size() + sequences_next_.size()) * sizeof(int32_t); }
+
   // After tokens are appended, this function must be called to update the state & log the tokens
   void AfterAppendNextTokens(DeviceSpan<int32_t>& next_tokens, size_t batch_beam_size);
 
@@ -0,0 +1,176 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "engine/block.h"
+#include "statistics_helper.h"
+
+namespace Generators::test {
+
+namespace {
+
+// The BlockPool as it was before the free list was introduced. Every allocation scans the pool for an
+// empty slot and every availability query counts the empty slots. Kept here as the benchmark baseline.
+struct LinearScanBlockPool {
+  LinearScanBlockPool(size_t block_size, size_t num_blocks)
+      : block_size_(block_size), blocks_(num_blocks) {}
+
+  size_t AvailableBlocks() const {
+    return std::count_if(blocks_.begin(), blocks_.end(), [](const std::shared_ptr<Block>& block) { return block == nullptr; });
+  }
+
+  size_t BlocksNeeded(size_t num_slots) const {
+    return (num_slots + block_size_ - 1) / block_size_;
+  }
+
+  std::vector<std::shared_ptr<Block>> AllocateBlocks(size_t num_slots) {
+    std::vector<std::shared_ptr<Block>> allocated_blocks;
+    for (size_t i = 0; i < num_slots; i += block_size_) {
+      for (size_t j = 0; j < blocks_.size(); ++j) {
+        if (blocks_[j] == nullptr) {
+          blocks_[j] = std::make_shared<Block>(j, std::min(block_size_, num_slots - i), block_size_);
+          allocated_blocks.push_back(blocks_[j]);
+          break;
+        }
+      }
+    }
+    return allocated_blocks;
+  }
+
+  void Free(const std::vector<std::shared_ptr<Block>>& blocks) {
+    for (const auto& block : blocks) {
+      blocks_[block->Id()].reset();
+    }
+  }
+
+ private:
+  const size_t block_size_;
+  std::vector<std::shared_ptr<Block>> blocks_;
+};
+
+struct BenchmarkParams {
+  size_t num_blocks;
+  size_t num_requests;
+};
+
+struct BenchmarkResult {
+  BenchmarkParams params;
+  double linear_scan_us;
+  double free_list_us;
+};
+
+// Simulates the block pool traffic of engine steps: every active request checks whether its next
+// token fits and appends a block when its last block is full, then a few requests complete and
+// free their blocks while new requests are admitted.
+template <typename Pool>
+double RunSteps(Pool& pool, const BenchmarkParams& params, size_t block_size) {
+  constexpr size_t num_warm_up_steps = 5;
+  constexpr size_t num_steps = 50;
+  constexpr size_t num_requests_replaced_per_step = 4;
+
+  std::mt19937 engine(0);
+  std::uniform_int_distribution<size_t> prompt_length(block_size, 8 * block_size);
+  std::uniform_int_distribution<size_t> request_index(0, params.num_requests - 1);
+
+  struct SimulatedRequest {
+    std::vector<std::shared_ptr<Block>> blocks;
+    size_t num_slots;
+  };
+
+  std::vector<SimulatedRequest> requests(params.num_requests);
+  for (auto& request : requests) {
+    request.num_slots = prompt_length(engine);
+    request.blocks = pool.AllocateBlocks(request.num_slots);
+  }
+
+  std::vector<double> latencies;
+  for (size_t step = 0; step < num_warm_up_steps + num_steps; ++step) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (auto& request : requests) {
+      const bool needs_block = request.num_slots % block_size == 0;
+      EXPECT_TRUE(pool.AvailableBlocks() > (needs_block ? pool.BlocksNeeded(1) : 0));
+      if (needs_block) {
+        auto blocks = pool.AllocateBlocks(1);
+        request.blocks.insert(request.blocks.end(), blocks.begin(), blocks.end());
+      }
+      request.num_slots++;
+    }
+
+    for (size_t i = 0; i < num_requests_replaced_per_step; ++i) {
+      auto& request = requests[request_index(engine)];
+      pool.Free(request.blocks);
+      request.num_slots = prompt_length(engine);
+      request.blocks = pool.AllocateBlocks(request.num_slots);
+    }
+
+    auto stop = std::chrono::high_resolution_clock::now();
+    if (step >= num_warm_up_steps) {
+      latencies.push_back(static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count()) / 1000.0);
+    }
+  }
+
+  for (auto& request : requests) {
+    pool.Free(request.blocks);
+  }
+
+  return mean(latencies);
+}
+
+}  // namespace
+
+TEST(BlockPoolBenchmarks, PerformanceTests) {
+  constexpr size_t block_size = 16;
+  const std::vector<BenchmarkParams> test_cases = {
+      {1024, 16},
+      {16384, 64},
+      {65536, 256},
+  };
+
+  std::vector<BenchmarkResult> results;
+  for (const auto& params : test_cases) {
+    LinearScanBlockPool linear_scan_pool(block_size, params.num_blocks);
+    BlockPool free_list_pool(block_size, params.num_blocks);
+    results.push_back({params,
+                       RunSteps(linear_scan_pool, params, block_size),
+                       RunSteps(free_list_pool, params, block_size)});
+
+    const auto stats = free_list_pool.Stats();
+    EXPECT_EQ(stats.num_available_blocks, params.num_blocks);
+    EXPECT_EQ(stats.num_allocations, stats.num_frees);
+    EXPECT_LE(stats.high_water_mark, params.num_blocks);
+  }
+
+  // clang-format off
+  std::cout << "\n--- BlockPool Benchmark Summary (per engine step) ---\n";
+  std::cout << std::left
+            << std::setw(12) << "Blocks"
+            << std::setw(12) << "Requests"
+            << std::setw(18) << "LinearScan(us)"
+            << std::setw(18) << "FreeList(us)"
+            << std::setw(10) << "Speedup" << "\n";
+  std::cout << std::string(70, '-') << "\n";
+
+  for (const auto& result : results) {
+    std::cout << std::left << std::fixed << std::setprecision(2)
+              << std::setw(12) << result.params.num_blocks
+              << std::setw(12) << result.params.num_requests
+              << std::setw(18) << result.linear_scan_us
+              << std::setw(18) << result.free_list_us
+              << std::setw(10) << result.linear_scan_us / result.free_list_us
+              << "\n";
+  }
+  // clang-format on
+}
+
+}  // namespace Generators::test
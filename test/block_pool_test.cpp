@@ -0,0 +1,157 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "engine/block.h"
+
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace Generators::test {
+
+namespace {
+
+constexpr size_t block_size = 4;
+
+// Allocates a full block and registers it for prefix caching as the block of token_ids after parent_hash
+std::shared_ptr<Block> AllocateCachedBlock(BlockPool& pool, const std::vector<int32_t>& token_ids, size_t parent_hash = 0) {
+  auto block = pool.AllocateBlocks(block_size).front();
+  EXPECT_TRUE(pool.CacheBlock(block, ComputeBlockHash(parent_hash, token_ids), parent_hash, token_ids));
+  return block;
+}
+
+}  // namespace
+
+TEST(BlockPoolTest, LookupRejectsHashCollisions) {
+  BlockPool pool(block_size, 4);
+  const std::vector<int32_t> token_ids{1, 2, 3, 4}, other_token_ids{5, 6, 7, 8};
+  const size_t hash = ComputeBlockHash(0, token_ids);
+  auto block = AllocateCachedBlock(pool, token_ids);
+
+  EXPECT_EQ(pool.LookupCachedBlock(hash, 0, token_ids), block);
+
+  // The same hash for other tokens, or for the same tokens after another parent block, is a collision
+  EXPECT_EQ(pool.LookupCachedBlock(hash, 0, other_token_ids), nullptr);
+  EXPECT_EQ(pool.LookupCachedBlock(hash, 1, token_ids), nullptr);
+  EXPECT_EQ(pool.LookupCachedBlock(ComputeBlockHash(0, other_token_ids), 0, other_token_ids), nullptr);
+
+  // A second block with the same hash stays private to its request
+  auto other_block = pool.AllocateBlocks(block_size).front();
+  EXPECT_FALSE(pool.CacheBlock(other_block, hash, 0, other_token_ids));
+  EXPECT_FALSE(other_block->Hash().has_value());
+  EXPECT_EQ(pool.LookupCachedBlock(hash, 0, token_ids), block);
+  EXPECT_EQ(pool.Stats().num_cached_blocks, 1);
+}
+
+TEST(BlockPoolTest, CachedBlocksAreReferenceCounted) {
+  BlockPool pool(block_size, 4);
+  const std::vector<int32_t> token_ids{1, 2, 3, 4};
+  auto block = AllocateCachedBlock(pool, token_ids);
+  EXPECT_EQ(pool.AvailableBlocks(), 3);
+
+  // A second request shares the block
+  pool.AcquireCachedBlock(block);
+  EXPECT_EQ(block->RefCount(), 2);
+  EXPECT_EQ(pool.Stats().num_cache_hits, 1);
+
+  // The block stays in use until both requests free it, then it is cached but available
+  pool.Free({block});
+  EXPECT_EQ(block->RefCount(), 1);
+  EXPECT_EQ(pool.AvailableBlocks(), 3);
+  pool.Free({block});
+  EXPECT_EQ(block->RefCount(), 0);
+  EXPECT_EQ(pool.AvailableBlocks(), 4);
+  EXPECT_EQ(pool.Stats().num_cached_blocks, 1);
+
+  // A later request with the same prefix takes the unreferenced block back from the evictable blocks
+  auto cached_block = pool.LookupCachedBlock(ComputeBlockHash(0, token_ids), 0, token_ids);
+  ASSERT_EQ(cached_block, block);
+  pool.AcquireCachedBlock(cached_block);
+  EXPECT_EQ(cached_block->RefCount(), 1);
+  EXPECT_EQ(pool.AvailableBlocks(), 3);
+  EXPECT_EQ(pool.Stats().num_cache_hits, 2);
+
+  EXPECT_THROW(pool.AllocateBlocks(4 * block_size), std::runtime_error);
+  auto blocks = pool.AllocateBlocks(3 * block_size);
+  EXPECT_EQ(pool.AvailableBlocks(), 0);
+  EXPECT_EQ(pool.Stats().num_evictions, 0);
+  pool.Free(blocks);
+  pool.Free({cached_block});
+}
+
+TEST(BlockPoolTest, EvictsLeastRecentlyFreedCachedBlocks) {
+  BlockPool pool(block_size, 3);
+  const std::vector<std::vector<int32_t>> token_ids{{1, 2, 3, 4}, {5, 6, 7, 8}, {9, 10, 11, 12}};
+  std::vector<std::shared_ptr<Block>> blocks;
+  std::vector<size_t> hashes;
+  for (const auto& block_token_ids : token_ids) {
+    blocks.push_back(AllocateCachedBlock(pool, block_token_ids));
+    hashes.push_back(ComputeBlockHash(0, block_token_ids));
+  }
+
+  // Free the blocks out of order, then reuse the first block so that it is freed last
+  pool.Free({blocks[0]});
+  pool.Free({blocks[2]});
+  pool.Free({blocks[1]});
+  pool.AcquireCachedBlock(blocks[0]);
+  pool.Free({blocks[0]});
+  EXPECT_EQ(pool.AvailableBlocks(), 3);
+
+  const auto is_cached = [&](size_t i) { return pool.LookupCachedBlock(hashes[i], 0, token_ids[i]) != nullptr; };
+
+  auto allocated = pool.AllocateBlocks(1);
+  EXPECT_FALSE(is_cached(2));
+  EXPECT_TRUE(is_cached(1));
+  EXPECT_TRUE(is_cached(0));
+
+  auto more_allocated = pool.AllocateBlocks(1);
+  EXPECT_FALSE(is_cached(1));
+  EXPECT_TRUE(is_cached(0));
+
+  const auto stats = pool.Stats();
+  EXPECT_EQ(stats.num_evictions, 2);
+  EXPECT_EQ(stats.num_cached_blocks, 1);
+  EXPECT_EQ(stats.num_available_blocks, 1);
+  pool.Free(allocated);
+  pool.Free(more_allocated);
+}
+
+TEST(BlockPoolTest, SizesBlocksByTheElementSizeOfTheCache) {
+  // A layer of 32 key-value heads of 128 elements per slot, 16 slots per block, stored in float16 and in int8
+  constexpr size_t num_layers = 32, num_caches_per_layer = 2;
+  const size_t float16_block_size = ComputeBlockSizeInBytes(16, 32, 128, 2);
+  const size_t int8_block_size = ComputeBlockSizeInBytes(16, 32, 128, 1);
+  EXPECT_EQ(float16_block_size, 131072);
+  EXPECT_EQ(int8_block_size, 65536);
+
+  // The same memory holds twice as many blocks of a cache of half the element size, up to rounding
+  const size_t float16_bytes_per_block = float16_block_size * num_caches_per_layer * num_layers;
+  const size_t int8_bytes_per_block = int8_block_size * num_caches_per_layer * num_layers;
+  constexpr size_t free_bytes = size_t{8} << 30;
+  const size_t float16_blocks = ComputeNumBlocks(float16_bytes_per_block, free_bytes, 0.5f, std::nullopt);
+  const size_t int8_blocks = ComputeNumBlocks(int8_bytes_per_block, free_bytes, 0.5f, std::nullopt);
+  EXPECT_EQ(float16_blocks, static_cast<size_t>(free_bytes * 0.9f * 0.5f) / float16_bytes_per_block);
+  EXPECT_EQ(int8_blocks, static_cast<size_t>(free_bytes * 0.9f * 0.5f) / int8_bytes_per_block);
+  EXPECT_GE(int8_blocks, 2 * float16_blocks);
+
+  constexpr size_t max_memory_bytes = size_t{1} << 30;
+  EXPECT_EQ(ComputeNumBlocks(float16_bytes_per_block, 0, std::nullopt, max_memory_bytes), 128);
+  EXPECT_EQ(ComputeNumBlocks(int8_bytes_per_block, 0, std::nullopt, max_memory_bytes), 256);
+}
+
+TEST(BlockPoolTest, CapsTheNumberOfBlocksAtTheMemoryBudget) {
+  constexpr size_t bytes_per_block = size_t{1} << 20;
+  constexpr size_t free_bytes = size_t{16} << 30;
+
+  // The budget is smaller than the fraction of the free memory, then larger
+  EXPECT_EQ(ComputeNumBlocks(bytes_per_block, free_bytes, 0.9f, size_t{100} << 20), 100);
+  EXPECT_EQ(ComputeNumBlocks(bytes_per_block, free_bytes, 0.1f, size_t{64} << 30),
+            static_cast<size_t>(free_bytes * 0.9f * 0.1f) / bytes_per_block);
+
+  EXPECT_THROW(ComputeNumBlocks(bytes_per_block, free_bytes, std::nullopt, std::nullopt), std::runtime_error);
+}
+
+}  // namespace Generators::test
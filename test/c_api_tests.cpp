@@ -1,6 +1,8 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT License.
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstdlib>
 #include <cstring>  // for memcmp
@@ -108,6 +110,71 @@ TEST(CAPITests, TokenizerCAPI) {
 #endif
 }
 
+TEST(CAPITests, BatchTokenizerStreamCAPI) {
+#if TEST_PHI2
+  auto model = OgaModel::Create(PHI2_PATH);
+  auto tokenizer = OgaTokenizer::Create(*model);
+
+  const char* input_strings[] = {
+      "This is a test.",
+      "Rats are awesome pets! \xf0\x9f\x90\x80",  // The rat emoji is split across tokens
+      "The quick brown fox jumps over the lazy dog at the caf\xc3\xa9.",
+  };
+
+  auto sequences = OgaSequences::Create();
+  for (auto& string : input_strings)
+    tokenizer->Encode(string, *sequences);
+
+  // Decode a token of every sequence per call, like the new tokens of the requests of an engine step
+  auto stream = OgaBatchTokenizerStream::Create(*tokenizer);
+  std::vector<std::string> results(sequences->Count());
+  for (size_t step = 0;; step++) {
+    std::vector<uint64_t> stream_ids;
+    std::vector<int32_t> tokens;
+    for (size_t i = 0; i < sequences->Count(); i++) {
+      if (step < sequences->SequenceCount(i)) {
+        stream_ids.push_back(i);
+        tokens.push_back(sequences->SequenceData(i)[step]);
+      }
+    }
+    if (tokens.empty())
+      break;
+
+    const char* text;
+    const size_t* offsets;
+    stream->Decode(stream_ids.data(), tokens.data(), tokens.size(), text, offsets);
+    for (size_t j = 0; j < tokens.size(); j++)
+      results[stream_ids[j]].append(text + offsets[j], offsets[j + 1] - offsets[j]);
+  }
+
+  for (size_t i = 0; i < sequences->Count(); i++) {
+    EXPECT_EQ(results[i], input_strings[i]);
+    stream->Remove(i);
+  }
+
+  // Updating the options of the tokenizer mid-stream applies to the tokens decoded after the update
+  const int32_t end_of_text = 50256;
+  auto decode = [&](int32_t token) {
+    const uint64_t stream_id = 0;
+    const char* text;
+    const size_t* offsets;
+    stream->Decode(&stream_id, &token, 1, text, offsets);
+    return std::string(text + offsets[0], offsets[1] - offsets[0]);
+  };
+  std::string text;
+  for (size_t i = 0; i < sequences->SequenceCount(0); i++)
+    text += decode(sequences->SequenceData(0)[i]);
+  text += decode(end_of_text);
+  EXPECT_EQ(text, input_strings[0]);
+
+  const char* keys[] = {"skip_special_tokens"};
+  const char* values[] = {"false"};
+  tokenizer->UpdateOptions(keys, values, 1);
+  EXPECT_EQ(decode(end_of_text), "<|endoftext|>");
+  stream->Remove(0);
+#endif
+}
+
 TEST(CAPITests, TokenizerUpdateOptions) {
 #if TEST_PHI2
   auto config = OgaConfig::Create(PHI2_PATH);
@@ -620,6 +687,377 @@ TEST(CAPIEngineTests, EndToEndPhi) {
 }
 #endif
 
+#if ENABLE_ENGINE_TESTS
+TEST(CAPIEngineTests, StartedEngineRemovesRequestMidGeneration) {
+  auto model = OgaModel::Create(PHI2_PATH);
+  auto engine = OgaEngine::Create(*model);
+  auto tokenizer = OgaTokenizer::Create(*model);
+  engine->Start();
+
+  auto params = OgaGeneratorParams::Create(*model);
+  params->SetSearchOption("max_length", 40);
+
+  std::vector<std::unique_ptr<OgaRequest>> requests;
+  for (const char* input_string : {"This is a test.", "Rats are awesome pets!"}) {
+    auto input_sequence = OgaSequences::Create();
+    tokenizer->Encode(input_string, *input_sequence);
+    requests.push_back(OgaRequest::Create(*params));
+    requests.back()->AddTokens(*input_sequence);
+    engine->Add(*requests.back());
+  }
+
+  // Remove the first request from the application thread while the step thread keeps generating
+  size_t num_kept_tokens = 0;
+  bool removed = false;
+  while (auto ready_request = engine->Step()) {
+    while (ready_request->HasUnseenTokens()) {
+      ready_request->GetUnseenToken();
+      if (ready_request.get() != requests[0].get())
+        num_kept_tokens++;
+    }
+
+    if (!removed) {
+      engine->Remove(*requests[0]);
+      removed = true;
+    }
+  }
+
+  EXPECT_FALSE(engine->HasPendingRequests());
+  EXPECT_FALSE(requests[0]->IsDone());
+  EXPECT_TRUE(requests[1]->IsDone());
+  EXPECT_GT(num_kept_tokens, 0);
+  engine->Stop();
+}
+#endif
+
+#if ENABLE_ENGINE_TESTS
+TEST(CAPIEngineTests, AsyncTokenDeliveryOverlapsCallbacksWithSteps) {
+  // Each callback takes about as long as a step. Delivered on the step thread, the callbacks add up with the steps.
+  // Delivered asynchronously, they run while the next step runs.
+  auto generate = [](bool async_token_delivery, std::vector<int32_t>& generated_tokens) {
+    auto config = OgaConfig::Create(PHI2_PATH);
+    if (async_token_delivery)
+      config->Overlay(R"({ "engine": { "async_token_delivery": true } })");
+    auto model = OgaModel::Create(*config);
+    auto engine = OgaEngine::Create(*model);
+    auto tokenizer = OgaTokenizer::Create(*model);
+    engine->Start();
+
+    auto input_sequence = OgaSequences::Create();
+    tokenizer->Encode("This is a test.", *input_sequence);
+    generated_tokens.assign(input_sequence->SequenceData(0), input_sequence->SequenceData(0) + input_sequence->SequenceCount(0));
+
+    auto params = OgaGeneratorParams::Create(*model);
+    params->SetSearchOption("max_length", 40);
+    auto request = OgaRequest::Create(*params);
+    request->AddTokens(*input_sequence);
+    request->SetTokenCallback(
+        [](OgaRequest* request, void* user_data) {
+          auto& tokens = *reinterpret_cast<std::vector<int32_t>*>(user_data);
+          while (request->HasUnseenTokens()) {
+            tokens.push_back(request->GetUnseenToken());
+          }
+          std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        },
+        &generated_tokens);
+
+    const auto start = std::chrono::steady_clock::now();
+    engine->Add(*request);
+    while (engine->HasPendingRequests()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    engine->Stop();
+    return std::chrono::duration<double, std::milli>(elapsed).count();
+  };
+
+  std::vector<int32_t> generated_tokens, async_generated_tokens;
+  const double elapsed_ms = generate(false, generated_tokens);
+  const double async_elapsed_ms = generate(true, async_generated_tokens);
+  std::cout << "Synchronous token delivery: " << elapsed_ms << " ms, asynchronous token delivery: "
+            << async_elapsed_ms << " ms" << std::endl;
+
+  EXPECT_EQ(generated_tokens, async_generated_tokens);
+  EXPECT_LT(async_elapsed_ms, elapsed_ms);
+}
+#endif
+
+#if ENABLE_ENGINE_TESTS
+TEST(CAPIEngineTests, RemovedRequestCanBeAddedAgain) {
+  auto model = OgaModel::Create(PHI2_PATH);
+  auto engine = OgaEngine::Create(*model);
+  auto tokenizer = OgaTokenizer::Create(*model);
+
+  auto input_sequence = OgaSequences::Create();
+  tokenizer->Encode("Rats are awesome pets!", *input_sequence);
+
+  auto params = OgaGeneratorParams::Create(*model);
+  params->SetSearchOption("max_length", 40);
+  auto request = OgaRequest::Create(*params);
+  request->AddTokens(*input_sequence);
+
+  engine->Add(*request);
+  while (auto ready_request = engine->Step()) {
+    while (ready_request->HasUnseenTokens()) {
+      ready_request->GetUnseenToken();
+    }
+  }
+  EXPECT_TRUE(request->IsDone());
+
+  // Removing the completed request from an engine that is not started retires its batch right away,
+  // so the request no longer counts as completed and its next tokens are queued for another prefill
+  engine->Remove(*request);
+  EXPECT_FALSE(request->IsDone());
+  EXPECT_FALSE(engine->HasPendingRequests());
+  request->AddTokens(*input_sequence);
+  EXPECT_NO_THROW(engine->Add(*request));
+  EXPECT_TRUE(engine->HasPendingRequests());
+
+  engine->Remove(*request);
+  EXPECT_FALSE(engine->HasPendingRequests());
+}
+#endif
+
+#if ENABLE_ENGINE_TESTS
+TEST(CAPIEngineTests, RecomputesPreemptedRequests) {
+  // Too few blocks for all requests, so requests are preempted and recompute their key-value cache once resumed
+  auto config = OgaConfig::Create(PHI2_PATH);
+  config->Overlay(R"({ "engine": { "dynamic_batching": { "block_size": 8, "num_blocks": 5, "preemption_mode": "recompute" } } })");
+  auto model = OgaModel::Create(*config);
+  auto engine = OgaEngine::Create(*model);
+  auto tokenizer = OgaTokenizer::Create(*model);
+
+  auto params = OgaGeneratorParams::Create(*model);
+  params->SetSearchOption("max_length", 40);
+
+  std::vector<std::unique_ptr<OgaRequest>> requests;
+  std::vector<std::vector<int32_t>> generated_tokens;
+  generated_tokens.reserve(3);
+  for (const char* input_string : {"This is a test.", "Rats are awesome pets!", "The quick brown fox jumps over the lazy dog."}) {
+    auto input_sequence = OgaSequences::Create();
+    tokenizer->Encode(input_string, *input_sequence);
+    generated_tokens.emplace_back(input_sequence->SequenceData(0), input_sequence->SequenceData(0) + input_sequence->SequenceCount(0));
+    requests.push_back(OgaRequest::Create(*params));
+    requests.back()->AddTokens(*input_sequence);
+    requests.back()->SetOpaqueData(&generated_tokens.back());
+    engine->Add(*requests.back());
+  }
+
+  while (auto request = engine->Step()) {
+    while (request->HasUnseenTokens()) {
+      reinterpret_cast<std::vector<int32_t>*>(request->GetOpaqueData())->push_back(request->GetUnseenToken());
+    }
+  }
+
+  // Same as without preemption, see EndToEndPhiBatch
+  std::vector<std::vector<int32_t>> expected_output{
+      {1212, 318, 257, 1332, 13, 198, 50280, 2, 16926, 1330,
+       1635, 10412, 6617, 278, 6335, 32994, 21857, 13849, 38665, 82,
+       21815, 1108, 9557, 40755, 27446, 2417, 6381, 6, 7131, 6,
+       14870, 31314, 21411, 46009, 3974, 82, 1039, 889, 263, 3684},
+      {49, 1381, 389, 7427, 17252, 0, 198, 50284, 37811, 628, 50256},
+      {464, 2068, 7586, 21831, 18045, 625, 262, 16931, 3290, 13,
+       198, 50284, 37811, 628, 50256}};
+  EXPECT_EQ(expected_output, generated_tokens);
+  EXPECT_GT(engine->GetStatistic("num_recomputed_preemptions"), 0);
+  EXPECT_EQ(engine->GetStatistic("num_swapped_preemptions"), 0);
+}
+#endif
+
+#if ENABLE_ENGINE_TESTS
+TEST(CAPIEngineTests, SwapsRequestsThroughTheSwapFile) {
+  const auto swap_file = (std::filesystem::temp_directory_path() / "oga_engine_swap_file.bin").string();
+
+  // Too few blocks for all requests, and a single host swap block, so preempted requests go to the swap file and are
+  // prefetched and swapped back in from there
+  auto config = OgaConfig::Create(PHI2_PATH);
+  config->Overlay((R"({ "engine": { "dynamic_batching": { "block_size": 8, "num_blocks": 5, "preemption_mode": "swap",
+                       "num_swap_blocks": 1, "num_disk_swap_blocks": 16, "swap_file": ")" +
+                   std::filesystem::path(swap_file).generic_string() + R"(" } } })")
+                      .c_str());
+  auto model = OgaModel::Create(*config);
+  auto engine = OgaEngine::Create(*model);
+  auto tokenizer = OgaTokenizer::Create(*model);
+
+  auto params = OgaGeneratorParams::Create(*model);
+  params->SetSearchOption("max_length", 40);
+
+  std::vector<std::unique_ptr<OgaRequest>> requests;
+  std::vector<std::vector<int32_t>> generated_tokens;
+  generated_tokens.reserve(3);
+  for (const char* input_string : {"This is a test.", "Rats are awesome pets!", "The quick brown fox jumps over the lazy dog."}) {
+    auto input_sequence = OgaSequences::Create();
+    tokenizer->Encode(input_string, *input_sequence);
+    generated_tokens.emplace_back(input_sequence->SequenceData(0), input_sequence->SequenceData(0) + input_sequence->SequenceCount(0));
+    requests.push_back(OgaRequest::Create(*params));
+    requests.back()->AddTokens(*input_sequence);
+    requests.back()->SetOpaqueData(&generated_tokens.back());
+    engine->Add(*requests.back());
+  }
+
+  double max_disk_swap_blocks = 0;
+  while (auto request = engine->Step()) {
+    while (request->HasUnseenTokens()) {
+      reinterpret_cast<std::vector<int32_t>*>(request->GetOpaqueData())->push_back(request->GetUnseenToken());
+    }
+    max_disk_swap_blocks = std::max(max_disk_swap_blocks, engine->GetStatistic("num_disk_swap_blocks"));
+  }
+
+  // Same as without preemption, see EndToEndPhiBatch
+  std::vector<std::vector<int32_t>> expected_output{
+      {1212, 318, 257, 1332, 13, 198, 50280, 2, 16926, 1330,
+       1635, 10412, 6617, 278, 6335, 32994, 21857, 13849, 38665, 82,
+       21815, 1108, 9557, 40755, 27446, 2417, 6381, 6, 7131, 6,
+       14870, 31314, 21411, 46009, 3974, 82, 1039, 889, 263, 3684},
+      {49, 1381, 389, 7427, 17252, 0, 198, 50284, 37811, 628, 50256},
+      {464, 2068, 7586, 21831, 18045, 625, 262, 16931, 3290, 13,
+       198, 50284, 37811, 628, 50256}};
+  EXPECT_EQ(expected_output, generated_tokens);
+  EXPECT_GT(max_disk_swap_blocks, 0);
+  EXPECT_EQ(engine->GetStatistic("num_disk_swap_blocks"), 0);
+  EXPECT_GT(engine->GetStatistic("num_swapped_preemptions"), 0);
+}
+#endif
+
+#if ENABLE_ENGINE_TESTS
+TEST(CAPIEngineTests, PrefillsLongPromptsInChunks) {
+  // The 10 token prompt of the second request does not fit in the token budget of a step
+  auto config = OgaConfig::Create(PHI2_PATH);
+  config->Overlay(R"({ "engine": { "dynamic_batching": { "max_num_batched_tokens": 4 } } })");
+  auto model = OgaModel::Create(*config);
+  auto engine = OgaEngine::Create(*model);
+  auto tokenizer = OgaTokenizer::Create(*model);
+
+  auto params = OgaGeneratorParams::Create(*model);
+  params->SetSearchOption("max_length", 40);
+
+  std::vector<std::unique_ptr<OgaRequest>> requests;
+  std::vector<std::vector<int32_t>> generated_tokens;
+  generated_tokens.reserve(2);
+  for (const char* input_string : {"This is a test.", "The quick brown fox jumps over the lazy dog."}) {
+    auto input_sequence = OgaSequences::Create();
+    tokenizer->Encode(input_string, *input_sequence);
+    generated_tokens.emplace_back(input_sequence->SequenceData(0), input_sequence->SequenceData(0) + input_sequence->SequenceCount(0));
+    requests.push_back(OgaRequest::Create(*params));
+    requests.back()->AddTokens(*input_sequence);
+    requests.back()->SetOpaqueData(&generated_tokens.back());
+  }
+
+  // Add the long prompt once the first request is decoding, and count the tokens the first request generates until
+  // the long prompt is prefilled
+  engine->Add(*requests[0]);
+  bool long_prompt_added = false, long_prompt_prefilled = false;
+  size_t num_tokens_during_prefill = 0;
+  while (auto request = engine->Step()) {
+    while (request->HasUnseenTokens()) {
+      reinterpret_cast<std::vector<int32_t>*>(request->GetOpaqueData())->push_back(request->GetUnseenToken());
+      if (request.get() == requests[1].get())
+        long_prompt_prefilled = true;
+      else if (long_prompt_added && !long_prompt_prefilled)
+        num_tokens_during_prefill++;
+    }
+
+    if (!long_prompt_added) {
+      engine->Add(*requests[1]);
+      long_prompt_added = true;
+    }
+  }
+
+  // Same as without chunking, see EndToEndPhiBatch
+  std::vector<std::vector<int32_t>> expected_output{
+      {1212, 318, 257, 1332, 13, 198, 50280, 2, 16926, 1330,
+       1635, 10412, 6617, 278, 6335, 32994, 21857, 13849, 38665, 82,
+       21815, 1108, 9557, 40755, 27446, 2417, 6381, 6, 7131, 6,
+       14870, 31314, 21411, 46009, 3974, 82, 1039, 889, 263, 3684},
+      {464, 2068, 7586, 21831, 18045, 625, 262, 16931, 3290, 13,
+       198, 50284, 37811, 628, 50256}};
+  EXPECT_EQ(expected_output, generated_tokens);
+
+  // The first request decodes one token per step, leaving 3 tokens of the budget to the long prompt, which takes 4
+  // steps to prefill
+  EXPECT_GE(num_tokens_during_prefill, 3);
+}
+#endif
+
+#if ENABLE_ENGINE_TESTS
+TEST(CAPIEngineTests, RejectsRequestsThatMissTheirDeadline) {
+  auto config = OgaConfig::Create(PHI2_PATH);
+  config->Overlay(R"({ "engine": { "scheduling": { "policy": "earliest_deadline_first", "reject_missed_deadlines": true } } })");
+  auto model = OgaModel::Create(*config);
+  auto engine = OgaEngine::Create(*model);
+  auto tokenizer = OgaTokenizer::Create(*model);
+
+  auto input_sequence = OgaSequences::Create();
+  tokenizer->Encode("This is a test.", *input_sequence);
+  auto params = OgaGeneratorParams::Create(*model);
+  params->SetSearchOption("max_length", 40);
+
+  // The step latency is not known before the first step, so any deadline is accepted
+  auto request = OgaRequest::Create(*params);
+  request->AddTokens(*input_sequence);
+  request->SetDeadline(1.0);
+  engine->Add(*request);
+  while (auto ready_request = engine->Step()) {
+    while (ready_request->HasUnseenTokens()) {
+      ready_request->GetUnseenToken();
+    }
+  }
+  engine->Remove(*request);
+  ASSERT_GT(engine->GetStatistic("average_step_latency_ms"), 0);
+
+  // 35 tokens are left to generate, which takes more than a millisecond
+  auto late_request = OgaRequest::Create(*params);
+  late_request->AddTokens(*input_sequence);
+  late_request->SetDeadline(1.0);
+  EXPECT_THROW(engine->Add(*late_request), std::runtime_error);
+
+  auto timely_request = OgaRequest::Create(*params);
+  timely_request->AddTokens(*input_sequence);
+  timely_request->SetDeadline(3600.0 * 1000.0);
+  engine->Add(*timely_request);
+  EXPECT_TRUE(engine->HasPendingRequests());
+}
+#endif
+
+#if ENABLE_ENGINE_TESTS
+TEST(CAPIEngineTests, ReusesCachedPrefixBlocks) {
+  auto config = OgaConfig::Create(PHI2_PATH);
+  config->Overlay(R"({ "engine": { "dynamic_batching": { "block_size": 4, "enable_prefix_caching": true } } })");
+  auto model = OgaModel::Create(*config);
+  auto engine = OgaEngine::Create(*model);
+  auto tokenizer = OgaTokenizer::Create(*model);
+
+  auto input_sequence = OgaSequences::Create();
+  tokenizer->Encode("The quick brown fox jumps over the lazy dog.", *input_sequence);
+
+  auto params = OgaGeneratorParams::Create(*model);
+  params->SetSearchOption("max_length", 40);
+
+  // Run the same prompt twice, the second request starts after the first has cached its prompt blocks
+  std::vector<std::vector<int32_t>> generated_tokens;
+  for (int i = 0; i < 2; i++) {
+    auto request = OgaRequest::Create(*params);
+    request->AddTokens(*input_sequence);
+    engine->Add(*request);
+
+    auto& tokens = generated_tokens.emplace_back(input_sequence->SequenceData(0), input_sequence->SequenceData(0) + input_sequence->SequenceCount(0));
+    while (auto ready_request = engine->Step()) {
+      while (ready_request->HasUnseenTokens()) {
+        tokens.push_back(ready_request->GetUnseenToken());
+      }
+    }
+    engine->Remove(*request);
+  }
+
+  // Same as without prefix caching, see EndToEndPhiBatch
+  const std::vector<int32_t> expected_output{464, 2068, 7586, 21831, 18045, 625, 262, 16931, 3290, 13,
+                                             198, 50284, 37811, 628, 50256};
+  EXPECT_EQ(expected_output, generated_tokens[0]);
+  EXPECT_EQ(generated_tokens[0], generated_tokens[1]);
+  EXPECT_GT(engine->GetStatistic("num_prefix_cache_hits"), 0);
+}
+#endif
+
 TEST(CAPITests, LoadModelFromMemory) {
 #if TEST_PHI2
 
@@ -1332,6 +1770,244 @@ TEST(CAPITests, RewindGptFp32CAPI) {
   expected_output_start = &expected_output[0];
   EXPECT_TRUE(0 == std::memcmp(expected_output_start, sequence_data, sequence_length * sizeof(int32_t)));
 }
+
+TEST(CAPITests, SaveLoadStateGptFp32CAPI) {
+  std::vector<int32_t> input_ids{0, 0, 195, 731};
+
+  std::vector<int32_t> expected_output{
+      0, 0, 195, 731, 731, 114, 114, 114, 114, 114};
+
+  int max_length = 10;
+
+  auto model = OgaModel::Create(MODEL_PATH "hf-internal-testing/tiny-random-gpt2-fp32");
+  auto params = OgaGeneratorParams::Create(*model);
+  params->SetSearchOption("max_length", max_length);
+
+  // Save after the prompt and one generated token, whose logits are not computed yet
+  auto generator = OgaGenerator::Create(*model, *params);
+  generator->AppendTokens(input_ids.data(), input_ids.size());
+  generator->GenerateNextToken();
+
+  const auto state_path = (std::filesystem::temp_directory_path() / "oga_generator_state.bin").string();
+  generator->SaveState(state_path.c_str());
+
+  auto check_output = [&](OgaGenerator& restored) {
+    EXPECT_EQ(restored.GetSequenceCount(0), 5);
+    while (!restored.IsDone()) {
+      restored.GenerateNextToken();
+    }
+
+    auto sequence_length = restored.GetSequenceCount(0);
+    auto* sequence_data = restored.GetSequenceData(0);
+    ASSERT_EQ(sequence_length, max_length);
+    EXPECT_TRUE(0 == std::memcmp(expected_output.data(), sequence_data, sequence_length * sizeof(int32_t)));
+  };
+
+  auto from_file = OgaGenerator::Create(*model, *params);
+  from_file->LoadState(state_path.c_str());
+  check_output(*from_file);
+
+  std::ifstream file(state_path, std::ios::binary);
+  std::vector<char> state((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  file.close();
+  auto from_buffer = OgaGenerator::Create(*model, *params);
+  from_buffer->LoadStateFromBuffer(state.data(), state.size());
+  check_output(*from_buffer);
+
+  // The generator that saved the state continues as before
+  check_output(*generator);
+
+  // A state can only be loaded into a generator with no tokens
+  EXPECT_THROW(from_file->LoadState(state_path.c_str()), std::runtime_error);
+
+  std::filesystem::remove(state_path);
+}
+
+TEST(CAPITests, ForkGptFp32CAPI) {
+  std::vector<int32_t> input_ids{0, 0, 195, 731};
+
+  std::vector<int32_t> expected_output{
+      0, 0, 195, 731, 731, 114, 114, 114, 114, 114};
+
+  int max_length = 10;
+
+  auto model = OgaModel::Create(MODEL_PATH "hf-internal-testing/tiny-random-gpt2-fp32");
+  auto params = OgaGeneratorParams::Create(*model);
+  params->SetSearchOption("max_length", max_length);
+
+  auto generator = OgaGenerator::Create(*model, *params);
+  generator->AppendTokens(input_ids.data(), input_ids.size());
+  generator->GenerateNextToken();
+
+  // Fork twice from the same sequence, then once from a fork, and finish them in a different order than they were made
+  auto fork = generator->Fork();
+  auto fork_of_fork = fork->Fork();
+  auto second_fork = generator->Fork();
+
+  for (auto* g : {second_fork.get(), generator.get(), fork_of_fork.get(), fork.get()}) {
+    while (!g->IsDone()) {
+      g->GenerateNextToken();
+    }
+
+    auto sequence_length = g->GetSequenceCount(0);
+    auto* sequence_data = g->GetSequenceData(0);
+    ASSERT_EQ(sequence_length, max_length);
+    EXPECT_TRUE(0 == std::memcmp(expected_output.data(), sequence_data, sequence_length * sizeof(int32_t)));
+  }
+
+  // A fork outlives the generator it was forked from
+  auto last_fork = fork->Fork();
+  fork.reset();
+  last_fork->RewindTo(5);
+  while (!last_fork->IsDone()) {
+    last_fork->GenerateNextToken();
+  }
+  EXPECT_TRUE(0 == std::memcmp(expected_output.data(), last_fork->GetSequenceData(0), max_length * sizeof(int32_t)));
+}
+
+TEST(CAPITests, ForkSamplingGptFp32CAPI) {
+  std::vector<int32_t> input_ids{0, 0, 195, 731};
+
+  int max_length = 20;
+
+  auto model = OgaModel::Create(MODEL_PATH "hf-internal-testing/tiny-random-gpt2-fp32");
+  auto params = OgaGeneratorParams::Create(*model);
+  params->SetSearchOption("max_length", max_length);
+  params->SetSearchOptionBool("do_sample", true);
+  params->SetSearchOption("top_k", 50);
+  params->SetSearchOption("random_seed", 42);
+
+  // Returns the sequences of the generator and of two forks of it, each finished after the fork is made
+  auto generate = [&]() {
+    auto generator = OgaGenerator::Create(*model, *params);
+    generator->AppendTokens(input_ids.data(), input_ids.size());
+    generator->GenerateNextToken();
+
+    auto fork = generator->Fork();
+    auto second_fork = generator->Fork();
+
+    std::vector<std::vector<int32_t>> sequences;
+    for (auto* g : {generator.get(), fork.get(), second_fork.get()}) {
+      while (!g->IsDone()) {
+        g->GenerateNextToken();
+      }
+      sequences.emplace_back(g->GetSequenceData(0), g->GetSequenceData(0) + g->GetSequenceCount(0));
+    }
+    return sequences;
+  };
+
+  // The forks are seeded from the random seed and their place in the fork tree, so runs are reproducible
+  auto sequences = generate();
+  EXPECT_EQ(sequences, generate());
+
+  // Each fork samples its own continuation of the shared prefix
+  ASSERT_EQ(sequences.size(), 3);
+  for (auto& sequence : sequences) {
+    ASSERT_GT(sequence.size(), input_ids.size());
+    EXPECT_TRUE(std::equal(sequence.begin(), sequence.begin() + input_ids.size() + 1, sequences[0].begin()));
+  }
+  EXPECT_NE(sequences[1], sequences[0]);
+  EXPECT_NE(sequences[2], sequences[0]);
+  EXPECT_NE(sequences[2], sequences[1]);
+}
+
+TEST(CAPITests, PromptCacheGptFp32CAPI) {
+  std::vector<int32_t> system_prompt{0, 0, 195};
+  std::vector<int32_t> input_ids{0, 0, 195, 731};
+
+  std::vector<int32_t> expected_output{
+      0, 0, 195, 731, 731, 114, 114, 114, 114, 114};
+
+  int max_length = 10;
+
+  auto config = OgaConfig::Create(MODEL_PATH "hf-internal-testing/tiny-random-gpt2-fp32");
+  config->Overlay(R"({ "prompt_cache": { "max_bytes": 67108864, "min_length": 1 } })");
+  auto model = OgaModel::Create(*config);
+  auto params = OgaGeneratorParams::Create(*model);
+  params->SetSearchOption("max_length", max_length);
+  model->PinPrompt(system_prompt);
+
+  // The first generator caches the system prompt, the second continues from it and only runs the last token
+  for (int i = 0; i < 2; i++) {
+    auto generator = OgaGenerator::Create(*model, *params);
+    if (i == 0) {
+      generator->AppendTokens(system_prompt.data(), system_prompt.size());
+      generator->AppendTokens(input_ids.data() + system_prompt.size(), input_ids.size() - system_prompt.size());
+    } else {
+      generator->AppendTokens(input_ids.data(), input_ids.size());
+    }
+    while (!generator->IsDone()) {
+      generator->GenerateNextToken();
+    }
+
+    ASSERT_EQ(generator->GetSequenceCount(0), max_length);
+    EXPECT_TRUE(0 == std::memcmp(expected_output.data(), generator->GetSequenceData(0), max_length * sizeof(int32_t)));
+  }
+
+  EXPECT_EQ(model->GetStatistic("prompt_cache_hits"), 1);
+  EXPECT_EQ(model->GetStatistic("prompt_cache_hit_tokens"), system_prompt.size());
+  EXPECT_GT(model->GetStatistic("prompt_cache_bytes"), 0);
+  model->UnpinPrompt(system_prompt);
+  EXPECT_THROW(model->UnpinPrompt(system_prompt), std::runtime_error);
+  EXPECT_THROW(model->GetStatistic("unknown"), std::runtime_error);
+}
+
+// A generator with a shared past and present buffer cannot restore the snapshots that other generators cached, so it
+// must not look them up
+TEST(CAPITests, PromptCacheSkippedWithSharedBufferPhi2) {
+#if TEST_PHI2
+  auto config = OgaConfig::Create(PHI2_PATH);
+  config->Overlay(R"({ "prompt_cache": { "max_bytes": 268435456, "min_length": 1 } })");
+  auto model = OgaModel::Create(*config);
+  auto tokenizer = OgaTokenizer::Create(*model);
+
+  auto input_sequences = OgaSequences::Create();
+  tokenizer->Encode("This is a test.", *input_sequences);
+
+  auto generate = [&](bool past_present_share_buffer) {
+    auto params = OgaGeneratorParams::Create(*model);
+    params->SetSearchOption("max_length", 20);
+    params->SetSearchOptionBool("past_present_share_buffer", past_present_share_buffer);
+
+    auto generator = OgaGenerator::Create(*model, *params);
+    generator->AppendTokenSequences(*input_sequences);
+    while (!generator->IsDone()) {
+      generator->GenerateNextToken();
+    }
+    return std::vector<int32_t>(generator->GetSequenceData(0), generator->GetSequenceData(0) + generator->GetSequenceCount(0));
+  };
+
+  const auto expected_output = generate(true);
+  EXPECT_EQ(model->GetStatistic("prompt_cache_bytes"), 0);
+
+  // The generator without a shared buffer caches its sequence, the next one with a shared buffer does not restore it
+  generate(false);
+  EXPECT_GT(model->GetStatistic("prompt_cache_bytes"), 0);
+  EXPECT_EQ(generate(true), expected_output);
+  EXPECT_EQ(model->GetStatistic("prompt_cache_hits"), 0);
+#endif
+}
+
+TEST(CAPITests, MemoryUsageGptFp32CAPI) {
+  std::vector<int32_t> input_ids{0, 0, 195, 731};
+
+  auto model = OgaModel::Create(MODEL_PATH "hf-internal-testing/tiny-random-gpt2-fp32");
+  auto params = OgaGeneratorParams::Create(*model);
+  params->SetSearchOption("max_length", 10);
+
+  EXPECT_GT(model->GetMemoryUsage("weights"), 0);
+  EXPECT_EQ(model->GetMemoryUsage("kv_cache"), 0);
+
+  auto generator = OgaGenerator::Create(*model, *params);
+  generator->AppendTokens(input_ids.data(), input_ids.size());
+  EXPECT_EQ(generator->GetMemoryUsage("weights"), 0);
+  EXPECT_GT(generator->GetMemoryUsage("kv_cache"), 0);
+  EXPECT_GT(generator->GetMemoryUsage("activations"), 0);
+  EXPECT_GT(generator->GetMemoryUsage("scratch"), 0);
+  EXPECT_EQ(generator->GetMemoryUsage("total"), generator->GetMemoryUsage("kv_cache") + generator->GetMemoryUsage("activations") +
+                                                    generator->GetMemoryUsage("scratch"));
+  EXPECT_THROW(generator->GetMemoryUsage("unknown"), std::runtime_error);
+}
 #endif
 
 #ifndef STREAMING_ASR_PATH
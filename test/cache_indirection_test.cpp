@@ -0,0 +1,89 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "cpu/cpu_cache_indirection.h"
+
+#include <numeric>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace Generators::test {
+
+namespace {
+
+// One entry at a time, the way the CUDA kernel computes the table
+void ReferenceUpdateCacheIndirection(int32_t* tgt_indir_cache, const int32_t* src_indir_cache, const int32_t* beam_ids, int batch_size, int beam_width,
+                                     int input_seq_length, int max_seq_length, int current_length) {
+  for (int batch = 0; batch < batch_size; batch++) {
+    for (int beam = 0; beam < beam_width; beam++) {
+      const int src_beam = beam_ids[batch * beam_width + beam] % beam_width;
+      for (int t = 0; t < current_length; t++) {
+        int32_t& tgt = tgt_indir_cache[(batch * beam_width + beam) * max_seq_length + t];
+        if (t < input_seq_length)
+          tgt = 0;
+        else if (t == current_length - 1)
+          tgt = beam;
+        else
+          tgt = src_indir_cache[(batch * beam_width + src_beam) * max_seq_length + t];
+      }
+    }
+  }
+}
+
+}  // namespace
+
+TEST(CacheIndirectionTest, UpdateMatchesReferenceAfterBeamReorders) {
+  constexpr int batch_size = 2, beam_width = 4, max_length = 24, prompt_length = 5;
+  const size_t table_size = batch_size * beam_width * max_length;
+
+  // Entries past the current length are never written, -1 checks that they stay untouched
+  std::vector<int32_t> table(table_size, -1), table_next(table_size, -1);
+  std::vector<int32_t> expected(table_size, -1), expected_next(table_size, -1);
+
+  std::mt19937 engine{42};
+  std::vector<int32_t> beam_ids(batch_size * beam_width);
+  std::uniform_int_distribution<int32_t> beam_dist(0, batch_size * beam_width - 1);
+
+  // The prompt step keeps every beam in place, then each generated token reorders the beams
+  std::iota(beam_ids.begin(), beam_ids.end(), 0);
+  int new_length = prompt_length;
+  for (int total_length = prompt_length; total_length <= max_length; total_length++) {
+    cpu::UpdateCacheIndirection(table_next.data(), table.data(), beam_ids.data(), batch_size, beam_width, new_length, max_length, total_length);
+    ReferenceUpdateCacheIndirection(expected_next.data(), expected.data(), beam_ids.data(), batch_size, beam_width, new_length, max_length, total_length);
+    std::swap(table, table_next);
+    std::swap(expected, expected_next);
+    ASSERT_EQ(table, expected) << "total length " << total_length;
+
+    // Beam ids index the whole batch, as the beam scorer returns them
+    for (int32_t& beam_id : beam_ids) {
+      beam_id = beam_dist(engine);
+    }
+    new_length = 1;
+  }
+
+  // Every entry of the table names a beam of its batch entry
+  for (size_t i = 0; i < table.size(); i++) {
+    EXPECT_TRUE(table[i] >= 0 && table[i] < beam_width) << "entry " << i;
+  }
+}
+
+TEST(CacheIndirectionTest, UpdateWithinThePrompt) {
+  constexpr int batch_size = 1, beam_width = 3, max_length = 8;
+  const size_t table_size = batch_size * beam_width * max_length;
+
+  std::vector<int32_t> table(table_size), table_next(table_size, -1), expected(table_size, -1);
+  std::iota(table.begin(), table.end(), 0);
+  const std::vector<int32_t> beam_ids{2, 0, 1};
+
+  // A current length that does not go past the input sequence only writes zeros
+  for (int current_length : {0, 1, 4}) {
+    cpu::UpdateCacheIndirection(table_next.data(), table.data(), beam_ids.data(), batch_size, beam_width, 4, max_length, current_length);
+    ReferenceUpdateCacheIndirection(expected.data(), table.data(), beam_ids.data(), batch_size, beam_width, 4, max_length, current_length);
+    EXPECT_EQ(table_next, expected) << "current length " << current_length;
+  }
+}
+
+}  // namespace Generators::test
@@ -0,0 +1,229 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "cpu/cpu_cast.h"
+#include "models/threadpool.h"
+#include "statistics_helper.h"
+
+namespace Generators::test {
+
+namespace {
+
+uint32_t FloatBits(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+bool IsFloat16NaN(uint16_t value) {
+  return (value & 0x7c00) == 0x7c00 && (value & 0x03ff) != 0;
+}
+
+// Reference binary16 to float, from the definition of the format
+float ReferenceFloat16ToFloat32(uint16_t value) {
+  const float sign = (value & 0x8000) ? -1.0f : 1.0f;
+  const int exponent = (value >> 10) & 0x1f;
+  const int mantissa = value & 0x3ff;
+  if (exponent == 0)
+    return sign * std::ldexp(static_cast<float>(mantissa), -24);
+  if (exponent == 0x1f)
+    return mantissa ? std::nanf("") : sign * INFINITY;
+  return sign * std::ldexp(static_cast<float>(mantissa + 1024), exponent - 25);
+}
+
+// The scalar conversion CpuInterface::Cast used before the vectorized kernels. Kept here as the benchmark baseline.
+float BaselineFloat16ToFloat32(uint16_t x) {
+  const uint32_t e = (x & 0x7C00) >> 10;
+  const uint32_t m = (x & 0x03FF) << 13;
+  float mantissa = static_cast<float>(m);
+  uint32_t mantissa_bits;
+  std::memcpy(&mantissa_bits, &mantissa, sizeof(mantissa_bits));
+  const uint32_t v = mantissa_bits >> 23;
+  const uint32_t denormal = m != 0 ? (v - 37) << 23 | ((m << (150 - v)) & 0x007FE000) : 0;  // Guarded, the shift is undefined for 0
+  const uint32_t bits = (x & 0x8000) << 16 | (e != 0) * ((e + 112) << 23 | m) | (e == 0) * denormal;
+  float result;
+  std::memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+std::vector<uint16_t> AllFloat16Values() {
+  std::vector<uint16_t> values(1 << 16);
+  for (size_t i = 0; i < values.size(); i++)
+    values[i] = static_cast<uint16_t>(i);
+  return values;
+}
+
+struct BenchmarkParams {
+  size_t batch_size;
+  size_t vocab_size;
+};
+
+struct BenchmarkResult {
+  BenchmarkParams params;
+  double baseline_us;
+  double vectorized_us;
+  double parallel_us;
+};
+
+template <typename Func>
+double MeasureUs(Func&& func) {
+  constexpr int kNumRuns = 20;
+  std::vector<double> latencies;
+  for (int run = 0; run < kNumRuns; run++) {
+    auto start = std::chrono::high_resolution_clock::now();
+    func();
+    auto stop = std::chrono::high_resolution_clock::now();
+    latencies.push_back(static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count()) / 1000.0);
+  }
+  return mean(latencies);
+}
+
+}  // namespace
+
+TEST(CpuCastTest, Float16ToFloat32IsExact) {
+  const auto halves = AllFloat16Values();
+  std::vector<float> floats(halves.size());
+  cpu::CastFloat16ToFloat32(halves, floats);
+
+  for (size_t i = 0; i < halves.size(); i++) {
+    const float expected = ReferenceFloat16ToFloat32(halves[i]);
+    if (IsFloat16NaN(halves[i]))
+      EXPECT_TRUE(std::isnan(floats[i])) << i;
+    else
+      EXPECT_EQ(FloatBits(floats[i]), FloatBits(expected)) << i;
+  }
+}
+
+TEST(CpuCastTest, Float32ToFloat16RoundsToNearestEven) {
+  const auto halves = AllFloat16Values();
+  std::vector<float> floats(halves.size());
+  cpu::CastFloat16ToFloat32(halves, floats);
+
+  // Every binary16 value round trips
+  std::vector<uint16_t> round_trip(halves.size());
+  cpu::CastFloat32ToFloat16(floats, round_trip);
+  for (size_t i = 0; i < halves.size(); i++) {
+    if (IsFloat16NaN(halves[i]))
+      EXPECT_TRUE(IsFloat16NaN(round_trip[i])) << i;
+    else
+      EXPECT_EQ(round_trip[i], halves[i]) << i;
+  }
+
+  // Halfway between two positive finite values goes to the even one, just past it goes up
+  std::vector<float> midpoints, above_midpoints;
+  for (uint16_t value = 0; value < 0x7bff; value++) {
+    const double midpoint = (static_cast<double>(floats[value]) + floats[value + 1]) / 2;
+    midpoints.push_back(static_cast<float>(midpoint));
+    above_midpoints.push_back(std::nextafter(static_cast<float>(midpoint), INFINITY));
+  }
+  std::vector<uint16_t> rounded(midpoints.size()), rounded_up(midpoints.size());
+  cpu::CastFloat32ToFloat16(midpoints, rounded);
+  cpu::CastFloat32ToFloat16(above_midpoints, rounded_up);
+  for (uint16_t value = 0; value < 0x7bff; value++) {
+    EXPECT_EQ(rounded[value], (value & 1) ? value + 1 : value) << value;
+    EXPECT_EQ(rounded_up[value], value + 1) << value;
+  }
+
+  // Values that round past the largest finite value become infinities
+  std::vector<float> large{65519.0f, 65520.0f, -65520.0f, 1e10f, INFINITY};
+  std::vector<uint16_t> large_halves(large.size());
+  cpu::CastFloat32ToFloat16(large, large_halves);
+  EXPECT_EQ(large_halves, (std::vector<uint16_t>{0x7bff, 0x7c00, 0xfc00, 0x7c00, 0x7c00}));
+}
+
+TEST(CpuCastTest, BFloat16) {
+  std::mt19937 engine{0};
+  std::uniform_int_distribution<uint32_t> distribution;
+  std::vector<float> floats(1027);  // Not a multiple of the vector width, so the scalar tail runs too
+  for (auto& value : floats) {
+    const uint32_t bits = distribution(engine);
+    std::memcpy(&value, &bits, sizeof(value));
+  }
+
+  std::vector<uint16_t> bfloats(floats.size());
+  std::vector<float> widened(floats.size());
+  cpu::CastFloat32ToBFloat16(floats, bfloats);
+  cpu::CastBFloat16ToFloat32(bfloats, widened);
+  for (size_t i = 0; i < floats.size(); i++) {
+    EXPECT_EQ(bfloats[i], FloatBits(floats[i]) >> 16) << i;
+    EXPECT_EQ(FloatBits(widened[i]), FloatBits(floats[i]) & 0xffff0000u) << i;
+  }
+}
+
+TEST(CpuCastBenchmarks, PerformanceTests) {
+  const std::vector<BenchmarkParams> test_cases = {
+      {1, 32000},
+      {1, 262144},
+      {16, 32000},
+      {16, 262144},
+  };
+
+  // Chunked the way CpuInterface::Cast splits large casts across its thread pool
+  constexpr size_t kChunkSize = 1 << 18;
+  ThreadPool thread_pool{std::max(1u, std::thread::hardware_concurrency()) - 1};
+
+  std::mt19937 engine{0};
+  std::normal_distribution<float> distribution{0.0f, 8.0f};
+  std::vector<BenchmarkResult> results;
+  for (const auto& params : test_cases) {
+    const size_t count = params.batch_size * params.vocab_size;
+    std::vector<float> logits(count);
+    for (auto& logit : logits)
+      logit = distribution(engine);
+    std::vector<uint16_t> halves(count);
+    cpu::CastFloat32ToFloat16(logits, halves);
+
+    std::vector<float> output(count);
+    BenchmarkResult result{params};
+    result.baseline_us = MeasureUs([&] {
+      for (size_t i = 0; i < count; i++)
+        output[i] = BaselineFloat16ToFloat32(halves[i]);
+    });
+    result.vectorized_us = MeasureUs([&] { cpu::CastFloat16ToFloat32(halves, output); });
+    result.parallel_us = MeasureUs([&] {
+      thread_pool.ParallelFor((count + kChunkSize - 1) / kChunkSize, [&](size_t chunk) {
+        const size_t begin = chunk * kChunkSize;
+        const size_t chunk_count = std::min(kChunkSize, count - begin);
+        cpu::CastFloat16ToFloat32(std::span<const uint16_t>{halves}.subspan(begin, chunk_count),
+                                  std::span<float>{output}.subspan(begin, chunk_count));
+      });
+    });
+    results.push_back(result);
+  }
+
+  // clang-format off
+  std::cout << "\n--- CPU fp16 to fp32 Cast Benchmark Summary (" << thread_pool.NumThreads() << " threads) ---\n";
+  std::cout << std::left
+            << std::setw(8) << "Batch"
+            << std::setw(10) << "Vocab"
+            << std::setw(16) << "Scalar(us)"
+            << std::setw(16) << "Vector(us)"
+            << std::setw(16) << "Parallel(us)"
+            << std::setw(10) << "Speedup" << "\n";
+  std::cout << std::string(76, '-') << "\n";
+
+  for (const auto& result : results) {
+    std::cout << std::left << std::fixed << std::setprecision(2)
+              << std::setw(8) << result.params.batch_size
+              << std::setw(10) << result.params.vocab_size
+              << std::setw(16) << result.baseline_us
+              << std::setw(16) << result.vectorized_us
+              << std::setw(16) << result.parallel_us
+              << std::setw(10) << result.baseline_us / std::min(result.vectorized_us, result.parallel_us)
+              << "\n";
+  }
+  // clang-format on
+}
+
+}  // namespace Generators::test
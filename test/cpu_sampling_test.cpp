@@ -0,0 +1,147 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "cpu/cpu_sampling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <queue>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace Generators::test {
+
+namespace {
+
+struct BeamTopK {
+  std::vector<float> scores;
+  std::vector<int32_t> tokens;
+  std::vector<int32_t> indices;
+};
+
+// The beam search selection before the fused top k: a log softmax over every beam, plus the beam score, then a heap
+// over all num_beams * vocab_size scores of the batch entry
+BeamTopK ReferenceBeamTopK(std::vector<float> logits, const std::vector<float>& beam_scores, size_t vocab_size, size_t top_k) {
+  struct ScoreIndex {
+    float score;
+    int32_t index;
+
+    bool operator<(const ScoreIndex& s) const { return score < s.score; }
+  };
+
+  std::priority_queue<ScoreIndex, std::vector<ScoreIndex>> queue;
+  for (size_t beam = 0; beam < beam_scores.size(); beam++) {
+    auto scores = logits.begin() + beam * vocab_size;
+    const float max_score = *std::max_element(scores, scores + vocab_size);
+    std::transform(scores, scores + vocab_size, scores, [max_score](float score) { return score - max_score; });
+    const float exp_sum = std::accumulate(scores, scores + vocab_size, 0.0f, [](float a, float b) { return a + std::exp(b); });
+    std::transform(scores, scores + vocab_size, scores, [exp_sum](float score) { return score - std::log(exp_sum); });
+    for (size_t token = 0; token < vocab_size; token++) {
+      queue.push({scores[token] + beam_scores[beam], static_cast<int32_t>(beam * vocab_size + token)});
+    }
+  }
+
+  BeamTopK top;
+  for (size_t i = 0; i < top_k; i++) {
+    auto v = queue.top();
+    top.scores.push_back(v.score);
+    top.indices.push_back(static_cast<int32_t>(v.index / vocab_size));
+    top.tokens.push_back(static_cast<int32_t>(v.index % vocab_size));
+    queue.pop();
+  }
+  return top;
+}
+
+// Runs the selection of BeamSearch_Cpu::SelectTop for one batch entry
+BeamTopK FusedBeamTopK(const std::vector<float>& logits, const std::vector<float>& beam_scores, size_t vocab_size, size_t top_k) {
+  const size_t num_beams = beam_scores.size();
+  const size_t num_candidates = std::min(top_k, vocab_size);
+  std::vector<float> candidate_scores(num_beams * num_candidates);
+  std::vector<int32_t> candidate_tokens(num_beams * num_candidates);
+  std::vector<int32_t> order(num_beams * num_candidates);
+
+  cpu::SamplingData data{0};
+  for (size_t beam = 0; beam < num_beams; beam++) {
+    cpu::SelectBeamCandidates(std::span<const float>{logits}.subspan(beam * vocab_size, vocab_size), beam_scores[beam], data,
+                              std::span<float>{candidate_scores}.subspan(beam * num_candidates, num_candidates),
+                              std::span<int32_t>{candidate_tokens}.subspan(beam * num_candidates, num_candidates));
+  }
+
+  BeamTopK top{std::vector<float>(top_k), std::vector<int32_t>(top_k), std::vector<int32_t>(top_k)};
+  cpu::MergeBeamCandidates(candidate_scores, candidate_tokens, num_beams, order, top.scores, top.tokens, top.indices);
+  return top;
+}
+
+// Checks that both selections pick tokens with the same scores. Equal scores may be picked in a different order, so
+// the tokens are only compared exactly when expect_same_tokens is set.
+void ExpectSameTopK(const std::vector<float>& logits, const std::vector<float>& beam_scores, size_t vocab_size, bool expect_same_tokens) {
+  const size_t top_k = 2 * beam_scores.size();
+  const auto expected = ReferenceBeamTopK(logits, beam_scores, vocab_size, top_k);
+  const auto actual = FusedBeamTopK(logits, beam_scores, vocab_size, top_k);
+
+  std::set<std::pair<int32_t, int32_t>> selected;
+  for (size_t i = 0; i < top_k; i++) {
+    EXPECT_NEAR(actual.scores[i], expected.scores[i], 1e-4f) << "rank " << i;
+    if (i > 0) {
+      EXPECT_GE(actual.scores[i - 1], actual.scores[i]);
+    }
+    EXPECT_TRUE(selected.emplace(actual.indices[i], actual.tokens[i]).second) << "rank " << i << " selected twice";
+    if (expect_same_tokens) {
+      EXPECT_EQ(actual.indices[i], expected.indices[i]) << "rank " << i;
+      EXPECT_EQ(actual.tokens[i], expected.tokens[i]) << "rank " << i;
+    }
+  }
+}
+
+}  // namespace
+
+TEST(CpuSamplingTest, BeamTopKMatchesSoftmaxAndSort) {
+  std::mt19937 engine{1234};
+  std::uniform_real_distribution<float> logit_dist(-10.0f, 10.0f);
+  std::uniform_real_distribution<float> beam_score_dist(-5.0f, 0.0f);
+
+  for (size_t num_beams : {2, 4, 8}) {
+    for (size_t vocab_size : {50, 1000, 5000}) {
+      std::vector<float> logits(num_beams * vocab_size);
+      std::vector<float> beam_scores(num_beams);
+      std::generate(logits.begin(), logits.end(), [&] { return logit_dist(engine); });
+      std::generate(beam_scores.begin(), beam_scores.end(), [&] { return beam_score_dist(engine); });
+      ExpectSameTopK(logits, beam_scores, vocab_size, true);
+    }
+  }
+}
+
+TEST(CpuSamplingTest, BeamTopKWithTies) {
+  std::mt19937 engine{5678};
+  std::uniform_int_distribution<int> logit_dist(0, 3);
+
+  // Few distinct logits and equal beam scores, so many tokens within and across the beams have the same score
+  const size_t num_beams = 4, vocab_size = 100;
+  for (int iteration = 0; iteration < 20; iteration++) {
+    std::vector<float> logits(num_beams * vocab_size);
+    std::generate(logits.begin(), logits.end(), [&] { return static_cast<float>(logit_dist(engine)); });
+    ExpectSameTopK(logits, std::vector<float>(num_beams, -1.0f), vocab_size, false);
+  }
+}
+
+TEST(CpuSamplingTest, BeamTopKWithMoreBeamsThanHalfTheVocabulary) {
+  std::mt19937 engine{9012};
+  std::uniform_real_distribution<float> logit_dist(-10.0f, 10.0f);
+  std::uniform_real_distribution<float> beam_score_dist(-5.0f, 0.0f);
+
+  // Every beam has fewer tokens than the 2 * num_beams candidates a batch entry needs
+  for (auto [num_beams, vocab_size] : {std::pair<size_t, size_t>{4, 5}, {6, 7}, {8, 3}}) {
+    std::vector<float> logits(num_beams * vocab_size);
+    std::vector<float> beam_scores(num_beams);
+    std::generate(logits.begin(), logits.end(), [&] { return logit_dist(engine); });
+    std::generate(beam_scores.begin(), beam_scores.end(), [&] { return beam_score_dist(engine); });
+    ExpectSameTopK(logits, beam_scores, vocab_size, true);
+  }
+}
+
+}  // namespace Generators::test
@@ -0,0 +1,175 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "models/growable_buffer.h"
+#include "statistics_helper.h"
+
+namespace Generators::test {
+
+namespace {
+
+// Allocates from the heap and counts the calls, standing in for the key-value cache device allocator
+struct CountingAllocator {
+  void* Alloc(size_t size) {
+    ++num_allocations;
+    return std::malloc(size);
+  }
+
+  void Free(void* p) {
+    ++num_frees;
+    std::free(p);
+  }
+
+  size_t num_allocations{};
+  size_t num_frees{};
+};
+
+struct BenchmarkParams {
+  size_t num_layers;
+  size_t num_heads;
+  size_t head_size;
+  size_t prompt_length;
+  size_t num_tokens;
+};
+
+struct RunResult {
+  double allocations_per_token;
+  double latency_us;  // Per token
+};
+
+struct BenchmarkResult {
+  BenchmarkParams params;
+  RunResult per_token;
+  RunResult growable;
+};
+
+size_t TensorBytes(const BenchmarkParams& params, size_t length) {
+  return params.num_heads * length * params.head_size * sizeof(uint16_t);
+}
+
+// The key-value cache as it was before the growable buffers: every token allocates a new present
+// tensor per key and value of every layer and frees the past. Kept here as the benchmark baseline.
+RunResult RunPerTokenAllocation(const BenchmarkParams& params) {
+  CountingAllocator allocator;
+  std::vector<void*> pasts(params.num_layers * 2), presents(params.num_layers * 2);
+
+  std::vector<double> latencies;
+  for (size_t length = params.prompt_length; length < params.prompt_length + params.num_tokens; ++length) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < presents.size(); ++i) {
+      if (pasts[i] != nullptr) {
+        allocator.Free(pasts[i]);
+      }
+      pasts[i] = presents[i];
+      presents[i] = allocator.Alloc(TensorBytes(params, length));
+      std::memset(presents[i], 0, TensorBytes(params, length));  // The model writes the whole present
+    }
+
+    auto stop = std::chrono::high_resolution_clock::now();
+    latencies.push_back(static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count()) / 1000.0);
+  }
+
+  for (size_t i = 0; i < presents.size(); ++i) {
+    allocator.Free(pasts[i]);
+    allocator.Free(presents[i]);
+  }
+
+  return {static_cast<double>(allocator.num_allocations) / params.num_tokens, mean(latencies)};
+}
+
+// The present is written to one of two growable buffers per tensor while the past is read from the other
+RunResult RunGrowableBuffers(const BenchmarkParams& params) {
+  CountingAllocator allocator;
+  std::vector<std::array<GrowableBuffer<CountingAllocator>, 2>> buffers;
+  for (size_t i = 0; i < params.num_layers * 2; ++i) {
+    buffers.push_back({GrowableBuffer<CountingAllocator>{allocator}, GrowableBuffer<CountingAllocator>{allocator}});
+  }
+
+  std::vector<double> latencies;
+  size_t present_buffer = 0;
+  for (size_t length = params.prompt_length; length < params.prompt_length + params.num_tokens; ++length) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (auto& tensor_buffers : buffers) {
+      void* present = tensor_buffers[present_buffer].Reserve(TensorBytes(params, length));
+      std::memset(present, 0, TensorBytes(params, length));
+    }
+    present_buffer ^= 1;
+
+    auto stop = std::chrono::high_resolution_clock::now();
+    latencies.push_back(static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count()) / 1000.0);
+  }
+
+  buffers.clear();
+  EXPECT_EQ(allocator.num_allocations, allocator.num_frees);
+
+  return {static_cast<double>(allocator.num_allocations) / params.num_tokens, mean(latencies)};
+}
+
+}  // namespace
+
+TEST(GrowableBufferTest, GrowsGeometrically) {
+  CountingAllocator allocator;
+  {
+    GrowableBuffer<CountingAllocator> buffer{allocator};
+    for (size_t size = 1; size <= 1024; ++size) {
+      EXPECT_NE(buffer.Reserve(size), nullptr);
+      EXPECT_GE(buffer.Capacity(), size);
+    }
+    EXPECT_EQ(allocator.num_allocations, 11);  // 1, 2, 4, ..., 1024
+  }
+  EXPECT_EQ(allocator.num_frees, allocator.num_allocations);
+}
+
+TEST(KeyValueCacheBenchmarks, PerformanceTests) {
+  const std::vector<BenchmarkParams> test_cases = {
+      {16, 4, 64, 64, 256},
+      {24, 8, 64, 256, 256},
+      {32, 8, 128, 512, 128},
+  };
+
+  std::vector<BenchmarkResult> results;
+  for (const auto& params : test_cases) {
+    results.push_back({params, RunPerTokenAllocation(params), RunGrowableBuffers(params)});
+  }
+
+  // clang-format off
+  std::cout << "\n--- Key-Value Cache Benchmark Summary (per generated token) ---\n";
+  std::cout << std::left
+            << std::setw(10) << "Layers"
+            << std::setw(10) << "Prompt"
+            << std::setw(10) << "Tokens"
+            << std::setw(18) << "PerToken(allocs)"
+            << std::setw(18) << "Growable(allocs)"
+            << std::setw(16) << "PerToken(us)"
+            << std::setw(16) << "Growable(us)"
+            << std::setw(10) << "Speedup" << "\n";
+  std::cout << std::string(108, '-') << "\n";
+
+  for (const auto& result : results) {
+    std::cout << std::left << std::fixed << std::setprecision(2)
+              << std::setw(10) << result.params.num_layers
+              << std::setw(10) << result.params.prompt_length
+              << std::setw(10) << result.params.num_tokens
+              << std::setw(18) << result.per_token.allocations_per_token
+              << std::setw(18) << result.growable.allocations_per_token
+              << std::setw(16) << result.per_token.latency_us
+              << std::setw(16) << result.growable.latency_us
+              << std::setw(10) << result.per_token.latency_us / result.growable.latency_us
+              << "\n";
+  }
+  // clang-format on
+}
+
+}  // namespace Generators::test
@@ -0,0 +1,67 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "engine/mpsc_queue.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace Generators::test {
+
+TEST(MpscQueueTest, PopAllReturnsItemsInPushOrder) {
+  MpscQueue<int> queue;
+  EXPECT_TRUE(queue.Empty());
+
+  for (int i = 0; i < 8; ++i) {
+    queue.Push(i);
+  }
+  EXPECT_FALSE(queue.Empty());
+
+  const auto items = queue.PopAll();
+  EXPECT_EQ(items, (std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7}));
+  EXPECT_TRUE(queue.Empty());
+  EXPECT_TRUE(queue.PopAll().empty());
+}
+
+TEST(MpscQueueTest, ConcurrentProducers) {
+  constexpr int num_producers = 8;
+  constexpr int num_items_per_producer = 10000;
+
+  MpscQueue<std::pair<int, int>> queue;
+  std::atomic<int> num_finished_producers = 0;
+  std::vector<std::thread> producers;
+  for (int producer = 0; producer < num_producers; ++producer) {
+    producers.emplace_back([&queue, &num_finished_producers, producer]() {
+      for (int i = 0; i < num_items_per_producer; ++i) {
+        queue.Push({producer, i});
+      }
+      ++num_finished_producers;
+    });
+  }
+
+  // Every item is received exactly once, and the items of each producer arrive in the order they were pushed.
+  std::vector<int> next_item(num_producers, 0);
+  auto consume = [&]() {
+    for (const auto& [producer, i] : queue.PopAll()) {
+      ASSERT_EQ(i, next_item[producer]);
+      ++next_item[producer];
+    }
+  };
+  while (num_finished_producers < num_producers) {
+    consume();
+  }
+  consume();
+
+  for (auto& producer : producers) {
+    producer.join();
+  }
+
+  for (int producer = 0; producer < num_producers; ++producer) {
+    EXPECT_EQ(next_item[producer], num_items_per_producer);
+  }
+}
+
+}  // namespace Generators::test
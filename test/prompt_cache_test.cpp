@@ -0,0 +1,122 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "models/prompt_cache.h"
+
+#include <stdexcept>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace Generators::test {
+
+namespace {
+
+struct FakeEntry : PromptCacheEntry {
+  explicit FakeEntry(size_t size) : size_{size} {}
+  size_t SizeInBytes() const override { return size_; }
+  size_t size_;
+};
+
+std::shared_ptr<const PromptCacheEntry> MakeEntry(size_t size) {
+  return std::make_shared<FakeEntry>(size);
+}
+
+size_t LookupLength(PromptCache& cache, const std::vector<int32_t>& tokens, size_t max_length = ~size_t{}) {
+  return cache.Lookup(tokens, max_length).second;
+}
+
+}  // namespace
+
+TEST(PromptCacheTest, FindsLongestCachedPrefix) {
+  PromptCache cache{1000, 1};
+  cache.Insert(std::vector<int32_t>{1, 2, 3}, MakeEntry(10));
+  cache.Insert(std::vector<int32_t>{1, 2, 3, 4, 5}, MakeEntry(10));
+  cache.Insert(std::vector<int32_t>{1, 2, 7}, MakeEntry(10));  // Splits the edge of the first two
+
+  EXPECT_EQ(LookupLength(cache, {1, 2, 3, 4, 5, 6}), 5);
+  EXPECT_EQ(LookupLength(cache, {1, 2, 3, 4, 6}), 3);
+  EXPECT_EQ(LookupLength(cache, {1, 2, 7, 8}), 3);
+  EXPECT_EQ(LookupLength(cache, {1, 2, 3, 4, 5, 6}, 4), 3);  // The prefix is limited to max_length
+  EXPECT_EQ(LookupLength(cache, {1, 2}), 0);
+  EXPECT_EQ(LookupLength(cache, {9}), 0);
+
+  const auto stats = cache.Stats();
+  EXPECT_EQ(stats.num_entries, 3);
+  EXPECT_EQ(stats.size_in_bytes, 30);
+  EXPECT_EQ(stats.num_hits, 4);
+  EXPECT_EQ(stats.num_misses, 2);
+  EXPECT_EQ(stats.num_hit_tokens, 14);
+}
+
+TEST(PromptCacheTest, SkipsShortPrompts) {
+  PromptCache cache{1000, 4};
+  cache.Insert(std::vector<int32_t>{1, 2, 3}, MakeEntry(10));
+  EXPECT_EQ(cache.Stats().num_entries, 0);
+  EXPECT_EQ(LookupLength(cache, {1, 2, 3, 4}), 0);
+}
+
+TEST(PromptCacheTest, EvictsLeastRecentlyUsedToBudget) {
+  PromptCache cache{30, 1};
+  cache.Insert(std::vector<int32_t>{1, 1}, MakeEntry(10));
+  cache.Insert(std::vector<int32_t>{2, 2}, MakeEntry(10));
+  cache.Insert(std::vector<int32_t>{3, 3}, MakeEntry(10));
+  EXPECT_EQ(LookupLength(cache, {1, 1, 0}), 2);  // {2, 2} is now the least recently used
+
+  cache.Insert(std::vector<int32_t>{4, 4}, MakeEntry(10));
+  EXPECT_EQ(LookupLength(cache, {2, 2, 0}), 0);
+  EXPECT_EQ(LookupLength(cache, {1, 1, 0}), 2);
+  EXPECT_EQ(LookupLength(cache, {3, 3, 0}), 2);
+  EXPECT_EQ(LookupLength(cache, {4, 4, 0}), 2);
+
+  // An entry larger than the budget is not cached, rather than evicting all the others
+  cache.Insert(std::vector<int32_t>{5, 5}, MakeEntry(100));
+  EXPECT_EQ(LookupLength(cache, {5, 5, 0}), 0);
+  EXPECT_EQ(LookupLength(cache, {4, 4, 0}), 2);
+
+  const auto stats = cache.Stats();
+  EXPECT_EQ(stats.num_evictions, 1);
+  EXPECT_LE(stats.size_in_bytes, 30);
+}
+
+TEST(PromptCacheTest, PinnedPrefixesAreNotEvicted) {
+  PromptCache cache{20, 1};
+  cache.Pin(std::vector<int32_t>{1, 2, 3});  // Pinned before it is cached
+  cache.Insert(std::vector<int32_t>{1, 2, 3}, MakeEntry(10));
+  cache.Insert(std::vector<int32_t>{4, 5}, MakeEntry(10));
+  cache.Insert(std::vector<int32_t>{6, 7}, MakeEntry(10));
+  cache.Insert(std::vector<int32_t>{8, 9}, MakeEntry(10));
+
+  EXPECT_EQ(LookupLength(cache, {1, 2, 3, 4}), 3);
+  EXPECT_EQ(LookupLength(cache, {8, 9, 0}), 2);
+  EXPECT_EQ(LookupLength(cache, {4, 5, 0}), 0);
+
+  // Once unpinned it is evicted like any other entry
+  cache.Unpin(std::vector<int32_t>{1, 2, 3});
+  cache.Insert(std::vector<int32_t>{10, 11}, MakeEntry(10));
+  EXPECT_EQ(LookupLength(cache, {1, 2, 3, 4}), 0);
+  EXPECT_EQ(LookupLength(cache, {10, 11, 0}), 2);
+
+  EXPECT_THROW(cache.Unpin(std::vector<int32_t>{1, 2, 3}), std::runtime_error);
+  EXPECT_THROW(cache.Unpin(std::vector<int32_t>{1, 2}), std::runtime_error);
+}
+
+TEST(PromptCacheTest, ClearKeepsPinnedEntries) {
+  PromptCache cache{1000, 1};
+  cache.Insert(std::vector<int32_t>{1, 2, 3}, MakeEntry(10));
+  cache.Insert(std::vector<int32_t>{1, 2, 3, 4}, MakeEntry(10));
+  cache.Insert(std::vector<int32_t>{1, 5}, MakeEntry(10));
+  cache.Pin(std::vector<int32_t>{1, 5});
+  cache.Clear();
+
+  EXPECT_EQ(LookupLength(cache, {1, 2, 3, 4, 5}), 0);
+  EXPECT_EQ(LookupLength(cache, {1, 5, 6}), 2);
+  EXPECT_EQ(cache.Stats().num_entries, 1);
+
+  // The tree is still usable after nodes were merged and removed
+  cache.Insert(std::vector<int32_t>{1, 2}, MakeEntry(10));
+  EXPECT_EQ(LookupLength(cache, {1, 2, 3}), 2);
+  EXPECT_EQ(LookupLength(cache, {1, 5, 6}), 2);
+}
+
+}  // namespace Generators::test
@@ -3,6 +3,7 @@
 
 from __future__ import annotations
 
+import json
 import os
 import shutil
 import sysconfig
@@ -307,6 +308,29 @@ def test_tokenizer_encode_decode(device, phi2_for, batch):
             assert prompt == decoded_string
 
 
+@pytest.mark.skipif(
+    sysconfig.get_platform().endswith("arm64"),
+    reason="Model is not available on arm64.",
+)
+@pytest.mark.parametrize("device", devices)
+def test_tokenizer_encode_batch_ragged(device, phi2_for):
+    model_path = phi2_for(device)
+
+    model = og.Model(model_path)
+    tokenizer = og.Tokenizer(model)
+
+    prompts = [
+        "This is a test.",
+        "Rats are awesome pets!",
+        "The quick brown fox jumps over the lazy dog.",
+    ]
+    token_ids, offsets = tokenizer.encode_batch_ragged(prompts)
+    assert len(offsets) == len(prompts) + 1
+    assert offsets[-1] == len(token_ids)
+    for i, prompt in enumerate(prompts):
+        assert np.array_equal(token_ids[offsets[i] : offsets[i + 1]], tokenizer.encode(prompt))
+
+
 # Test Chat Template Supported Model
 @pytest.mark.skipif(
     sysconfig.get_platform().endswith("arm64"),
@@ -350,6 +374,39 @@ def test_phi2_chat_template(device, phi2_for):
         assert False, f"Error while trying to override chat template: {e}"
 
 
+@pytest.mark.skipif(
+    sysconfig.get_platform().endswith("arm64"),
+    reason="Model is not available on arm64.",
+)
+@pytest.mark.parametrize("device", devices)
+def test_chat_encoder(device, phi2_for):
+    model = og.Model(phi2_for(device))
+    tokenizer = og.Tokenizer(model)
+    encoder = og.ChatEncoder(tokenizer)
+
+    template = """{% for message in messages %}{{'<|' + message['role'] + '|>\n' + message['content'] + '<|end|>\n'}}{% endfor %}{% if add_generation_prompt %}{{ '<|assistant|>\n' }}{% endif %}"""
+    turns = [
+        {"role": "system", "content": "This is a test."},
+        {"role": "user", "content": "Hi, how are you?"},
+        {"role": "assistant", "content": "I am fine, thank you!"},
+        {"role": "user", "content": "What are rats like as pets?"},
+        {"role": "assistant", "content": "Rats are awesome pets!"},
+        {"role": "user", "content": "Why?"},
+    ]
+
+    # Each turn continues the previous conversation, the tokens must match encoding the whole conversation
+    for length in range(2, len(turns) + 1, 2):
+        messages = json.dumps(turns[:length])
+        expected = tokenizer.encode(tokenizer.apply_chat_template(messages, template_str=template))
+        assert np.array_equal(encoder.encode(messages, template_str=template), expected)
+
+    # Going back to an earlier turn and editing it
+    turns[3]["content"] = "What about hamsters?"
+    messages = json.dumps(turns[:4])
+    expected = tokenizer.encode(tokenizer.apply_chat_template(messages, template_str=template))
+    assert np.array_equal(encoder.encode(messages, template_str=template), expected)
+
+
 @pytest.mark.skipif(
     sysconfig.get_platform().endswith("arm64"),
     reason="Model is not available on arm64.",
@@ -689,6 +746,29 @@ def test_vision_preprocessing_load_image_from_bytes(test_data_path, relative_mod
     _ = processor(prompt, images=images)
 
 
+@pytest.mark.parametrize("relative_model_path", [Path("vision-preprocessing")])
+@pytest.mark.parametrize("relative_image_path", [Path("images") / "sheet.png"])
+def test_vision_preprocessing_cache(test_data_path, relative_model_path, relative_image_path):
+    config = og.Config(os.fspath(Path(test_data_path) / relative_model_path))
+    config.overlay('{"vision_cache": {"max_bytes": 268435456}}')
+    model = og.Model(config)
+
+    processor = model.create_multimodal_processor()
+
+    image_path = os.fspath(Path(test_data_path) / relative_image_path)
+    prompt = "<|user|>\n<|image_1|>\n Can you convert the table to markdown format?\n<|end|>\n<|assistant|>\n"
+    first = processor(prompt, images=og.Images.open(image_path))
+    with open(image_path, "rb") as image:
+        second = processor(prompt, images=og.Images.open_bytes(image.read()))
+
+    # The same image bytes are preprocessed once, however they are loaded
+    assert model.get_statistic("vision_cache_misses") == 1
+    assert model.get_statistic("vision_cache_hits") == 1
+    assert model.get_statistic("vision_cache_bytes") > 0
+    np.testing.assert_array_equal(first["pixel_values"].as_numpy(), second["pixel_values"].as_numpy())
+    np.testing.assert_array_equal(first["vision_cache_key"].as_numpy(), second["vision_cache_key"].as_numpy())
+
+
 @pytest.mark.parametrize("relative_model_path", [Path("vision-preprocessing")])
 @pytest.mark.parametrize(
     "relative_image_paths",
@@ -59,6 +59,7 @@ struct BenchmarkResult {
   float latency_us;
   float latency_us_stdev;
   float latency_us_95_percentile;
+  float tokens_per_second;  // Sampled tokens per second across the batch
 };
 
 void PrintSummary(const std::vector<BenchmarkResult>& results) {
@@ -86,8 +87,9 @@ void PrintSummary(const std::vector<BenchmarkResult>& results) {
               << std::setw(12) << "Function"
               << std::setw(15) << "Latency(us)"
               << std::setw(15) << "Stdev(us)"
-              << std::setw(15) << "P95(us)" << "\n";
-    std::cout << std::string(82, '-') << "\n";
+              << std::setw(15) << "P95(us)"
+              << std::setw(15) << "Tokens/s" << "\n";
+    std::cout << std::string(97, '-') << "\n";
 
     for (const auto& result : device_results) {
       std::cout << std::left << std::fixed << std::setprecision(2)
@@ -98,6 +100,7 @@ void PrintSummary(const std::vector<BenchmarkResult>& results) {
                 << std::setw(15) << result.latency_us
                 << std::setw(15) << result.latency_us_stdev
                 << std::setw(15) << result.latency_us_95_percentile
+                << std::setw(15) << result.tokens_per_second
                 << "\n";
     }
     // clang-format on 
@@ -165,7 +168,7 @@ BenchmarkResult RunBenchmark(const BenchmarkParams& params) {
     auto stop = std::chrono::high_resolution_clock::now();
 
     if (i >= warm_up_runs) {
-      latencies.push_back(static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count()));
+      latencies.push_back(static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count()) / 1000.0);
     }
   }
 
@@ -173,7 +176,9 @@ BenchmarkResult RunBenchmark(const BenchmarkParams& params) {
   double stdev_us = stdev(latencies);
   double p95_us = percentile(latencies, 95.0);
 
-  return {params, static_cast<float>(mean_us), static_cast<float>(stdev_us), static_cast<float>(p95_us)};
+  double tokens_per_second = params.batch_size * 1e6 / mean_us;
+
+  return {params, static_cast<float>(mean_us), static_cast<float>(stdev_us), static_cast<float>(p95_us), static_cast<float>(tokens_per_second)};
 }
 
 TEST(SamplingBenchmarks, PerformanceTests) {
@@ -189,7 +194,7 @@ TEST(SamplingBenchmarks, PerformanceTests) {
   }
 
   std::vector<int> batch_sizes = {1};
-  std::vector<int> vocab_sizes = {201088};
+  std::vector<int> vocab_sizes = {32000, 128256, 201088};
   std::vector<int> ks = {1, 50};
 
   for (const auto& device_type : device_types) {
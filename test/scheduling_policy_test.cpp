@@ -0,0 +1,103 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "engine/scheduling_policy.h"
+
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace Generators::test {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Has the accessors of Request that the policies order requests by
+struct FakeRequest {
+  std::string name;
+  int32_t priority{};
+  size_t num_unprocessed_tokens{};
+  std::optional<Clock::time_point> deadline;
+  Clock::time_point arrival_time;
+
+  int32_t Priority() const { return priority; }
+  std::vector<int32_t> UnprocessedTokens() const { return std::vector<int32_t>(num_unprocessed_tokens); }
+  std::optional<Clock::time_point> Deadline() const { return deadline; }
+  Clock::time_point ArrivalTime() const { return arrival_time; }
+};
+
+const Clock::time_point start = Clock::now();
+
+std::shared_ptr<FakeRequest> MakeRequest(std::string name, int arrival_ms, int32_t priority, size_t num_unprocessed_tokens,
+                                         std::optional<int> deadline_ms = std::nullopt) {
+  auto request = std::make_shared<FakeRequest>();
+  request->name = std::move(name);
+  request->arrival_time = start + std::chrono::milliseconds(arrival_ms);
+  request->priority = priority;
+  request->num_unprocessed_tokens = num_unprocessed_tokens;
+  if (deadline_ms)
+    request->deadline = start + std::chrono::milliseconds(*deadline_ms);
+  return request;
+}
+
+// Sorts the requests with the named policy and returns their names in order
+std::vector<std::string> Order(std::string_view policy_name, std::vector<std::shared_ptr<FakeRequest>> requests) {
+  SchedulingPolicy::Create(policy_name)->Sort(requests);
+  std::vector<std::string> names;
+  for (const auto& request : requests)
+    names.push_back(request->name);
+  return names;
+}
+
+// Added out of arrival order, so that each policy has to reorder them
+std::vector<std::shared_ptr<FakeRequest>> Requests() {
+  return {MakeRequest("c", 30, 1, 8, 100),
+          MakeRequest("a", 10, 0, 64),
+          MakeRequest("d", 40, 5, 16, 50),
+          MakeRequest("b", 20, 5, 4, 200)};
+}
+
+}  // namespace
+
+TEST(SchedulingPolicyTest, FirstComeFirstServed) {
+  EXPECT_EQ(Order("fcfs", Requests()), (std::vector<std::string>{"a", "b", "c", "d"}));
+}
+
+TEST(SchedulingPolicyTest, Priority) {
+  // b and d have the same priority, b arrived first
+  EXPECT_EQ(Order("priority", Requests()), (std::vector<std::string>{"b", "d", "c", "a"}));
+}
+
+TEST(SchedulingPolicyTest, ShortestPromptFirst) {
+  EXPECT_EQ(Order("shortest_prompt_first", Requests()), (std::vector<std::string>{"b", "c", "d", "a"}));
+}
+
+TEST(SchedulingPolicyTest, EarliestDeadlineFirst) {
+  // a has no deadline, so it is served last
+  EXPECT_EQ(Order("earliest_deadline_first", Requests()), (std::vector<std::string>{"d", "c", "b", "a"}));
+}
+
+TEST(SchedulingPolicyTest, EqualRequestsAreServedInArrivalOrder) {
+  for (const char* policy_name : {"fcfs", "priority", "shortest_prompt_first", "earliest_deadline_first"}) {
+    // Equal priorities, prompt lengths and deadlines, and two requests without a deadline
+    std::vector<std::shared_ptr<FakeRequest>> requests{MakeRequest("c", 30, 1, 8, 100),
+                                                       MakeRequest("a", 10, 1, 8, 100),
+                                                       MakeRequest("b", 20, 1, 8, 100)};
+    EXPECT_EQ(Order(policy_name, requests), (std::vector<std::string>{"a", "b", "c"})) << policy_name;
+
+    std::vector<std::shared_ptr<FakeRequest>> no_deadlines{MakeRequest("b", 20, 1, 8), MakeRequest("a", 10, 1, 8)};
+    EXPECT_EQ(Order(policy_name, no_deadlines), (std::vector<std::string>{"a", "b"})) << policy_name;
+  }
+}
+
+TEST(SchedulingPolicyTest, UnsupportedPolicy) {
+  EXPECT_THROW(SchedulingPolicy::Create("round_robin"), std::runtime_error);
+}
+
+}  // namespace Generators::test
@@ -0,0 +1,68 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "engine/swap_file.h"
+
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace Generators::test {
+
+namespace {
+
+std::filesystem::path SwapFilePath() {
+  return std::filesystem::temp_directory_path() / "oga_swap_file_test.bin";
+}
+
+uint8_t Pattern(size_t index) {
+  return static_cast<uint8_t>(index * 31 + 7);
+}
+
+}  // namespace
+
+TEST(SwapFileTest, WritesAndReadsBack) {
+  const auto path = SwapFilePath();
+  {
+    constexpr size_t size = 3 * 4096 + 100;  // Not a whole number of pages
+    SwapFile swap_file{fs::path{path.string()}, size};
+    auto data = swap_file.Data();
+    ASSERT_EQ(data.size(), size);
+
+    for (size_t i = 0; i < data.size(); i++) {
+      data[i] = Pattern(i);
+    }
+    for (size_t i = 0; i < data.size(); i++) {
+      ASSERT_EQ(data[i], Pattern(i)) << "offset " << i;
+    }
+  }
+
+  EXPECT_FALSE(std::filesystem::exists(path));
+}
+
+TEST(SwapFileTest, PrefetchKeepsTheData) {
+  constexpr size_t size = 64 * 1024;
+  SwapFile swap_file{fs::path{SwapFilePath().string()}, size};
+  auto data = swap_file.Data();
+  for (size_t i = 0; i < data.size(); i++) {
+    data[i] = Pattern(i);
+  }
+
+  // Ranges that start inside a page, span several pages and end at the end of the file
+  swap_file.Prefetch(0, size);
+  swap_file.Prefetch(100, 10);
+  swap_file.Prefetch(4095, 4098);
+  swap_file.Prefetch(size - 1, 1);
+
+  for (size_t i = 0; i < data.size(); i++) {
+    ASSERT_EQ(data[i], Pattern(i)) << "offset " << i;
+  }
+}
+
+TEST(SwapFileTest, EmptyFileThrows) {
+  EXPECT_THROW(SwapFile(fs::path{SwapFilePath().string()}, 0), std::runtime_error);
+}
+
+}  // namespace Generators::test
@@ -0,0 +1,100 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "models/threadpool.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace Generators::test {
+
+TEST(ThreadPoolTest, ParallelForVisitsEveryIndexOnce) {
+  constexpr size_t count = 1000;
+
+  ThreadPool thread_pool{4};
+  std::vector<std::atomic<int>> visits(count);
+
+  for (size_t iteration = 0; iteration < 16; ++iteration) {
+    thread_pool.ParallelFor(count, [&](size_t i) { ++visits[i]; });
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    EXPECT_EQ(visits[i], 16);
+  }
+}
+
+TEST(ThreadPoolTest, NestedParallelFor) {
+  constexpr size_t outer_count = 8;
+  constexpr size_t inner_count = 64;
+
+  ThreadPool thread_pool{3};
+  std::atomic<size_t> work_counter = 0;
+
+  thread_pool.ParallelFor(outer_count, [&](size_t) {
+    thread_pool.ParallelFor(inner_count, [&](size_t) { ++work_counter; });
+  });
+
+  EXPECT_EQ(work_counter, outer_count * inner_count);
+}
+
+TEST(ThreadPoolTest, CallerOnlyRunsItsOwnTasks) {
+  ThreadPool thread_pool{1};
+  std::atomic<size_t> num_started = 0;
+  std::atomic<bool> release = false;
+
+  // A long call whose tasks block the worker and its own caller
+  std::thread long_caller{[&] {
+    thread_pool.ParallelFor(8, [&](size_t) {
+      ++num_started;
+      while (!release) {
+        std::this_thread::yield();
+      }
+    });
+  }};
+  while (num_started < 2) {
+    std::this_thread::yield();
+  }
+
+  // Would never return if this caller picked up one of the blocked tasks of the long call
+  std::atomic<size_t> work_counter = 0;
+  thread_pool.ParallelFor(16, [&](size_t) { ++work_counter; });
+  EXPECT_EQ(work_counter, 16);
+
+  release = true;
+  long_caller.join();
+  EXPECT_EQ(num_started, 8);
+}
+
+TEST(ThreadPoolTest, ParallelForRethrowsException) {
+  ThreadPool thread_pool{2};
+  std::atomic<size_t> work_counter = 0;
+
+  EXPECT_THROW(thread_pool.ParallelFor(100, [&](size_t i) {
+    ++work_counter;
+    if (i == 42) {
+      throw std::runtime_error("failed");
+    }
+  }),
+               std::runtime_error);
+
+  // The pool is still usable after a failed call
+  work_counter = 0;
+  thread_pool.ParallelFor(100, [&](size_t) { ++work_counter; });
+  EXPECT_EQ(work_counter, 100);
+}
+
+TEST(ThreadPoolTest, NoWorkerThreads) {
+  ThreadPool thread_pool{0};
+  size_t work_counter = 0;
+
+  thread_pool.ParallelFor(10, [&](size_t) { ++work_counter; });
+
+  EXPECT_EQ(thread_pool.NumThreads(), 1);
+  EXPECT_EQ(work_counter, 10);
+}
+
+}  // namespace Generators::test
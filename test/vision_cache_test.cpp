@@ -0,0 +1,81 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "models/vision_cache.h"
+
+#include <numeric>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace Generators::test {
+
+namespace {
+
+struct FakeEntry : VisionCacheEntry {
+  explicit FakeEntry(size_t size) : size_{size} {}
+  size_t SizeInBytes() const override { return size_; }
+  size_t size_;
+};
+
+std::shared_ptr<const VisionCacheEntry> MakeEntry(size_t size) {
+  return std::make_shared<FakeEntry>(size);
+}
+
+}  // namespace
+
+TEST(VisionCacheTest, EvictsLeastRecentlyUsed) {
+  VisionCache cache{100};
+  auto first = MakeEntry(40);
+  cache.Insert(1, first);
+  cache.Insert(2, MakeEntry(40));
+  EXPECT_EQ(cache.Lookup(1), first);  // Now 2 is the least recently used
+
+  cache.Insert(3, MakeEntry(40));
+  EXPECT_EQ(cache.Lookup(2), nullptr);
+  EXPECT_NE(cache.Lookup(1), nullptr);
+  EXPECT_NE(cache.Lookup(3), nullptr);
+
+  cache.Insert(4, MakeEntry(101));  // Larger than the whole budget
+  EXPECT_EQ(cache.Lookup(4), nullptr);
+
+  const auto stats = cache.Stats();
+  EXPECT_EQ(stats.num_entries, 2);
+  EXPECT_EQ(stats.size_in_bytes, 80);
+  EXPECT_EQ(stats.num_hits, 3);
+  EXPECT_EQ(stats.num_misses, 2);
+  EXPECT_EQ(stats.num_evictions, 1);
+}
+
+TEST(VisionCacheTest, ReplacesAndClears) {
+  VisionCache cache{100};
+  cache.Insert(1, MakeEntry(30));
+  cache.Insert(1, MakeEntry(50));
+  EXPECT_EQ(cache.Stats().num_entries, 1);
+  EXPECT_EQ(cache.Stats().size_in_bytes, 50);
+
+  cache.Clear();
+  EXPECT_EQ(cache.Lookup(1), nullptr);
+  EXPECT_EQ(cache.Stats().size_in_bytes, 0);
+}
+
+TEST(VisionCacheTest, HashContent) {
+  std::vector<uint8_t> bytes(1000);
+  std::iota(bytes.begin(), bytes.end(), uint8_t{});
+
+  // Every length exercises a different mix of the 32 byte, 8 byte, 4 byte and single byte steps
+  std::vector<uint64_t> hashes;
+  for (size_t size = 0; size <= 70; size++)
+    hashes.push_back(HashContent(bytes.data(), size));
+  for (size_t i = 0; i < hashes.size(); i++)
+    for (size_t j = i + 1; j < hashes.size(); j++)
+      EXPECT_NE(hashes[i], hashes[j]) << i << " " << j;
+
+  const uint64_t hash = HashContent(bytes.data(), bytes.size());
+  EXPECT_EQ(HashContent(bytes.data(), bytes.size()), hash);
+  EXPECT_NE(HashContent(bytes.data(), bytes.size(), 1), hash);
+  bytes[500] ^= 1;
+  EXPECT_NE(HashContent(bytes.data(), bytes.size()), hash);
+}
+
+}  // namespace Generators::test
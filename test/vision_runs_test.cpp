@@ -0,0 +1,90 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "models/vision_runs.h"
+
+#include <stdexcept>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace Generators::test {
+
+namespace {
+
+constexpr int64_t spatial_merge_size = 2;  // 4 patches per feature
+
+void ExpectRun(const VisionRun& run, std::vector<int64_t> grid, int64_t patch_offset, int64_t num_patches, int64_t feat_offset, int64_t num_feats) {
+  EXPECT_EQ(std::vector<int64_t>(run.grid, run.grid + 3), grid);
+  EXPECT_EQ(run.patch_offset, patch_offset);
+  EXPECT_EQ(run.num_patches, num_patches);
+  EXPECT_EQ(run.feat_offset, feat_offset);
+  EXPECT_EQ(run.num_feats, num_feats);
+}
+
+// Three 4x4 images, one of them with 2 frames, then an 8x4 image: 16, 16, 32 and 32 patches
+const std::vector<int64_t> grid_thw{1, 4, 4, 1, 4, 4, 2, 4, 4, 1, 8, 4};
+constexpr int64_t num_images = 4, total_patches = 96, total_feats = 24;
+
+}  // namespace
+
+TEST(VisionRunsTest, PacksConsecutiveImagesOfTheSameSize) {
+  auto runs = SplitVisionRuns(grid_thw.data(), num_images, total_patches, total_feats, spatial_merge_size, 1024);
+
+  // The 4x4 images are the frames of one grid, the 8x4 image has a different size
+  ASSERT_EQ(runs.size(), 2);
+  ExpectRun(runs[0], {4, 4, 4}, 0, 64, 0, 16);
+  ExpectRun(runs[1], {1, 8, 4}, 64, 32, 16, 8);
+}
+
+TEST(VisionRunsTest, PacksUpToMaxPackedPatches) {
+  auto runs = SplitVisionRuns(grid_thw.data(), num_images, total_patches, total_feats, spatial_merge_size, 32);
+
+  ASSERT_EQ(runs.size(), 3);
+  ExpectRun(runs[0], {2, 4, 4}, 0, 32, 0, 8);
+  ExpectRun(runs[1], {2, 4, 4}, 32, 32, 8, 8);
+  ExpectRun(runs[2], {1, 8, 4}, 64, 32, 16, 8);
+}
+
+TEST(VisionRunsTest, RunsEveryImageWithoutPacking) {
+  auto runs = SplitVisionRuns(grid_thw.data(), num_images, total_patches, total_feats, spatial_merge_size, 0);
+
+  ASSERT_EQ(runs.size(), 4);
+  ExpectRun(runs[0], {1, 4, 4}, 0, 16, 0, 4);
+  ExpectRun(runs[1], {1, 4, 4}, 16, 16, 4, 4);
+  ExpectRun(runs[2], {2, 4, 4}, 32, 32, 8, 8);
+  ExpectRun(runs[3], {1, 8, 4}, 64, 32, 16, 8);
+}
+
+TEST(VisionRunsTest, DoesNotPackImagesOfDifferentSizes) {
+  const std::vector<int64_t> grids{1, 4, 4, 1, 4, 8, 1, 4, 4};
+  auto runs = SplitVisionRuns(grids.data(), 3, 64, 16, spatial_merge_size, 1024);
+
+  // Only consecutive images are packed, the last 4x4 image is not packed with the first
+  ASSERT_EQ(runs.size(), 3);
+  ExpectRun(runs[0], {1, 4, 4}, 0, 16, 0, 4);
+  ExpectRun(runs[1], {1, 4, 8}, 16, 32, 4, 8);
+  ExpectRun(runs[2], {1, 4, 4}, 48, 16, 12, 4);
+}
+
+TEST(VisionRunsTest, DoesNotPackTemporallyPaddedImages) {
+  // Both images are padded to 2 frames in pixel_values, the features are those of the grid
+  const std::vector<int64_t> grids{1, 4, 4, 1, 4, 4};
+  auto runs = SplitVisionRuns(grids.data(), 2, 64, 8, spatial_merge_size, 1024);
+
+  ASSERT_EQ(runs.size(), 2);
+  ExpectRun(runs[0], {1, 4, 4}, 0, 32, 0, 4);
+  ExpectRun(runs[1], {1, 4, 4}, 32, 32, 4, 4);
+}
+
+TEST(VisionRunsTest, ThrowsOnGridsThatDoNotFit) {
+  // image_features too small for the grids
+  EXPECT_THROW(SplitVisionRuns(grid_thw.data(), num_images, total_patches, total_feats - 1, spatial_merge_size, 0), std::runtime_error);
+  // pixel_values too small for the grids, and not a whole number of frames of every image either
+  EXPECT_THROW(SplitVisionRuns(grid_thw.data(), num_images, total_patches - 8, total_feats, spatial_merge_size, 0), std::runtime_error);
+  // A grid that does not merge into whole features
+  const std::vector<int64_t> odd_grid{1, 3, 3};
+  EXPECT_THROW(SplitVisionRuns(odd_grid.data(), 1, 9, 4, spatial_merge_size, 0), std::runtime_error);
+}
+
+}  // namespace Generators::test